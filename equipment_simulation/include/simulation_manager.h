@@ -1,13 +1,17 @@
 #pragma once
 
 #include "epoll.h"
+#include "io_uring.h"
 #include "message_buffer.h"
 #include "protocol_parser.h"
 #include "simulator_connections.h"
+#include "shm_channel.h"
 #include "socket.h"
+#include "udp_batch.h"
 #include <atomic>
 #include <memory>
 #include <string>
+#include <string_view>
 #include <thread>
 #include <unordered_map>
 
@@ -46,7 +50,13 @@ private:
   void heartbeat_loop();
   bool process_events(int nfds, struct epoll_event *events);
   void handle_server_data(int fd);
-  void process_single_message(int fd, const std::string &message);
+  // io_uring后端的事件循环（EMS_IO_BACKEND=io_uring）
+  void event_loop_uring();
+  // 处理收到的字节，连接被关闭时返回false
+  bool consume_server_data(int fd, const char *data, size_t len);
+  // 处理缓冲区中所有完整的帧，连接被关闭时返回false
+  bool dispatch_server_frames(int fd, MessageBuffer *msg_buffer);
+  void process_single_message(int fd, std::string_view message);
 
   // 连接管理
   bool create_equipment_connection(const std::string &equipment_id);
@@ -57,13 +67,15 @@ private:
                               bool success);
   void handle_heartbeat_response(int fd, const std::string &equipment_id);
   void handle_control_command(int fd, const std::string &equipment_id,
-                              const std::string &payload);
+                              const ProtocolParser::MessageView &message);
   void
   handle_status_query(int fd,
                       const std::string &equipment_id); // 新增：处理状态查询
-  // 新增：发送控制响应
+  // 发送控制响应，带回服务器在控制命令中给的请求ID
   void send_control_response(int fd, const std::string &equipment_id,
-                             bool success, const std::string &message);
+                             uint32_t request_id, bool success,
+                             const std::string &command_name,
+                             const std::string &message);
 
   //设备模拟操作
   bool simulate_turn_on(const std::string &equipment_id);
@@ -79,7 +91,11 @@ private:
   std::string get_current_time();
 
   // 消息发送
-  bool send_message(int fd, const std::vector<char> &message);
+  // request_id只在v2帧头中发送（回复服务器的请求时带回）
+  bool send_message(int fd, const std::vector<char> &message,
+                    uint32_t request_id = 0);
+  // 把一轮攒下的消息打包成BATCH帧从fd发出，返回发送成功的子消息数
+  size_t send_batched(int fd, std::vector<std::vector<char>> &messages);
   bool send_online_message(
       const std::string &equipment_id); // 修改：注册消息->上线消息
   bool send_heartbeat_message(const std::string &equipment_id);
@@ -89,16 +105,55 @@ private:
 
   // 工具函数
   MessageBuffer *get_message_buffer(int fd);
-  bool add_to_epoll(int fd);
+  bool add_to_event_loop(int fd);
+  void remove_from_event_loop(int fd);
   std::string get_command_name(ProtocolParser::ControlCommandType command_type);
 
   void send_power_reports(); // 新增：定时发送功耗报告
 
   // 成员变量
   std::unique_ptr<SimulatorConnections> connections_;
+  Epoll epoll_; // 模拟器自己的事件循环
+  // 非空表示使用io_uring后端，此时epoll_不使用
+  std::unique_ptr<IoUring> uring_;
+  // io_uring下用连接代数丢弃fd复用前的残留完成事件
+  std::mutex uring_mutex_;
+  std::unordered_map<int, uint32_t> uring_generations_;
+  uint32_t next_uring_generation_ = 1;
 
   std::string server_ip_;
   uint16_t server_port_;
+  // 非空时通过Unix域socket连接服务器（与服务器同机部署），不使用TCP
+  std::string unix_socket_path_;
+  // 非空时功耗报告经由UDP批量发送（EMS_UDP_PORT），
+  // 令牌来自上线响应，只在事件循环线程中访问
+  std::unique_ptr<UdpBatchSocket> udp_;
+  std::unordered_map<std::string, std::string> udp_tokens_;
+  // 发送使用的协议版本（EMS_PROTOCOL_VERSION=2时用二进制v2，
+  // 上线消息也用v2发送，服务器据此用v2回复），接收两种版本都支持
+  uint8_t protocol_version_ = ProtocolParser::PROTOCOL_V1;
+  // EMS_BATCH_TELEMETRY=1时模拟网关：首个设备建立连接，其余设备在这条
+  // 连接上逐个上线，一轮的心跳和功耗报告打包成BATCH帧一次发出
+  // （服务器只接受在发送连接上上线的设备的子消息）
+  bool batch_telemetry_ = false;
+  std::atomic<int> gateway_fd_{-1}; // 网关连接，未建立或已断开时为-1
+
+  // 非空时每个设备向该Unix域socket申请一条共享内存通道代替TCP连接
+  // （EMS_SHM_SOCKET，只支持epoll后端）。连接fd为通道的eventfd；
+  // 心跳线程和事件循环都会发送，写入方向用write_mutex串行化
+  struct ShmConnection {
+    std::shared_ptr<ShmChannel> channel;
+    std::mutex write_mutex;
+  };
+  std::string shm_socket_path_;
+  std::mutex shm_lock_;
+  std::unordered_map<int, std::shared_ptr<ShmConnection>> shm_connections_;
+  // 申请共享内存通道，返回本端eventfd，失败返回-1
+  int open_shm_channel();
+  // 连接建立之后的公共步骤：加入事件循环、登记连接、发送上线消息
+  bool finish_equipment_connection(const std::string &equipment_id, int fd);
+  std::shared_ptr<ShmConnection> get_shm_connection(int fd);
+  void close_shm_connection(int fd);
 
   std::unordered_map<int, std::unique_ptr<MessageBuffer>> message_buffers_;
 
@@ -123,6 +178,11 @@ private:
   std::mutex heartbeat_mutex_;
   std::atomic<bool> threads_started_{false};
 
+  // io_uring后端参数
+  static constexpr unsigned URING_QUEUE_DEPTH = 256;
+  static constexpr unsigned URING_BUFFER_COUNT = 1024;
+  static constexpr unsigned URING_BUFFER_SIZE = 2048;
+
   // 心跳间隔（秒）
   const int HEARTBEAT_INTERVAL_SECONDS = 5;
 };
\ No newline at end of file
@@ -25,6 +25,8 @@ public:
 
   // 连接管理
   bool add_connection(int fd, const std::string &equipment_id);
+  // 把设备挂到已有连接上（网关连接），关闭该连接时一起移除
+  bool add_gateway_equipment(int fd, const std::string &equipment_id);
   void remove_connection(int fd);
   void remove_connection_by_equipment_id(const std::string &equipment_id);
   bool has_connection(int fd) const;
@@ -39,6 +41,8 @@ public:
 
   // 设备查找
   std::shared_ptr<Equipment> get_equipment_by_fd(int fd);
+  // fd上的全部设备：连接的首个设备加上网关连接上挂的设备
+  std::vector<std::shared_ptr<Equipment>> get_equipments_by_fd(int fd);
   std::shared_ptr<Equipment>
   get_equipment_by_id(const std::string &equipment_id);
   int get_fd_by_equipment_id(const std::string &equipment_id);
@@ -87,12 +91,19 @@ private:
   std::unordered_map<int, std::shared_ptr<Equipment>>
       fd_to_equipment_;                                  // fd -> Equipment
   std::unordered_map<std::string, int> equipment_to_fd_; // equipment_id -> fd
+  // fd -> 网关连接上除首个设备外的其他设备
+  std::unordered_map<int, std::vector<std::shared_ptr<Equipment>>>
+      gateway_equipments_;
 
   // 读写锁保护共享数据
   mutable std::shared_mutex equipments_rw_lock_;
   mutable std::shared_mutex connections_rw_lock_;
 
   // 内部方法
+  // 以下两个需持有connections_rw_lock_写锁
+  void remove_gateway_equipments_locked(int fd);
+  // 设备是fd上网关挂的设备时解除并返回true，是连接的首个设备时返回false
+  bool detach_gateway_equipment_locked(int fd, const std::string &equipment_id);
   bool add_real_equipment(const std::string &equipment_id,
                           const std::string &equipment_name,
                           const std::string &equipment_type,
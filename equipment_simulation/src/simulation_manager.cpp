@@ -1,11 +1,15 @@
 #include "simulation_manager.h"
+#include "message_schema.h"
 
+#include <charconv>
 #include <chrono>
 #include <cstdlib> // 用于 rand()
 #include <cstring>
 #include <fcntl.h>
 #include <iomanip>
+#include <iterator>
 #include <iostream>
+#include <map>
 #include <sstream>
 #include <sys/epoll.h>
 #include <sys/socket.h>
@@ -42,13 +46,65 @@ bool SimulationManager::initialize(const std::string &server_ip,
   server_ip_ = server_ip;
   server_port_ = server_port;
 
-  // 初始化Epoll单例
-  Epoll &epoll = Epoll::get_instance();
-  if (!epoll.initialize()) {
+  // 初始化Epoll
+  if (!epoll_.initialize()) {
     std::cerr << "Epoll 初始化失败" << std::endl;
     return false;
   }
 
+  // 与服务器相同，通过EMS_IO_BACKEND选择io_uring后端，不可用时使用epoll
+  const char *backend = std::getenv("EMS_IO_BACKEND");
+  if (backend && std::string(backend) == "io_uring") {
+    auto uring = std::make_unique<IoUring>();
+    if (uring->initialize(URING_QUEUE_DEPTH) &&
+        uring->setup_buffer_ring(URING_BUFFER_COUNT, URING_BUFFER_SIZE)) {
+      uring_ = std::move(uring);
+      std::cout << "模拟器使用io_uring事件后端" << std::endl;
+    } else {
+      std::cerr << "io_uring初始化失败，回退到epoll" << std::endl;
+    }
+  }
+
+  // 与服务器同机时可以通过EMS_UNIX_SOCKET指定Unix域socket路径
+  const char *unix_socket = std::getenv("EMS_UNIX_SOCKET");
+  if (unix_socket && *unix_socket != '\0') {
+    unix_socket_path_ = unix_socket;
+  }
+
+  // 压测时通过EMS_SHM_SOCKET改用共享内存通道，排除内核网络栈的开销
+  const char *shm_socket = std::getenv("EMS_SHM_SOCKET");
+  if (shm_socket && *shm_socket != '\0') {
+    shm_socket_path_ = shm_socket;
+    if (uring_) {
+      std::cerr << "共享内存通道只支持epoll后端，不使用io_uring" << std::endl;
+      uring_.reset();
+    }
+  }
+
+  // 服务器开启UDP功耗上报时，通过EMS_UDP_PORT改用UDP批量发送功耗报告
+  const char *udp_port = std::getenv("EMS_UDP_PORT");
+  if (udp_port && std::atoi(udp_port) > 0) {
+    auto udp = std::make_unique<UdpBatchSocket>();
+    if (udp->connect(server_ip_, static_cast<uint16_t>(std::atoi(udp_port)))) {
+      udp_ = std::move(udp);
+      std::cout << "功耗报告经由UDP发送: 端口=" << udp_port << std::endl;
+    } else {
+      std::cerr << "UDP socket创建失败，功耗报告使用TCP发送" << std::endl;
+    }
+  }
+
+  const char *protocol = std::getenv("EMS_PROTOCOL_VERSION");
+  if (protocol && std::atoi(protocol) == ProtocolParser::PROTOCOL_V2) {
+    protocol_version_ = ProtocolParser::PROTOCOL_V2;
+    std::cout << "使用二进制协议v2" << std::endl;
+  }
+
+  const char *batch = std::getenv("EMS_BATCH_TELEMETRY");
+  if (batch && std::atoi(batch) == 1) {
+    batch_telemetry_ = true;
+    std::cout << "心跳和功耗报告按BATCH帧批量发送" << std::endl;
+  }
+
   // 从数据库加载设备信息
   if (!connections_->initialize_from_database(db_host, db_user, db_password,
                                               db_database, db_port)) {
@@ -57,7 +113,13 @@ bool SimulationManager::initialize(const std::string &server_ip,
   }
 
   std::cout << "SimulationManager 初始化成功" << std::endl;
-  std::cout << "服务器地址: " << server_ip_ << ":" << server_port_ << std::endl;
+  std::cout << "服务器地址: " << server_ip_ << ":" << server_port_;
+  if (!shm_socket_path_.empty()) {
+    std::cout << " (经由共享内存通道 " << shm_socket_path_ << ")";
+  } else if (!unix_socket_path_.empty()) {
+    std::cout << " (经由Unix域socket " << unix_socket_path_ << ")";
+  }
+  std::cout << std::endl;
   connections_->print_statistics();
 
   return true;
@@ -210,20 +272,89 @@ bool SimulationManager::connect_equipment(const std::string &equipment_id) {
 }
 
 void SimulationManager::disconnect_equipment(const std::string &equipment_id) {
+  int fd = connections_->get_fd_by_equipment_id(equipment_id);
+  auto owner = connections_->get_equipment_by_fd(fd);
+  if (owner && owner->get_equipment_id() != equipment_id) {
+    // 网关连接上挂的设备只解除映射，连接留给其他设备
+    connections_->close_connection_by_equipment_id(equipment_id);
+    return;
+  }
+  int gateway_fd = fd;
+  gateway_fd_.compare_exchange_strong(gateway_fd, -1);
+  if (uring_ && fd > 0) {
+    remove_from_event_loop(fd);
+  }
+  close_shm_connection(fd);
   connections_->close_connection_by_equipment_id(equipment_id);
 }
 
 void SimulationManager::disconnect_all_equipments() {
+  {
+    std::lock_guard<std::mutex> lock(shm_lock_);
+    shm_connections_.clear();
+  }
+  gateway_fd_.store(-1);
   connections_->close_all_connections();
 }
 
+int SimulationManager::open_shm_channel() {
+  int socket_fd = Socket::create_unix_socket();
+  if (socket_fd < 0) {
+    return -1;
+  }
+  // 握手socket保持阻塞，等服务器发来通道的fd后即关闭
+  std::unique_ptr<ShmChannel> channel;
+  if (Socket::connect_to_unix_socket(socket_fd, shm_socket_path_)) {
+    channel = ShmChannel::receive_handshake(socket_fd);
+  }
+  close(socket_fd);
+  if (!channel) {
+    return -1;
+  }
+  int fd = channel->notify_fd();
+  auto connection = std::make_shared<ShmConnection>();
+  connection->channel = std::move(channel);
+  std::lock_guard<std::mutex> lock(shm_lock_);
+  shm_connections_[fd] = std::move(connection);
+  return fd;
+}
+
+std::shared_ptr<SimulationManager::ShmConnection>
+SimulationManager::get_shm_connection(int fd) {
+  if (shm_socket_path_.empty()) {
+    return nullptr;
+  }
+  std::lock_guard<std::mutex> lock(shm_lock_);
+  auto it = shm_connections_.find(fd);
+  return it != shm_connections_.end() ? it->second : nullptr;
+}
+
+void SimulationManager::close_shm_connection(int fd) {
+  // 通道析构时通知服务器关闭；eventfd随连接一起关闭
+  std::lock_guard<std::mutex> lock(shm_lock_);
+  shm_connections_.erase(fd);
+}
+
 bool SimulationManager::create_equipment_connection(
     const std::string &equipment_id) {
   std::cout << "DEBUG create_equipment_connection: 开始为设备 " << equipment_id
             << " 创建连接" << std::endl;
 
+  // 批量模式下其余设备经由网关连接上线，不再各自建立连接
+  int gateway_fd = gateway_fd_.load();
+  if (batch_telemetry_ && gateway_fd >= 0 &&
+      connections_->add_gateway_equipment(gateway_fd, equipment_id)) {
+    send_online_message(equipment_id);
+    return true;
+  }
+
+  if (!shm_socket_path_.empty()) {
+    return finish_equipment_connection(equipment_id, open_shm_channel());
+  }
+
   // 创建socket
-  int fd = Socket::create_socket();
+  int fd = unix_socket_path_.empty() ? Socket::create_socket()
+                                     : Socket::create_unix_socket();
   if (fd < 0) {
     std::cerr << "DEBUG: ❌ 创建socket失败: " << equipment_id << std::endl;
     return false;
@@ -241,16 +372,29 @@ bool SimulationManager::create_equipment_connection(
   // 连接服务器
   std::cout << "DEBUG: 开始连接到服务器 " << server_ip_ << ":" << server_port_
             << std::endl;
-  if (!Socket::connect_to_socket(fd, server_ip_, server_port_)) {
+  bool connected = unix_socket_path_.empty()
+                       ? Socket::connect_to_socket(fd, server_ip_, server_port_)
+                       : Socket::connect_to_unix_socket(fd, unix_socket_path_);
+  if (!connected) {
     std::cerr << "DEBUG: ❌ 连接服务器失败: " << equipment_id << std::endl;
     close(fd);
     return false;
   }
   std::cout << "DEBUG: ✅ 连接服务器成功" << std::endl;
+  return finish_equipment_connection(equipment_id, fd);
+}
+
+bool SimulationManager::finish_equipment_connection(
+    const std::string &equipment_id, int fd) {
+  if (fd < 0) {
+    std::cerr << "DEBUG: ❌ 连接服务器失败: " << equipment_id << std::endl;
+    return false;
+  }
 
-  // 添加到Epoll
-  if (!add_to_epoll(fd)) {
+  // 添加到事件循环
+  if (!add_to_event_loop(fd)) {
     std::cerr << "DEBUG: ❌ 添加到Epoll失败: " << equipment_id << std::endl;
+    close_shm_connection(fd);
     close(fd);
     return false;
   }
@@ -259,7 +403,8 @@ bool SimulationManager::create_equipment_connection(
   // 添加到连接管理
   if (!connections_->add_connection(fd, equipment_id)) {
     std::cerr << "DEBUG: ❌ 添加到连接管理失败: " << equipment_id << std::endl;
-    Epoll::get_instance().delete_epoll(fd);
+    remove_from_event_loop(fd);
+    close_shm_connection(fd);
     close(fd);
     return false;
   }
@@ -267,6 +412,10 @@ bool SimulationManager::create_equipment_connection(
 
   std::cout << "设备连接成功: " << equipment_id << " (fd=" << fd << ")"
             << std::endl;
+  if (batch_telemetry_) {
+    int no_gateway = -1;
+    gateway_fd_.compare_exchange_strong(no_gateway, fd);
+  }
 
   // 发送上线消息（原注册消息）
   send_online_message(equipment_id);
@@ -274,25 +423,55 @@ bool SimulationManager::create_equipment_connection(
   return true;
 }
 
-bool SimulationManager::add_to_epoll(int fd) {
+bool SimulationManager::add_to_event_loop(int fd) {
+  if (uring_) {
+    // 连接建立后提交一个multishot recv，之后的数据都通过完成事件送达
+    uint32_t generation = 0;
+    {
+      std::lock_guard<std::mutex> lock(uring_mutex_);
+      generation = next_uring_generation_++ & 0xFFFFFF;
+      uring_generations_[fd] = generation;
+    }
+    uint64_t user_data = (static_cast<uint64_t>(generation) << 32) |
+                         static_cast<uint32_t>(fd);
+    return uring_->submit_multishot_recv(fd, user_data) &&
+           uring_->flush_submissions();
+  }
+
   std::cout << "DEBUG add_to_epoll: 添加fd=" << fd << "到epoll" << std::endl;
-  Epoll &epoll = Epoll::get_instance();
-  bool result = epoll.add_epoll(fd, EPOLLIN | EPOLLET | EPOLLRDHUP);
+  bool result = epoll_.add_epoll(fd, EPOLLIN | EPOLLET | EPOLLRDHUP);
   std::cout << "DEBUG add_to_epoll: 结果=" << (result ? "成功" : "失败")
             << std::endl;
   return result;
 }
 
+void SimulationManager::remove_from_event_loop(int fd) {
+  if (uring_) {
+    {
+      std::lock_guard<std::mutex> lock(uring_mutex_);
+      uring_generations_.erase(fd);
+    }
+    // 未完成的recv持有socket引用，必须在close之前取消
+    uring_->submit_cancel_fd(fd, IoUring::INTERNAL_USER_DATA);
+    uring_->flush_submissions();
+    return;
+  }
+  epoll_.delete_epoll(fd);
+}
+
 void SimulationManager::event_loop() {
   std::cout << "进入事件循环..." << std::endl;
+  if (uring_) {
+    event_loop_uring();
+    return;
+  }
 
-  Epoll &epoll = Epoll::get_instance();
-  int max_events = epoll.get_epoll_max_events();
+  int max_events = epoll_.get_epoll_max_events();
   struct epoll_event *events = new epoll_event[max_events];
 
   while (is_running_) {
     // 使用较短的超时时间（10ms），避免长时间阻塞
-    int nfds = epoll.wait_events(events, 10);
+    int nfds = epoll_.wait_events(events, 10);
 
     if (nfds > 0) {
       if (!process_events(nfds, events)) {
@@ -323,6 +502,61 @@ void SimulationManager::event_loop() {
   std::cout << "退出事件循环" << std::endl;
 }
 
+void SimulationManager::event_loop_uring() {
+  std::vector<IoUring::Completion> completions(URING_QUEUE_DEPTH);
+
+  while (is_running_) {
+    int count = uring_->wait_completions(
+        completions.data(), static_cast<int>(completions.size()), 10);
+    if (count < 0) {
+      std::cerr << "io_uring等待完成事件错误: " << strerror(errno)
+                << std::endl;
+      break;
+    }
+
+    for (int i = 0; i < count; i++) {
+      const IoUring::Completion &c = completions[i];
+      if (c.user_data == IoUring::INTERNAL_USER_DATA) {
+        continue;
+      }
+      int fd = static_cast<int>(c.user_data & 0xFFFFFFFF);
+      uint32_t generation = static_cast<uint32_t>(c.user_data >> 32);
+
+      bool current = false;
+      {
+        std::lock_guard<std::mutex> lock(uring_mutex_);
+        auto it = uring_generations_.find(fd);
+        current = it != uring_generations_.end() && it->second == generation;
+      }
+      bool alive = current;
+      if (c.has_buffer()) {
+        if (current && c.res > 0) {
+          alive = consume_server_data(fd, uring_->buffer_data(c.buffer_id()),
+                                      static_cast<size_t>(c.res));
+        }
+        uring_->recycle_buffer(c.buffer_id());
+      }
+      if (!alive) {
+        continue;
+      }
+
+      if (c.res == 0) {
+        std::cout << "服务器关闭连接: fd=" << fd << std::endl;
+        handle_connection_close(fd);
+      } else if (c.res < 0 && c.res != -ENOBUFS) {
+        std::cerr << "接收数据错误: fd=" << fd << std::endl;
+        handle_connection_close(fd);
+      } else if (!c.has_more()) {
+        uring_->submit_multishot_recv(fd, c.user_data);
+      }
+    }
+
+    // 定期执行维护任务
+    perform_maintenance_tasks();
+  }
+  std::cout << "退出事件循环" << std::endl;
+}
+
 void SimulationManager::heartbeat_loop() {
   std::cout << "心跳线程启动，间隔: " << HEARTBEAT_INTERVAL_SECONDS << "秒"
             << std::endl;
@@ -378,32 +612,22 @@ bool SimulationManager::process_events(int nfds, struct epoll_event *events) {
 }
 
 void SimulationManager::handle_server_data(int fd) {
-  char buffer[2048];
+  MessageBuffer *msg_buffer = get_message_buffer(fd);
+  // 共享内存通道：只有事件循环线程读取
+  std::shared_ptr<ShmConnection> shm = get_shm_connection(fd);
 
   while (true) {
-    int bytes_received = recv(fd, buffer, sizeof(buffer), 0);
+    ssize_t bytes_received =
+        shm ? msg_buffer->read_with(
+                  [&shm](const struct iovec *iov, int iov_count) {
+                    return shm->channel->readv(iov, iov_count);
+                  })
+            : msg_buffer->read_from_fd(fd);
 
     if (bytes_received > 0) {
-      // 追加到应用层缓冲区
-      MessageBuffer *msg_buffer = get_message_buffer(fd);
-      msg_buffer->append_data(buffer, bytes_received);
-
-      // 解析完整消息
-      std::vector<std::string> complete_messages;
-      size_t extracted_count = msg_buffer->extract_messages(complete_messages);
-
-      // 处理所有完整消息
-      for (const auto &message : complete_messages) {
-        process_single_message(fd, message);
-      }
-
-      // 检查缓冲区是否异常
-      if (msg_buffer->is_too_large()) {
-        std::cerr << "连接 " << fd << " 缓冲区异常，关闭连接" << std::endl;
-        handle_connection_close(fd);
+      if (!dispatch_server_frames(fd, msg_buffer)) {
         return;
       }
-
     } else if (bytes_received == 0) {
       // 连接正常关闭
       std::cout << "服务器关闭连接: fd=" << fd << std::endl;
@@ -424,8 +648,33 @@ void SimulationManager::handle_server_data(int fd) {
   }
 }
 
+bool SimulationManager::consume_server_data(int fd, const char *data,
+                                            size_t len) {
+  // 追加到应用层缓冲区
+  MessageBuffer *msg_buffer = get_message_buffer(fd);
+  msg_buffer->append_data(data, len);
+  return dispatch_server_frames(fd, msg_buffer);
+}
+
+bool SimulationManager::dispatch_server_frames(int fd,
+                                               MessageBuffer *msg_buffer) {
+  // 逐帧处理，帧视图直接指向缓冲区
+  std::string_view frame;
+  while (msg_buffer->next_frame(frame)) {
+    process_single_message(fd, frame);
+  }
+
+  // 检查缓冲区是否异常
+  if (msg_buffer->is_too_large()) {
+    std::cerr << "连接 " << fd << " 缓冲区异常，关闭连接" << std::endl;
+    handle_connection_close(fd);
+    return false;
+  }
+  return true;
+}
+
 void SimulationManager::process_single_message(int fd,
-                                               const std::string &message) {
+                                               std::string_view message) {
   auto equipment = connections_->get_equipment_by_fd(fd);
   if (!equipment) {
     std::cerr << "找不到fd对应的设备: " << fd << std::endl;
@@ -433,27 +682,44 @@ void SimulationManager::process_single_message(int fd,
   }
 
   std::string equipment_id = equipment->get_equipment_id();
-  auto parse_result = ProtocolParser::parse_message(message);
-
-  if (!parse_result.success) {
+  // 视图指向读缓冲区中的帧，只在本函数内使用
+  ProtocolParser::MessageView parse_result;
+  if (ProtocolParser::parse_message(message, parse_result) !=
+      ProtocolParser::PARSE_OK) {
     std::cout << "协议解析失败: " << message << " from " << equipment_id
               << std::endl;
     return;
   }
+  // 网关连接上有多个设备，按消息头的设备ID找到消息是发给哪个设备的
+  std::string addressed(parse_result.equipment_id);
+  if (addressed != equipment_id &&
+      connections_->get_fd_by_equipment_id(addressed) == fd) {
+    equipment_id = std::move(addressed);
+  }
 
   std::cout << "收到服务器消息: " << equipment_id
             << " -> 类型: " << parse_result.type
-            << " payload: " << parse_result.payload << std::endl;
+            << " payload: " << parse_result.payload_text() << std::endl;
 
   switch (parse_result.type) {
-  case ProtocolParser::ONLINE_RESPONSE: // 修改：注册响应->上线响应
-    handle_online_response(fd, equipment_id, parse_result.payload == "success");
+  case ProtocolParser::ONLINE_RESPONSE: { // 修改：注册响应->上线响应
+    // payload: "success" 或 "success|UDP令牌"（服务器开启UDP上报时）
+    using Response = message_schema::OnlineResponse;
+    message_schema::Decoded<Response> response;
+    bool success = response.decode(parse_result) == message_schema::DECODE_OK &&
+                   response.text<Response::RESULT>() == "success";
+    if (success && response.has<Response::UDP_TOKEN>()) {
+      udp_tokens_[equipment_id] =
+          std::string(response.text<Response::UDP_TOKEN>());
+    }
+    handle_online_response(fd, equipment_id, success);
     break;
+  }
   case ProtocolParser::HEARTBEAT_RESPONSE:
     handle_heartbeat_response(fd, equipment_id);
     break;
   case ProtocolParser::CONTROL_COMMAND:
-    handle_control_command(fd, equipment_id, parse_result.payload);
+    handle_control_command(fd, equipment_id, parse_result);
     break;
   case ProtocolParser::STATUS_QUERY:
     handle_status_query(fd, equipment_id);
@@ -505,31 +771,35 @@ void SimulationManager::handle_heartbeat_response(
 }
 
 // 处理控制命令
-void SimulationManager::handle_control_command(int fd,
-                                               const std::string &equipment_id,
-                                               const std::string &payload) {
-  std::cout << "执行控制命令: " << equipment_id << " -> " << payload
-            << std::endl;
-
-  // 解析控制命令 (格式: "qt_fd|command_type|parameters")
-  auto parts = ProtocolParser::split_string(payload, '|');
-  if (parts.size() < 2) {
-    std::cout << "控制命令格式错误: " << payload << std::endl;
-    send_control_response(fd, equipment_id, false, "format_error");
+void SimulationManager::handle_control_command(
+    int fd, const std::string &equipment_id,
+    const ProtocolParser::MessageView &message) {
+  std::cout << "执行控制命令: " << equipment_id << " -> "
+            << message.payload_text() << std::endl;
+
+  // 解析控制命令 (格式: "command_type|request_id[|...]")
+  using Command = message_schema::ControlCommand;
+  message_schema::Decoded<Command> command;
+  message_schema::DecodeStatus status = command.decode(message);
+  if (status != message_schema::DECODE_OK) {
+    std::cout << "控制命令格式错误: 字段=" << command.error_field()
+              << " 错误码=" << status << std::endl;
     return;
   }
-  std::cout << payload << std::endl;
 
-  int command_type;
-  try {
-    command_type = std::stoi(parts[0]);
-  } catch (const std::exception &e) {
-    std::cout << "控制命令类型解析错误: " << parts[0] << std::endl;
-    send_control_response(fd, equipment_id, false, "invalid_command_type");
-    return;
+  int command_type = command.integer<Command::COMMAND_TYPE>();
+  // 请求ID：v2在帧头，v1服务器只放在parameters的第一段。
+  // 第一段总是请求ID，之后才是命令参数
+  std::string_view parameters = command.text<Command::PARAMETERS>();
+  size_t id_end = parameters.find('|');
+  std::string_view id_text = parameters.substr(0, id_end);
+  parameters = id_end == std::string_view::npos ? std::string_view()
+                                                : parameters.substr(id_end + 1);
+  uint32_t request_id = message.request_id;
+  if (request_id == 0) {
+    std::from_chars(id_text.data(), id_text.data() + id_text.size(),
+                    request_id);
   }
-
-  std::string parameters = parts.size() > 1 ? parts[1] : "";
   std::cout << "parameter: " << parameters << std::endl;
   bool success = false;
   std::string result_message = "";
@@ -549,25 +819,19 @@ void SimulationManager::handle_control_command(int fd,
     result_message = success ? "设备已重启" : "设备重启失败";
     break;
   case ProtocolParser::ADJUST_SETTINGS:
-    success = simulate_adjust_settings(equipment_id, parameters);
+    success = simulate_adjust_settings(equipment_id, std::string(parameters));
     result_message = success ? "设置已调整" : "设置调整失败";
     break;
   default:
     result_message = "未知控制命令";
     break;
   }
-  std::string parts_after_qt_fd{};
-  if (!success) {
-    parts_after_qt_fd = "fail";
-  }
-  parts_after_qt_fd = "success";
   // 发送控制响应
   send_control_response(
-      fd, equipment_id, success,
-      parameters + '|' + parts_after_qt_fd + '|' +
-          get_command_name(
-              static_cast<ProtocolParser::ControlCommandType>(command_type)) +
-          '|' + result_message);
+      fd, equipment_id, request_id, success,
+      get_command_name(
+          static_cast<ProtocolParser::ControlCommandType>(command_type)),
+      result_message);
 }
 
 // 新增：处理状态查询
@@ -578,17 +842,24 @@ void SimulationManager::handle_status_query(int fd,
 }
 
 // 发送控制响应
+// payload: "request_id|success/fail|命令名|结果说明"，
+// 服务端按request_id找到发起请求的Qt客户端
 void SimulationManager::send_control_response(int fd,
                                               const std::string &equipment_id,
+                                              uint32_t request_id,
                                               bool success,
-                                              const std::string &parameters) {
-  std::vector<char> response = ProtocolParser::build_control_response(
-      ProtocolParser::CLIENT_EQUIPMENT, equipment_id, success, parameters);
-
-  if (send_message(fd, response)) {
+                                              const std::string &command_name,
+                                              const std::string &message) {
+  std::vector<char> response =
+      message_schema::build<message_schema::ControlResponse>(
+          ProtocolParser::CLIENT_EQUIPMENT, equipment_id,
+          std::to_string(request_id), success ? "success" : "fail",
+          command_name, message);
+
+  if (send_message(fd, response, request_id)) {
     std::cout << "控制响应已发送: " << equipment_id
-              << " 结果: " << (success ? "成功" : "失败") << " parameters "
-              << parameters << std::endl;
+              << " 结果: " << (success ? "成功" : "失败") << " 命令 "
+              << command_name << " " << message << std::endl;
   } else {
     std::cout << "控制响应发送失败: " << equipment_id << std::endl;
   }
@@ -649,14 +920,18 @@ std::string SimulationManager::get_command_name(
 
 void SimulationManager::handle_connection_close(int fd) {
 
-  auto equipment = connections_->get_equipment_by_fd(fd);
-  if (equipment) {
+  for (const auto &equipment : connections_->get_equipments_by_fd(fd)) {
     std::cout << "设备断开连接: " << equipment->get_equipment_id()
               << " (fd=" << fd << ")" << std::endl;
+    // 令牌随TCP会话失效，重连后使用新的上线响应中的令牌
+    udp_tokens_.erase(equipment->get_equipment_id());
   }
+  int gateway_fd = fd;
+  gateway_fd_.compare_exchange_strong(gateway_fd, -1);
+  close_shm_connection(fd);
 
-  // 从Epoll中移除
-  Epoll::get_instance().delete_epoll(fd);
+  // 从事件循环中移除
+  remove_from_event_loop(fd);
 
   // 清理消息缓冲区
   {
@@ -698,6 +973,9 @@ void SimulationManager::send_heartbeats() {
 
   int success_count = 0;
   int fail_count = 0;
+  // 批量模式下本轮心跳按连接攒起来，每条连接一次发出
+  // （网关连接上的设备共用一帧）
+  std::map<int, std::vector<std::vector<char>>> batches;
 
   for (const auto &equipment : connected_equipments) {
     std::string equipment_id = equipment->get_equipment_id();
@@ -711,6 +989,12 @@ void SimulationManager::send_heartbeats() {
       continue;
     }
 
+    if (batch_telemetry_) {
+      batches[fd].push_back(ProtocolParser::build_heartbeat_message(
+          ProtocolParser::CLIENT_EQUIPMENT, equipment_id));
+      continue;
+    }
+
     // 发送心跳
     if (send_heartbeat_message(equipment_id)) {
       success_count++;
@@ -727,6 +1011,13 @@ void SimulationManager::send_heartbeats() {
     std::this_thread::sleep_for(std::chrono::milliseconds(10));
   }
 
+  for (auto &[fd, batch] : batches) {
+    size_t total = batch.size();
+    size_t sent = send_batched(fd, batch);
+    success_count += static_cast<int>(sent);
+    fail_count += static_cast<int>(total - sent);
+  }
+
   std::cout << "[" << get_current_time()
             << "] 心跳发送完成 - 成功: " << success_count
             << ", 失败: " << fail_count << std::endl;
@@ -749,13 +1040,34 @@ std::string SimulationManager::get_current_time() {
   return ss.str();
 }
 
-bool SimulationManager::send_message(int fd, const std::vector<char> &message) {
+bool SimulationManager::send_message(int fd,
+                                     const std::vector<char> &v1_message,
+                                     uint32_t request_id) {
+  // 消息都按v1构建，使用v2时在发送前转换
+  std::vector<char> converted;
+  if (protocol_version_ == ProtocolParser::PROTOCOL_V2) {
+    converted = ProtocolParser::convert_to_v2(v1_message, request_id);
+  }
+  const std::vector<char> &message = converted.empty() ? v1_message : converted;
   ssize_t send_bytes = 0;
   ssize_t message_len = static_cast<ssize_t>(message.size());
+  std::shared_ptr<ShmConnection> shm = get_shm_connection(fd);
+  std::unique_lock<std::mutex> shm_write_lock;
+  if (shm) {
+    shm_write_lock = std::unique_lock<std::mutex>(shm->write_mutex);
+  }
 
   while (send_bytes < message_len) {
-    ssize_t n_bytes =
-        send(fd, message.data() + send_bytes, message_len - send_bytes, 0);
+    ssize_t n_bytes;
+    if (shm) {
+      struct iovec iov {};
+      iov.iov_base = const_cast<char *>(message.data()) + send_bytes;
+      iov.iov_len = static_cast<size_t>(message_len - send_bytes);
+      n_bytes = shm->channel->writev(&iov, 1);
+    } else {
+      n_bytes =
+          send(fd, message.data() + send_bytes, message_len - send_bytes, 0);
+    }
     if (n_bytes < 0) {
       if (errno == EINTR) {
         continue;
@@ -771,6 +1083,51 @@ bool SimulationManager::send_message(int fd, const std::vector<char> &message) {
   return true;
 }
 
+size_t
+SimulationManager::send_batched(int fd,
+                                std::vector<std::vector<char>> &messages) {
+  // 子消息各自按协议版本转换；外层BATCH帧由send_message转换
+  if (protocol_version_ == ProtocolParser::PROTOCOL_V2) {
+    for (auto &message : messages) {
+      std::vector<char> converted = ProtocolParser::convert_to_v2(message);
+      if (!converted.empty()) {
+        message = std::move(converted);
+      }
+    }
+  }
+
+  // 每帧不超过MAX_BATCH_MESSAGES条，字节数留在服务器64KB接收缓冲区的一半以内
+  constexpr size_t max_frame_bytes = 32 * 1024;
+  size_t sent = 0;
+  size_t frames = 0;
+  size_t begin = 0;
+  while (begin < messages.size()) {
+    size_t end = begin;
+    size_t bytes = 0;
+    while (end < messages.size() &&
+           end - begin < ProtocolParser::MAX_BATCH_MESSAGES &&
+           (end == begin || bytes + messages[end].size() <= max_frame_bytes)) {
+      bytes += messages[end].size();
+      ++end;
+    }
+    std::vector<std::vector<char>> group(
+        std::make_move_iterator(messages.begin() + begin),
+        std::make_move_iterator(messages.begin() + end));
+    if (send_message(fd, ProtocolParser::build_batch_message(
+                             ProtocolParser::CLIENT_EQUIPMENT, group))) {
+      sent += group.size();
+      ++frames;
+    }
+    begin = end;
+  }
+
+  std::cout << "[" << get_current_time() << "] BATCH发送: " << sent << "/"
+            << messages.size() << " 条, " << frames << " 帧 (fd=" << fd << ")"
+            << std::endl;
+  messages.clear();
+  return sent;
+}
+
 // 修改：发送上线消息（原注册消息）
 bool SimulationManager::send_online_message(const std::string &equipment_id) {
   auto equipment = connections_->get_equipment_by_id(equipment_id);
@@ -894,6 +1251,10 @@ void SimulationManager::print_status() const {
 
 void SimulationManager::send_power_reports() {
   auto connected_equipments = connections_->get_connected_equipments();
+  // 拿到UDP令牌的设备攒成一批，最后一次sendmmsg发出
+  std::vector<std::string> datagrams;
+  // 批量模式下其余设备的TCP报告按连接攒成BATCH帧
+  std::map<int, std::vector<std::vector<char>>> batches;
 
   for (const auto &equipment : connected_equipments) {
     std::string equipment_id = equipment->get_equipment_id();
@@ -922,13 +1283,33 @@ void SimulationManager::send_power_reports() {
 
     // 构建 payload: "power_state|power_value|timestamp"
     std::string timestamp = get_current_time();
+    auto token = udp_tokens_.find(equipment_id);
+    if (udp_ && token != udp_tokens_.end()) {
+      datagrams.push_back(ProtocolParser::build_udp_power_report(
+          equipment_id, equipment->get_power_state(), current_power, timestamp,
+          token->second));
+      continue;
+    }
     std::vector<char> msg = ProtocolParser::build_power_report_message(
         ProtocolParser::CLIENT_EQUIPMENT, equipment_id,
         equipment->get_power_state(), current_power, timestamp);
+    if (batch_telemetry_) {
+      batches[fd].push_back(std::move(msg));
+      continue;
+    }
 
     send_message(fd, msg);
 
     std::cout << "[" << timestamp << "] 发送功耗报告: " << equipment_id
               << std::endl;
   }
+
+  if (!datagrams.empty()) {
+    size_t sent = udp_->send_batch(datagrams);
+    std::cout << "[" << get_current_time() << "] UDP发送功耗报告: " << sent
+              << "/" << datagrams.size() << std::endl;
+  }
+  for (auto &[fd, batch] : batches) {
+    send_batched(fd, batch);
+  }
 }
\ No newline at end of file
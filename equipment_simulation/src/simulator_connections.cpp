@@ -129,6 +129,70 @@ bool SimulatorConnections::add_connection(int fd,
   return true;
 }
 
+bool SimulatorConnections::add_gateway_equipment(
+    int fd, const std::string &equipment_id) {
+  std::shared_lock equip_lock(equipments_rw_lock_);
+  std::unique_lock conn_lock(connections_rw_lock_);
+
+  auto equip_it = real_equipments_.find(equipment_id);
+  if (equip_it == real_equipments_.end()) {
+    std::cerr << "设备不存在: " << equipment_id << std::endl;
+    return false;
+  }
+
+  if (fd_to_equipment_.find(fd) == fd_to_equipment_.end()) {
+    std::cout << "网关连接不存在: fd=" << fd << std::endl;
+    return false;
+  }
+
+  auto equip_fd_it = equipment_to_fd_.find(equipment_id);
+  if (equip_fd_it != equipment_to_fd_.end()) {
+    std::cout << "设备 " << equipment_id
+              << " 已连接到文件描述符: " << equip_fd_it->second << std::endl;
+    return false;
+  }
+
+  gateway_equipments_[fd].push_back(equip_it->second.equipment);
+  equipment_to_fd_[equipment_id] = fd;
+
+  std::cout << "网关连接添加设备: fd=" << fd << " -> " << equipment_id
+            << std::endl;
+  return true;
+}
+
+void SimulatorConnections::remove_gateway_equipments_locked(int fd) {
+  auto it = gateway_equipments_.find(fd);
+  if (it == gateway_equipments_.end()) {
+    return;
+  }
+  for (const auto &equipment : it->second) {
+    equipment_to_fd_.erase(equipment->get_equipment_id());
+  }
+  gateway_equipments_.erase(it);
+}
+
+bool SimulatorConnections::detach_gateway_equipment_locked(
+    int fd, const std::string &equipment_id) {
+  auto it = gateway_equipments_.find(fd);
+  if (it == gateway_equipments_.end()) {
+    return false;
+  }
+  auto &equipments = it->second;
+  auto equip_it = std::find_if(
+      equipments.begin(), equipments.end(),
+      [&equipment_id](const std::shared_ptr<Equipment> &equipment) {
+        return equipment->get_equipment_id() == equipment_id;
+      });
+  if (equip_it == equipments.end()) {
+    return false;
+  }
+  equipments.erase(equip_it);
+  if (equipments.empty()) {
+    gateway_equipments_.erase(it);
+  }
+  return true;
+}
+
 void SimulatorConnections::remove_connection(int fd) {
   std::unique_lock lock(connections_rw_lock_);
 
@@ -137,6 +201,7 @@ void SimulatorConnections::remove_connection(int fd) {
     std::string equipment_id = it->second->get_equipment_id();
     fd_to_equipment_.erase(it);
     equipment_to_fd_.erase(equipment_id);
+    remove_gateway_equipments_locked(fd);
     std::cout << "移除连接: fd=" << fd << " (" << equipment_id << ")"
               << std::endl;
   } else {
@@ -152,7 +217,11 @@ void SimulatorConnections::remove_connection_by_equipment_id(
   if (it != equipment_to_fd_.end()) {
     int fd = it->second;
     equipment_to_fd_.erase(it);
-    fd_to_equipment_.erase(fd);
+    // 网关连接上挂的设备只解除自己的映射，连接留给其他设备
+    if (!detach_gateway_equipment_locked(fd, equipment_id)) {
+      fd_to_equipment_.erase(fd);
+      remove_gateway_equipments_locked(fd);
+    }
     std::cout << "移除连接: " << equipment_id << " (fd=" << fd << ")"
               << std::endl;
   } else {
@@ -169,9 +238,10 @@ void SimulatorConnections::close_connection(int fd) {
   if (it != fd_to_equipment_.end()) {
     std::string equipment_id = it->second->get_equipment_id();
 
-    // 从映射中移除
+    // 从映射中移除（包括网关连接上挂的设备）
     fd_to_equipment_.erase(it);
     equipment_to_fd_.erase(equipment_id);
+    remove_gateway_equipments_locked(fd);
 
     // 关闭文件描述符
     if (fd > 0) {
@@ -195,7 +265,14 @@ void SimulatorConnections::close_connection_by_equipment_id(
 
     // 从映射中移除
     equipment_to_fd_.erase(it);
+    // 网关连接上挂的设备只解除自己的映射，连接留给其他设备
+    if (detach_gateway_equipment_locked(fd, equipment_id)) {
+      std::cout << "移除网关连接上的设备: " << equipment_id << " (fd=" << fd
+                << ")" << std::endl;
+      return;
+    }
     fd_to_equipment_.erase(fd);
+    remove_gateway_equipments_locked(fd);
 
     // 关闭文件描述符
     if (fd > 0) {
@@ -225,6 +302,7 @@ void SimulatorConnections::close_all_connections() {
   // 清空映射
   fd_to_equipment_.clear();
   equipment_to_fd_.clear();
+  gateway_equipments_.clear();
 }
 
 bool SimulatorConnections::is_connection_valid(int fd) const {
@@ -259,6 +337,24 @@ std::shared_ptr<Equipment> SimulatorConnections::get_equipment_by_fd(int fd) {
   return nullptr;
 }
 
+std::vector<std::shared_ptr<Equipment>>
+SimulatorConnections::get_equipments_by_fd(int fd) {
+  std::shared_lock lock(connections_rw_lock_);
+  std::vector<std::shared_ptr<Equipment>> equipments;
+
+  auto it = fd_to_equipment_.find(fd);
+  if (it == fd_to_equipment_.end()) {
+    return equipments;
+  }
+  equipments.push_back(it->second);
+  auto gateway_it = gateway_equipments_.find(fd);
+  if (gateway_it != gateway_equipments_.end()) {
+    equipments.insert(equipments.end(), gateway_it->second.begin(),
+                      gateway_it->second.end());
+  }
+  return equipments;
+}
+
 std::shared_ptr<Equipment>
 SimulatorConnections::get_equipment_by_id(const std::string &equipment_id) {
   // 使用try_shared_lock避免死锁
@@ -341,6 +437,9 @@ SimulatorConnections::get_connected_equipments() {
   for (const auto &[fd, equipment] : fd_to_equipment_) {
     equipments.push_back(equipment);
   }
+  for (const auto &[fd, gateway] : gateway_equipments_) {
+    equipments.insert(equipments.end(), gateway.begin(), gateway.end());
+  }
   return equipments;
 }
 
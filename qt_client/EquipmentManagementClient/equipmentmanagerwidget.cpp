@@ -1,4 +1,5 @@
 #include "equipmentmanagerwidget.h"
+#include "message_schema.h"
 #include "ui_equipmentmanagerwidget.h"
 #include "tcpclient.h"
 #include "messagedispatcher.h"
@@ -319,7 +320,16 @@ void EquipmentManagerWidget::sendControlCommand(const QString& equipmentId, Prot
         parameters
         );
 
-    if (m_tcpClient->sendData(QByteArray(controlMsg.data(), controlMsg.size())) > 0) {
+    // 控制响应要等设备执行完才返回，按请求ID交回本页面（超时由服务端回复失败）
+    quint32 requestId = m_dispatcher->sendRequest(
+        controlMsg, ProtocolParser::CONTROL_RESPONSE,
+        [this](const ProtocolParser::ParseResult &result) {
+            QMetaObject::invokeMethod(this, [this, result]() {
+                handleControlResponse(result);
+            });
+        },
+        equipmentId.toStdString());
+    if (requestId != 0) {
         QString commandStr = (command == ProtocolParser::TURN_ON) ? "开机" : "关机";
         logMessage(QString("控制命令已发送: [%1] -> %2").arg(equipmentId, commandStr));
         ui->turnOnButton->setEnabled(false);
@@ -370,13 +380,15 @@ void EquipmentManagerWidget::handleEquipmentStatusUpdate(const ProtocolParser::P
 
 void EquipmentManagerWidget::handleControlResponse(const ProtocolParser::ParseResult& result)
 {
+    using Response = message_schema::ControlResponse;
     QString equipmentId = QString::fromStdString(result.equipment_id);
-    QString payload = QString::fromStdString(result.payload);
-    QStringList parts = payload.split('|');
+    message_schema::Decoded<Response> response;
 
-    if (parts.size() >= 2) {
-        bool success = (parts[1] == "success");
-        QString command = parts.size() > 2 ? parts[2] : "unknown";
+    if (response.decode(result.payload) == message_schema::DECODE_OK) {
+        bool success = response.text<Response::RESULT>() == "success";
+        std::string_view commandText = response.text<Response::COMMAND>();
+        QString command = QString::fromUtf8(commandText.data(), commandText.size());
+        std::string_view reason = response.text<Response::MESSAGE>();
         QString message = QString("设备 [%1] %2命令执行%3")
                               .arg(equipmentId)
                               .arg(command)
@@ -391,11 +403,11 @@ void EquipmentManagerWidget::handleControlResponse(const ProtocolParser::ParseRe
                 logMessage("控制成功后自动刷新设备列表");
             });
         } else {
-            logMessage(message + "，原因: " + (parts.size() > 3 ? parts[3] : "未知"));
+            logMessage(message + "，原因: " + QString::fromUtf8(reason.data(), reason.size()));
             QMessageBox::warning(this, "控制失败", message);
         }
     } else {
-        logMessage(QString("收到格式异常的控制响应: %1").arg(payload));
+        logMessage(QString("收到格式异常的控制响应: %1").arg(QString::fromStdString(result.payload)));
     }
 
     updateControlButtonsState(!m_currentSelectedEquipmentId.isEmpty());
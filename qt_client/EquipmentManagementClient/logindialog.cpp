@@ -1,4 +1,5 @@
 #include "logindialog.h"
+#include "message_schema.h"
 #include <QMessageBox>
 #include <QTimer>
 #include <QDebug>
@@ -388,13 +389,17 @@ void LoginDialog::on_cancelButton_clicked() {
 }
 
 void LoginDialog::handleLoginResponse(const ProtocolParser::ParseResult& result) {
-    QString payload = QString::fromStdString(result.payload);
-    QStringList parts = payload.split('|');
-
-    if (parts.size() >= 4 && parts[0] == "success") {
+    using Response = message_schema::QtLoginResponse;
+    message_schema::Decoded<Response> response;
+    bool decoded = response.decode(result.payload) == message_schema::DECODE_OK;
+    std::string_view text = response.text<Response::MESSAGE>();
+    QString message = QString::fromUtf8(text.data(), text.size());
+    QStringList parts = message.split('|');
+
+    if (decoded && response.text<Response::RESULT>() == "success" && parts.size() >= 3) {
         // 登录成功，格式: success|user_id|username|role
-        m_userId = parts[1].toInt();
-        m_userRole = parts[3];
+        m_userId = parts[0].toInt();
+        m_userRole = parts[2];
 
         setStatusMessage("登录成功！正在进入系统...", false);
 
@@ -404,7 +409,7 @@ void LoginDialog::handleLoginResponse(const ProtocolParser::ParseResult& result)
         });
     } else {
         // 登录失败
-        QString errorMsg = parts.size() >= 2 ? parts[1] : "未知错误";
+        QString errorMsg = message.isEmpty() ? "未知错误" : message;
         setStatusMessage("登录失败: " + errorMsg, true);
         setLoginButtonEnabled(true);
         setCancelButtonEnabled(true);
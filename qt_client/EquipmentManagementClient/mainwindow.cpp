@@ -1,4 +1,5 @@
 #include "mainwindow.h"
+#include "message_schema.h"
 #include "./ui_mainwindow.h"
 #include <QTime>
 #include <QTimer>
@@ -658,7 +659,15 @@ void MainWindow::requestTodayEnergy()
         {payload.toStdString()}
         );
     std::vector<char> packet = ProtocolParser::pack_message(body);
-    m_tcpClient->sendData(QByteArray(packet.data(), packet.size()));
+    // 响应按请求ID交给仪表板，与能耗页面同时在途的查询互不干扰
+    quint32 requestId = m_dispatcher->sendRequest(
+        packet, ProtocolParser::QT_ENERGY_RESPONSE,
+        [this](const ProtocolParser::ParseResult &result) {
+            QMetaObject::invokeMethod(this, [this, result]() {
+                this->handleTodayEnergyResponse(result);
+            });
+        });
+    if (requestId == 0) return;
     m_isRequestingTodayEnergy = true;
     logMessage("请求今日总能耗");
 }
@@ -708,7 +717,15 @@ void MainWindow::requestTodayReservations()
         ProtocolParser::CLIENT_QT_CLIENT,
         "all"
         );
-    m_tcpClient->sendData(QByteArray(msg.data(), msg.size()));
+    // 响应按请求ID交给仪表板，预约页面自己的查询仍走类型分发
+    quint32 requestId = m_dispatcher->sendRequest(
+        msg, ProtocolParser::RESERVATION_QUERY,
+        [this](const ProtocolParser::ParseResult &result) {
+            QMetaObject::invokeMethod(this, [this, result]() {
+                this->handleTodayReservationsResponse(result);
+            });
+        });
+    if (requestId == 0) return;
     m_isRequestingTodayReservations = true;
     logMessage("请求今日预约数量");
 }
@@ -1082,10 +1099,12 @@ void MainWindow::onSetThresholdRequested(const QString &equipmentId, double valu
 
 void MainWindow::handleSetThresholdResponse(const ProtocolParser::ParseResult &result)
 {
-    QString payload = QString::fromStdString(result.payload);
-    QStringList parts = payload.split('|');
-    bool success = (parts.size() >= 1 && parts[0] == "success");
-    QString message = parts.size() >= 2 ? parts[1] : "";
+    using Response = message_schema::QtSetThresholdResponse;
+    message_schema::Decoded<Response> response;
+    bool success = response.decode(result.payload) == message_schema::DECODE_OK &&
+                   response.text<Response::RESULT>() == "success";
+    std::string_view text = response.text<Response::MESSAGE>();
+    QString message = QString::fromUtf8(text.data(), text.size());
 
     if (m_thresholdSettingsPage) {
         m_thresholdSettingsPage->handleSetThresholdResponse(success, message);
@@ -1543,11 +1562,14 @@ void MainWindow::handleMyReservationResponse(const ProtocolParser::ParseResult &
 
 void MainWindow::handleReservationApplyResponse(const ProtocolParser::ParseResult &result)
 {
-    QString payload = QString::fromStdString(result.payload);
-    QStringList parts = payload.split('|');
-
-    if (parts.size() >= 2 && parts[0] == "success") {
-        QMessageBox::information(this, "预约成功", parts[1]);
+    using Response = message_schema::ReservationApplyResponse;
+    message_schema::Decoded<Response> response;
+    bool decoded = response.decode(result.payload) == message_schema::DECODE_OK;
+    std::string_view text = response.text<Response::MESSAGE>();
+    QString message = QString::fromUtf8(text.data(), text.size());
+
+    if (decoded && response.text<Response::RESULT>() == "success") {
+        QMessageBox::information(this, "预约成功", message);
         logMessage("预约申请提交成功");
 
         // ===== 新增：切换到查询页并自动刷新 =====
@@ -1559,28 +1581,21 @@ void MainWindow::handleReservationApplyResponse(const ProtocolParser::ParseResul
         });
         // ========================================
     } else {
-        QString errorMsg = parts.size() >= 2 ? parts[1] : "未知错误";
+        QString errorMsg = message.isEmpty() ? "未知错误" : message;
         QMessageBox::warning(this, "预约失败", errorMsg);
         logMessage(QString("预约申请失败: %1").arg(errorMsg));
     }
 }
 
 
-void MainWindow::handleReservationQueryResponse(const ProtocolParser::ParseResult &result)
+void MainWindow::handleTodayReservationsResponse(const ProtocolParser::ParseResult &result)
 {
     QString payload = QString::fromStdString(result.payload);
-    qDebug() << "=== 查询响应处理 ===";
-
     // 提取数据部分（去除 "success|" 前缀）
-    QString data;
-    bool hasSuccess = payload.startsWith("success|");
-    if (hasSuccess) {
-        data = payload.mid(8);
-    } else {
-        data = payload;
-    }
+    QString data = payload.startsWith("success|") ? payload.mid(8) : payload;
+    m_isRequestingTodayReservations = false;
 
-    // ---------- 1. 场所使用率请求（点击卡片触发）----------
+    // ---------- 1. 场所使用率请求（点击卡片触发，复用今日预约请求）----------
     if (m_isRequestingPlaceUsage) {
         // 原有场所使用率逻辑保持不变
         QMap<QString, int> placeTotalMinutes;
@@ -1622,49 +1637,59 @@ void MainWindow::handleReservationQueryResponse(const ProtocolParser::ParseResul
     }
 
     // ---------- 2. 仪表板今日预约请求（更新卡片）----------
-    if (m_isRequestingTodayReservations) {
-        // 原有今日预约逻辑保持不变
-        int todayCount = 0;
-        int totalUsedMinutes = 0;
-        QDate today = QDate::currentDate();
-        QStringList records = data.split(';', Qt::SkipEmptyParts);
-        for (const QString &rec : records) {
-            QStringList fields = rec.split('|');
-            if (fields.size() >= 5) {
-                QString startStr = fields[3];
-                QString endStr = fields[4];
-                QDateTime start = QDateTime::fromString(startStr, "yyyy-MM-dd HH:mm:ss");
-                QDateTime end = QDateTime::fromString(endStr, "yyyy-MM-dd HH:mm:ss");
-                if (start.isValid() && end.isValid() && start.date() == today) {
-                    todayCount++;
-                    int minutes = start.secsTo(end) / 60;
-                    totalUsedMinutes += minutes;
-                }
-            }
-        }
-        if (m_todayReservationsLabel) {
-            m_todayReservationsLabel->setText(QString::number(todayCount));
-        }
-        if (m_placeUsageLabel) {
-            int placeCount = m_placeNameMap.size();
-            if (placeCount > 0) {
-                const int AVAILABLE_MINUTES_PER_PLACE = 14 * 60;
-                int totalAvailableMinutes = placeCount * AVAILABLE_MINUTES_PER_PLACE;
-                double usagePercent = (totalUsedMinutes * 100.0) / totalAvailableMinutes;
-                if (usagePercent > 100.0) usagePercent = 100.0;
-                m_placeUsageLabel->setText(QString::number(usagePercent, 'f', 1) + "%");
-            } else {
-                m_placeUsageLabel->setText("0%");
+    int todayCount = 0;
+    int totalUsedMinutes = 0;
+    QDate today = QDate::currentDate();
+    QStringList records = data.split(';', Qt::SkipEmptyParts);
+    for (const QString &rec : records) {
+        QStringList fields = rec.split('|');
+        if (fields.size() >= 5) {
+            QString startStr = fields[3];
+            QString endStr = fields[4];
+            QDateTime start = QDateTime::fromString(startStr, "yyyy-MM-dd HH:mm:ss");
+            QDateTime end = QDateTime::fromString(endStr, "yyyy-MM-dd HH:mm:ss");
+            if (start.isValid() && end.isValid() && start.date() == today) {
+                todayCount++;
+                int minutes = start.secsTo(end) / 60;
+                totalUsedMinutes += minutes;
             }
         }
-        if (m_centralStack && m_centralStack->currentIndex() == PAGE_DASHBOARD) {
-            updateRecentReservations(data);
+    }
+    if (m_todayReservationsLabel) {
+        m_todayReservationsLabel->setText(QString::number(todayCount));
+    }
+    if (m_placeUsageLabel) {
+        int placeCount = m_placeNameMap.size();
+        if (placeCount > 0) {
+            const int AVAILABLE_MINUTES_PER_PLACE = 14 * 60;
+            int totalAvailableMinutes = placeCount * AVAILABLE_MINUTES_PER_PLACE;
+            double usagePercent = (totalUsedMinutes * 100.0) / totalAvailableMinutes;
+            if (usagePercent > 100.0) usagePercent = 100.0;
+            m_placeUsageLabel->setText(QString::number(usagePercent, 'f', 1) + "%");
+        } else {
+            m_placeUsageLabel->setText("0%");
         }
-        m_isRequestingTodayReservations = false;
-        return;
+    }
+    if (m_centralStack && m_centralStack->currentIndex() == PAGE_DASHBOARD) {
+        updateRecentReservations(data);
+    }
+}
+
+void MainWindow::handleReservationQueryResponse(const ProtocolParser::ParseResult &result)
+{
+    QString payload = QString::fromStdString(result.payload);
+    qDebug() << "=== 查询响应处理 ===";
+
+    // 提取数据部分（去除 "success|" 前缀）
+    QString data;
+    bool hasSuccess = payload.startsWith("success|");
+    if (hasSuccess) {
+        data = payload.mid(8);
+    } else {
+        data = payload;
     }
 
-    // ---------- 3. 检查数据有效性 ----------
+    // ---------- 检查数据有效性 ----------
     if (data.isEmpty() || payload.startsWith("fail|")) {
         QString errorMsg = data.isEmpty() ? "查询失败" : payload.mid(5);
         qDebug() << "查询失败:" << errorMsg;
@@ -1680,7 +1705,7 @@ void MainWindow::handleReservationQueryResponse(const ProtocolParser::ParseResul
         return;
     }
 
-    // ---------- 4. 将数据交给预约组件统一处理 ----------
+    // ---------- 将数据交给预约组件统一处理 ----------
     m_reservationPage->handleReservationData(data);
 
 
@@ -1773,11 +1798,14 @@ void MainWindow::handleReservationQueryResponse(const ProtocolParser::ParseResul
 
 void MainWindow::handleReservationApproveResponse(const ProtocolParser::ParseResult &result)
 {
-    QString payload = QString::fromStdString(result.payload);
-    QStringList parts = payload.split('|');
-
-    if (parts.size() >= 2 && parts[0] == "success") {
-        QMessageBox::information(this, "审批成功", parts[1]);
+    using Response = message_schema::ReservationApproveResponse;
+    message_schema::Decoded<Response> response;
+    bool decoded = response.decode(result.payload) == message_schema::DECODE_OK;
+    std::string_view text = response.text<Response::MESSAGE>();
+    QString message = QString::fromUtf8(text.data(), text.size());
+
+    if (decoded && response.text<Response::RESULT>() == "success") {
+        QMessageBox::information(this, "审批成功", message);
         logMessage("预约审批操作成功");
 
         // ✅ 自动刷新审批页面（延迟500ms确保数据库已更新）
@@ -1788,7 +1816,7 @@ void MainWindow::handleReservationApproveResponse(const ProtocolParser::ParseRes
             }
         });
     } else {
-        QString errorMsg = parts.size() >= 2 ? parts[1] : "未知错误";
+        QString errorMsg = message.isEmpty() ? "未知错误" : message;
         QMessageBox::warning(this, "审批失败", errorMsg);
         logMessage(QString("预约审批失败: %1").arg(errorMsg));
     }
@@ -1892,25 +1920,25 @@ void MainWindow::handlePlaceListResponse(const ProtocolParser::ParseResult &resu
     emit m_reservationPage->placeListLoaded();
 }
 
-void MainWindow::handleEnergyResponse(const ProtocolParser::ParseResult &result)
+void MainWindow::handleTodayEnergyResponse(const ProtocolParser::ParseResult &result)
 {
     QString data = QString::fromStdString(result.payload);
-
-    // 仪表板请求分支
-    if (m_isRequestingTodayEnergy) {
-        double total = 0.0;
-        QStringList records = data.split(';', Qt::SkipEmptyParts);
-        for (const QString &rec : records) {
-            QStringList fields = rec.split('|');
-            if (fields.size() >= 3) {
-                total += fields[2].toDouble();
-            }
+    double total = 0.0;
+    QStringList records = data.split(';', Qt::SkipEmptyParts);
+    for (const QString &rec : records) {
+        QStringList fields = rec.split('|');
+        if (fields.size() >= 3) {
+            total += fields[2].toDouble();
         }
-        if (m_todayEnergyLabel)
-            m_todayEnergyLabel->setText(QString::number(total, 'f', 2) + " kWh");
-        m_isRequestingTodayEnergy = false;
-        return;   // 仪表板请求不继续往下
     }
+    if (m_todayEnergyLabel)
+        m_todayEnergyLabel->setText(QString::number(total, 'f', 2) + " kWh");
+    m_isRequestingTodayEnergy = false;
+}
+
+void MainWindow::handleEnergyResponse(const ProtocolParser::ParseResult &result)
+{
+    QString data = QString::fromStdString(result.payload);
 
     // 能耗页面正常更新
     if (data.isEmpty() || data.startsWith("fail|")) {
@@ -1931,20 +1959,20 @@ void MainWindow::handleQtHeartbeatResponse(const ProtocolParser::ParseResult &re
 
 void MainWindow::handleAlertMessage(const ProtocolParser::ParseResult &result)
 {
-    QString payload = QString::fromStdString(result.payload);
-    QStringList parts = payload.split('|');
-    if (parts.size() < 4) {
-        qWarning() << "告警消息格式错误:" << payload;
+    using Alert = message_schema::QtAlertMessage;
+    message_schema::Decoded<Alert> alert;
+    if (alert.decode(result.payload) != message_schema::DECODE_OK) {
+        qWarning() << "告警消息格式错误:" << QString::fromStdString(result.payload);
         return;
     }
 
-    bool ok;
-    int alarmId = parts[0].toInt(&ok);
-    if (!ok) alarmId = 0; // 降级处理
-
-    QString alarmType = parts[1];
-    QString severity = parts[2];
-    QString message = parts[3];
+    int alarmId = alert.integer<Alert::ALARM_ID>();
+    auto field = [](std::string_view text) {
+        return QString::fromUtf8(text.data(), text.size());
+    };
+    QString alarmType = field(alert.text<Alert::ALARM_TYPE>());
+    QString severity = field(alert.text<Alert::SEVERITY>());
+    QString message = field(alert.text<Alert::MESSAGE>());
 
     // 根据严重程度决定是否弹窗
     if (severity == "critical" || severity == "error") {
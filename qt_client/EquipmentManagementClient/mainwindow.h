@@ -50,6 +50,8 @@ private slots:
     // 预约响应处理
     void handleReservationApplyResponse(const ProtocolParser::ParseResult &result);
     void handleReservationQueryResponse(const ProtocolParser::ParseResult &result);
+    // 仪表板今日预约/场所使用率请求的响应（按请求ID匹配，不经过预约页面）
+    void handleTodayReservationsResponse(const ProtocolParser::ParseResult &result);
     void handleReservationApproveResponse(const ProtocolParser::ParseResult &result);
     void handlePlaceListResponse(const ProtocolParser::ParseResult &result);
 
@@ -66,6 +68,8 @@ private slots:
     void showEnergyStatisticsWidget();
     void onEnergyQueryRequested(const QString &equipmentId, const QString &timeRange);
     void handleEnergyResponse(const ProtocolParser::ParseResult &result);
+    // 仪表板今日能耗请求的响应（按请求ID匹配，不经过能耗页面）
+    void handleTodayEnergyResponse(const ProtocolParser::ParseResult &result);
     void handleQtHeartbeatResponse(const ProtocolParser::ParseResult &result);
 
     //智能告警相关
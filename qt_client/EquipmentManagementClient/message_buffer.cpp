@@ -1,67 +1,104 @@
 #include "message_buffer.h"
+#include <algorithm>
 #include <arpa/inet.h>
 #include <cstring>
 
-MessageBuffer::MessageBuffer() { buffer_.reserve(INITIAL_BUFFER_SIZE); }
+MessageBuffer::MessageBuffer() { buffer_.resize(INITIAL_BUFFER_SIZE); }
 
 void MessageBuffer::append_data(const char *data, size_t len) {
-  if (buffer_.size() + len > MAX_BUFFER_SIZE) {
-    // 防止缓冲区过大，可以在这里处理或抛出异常
+  if (data_size() + len > MAX_BUFFER_SIZE + HEADER_SIZE) {
+    // 丢弃会破坏帧边界，标记溢出由调用方关闭连接
+    overflowed_ = true;
     return;
   }
 
-  size_t old_size = buffer_.size();
-  buffer_.resize(old_size + len);
-  memcpy(buffer_.data() + old_size, data, len);
+  memcpy(prepare_write(len), data, len);
+  commit_write(len);
 }
 
-size_t MessageBuffer::extract_messages(std::vector<std::string> &messages) {
-  size_t extracted_count = 0;
+char *MessageBuffer::prepare_write(size_t min_space) {
+  ensure_writable(min_space);
+  return buffer_.data() + write_pos_;
+}
 
-  while (true) {
-    // 检查是否有足够数据读取消息头
-    if (buffer_.size() < 4) {
-      break; // 连消息头都不完整，等待更多数据
-    }
-
-    // 解析消息长度
-    uint32_t msg_len;
-    if (!parse_message_length(msg_len)) {
-      // 消息头解析失败，清空缓冲区（协议错误）
-      clear();
-      break;
-    }
-
-    // 检查是否有完整的消息体
-    if (buffer_.size() < 4 + msg_len) {
-      break; // 消息体不完整，等待更多数据
-    }
-
-    // 提取完整消息
-    std::string message(buffer_.data() + 4, msg_len);
-    messages.push_back(message);
-    extracted_count++;
+void MessageBuffer::commit_write(size_t len) {
+  write_pos_ = std::min(write_pos_ + len, buffer_.size());
+}
 
-    // 从缓冲区移除已处理的消息
-    size_t remaining = buffer_.size() - (4 + msg_len);
-    if (remaining > 0) {
-      // 移动剩余数据到缓冲区开头
-      memmove(buffer_.data(), buffer_.data() + 4 + msg_len, remaining);
-    }
-    buffer_.resize(remaining);
+void MessageBuffer::ensure_writable(size_t min_space) {
+  if (read_pos_ == write_pos_) {
+    // 已全部消费，从头开始写，不需要搬移
+    read_pos_ = 0;
+    write_pos_ = 0;
+  }
+  if (writable_size() >= min_space) {
+    return;
   }
 
+  // 把未消费的尾部（通常是半帧）移到开头
+  size_t pending = data_size();
+  if (read_pos_ > 0) {
+    memmove(buffer_.data(), buffer_.data() + read_pos_, pending);
+    read_pos_ = 0;
+    write_pos_ = pending;
+  }
+  if (writable_size() < min_space) {
+    buffer_.resize(std::max(buffer_.size() * 2, pending + min_space));
+  }
+}
+
+bool MessageBuffer::next_frame(std::string_view &frame) {
+  // 检查是否有足够数据读取消息头
+  if (data_size() < HEADER_SIZE) {
+    return false; // 连消息头都不完整，等待更多数据
+  }
+
+  // 解析消息长度
+  uint32_t msg_len;
+  if (!parse_message_length(msg_len)) {
+    // 消息头解析失败，清空缓冲区（协议错误）
+    clear();
+    return false;
+  }
+
+  // 检查是否有完整的消息体
+  if (data_size() < HEADER_SIZE + msg_len) {
+    return false; // 消息体不完整，等待更多数据
+  }
+
+  frame = std::string_view(buffer_.data() + read_pos_ + HEADER_SIZE, msg_len);
+  read_pos_ += HEADER_SIZE + msg_len;
+  return true;
+}
+
+size_t MessageBuffer::extract_frames(std::vector<std::string_view> &frames) {
+  size_t extracted_count = 0;
+  std::string_view frame;
+  while (next_frame(frame)) {
+    frames.push_back(frame);
+    extracted_count++;
+  }
+  return extracted_count;
+}
+
+size_t MessageBuffer::extract_messages(std::vector<std::string> &messages) {
+  size_t extracted_count = 0;
+  std::string_view frame;
+  while (next_frame(frame)) {
+    messages.emplace_back(frame);
+    extracted_count++;
+  }
   return extracted_count;
 }
 
 bool MessageBuffer::parse_message_length(uint32_t &msg_len) const {
-  if (buffer_.size() < 4) {
+  if (data_size() < HEADER_SIZE) {
     return false;
   }
 
   // 从网络字节序转换为主机字节序
   uint32_t net_len;
-  memcpy(&net_len, buffer_.data(), 4);
+  memcpy(&net_len, buffer_.data() + read_pos_, HEADER_SIZE);
   msg_len = ntohl(net_len);
 
   // 简单的长度校验（防止恶意数据）
@@ -72,10 +109,14 @@ bool MessageBuffer::parse_message_length(uint32_t &msg_len) const {
   return true;
 }
 
-size_t MessageBuffer::data_size() const { return buffer_.size(); }
+size_t MessageBuffer::data_size() const { return write_pos_ - read_pos_; }
 
-void MessageBuffer::clear() { buffer_.clear(); }
+void MessageBuffer::clear() {
+  read_pos_ = 0;
+  write_pos_ = 0;
+  overflowed_ = false;
+}
 
 bool MessageBuffer::is_too_large() const {
-  return buffer_.size() > MAX_BUFFER_SIZE;
-}
\ No newline at end of file
+  return overflowed_ || data_size() > MAX_BUFFER_SIZE + HEADER_SIZE;
+}
@@ -1,7 +1,17 @@
 #pragma once
+#include <cstddef>
+#include <cstdint>
 #include <string>
+#include <string_view>
 #include <vector>
 
+// 连接的接收缓冲区：[read_pos_, write_pos_) 为未消费数据，write_pos_之后为空闲区。
+// QTcpSocket::read直接写入空闲区（prepare_write+commit_write），
+// 完整帧以string_view的形式返回，不再逐帧拷贝和搬移剩余数据。
+// 只有空闲区不够时才把未消费的尾部（通常是半帧）移到开头。
+//
+// 返回的帧视图在下一次写入（append_data/prepare_write）
+// 或clear之前有效。
 class MessageBuffer {
 
 public:
@@ -10,7 +20,18 @@ public:
   // 追加接收到的数据
   void append_data(const char *data, size_t len);
 
-  // 尝试从缓冲区提取完整消息
+  // 获取至少min_space字节的可写区域，写入后用commit_write提交实际长度
+  char *prepare_write(size_t min_space);
+  size_t writable_size() const { return buffer_.size() - write_pos_; }
+  void commit_write(size_t len);
+
+  // 取出下一个完整帧（不含4字节长度头），没有完整帧时返回false
+  bool next_frame(std::string_view &frame);
+
+  // 取出所有完整帧的视图，返回数量
+  size_t extract_frames(std::vector<std::string_view> &frames);
+
+  // 尝试从缓冲区提取完整消息（拷贝版本）
   // 返回提取到的消息数量，messages包含完整消息列表
   size_t extract_messages(std::vector<std::string> &messages);
 
@@ -27,7 +48,15 @@ private:
   // 解析消息头获取消息长度
   bool parse_message_length(uint32_t &msg_len) const;
 
+  // 保证写入位置之后至少有min_space字节：先压缩，不够再扩容
+  void ensure_writable(size_t min_space);
+
   std::vector<char> buffer_;
-  static const size_t INITIAL_BUFFER_SIZE = 1024;
-  static const size_t MAX_BUFFER_SIZE = 64 * 1024; // 64KB
+  size_t read_pos_ = 0;
+  size_t write_pos_ = 0;
+  bool overflowed_ = false; // 未消费数据超过上限，调用方应关闭连接
+
+  static constexpr size_t HEADER_SIZE = 4;
+  static constexpr size_t INITIAL_BUFFER_SIZE = 1024;
+  static constexpr size_t MAX_BUFFER_SIZE = 64 * 1024; // 64KB
 };
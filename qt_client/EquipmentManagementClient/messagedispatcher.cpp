@@ -3,7 +3,7 @@
 #include <QDebug>
 
 MessageDispatcher::MessageDispatcher(TcpClient *tcpClient, QObject *parent)
-    : QObject(parent), m_tcpClient(tcpClient)
+    : QObject(parent), m_tcpClient(tcpClient), m_nextRequestId(1)
 {
     if (!m_tcpClient) {
         qCritical() << "MessageDispatcher: TcpClient is null!";
@@ -11,6 +11,13 @@ MessageDispatcher::MessageDispatcher(TcpClient *tcpClient, QObject *parent)
     }
     connect(m_tcpClient, &TcpClient::protocolMessageReceived,
             this, &MessageDispatcher::onProtocolMessageReceived);
+    // 连接断开后不会再收到这些请求的响应
+    connect(m_tcpClient, &TcpClient::disconnected, this, [this]() {
+        if (!m_pendingRequests.isEmpty()) {
+            qDebug() << "Connection lost, dropping" << m_pendingRequests.size() << "pending requests";
+            m_pendingRequests.clear();
+        }
+    });
     qDebug() << "MessageDispatcher initialized and connected to TcpClient.";
 }
 
@@ -36,9 +43,57 @@ void MessageDispatcher::unregisterHandler(ProtocolParser::MessageType type)
     }
 }
 
+quint32 MessageDispatcher::sendRequest(const std::vector<char> &packet,
+                                       ProtocolParser::MessageType responseType,
+                                       ResponseHandler handler,
+                                       const std::string &equipmentId)
+{
+    if (!m_tcpClient || !handler) {
+        return 0;
+    }
+    quint32 id = m_nextRequestId++;
+    if (id == 0) {
+        id = m_nextRequestId++; // 0表示没有请求ID，回绕时跳过
+    }
+    // 先登记再发送，发送失败时撤销
+    m_pendingRequests.append({id, responseType, std::move(handler), equipmentId});
+    if (m_tcpClient->sendData(QByteArray(packet.data(), packet.size()), id) <= 0) {
+        m_pendingRequests.removeLast();
+        return 0;
+    }
+    return id;
+}
+
+bool MessageDispatcher::takePendingRequest(const ProtocolParser::ParseResult &result, ResponseHandler &handler)
+{
+    for (int i = 0; i < m_pendingRequests.size(); ++i) {
+        const PendingRequest &pending = m_pendingRequests[i];
+        bool matched = result.version == ProtocolParser::PROTOCOL_V2
+                           ? result.request_id != 0 && pending.id == result.request_id
+                           : pending.responseType == result.type &&
+                                 (pending.equipmentId.empty() ||
+                                  pending.equipmentId == result.equipment_id);
+        if (matched) {
+            handler = std::move(m_pendingRequests[i].handler);
+            m_pendingRequests.removeAt(i);
+            return true;
+        }
+    }
+    return false;
+}
+
 void MessageDispatcher::onProtocolMessageReceived(const ProtocolParser::ParseResult &result)
 {
-    qDebug() << "Dispatcher received message type:" << result.type;
+    qDebug() << "Dispatcher received message type:" << result.type << "request id:" << result.request_id;
+    ResponseHandler requestHandler;
+    if (takePendingRequest(result, requestHandler)) {
+        try {
+            requestHandler(result);
+        } catch (const std::exception &e) {
+            qCritical() << "Exception in request handler for type" << result.type << ":" << e.what();
+        }
+        return;
+    }
     auto it = m_handlerMap.find(result.type);
     if (it != m_handlerMap.end()) {
         const auto &handlers = it.value();
@@ -16,9 +16,22 @@ public:
     explicit MessageDispatcher(TcpClient *tcpClient, QObject *parent = nullptr);
     ~MessageDispatcher();
 
+    using ResponseHandler = std::function<void(const ProtocolParser::ParseResult&)>;
+
     void registerHandler(ProtocolParser::MessageType type, std::function<void(const ProtocolParser::ParseResult&)> handler);
     void unregisterHandler(ProtocolParser::MessageType type);
 
+    // 发送请求并登记一次性回调，对应的响应只交给这个回调，不再按类型分发。
+    // v2按请求ID匹配，同类请求可以同时有多个在途；v1没有请求ID，
+    // 按responseType先发先匹配（服务端按收到的顺序回复同一连接）。
+    // 经设备往返的请求（控制命令）不同设备的响应先后不定，v1时传入equipmentId，
+    // 只匹配该设备的响应（同一设备按顺序执行和回复）。
+    // 返回请求ID，发送失败返回0。断开连接时未完成的请求被丢弃
+    quint32 sendRequest(const std::vector<char> &packet,
+                        ProtocolParser::MessageType responseType,
+                        ResponseHandler handler,
+                        const std::string &equipmentId = std::string());
+
 signals:
     void heartbeatResponseReceived(const QString &fromEquipmentId);
 
@@ -26,8 +39,20 @@ public slots:
     void onProtocolMessageReceived(const ProtocolParser::ParseResult &result);
 
 private:
+    // 取出与响应匹配的在途请求的回调，没有匹配时返回false
+    bool takePendingRequest(const ProtocolParser::ParseResult &result, ResponseHandler &handler);
+
+    struct PendingRequest {
+        quint32 id;
+        ProtocolParser::MessageType responseType;
+        ResponseHandler handler;
+        std::string equipmentId; // 非空时v1只匹配该设备的响应
+    };
+
     TcpClient *m_tcpClient;
     QMap<ProtocolParser::MessageType, QList<std::function<void(const ProtocolParser::ParseResult&)>>> m_handlerMap;
+    QList<PendingRequest> m_pendingRequests; // 按发送顺序
+    quint32 m_nextRequestId;
 };
 
 #endif // MESSAGEDISPATCHER_H
@@ -1,5 +1,7 @@
 #include "protocol_parser.h"
+#include "message_schema.h"
 #include <arpa/inet.h>
+#include <charconv>
 #include <cstring>
 #include <iostream>
 #include <sstream>
@@ -26,8 +28,110 @@ std::vector<char> ProtocolParser::pack_message(const std::string &body) {
     return packed_message;
 }
 
+namespace {
+
+// ============ v2编解码工具 ============
+void put_varint(std::vector<char> &out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+bool get_varint(const std::string &data, size_t &pos, uint64_t &value) {
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (pos >= data.size()) {
+            return false;
+        }
+        uint8_t byte = static_cast<uint8_t>(data[pos++]);
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// 规范形式的十进制整数：格式化回文本后与原字段完全相同
+bool canonical_int(const std::string &field, int64_t &value) {
+    if (field.empty() || field.size() > 19) {
+        return false;
+    }
+    size_t digits = field[0] == '-' ? 1 : 0;
+    if (digits == field.size() || (field[digits] == '0' && field.size() > 1)) {
+        return false;
+    }
+    const char *end = field.data() + field.size();
+    auto [ptr, ec] = std::from_chars(field.data(), end, value);
+    // 标记里要腾出一位放字段类型
+    constexpr int64_t limit = int64_t{1} << 62;
+    return ec == std::errc() && ptr == end && value < limit && value >= -limit;
+}
+
+// 固定头：版本、客户端类型、消息类型、请求ID
+constexpr size_t V2_HEADER_SIZE = 1 + 1 + 1 + 4;
+
+ProtocolParser::ParseResult parse_message_v2(const std::string &data) {
+    ProtocolParser::ParseResult result;
+    result.version = ProtocolParser::PROTOCOL_V2;
+    if (data.size() < V2_HEADER_SIZE) {
+        return result;
+    }
+    result.client_type = static_cast<ProtocolParser::ClientType>(
+        static_cast<uint8_t>(data[1]));
+    int type_num = static_cast<uint8_t>(data[2]);
+    if (type_num < 1 || type_num > 200) {
+        return result;
+    }
+    result.type = static_cast<ProtocolParser::MessageType>(type_num);
+    uint32_t net_request_id;
+    memcpy(&net_request_id, data.data() + 3, sizeof(net_request_id));
+    result.request_id = ntohl(net_request_id);
+
+    size_t pos = V2_HEADER_SIZE;
+    uint64_t len = 0;
+    if (!get_varint(data, pos, len) || len > data.size() - pos ||
+        pos >= data.size() - len) {
+        return result;
+    }
+    result.equipment_id = data.substr(pos, len);
+    pos += len;
+
+    size_t count = static_cast<uint8_t>(data[pos++]);
+    for (size_t i = 0; i < count; ++i) {
+        uint64_t tag = 0;
+        if (!get_varint(data, pos, tag)) {
+            return result;
+        }
+        if (i > 0) {
+            result.payload += '|';
+        }
+        uint64_t value = tag >> 1;
+        if ((tag & 1) == ProtocolParser::FIELD_STRING) {
+            if (value > data.size() - pos) {
+                return result;
+            }
+            result.payload.append(data, pos, value);
+            pos += value;
+        } else {
+            int64_t number = static_cast<int64_t>(value >> 1) ^
+                             -static_cast<int64_t>(value & 1);
+            result.payload += std::to_string(number);
+        }
+    }
+    result.success = pos == data.size();
+    return result;
+}
+
+} // namespace
+
 ProtocolParser::ParseResult
 ProtocolParser::parse_message(const std::string &data) {
+    if (!data.empty() && static_cast<uint8_t>(data[0]) == PROTOCOL_V2) {
+        return parse_message_v2(data);
+    }
     ParseResult result;
     result.success = false;
 
@@ -63,6 +167,69 @@ ProtocolParser::parse_message(const std::string &data) {
     return result;
 }
 
+std::vector<char> ProtocolParser::pack_message_v2(
+    ClientType client_type, MessageType type, uint32_t request_id,
+    const std::string &equipment_id, const std::vector<std::string> &fields) {
+    if (fields.size() > MAX_V2_FIELDS) {
+        return {};
+    }
+    std::vector<char> packed(4); // 长度头最后填
+    packed.push_back(static_cast<char>(PROTOCOL_V2));
+    packed.push_back(static_cast<char>(client_type));
+    packed.push_back(static_cast<char>(type));
+    uint32_t net_request_id = htonl(request_id);
+    const char *id_bytes = reinterpret_cast<const char *>(&net_request_id);
+    packed.insert(packed.end(), id_bytes, id_bytes + sizeof(net_request_id));
+    put_varint(packed, equipment_id.size());
+    packed.insert(packed.end(), equipment_id.begin(), equipment_id.end());
+    packed.push_back(static_cast<char>(fields.size()));
+    for (const auto &field : fields) {
+        int64_t value = 0;
+        if (canonical_int(field, value)) {
+            uint64_t zigzag = (static_cast<uint64_t>(value) << 1) ^
+                              static_cast<uint64_t>(value >> 63);
+            put_varint(packed, (zigzag << 1) | FIELD_INT);
+        } else {
+            put_varint(packed, uint64_t{field.size()} << 1 | FIELD_STRING);
+            packed.insert(packed.end(), field.begin(), field.end());
+        }
+    }
+    uint32_t net_len = htonl(static_cast<uint32_t>(packed.size() - 4));
+    memcpy(packed.data(), &net_len, 4);
+    return packed;
+}
+
+std::vector<char> ProtocolParser::convert_to_v2(const std::vector<char> &packed,
+                                                uint32_t request_id) {
+    // 只转换恰好一条完整消息的数据
+    uint32_t net_len = 0;
+    if (packed.size() < 4) {
+        return {};
+    }
+    memcpy(&net_len, packed.data(), 4);
+    if (ntohl(net_len) != packed.size() - 4) {
+        return {};
+    }
+    std::string body(packed.begin() + 4, packed.end());
+    if (!body.empty() && static_cast<uint8_t>(body[0]) == PROTOCOL_V2) {
+        return packed;
+    }
+    ParseResult parsed = parse_message(body);
+    if (!parsed.success) {
+        return {};
+    }
+    std::vector<std::string> fields = split_string(parsed.payload, '|');
+    // 超出的字段合并到最后一个字段中，与服务端的切分规则一致
+    if (fields.size() > MAX_V2_FIELDS) {
+        for (size_t i = MAX_V2_FIELDS; i < fields.size(); ++i) {
+            fields[MAX_V2_FIELDS - 1] += "|" + fields[i];
+        }
+        fields.resize(MAX_V2_FIELDS);
+    }
+    return pack_message_v2(parsed.client_type, parsed.type, request_id,
+                           parsed.equipment_id, fields);
+}
+
 std::vector<std::string> ProtocolParser::split_string(const std::string &str,
                                                       char delimiter) {
     std::vector<std::string> tokens;
@@ -85,82 +252,65 @@ std::vector<char>
 ProtocolParser::build_qt_login_message(ProtocolParser::ClientType client_type,
                                        const std::string &username,
                                        const std::string &password) {
-    std::string body = std::to_string(client_type) + "|" +
-                       std::to_string(static_cast<int>(QT_CLIENT_LOGIN)) + "|" +
-                       "qt_client" + "|" + // 固定设备ID，标识为Qt客户端
-                       username + "|" + password;
-    return pack_message(body);
+    // 固定设备ID，标识为Qt客户端
+    return message_schema::build<message_schema::QtClientLogin>(
+        client_type, "qt_client", username, password);
 }
 
 // Qt客户端登录响应
 std::vector<char> ProtocolParser::build_qt_login_response_message(
     ProtocolParser::ClientType client_type, bool success,
     const std::string &message) {
-    std::vector<std::string> fields;
-    fields.push_back(success ? "success" : "fail");
-    if (!message.empty()) {
-        fields.push_back(message);
-    }
-    std::string body =
-        build_message_body(client_type, QT_LOGIN_RESPONSE, "", fields);
-    return pack_message(body);
+    return message_schema::build<message_schema::QtLoginResponse>(
+        client_type, "", success ? "success" : "fail", message);
 }
 
 std::vector<char> ProtocolParser::build_qt_equipment_list_query(
     ProtocolParser::ClientType client_type) {
-    std::string body = std::to_string(client_type) + "|" +
-                       std::to_string(static_cast<int>(QT_EQUIPMENT_LIST_QUERY)) +
-                       "||";
-    return pack_message(body);
+    return message_schema::build<message_schema::QtEquipmentListQuery>(
+        client_type, "");
 }
 
 // ============ Qt客户端心跳消息实现 ============
 
 std::vector<char> ProtocolParser::build_qt_heartbeat_message(
     ClientType client_type, const std::string &client_identifier) {
-    // payload为空
-    return pack_message(
-        build_message_body(client_type, QT_HEARTBEAT, client_identifier, {}));
+    return message_schema::build<message_schema::QtHeartbeat>(
+        client_type, client_identifier);
 }
 
 std::vector<char> ProtocolParser::build_qt_heartbeat_response(
     ClientType client_type, const std::string &client_identifier,
     const std::string &timestamp) {
-    return pack_message(build_message_body(client_type, QT_HEARTBEAT_RESPONSE,
-                                           client_identifier, {timestamp}));
+    return message_schema::build<message_schema::QtHeartbeatResponse>(
+        client_type, client_identifier, timestamp);
 }
 
 std::vector<char>
 ProtocolParser::build_set_threshold_message(ClientType client_type,
                                             const std::string &equipment_id,
                                             float threshold_value) {
-    // payload: "equipment_id|threshold_value"
-    std::string payload = equipment_id + "|" + std::to_string(threshold_value);
-    return pack_message(build_message_body(client_type, QT_SET_THRESHOLD,
-                                           equipment_id, {payload}));
+    return message_schema::build<message_schema::QtSetThreshold>(
+        client_type, equipment_id, equipment_id,
+        std::to_string(threshold_value));
 }
 
 std::vector<char> ProtocolParser::build_set_threshold_response(
     ClientType client_type, bool success, const std::string &message) {
-    return pack_message(
-        build_message_body(client_type, QT_SET_THRESHOLD_RESPONSE, "response",
-                           {success ? "success" : "fail", message}));
+    return message_schema::build<message_schema::QtSetThresholdResponse>(
+        client_type, "response", success ? "success" : "fail", message);
 }
 
 std::vector<char>
 ProtocolParser::build_get_all_thresholds_message(ClientType client_type) {
-    return pack_message(
-        build_message_body(client_type, QT_GET_ALL_THRESHOLDS, "", {}));
+    return message_schema::build<message_schema::QtGetAllThresholds>(
+        client_type, "");
 }
 
 std::vector<char> ProtocolParser::build_get_all_thresholds_response(
     ClientType client_type, bool success, const std::string &data) {
-    std::vector<std::string> fields;
-    fields.push_back(success ? "success" : "fail");
-    if (!data.empty())
-        fields.push_back(data);
-    return pack_message(build_message_body(
-        client_type, QT_GET_ALL_THRESHOLDS_RESPONSE, "response", fields));
+    return message_schema::build<message_schema::QtGetAllThresholdsResponse>(
+        client_type, "response", success ? "success" : "fail", data);
 }
 
 // ============ 私有工具函数 ============
@@ -189,32 +339,23 @@ ProtocolParser::build_message_body(ClientType client_type, MessageType type,
 std::vector<char> ProtocolParser::build_online_message(
     ClientType client_type, const std::string &equipment_id,
     const std::string &location, const std::string &equipment_type) {
-    std::string body = build_message_body(
-        client_type, EQUIPMENT_ONLINE, equipment_id, {location, equipment_type});
-    return pack_message(body);
+    return message_schema::build<message_schema::EquipmentOnline>(
+        client_type, equipment_id, location, equipment_type);
 }
 
 std::vector<char> ProtocolParser::build_online_response(ClientType client_type,
                                                         bool success) {
-    std::string body =
-        build_message_body(client_type, MessageType::ONLINE_RESPONSE, "response",
-                           {success ? "success" : "fail"});
-    return pack_message(body);
+    return message_schema::build<message_schema::OnlineResponse>(
+        client_type, "response", success ? "success" : "fail");
 }
 
 // ============ 登录消息实现 ============
 
 std::vector<char> ProtocolParser::buildQtLoginResponseMessage(
     ClientType client_type, bool success, const std::string &message) {
-    std::vector<std::string> fields;
-    fields.push_back(success ? "success" : "fail");
-    if (!message.empty()) {
-        fields.push_back(message);
-    }
-    // 注意：这里设备ID为空字符串，使用专门的消息构建函数
-    std::string body = build_message_body(
-        client_type, MessageType::QT_LOGIN_RESPONSE, "", fields);
-    return pack_message(body);
+    // 注意：这里设备ID为空字符串
+    return message_schema::build<message_schema::QtLoginResponse>(
+        client_type, "", success ? "success" : "fail", message);
 }
 
 // ============ 状态相关消息实现 ============
@@ -223,31 +364,22 @@ std::vector<char> ProtocolParser::build_status_update_message(
     ClientType client_type, const std::string &equipment_id,
     const std::string &status, const std::string &power_state,
     const std::string &more_data) {
-    std::vector<std::string> fields = {status, power_state};
-    if (!more_data.empty()) {
-        fields.push_back(more_data);
-    }
-
-    std::string body = build_message_body(client_type, MessageType::STATUS_UPDATE,
-                                          equipment_id, fields);
-    return pack_message(body);
+    return message_schema::build<message_schema::StatusUpdate>(
+        client_type, equipment_id, status, power_state, more_data);
 }
 
 std::vector<char>
 ProtocolParser::build_status_query(ClientType client_type,
                                    const std::string &equipment_id) {
-    std::string body =
-        build_message_body(client_type, MessageType::STATUS_QUERY, equipment_id);
-    return pack_message(body);
+    return message_schema::build<message_schema::StatusQuery>(
+        client_type, equipment_id);
 }
 
 std::vector<char> ProtocolParser::build_status_response(
     ClientType client_type, const std::string &equipment_id,
     const std::string &status, const std::string &power_state) {
-    std::string body =
-        build_message_body(client_type, MessageType::STATUS_RESPONSE,
-                           equipment_id, {status, power_state});
-    return pack_message(body);
+    return message_schema::build<message_schema::StatusResponse>(
+        client_type, equipment_id, status, power_state);
 }
 
 // ============ 控制相关消息实现 ============
@@ -255,29 +387,15 @@ std::vector<char> ProtocolParser::build_status_response(
 std::vector<char> ProtocolParser::build_control_command(
     ClientType client_type, const std::string &equipment_id,
     ControlCommandType command_type, const std::string &parameters) {
-    std::vector<std::string> fields = {
-                                       std::to_string(static_cast<int>(command_type))};
-    if (!parameters.empty()) {
-        fields.push_back(parameters);
-    }
-
-    std::string body = build_message_body(
-        client_type, MessageType::CONTROL_COMMAND, equipment_id, fields);
-    return pack_message(body);
+    return message_schema::build<message_schema::ControlCommand>(
+        client_type, equipment_id, command_type, parameters);
 }
 
 std::vector<char> ProtocolParser::build_control_command_to_server(
     ClientType client_type, const std::string &equipment_id,
     ControlCommandType command_type, const std::string &parameters) {
-    std::vector<std::string> fields = {
-                                       std::to_string(static_cast<int>(command_type))};
-    if (!parameters.empty()) {
-        fields.push_back(parameters);
-    }
-
-    std::string body = build_message_body(
-        client_type, MessageType::QT_CONTROL_REQUEST, equipment_id, fields);
-    return pack_message(body);
+    return message_schema::build<message_schema::QtControlRequest>(
+        client_type, equipment_id, command_type, parameters);
 }
 
 std::vector<char> ProtocolParser::build_control_response(
@@ -291,23 +409,17 @@ std::vector<char> ProtocolParser::build_control_response(
 std::vector<char>
 ProtocolParser::build_my_control_query(ClientType client_type,
                                        const std::string &reservation_id) {
-    // 消息体：类型 + 设备ID（留空）+ payload（预约ID）
-    std::string body = build_message_body(client_type, QT_MY_CONTROL_QUERY, "",
-                                          {reservation_id});
-    return pack_message(body);
+    // 设备ID留空
+    return message_schema::build<message_schema::QtMyControlQuery>(
+        client_type, "", reservation_id);
 }
 
 std::vector<char> ProtocolParser::build_my_control_request(
     ClientType client_type, const std::string &equipment_id,
     const std::string &command, const std::string &parameters) {
-    // payload 格式：设备ID|命令|参数
-    std::string payload = equipment_id + "|" + command;
-    if (!parameters.empty()) {
-        payload += "|" + parameters;
-    }
-    std::string body =
-        build_message_body(client_type, QT_MY_CONTROL_REQUEST, "", {payload});
-    return pack_message(body);
+    // 设备ID在payload中，消息头的设备ID留空
+    return message_schema::build<message_schema::QtMyControlRequest>(
+        client_type, "", equipment_id, command, parameters);
 }
 
 std::vector<char>
@@ -323,16 +435,14 @@ ProtocolParser::build_my_control_response(ClientType client_type,
 std::vector<char>
 ProtocolParser::build_heartbeat_message(ClientType client_type,
                                         const std::string &equipment_id) {
-    std::string body =
-        build_message_body(client_type, MessageType::HEARTBEAT, equipment_id);
-    return pack_message(body);
+    return message_schema::build<message_schema::Heartbeat>(
+        client_type, equipment_id);
 }
 
 std::vector<char>
 ProtocolParser::build_heartbeat_response(ClientType client_type) {
-    std::string body =
-        build_message_body(client_type, MessageType::HEARTBEAT_RESPONSE, "pong");
-    return pack_message(body);
+    return message_schema::build<message_schema::HeartbeatResponse>(
+        client_type, "pong");
 }
 
 // ============ 预约系统消息实现 ============
@@ -340,37 +450,27 @@ ProtocolParser::build_heartbeat_response(ClientType client_type) {
 std::vector<char>
 ProtocolParser::build_reservation_response(ClientType client_type, bool success,
                                            const std::string &message) {
-    std::string body =
-        build_message_body(client_type, MessageType::RESERVATION_APPLY,
-                           "response", {success ? "success" : "fail", message});
-    return pack_message(body);
+    return message_schema::build<message_schema::ReservationApplyResponse>(
+        client_type, "response", success ? "success" : "fail", message);
 }
 
 std::vector<char> ProtocolParser::build_reservation_query_response(
     ClientType client_type, bool success, const std::string &data) {
-    std::string body =
-        build_message_body(client_type, MessageType::RESERVATION_QUERY,
-                           "response", {success ? "success" : "fail", data});
-    return pack_message(body);
+    return message_schema::build<message_schema::ReservationQueryResponse>(
+        client_type, "response", success ? "success" : "fail", data);
 }
 
 std::vector<char> ProtocolParser::build_reservation_approve_response(
     ClientType client_type, bool success, const std::string &message) {
-    std::string body =
-        build_message_body(client_type, MessageType::RESERVATION_APPROVE,
-                           "response", {success ? "success" : "fail", message});
-    return pack_message(body);
+    return message_schema::build<message_schema::ReservationApproveResponse>(
+        client_type, "response", success ? "success" : "fail", message);
 }
 
 std::vector<char>
 ProtocolParser::build_my_reservation_response(bool success,
                                               const std::string &data) {
-    std::vector<std::string> fields = {success ? "success" : "fail"};
-    if (!data.empty())
-        fields.push_back(data);
-    std::string body = build_message_body(
-        CLIENT_QT_CLIENT, MY_RESERVATION_RESPONSE, "response", fields);
-    return pack_message(body);
+    return message_schema::build<message_schema::MyReservationResponse>(
+        CLIENT_QT_CLIENT, "response", success ? "success" : "fail", data);
 }
 
 // ============ Qt端预约请求消息实现 ============
@@ -387,9 +487,8 @@ ProtocolParser::build_reservation_message(ClientType client_type,
 std::vector<char>
 ProtocolParser::build_reservation_query(ClientType client_type,
                                         const std::string &equipment_id) {
-    std::string body = build_message_body(
-        client_type, MessageType::RESERVATION_QUERY, equipment_id, {});
-    return pack_message(body);
+    return message_schema::build<message_schema::ReservationQuery>(
+        client_type, equipment_id);
 }
 
 std::vector<char>
@@ -403,20 +502,16 @@ ProtocolParser::build_reservation_approve(ClientType client_type,
 
 std::vector<char>
 ProtocolParser::build_my_reservation_query(ClientType client_type) {
-    std::string body =
-        build_message_body(client_type, MY_RESERVATION_QUERY, "", {});
-    return pack_message(body);
+    return message_schema::build<message_schema::MyReservationQuery>(
+        client_type, "");
 }
 
 std::vector<char> ProtocolParser::build_power_report_message(
     ClientType client_type, const std::string &equipment_id,
     const std::string &power_state, int power_value,
     const std::string &timestamp) {
-    std::string payload =
-        power_state + "|" + std::to_string(power_value) + "|" + timestamp;
-    std::string body =
-        build_message_body(client_type, POWER_REPORT, equipment_id, {payload});
-    return pack_message(body);
+    return message_schema::build<message_schema::PowerReport>(
+        client_type, equipment_id, power_state, power_value, timestamp);
 }
 
 // ============ 告警系统消息实现 ============
@@ -425,31 +520,25 @@ std::vector<char> ProtocolParser::build_alert_message(
     ClientType client_type, const std::string &equipment_id, int alarm_id,
     const std::string &alarm_type, const std::string &severity,
     const std::string &message) {
-    // payload格式: "alarm_id|alarm_type|severity|message"
-    std::string payload = std::to_string(alarm_id) + "|" + alarm_type + "|" +
-                          severity + "|" + message;
-    return pack_message(build_message_body(client_type, QT_ALERT_MESSAGE,
-                                           equipment_id, {payload}));
+    return message_schema::build<message_schema::QtAlertMessage>(
+        client_type, equipment_id, alarm_id, alarm_type, severity, message);
 }
 
 std::vector<char>
 ProtocolParser::build_alert_ack(ClientType client_type,
                                 const std::string &equipment_id, int alarm_id) {
-    return pack_message(build_message_body(
-        client_type, QT_ALERT_ACK, equipment_id, {std::to_string(alarm_id)}));
+    return message_schema::build<message_schema::QtAlertAck>(
+        client_type, equipment_id, alarm_id);
 }
 
 std::vector<char>
 ProtocolParser::build_alarm_query_message(ClientType client_type) {
-    return pack_message(build_message_body(client_type, QT_ALARM_QUERY, "", {}));
+    return message_schema::build<message_schema::QtAlarmQuery>(client_type, "");
 }
 
 std::vector<char>
 ProtocolParser::build_alarm_query_response(ClientType client_type, bool success,
                                            const std::string &data) {
-    std::vector<std::string> fields = {success ? "success" : "fail"};
-    if (!data.empty())
-        fields.push_back(data);
-    return pack_message(build_message_body(client_type, QT_ALARM_QUERY_RESPONSE,
-                                           "response", fields));
+    return message_schema::build<message_schema::QtAlarmQueryResponse>(
+        client_type, "response", success ? "success" : "fail", data);
 }
@@ -1,4 +1,5 @@
 #pragma once
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -42,6 +43,9 @@ public:
         QT_ENERGY_QUERY = 18,    // Qt客户端 -> 服务器：查询能耗
         QT_ENERGY_RESPONSE = 19, // 服务器 -> Qt客户端：返回能耗数据
 
+        // 设备→服务器：一帧携带多条遥测消息，Qt客户端不收发
+        BATCH = 20,
+
         // ===== Qt客户端专用消息 =====
         QT_CLIENT_LOGIN = 100,         // Qt客户端 -> 服务器：登录请求
         QT_LOGIN_RESPONSE = 101,       // 服务器 -> Qt客户端：登录响应
@@ -85,18 +89,44 @@ public:
         GET_STATUS = 5
     };
 
+    // ============ 协议版本 ============
+    // 与服务端shared_components/protocol_parser.h保持一致：
+    // v1为文本消息体，v2为二进制消息体（网络字节序）：
+    //   u8 版本(=2) | u8 客户端类型 | u8 消息类型 | u32 请求ID |
+    //   varint 设备ID长度 | 设备ID | u8 字段数 | 字段...
+    // 字段是一个varint标记，最低位为FieldKind：FIELD_STRING为长度<<1后跟字节，
+    // FIELD_INT为(zigzag值<<1)|1。
+    // 登录消息（QT_CLIENT_LOGIN）用v2发送时，服务端此后用v2回复
+    static constexpr uint8_t PROTOCOL_V1 = 1;
+    static constexpr uint8_t PROTOCOL_V2 = 2;
+    enum FieldKind : uint8_t { FIELD_STRING = 0, FIELD_INT = 1 };
+    // v2单条消息最多的payload字段数（服务端MAX_FIELDS - 3）
+    static constexpr size_t MAX_V2_FIELDS = 29;
+
     // ============ 解析结果结构 ============
+    // v2消息的payload按v1格式用'|'拼接，整数字段还原为十进制文本
     struct ParseResult {
-        ClientType client_type;
-        MessageType type;
+        ClientType client_type = CLIENT_UNKNOWN;
+        MessageType type = UNKNOWN_TYPE;
         std::string equipment_id;
         std::string payload;
-        bool success;
+        bool success = false;
+        uint8_t version = PROTOCOL_V1;
+        uint32_t request_id = 0;
     };
 
     // ============ 基础消息操作 ============
     static std::vector<char> pack_message(const std::string &body);
+    // 自动识别v1/v2消息体
     static ParseResult parse_message(const std::string &data);
+    // 按v2编码并加长度头，规范形式的十进制整数字段编码为FIELD_INT
+    static std::vector<char>
+    pack_message_v2(ClientType client_type, MessageType type,
+                    uint32_t request_id, const std::string &equipment_id,
+                    const std::vector<std::string> &fields);
+    // 把一条已打包的v1消息转换为v2，格式错误时返回空
+    static std::vector<char> convert_to_v2(const std::vector<char> &packed,
+                                           uint32_t request_id = 0);
     static std::vector<std::string> split_string(const std::string &str,
                                                  char delimiter);
     // Qt客户端登录相关
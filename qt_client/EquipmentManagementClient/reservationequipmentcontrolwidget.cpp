@@ -1,4 +1,5 @@
 #include "reservationequipmentcontrolwidget.h"
+#include "message_schema.h"
 #include <QMessageBox>
 #include <QDebug>
 #include <QScrollArea>
@@ -28,13 +29,6 @@ void ReservationEquipmentControlWidget::setMessageDispatcher(MessageDispatcher *
                                               handleEquipmentListResponse(result);
                                           });
                                       });
-        // 注册控制响应处理器（复用 CONTROL_RESPONSE）
-        m_dispatcher->registerHandler(ProtocolParser::CONTROL_RESPONSE,
-                                      [this](const ProtocolParser::ParseResult &result) {
-                                          QMetaObject::invokeMethod(this, [this, result]() {
-                                              handleControlResponse(result);
-                                          });
-                                      });
     }
 }
 
@@ -319,7 +313,15 @@ void ReservationEquipmentControlWidget::onControlButtonClicked()
         equipmentId.toStdString(),
         command.toStdString()
         );
-    m_tcpClient->sendData(QByteArray(msg.data(), msg.size()));
+    // CONTROL_RESPONSE也会发给设备管理页面，按请求ID只接收本控件发出的请求的响应
+    if (!m_dispatcher) return;
+    m_dispatcher->sendRequest(msg, ProtocolParser::CONTROL_RESPONSE,
+                              [this](const ProtocolParser::ParseResult &result) {
+                                  QMetaObject::invokeMethod(this, [this, result]() {
+                                      handleControlResponse(result);
+                                  });
+                              },
+                              equipmentId.toStdString());
 }
 
 void ReservationEquipmentControlWidget::handleControlResponse(const ProtocolParser::ParseResult &result)
@@ -333,13 +335,15 @@ void ReservationEquipmentControlWidget::handleControlResponse(const ProtocolPars
     qDebug() << "[响应] 设备:" << equipId << "载荷:" << QString::fromStdString(result.payload);
     qDebug() << "[响应] 当前控件映射:" << m_equipmentControls.keys();
     QString equipmentId = QString::fromStdString(result.equipment_id);  // 设备ID从消息中获取
-    QString payload = QString::fromStdString(result.payload);
-    QStringList parts = payload.split('|');
-    if (parts.size() < 4) return;  // 格式错误
-
-    bool success = (parts[1] == "success");
-    QString command = parts[2];
-    QString message = parts[3];
+    using Response = message_schema::ControlResponse;
+    message_schema::Decoded<Response> response;
+    if (response.decode(result.payload) != message_schema::DECODE_OK) return;  // 格式错误
+
+    bool success = response.text<Response::RESULT>() == "success";
+    std::string_view commandText = response.text<Response::COMMAND>();
+    std::string_view messageText = response.text<Response::MESSAGE>();
+    QString command = QString::fromUtf8(commandText.data(), commandText.size());
+    QString message = QString::fromUtf8(messageText.data(), messageText.size());
 
     if (success) {
         if (m_equipmentControls.contains(equipmentId)) {
@@ -6,6 +6,8 @@ TcpClient::TcpClient(QObject *parent) : QObject(parent)
     , m_isProcessingData(false) // 新增初始化
     , m_heartbeatTimer(new QTimer(this))  // 新增
     , m_heartbeatInterval(30)              // 新增
+    , m_protocolVersion(qEnvironmentVariableIntValue("EMS_PROTOCOL_VERSION") == ProtocolParser::PROTOCOL_V2
+                            ? ProtocolParser::PROTOCOL_V2 : ProtocolParser::PROTOCOL_V1)
 {
     // 连接信号与槽：当socket有数据可读时，调用我们的处理函数
     connect(m_socket, &QTcpSocket::readyRead, this, &TcpClient::onSocketReadyRead);
@@ -49,12 +51,22 @@ void TcpClient::disconnectFromServer()
     }
 }
 
-qint64 TcpClient::sendData(const QByteArray& data)
+qint64 TcpClient::sendData(const QByteArray& data, quint32 requestId)
 {
     if (!isConnected()) {
         qWarning() << "Cannot send data, socket not connected.";
         return -1;
     }
+    if (m_protocolVersion == ProtocolParser::PROTOCOL_V2) {
+        // 消息仍按v1构建，发送前转换；不是单条完整消息时原样发送
+        std::vector<char> packed(data.begin(), data.end());
+        std::vector<char> converted = ProtocolParser::convert_to_v2(packed, requestId);
+        if (!converted.empty()) {
+            qint64 bytesWritten = m_socket->write(converted.data(), converted.size());
+            m_socket->flush();
+            return bytesWritten;
+        }
+    }
     qint64 bytesWritten = m_socket->write(data);
     m_socket->flush(); // 尝试立即发送
     return bytesWritten;
@@ -102,15 +114,15 @@ void TcpClient::onSocketReadyRead()
             bytesAvailable = 1024; // 默认读取块大小
         }
 
-        // 2. 准备缓冲区并读取数据
-        QByteArray buffer;
-        buffer.resize(bytesAvailable);
-        qint64 bytesRead = m_socket->read(buffer.data(), buffer.size());
+        // 2. 直接读进消息缓冲区的空闲区（单次最多16KB，剩余的下一轮再读）
+        bytesAvailable = qMin<qint64>(bytesAvailable, 16 * 1024);
+        char *dest = m_messageBuffer.prepare_write(static_cast<size_t>(bytesAvailable));
+        qint64 bytesRead = m_socket->read(dest, bytesAvailable);
 
         if (bytesRead > 0) {
-            // 3. 调整缓冲区实际大小并处理数据
-            buffer.resize(bytesRead);
-            processReceivedData(buffer);
+            // 3. 提交实际读取的长度并处理完整消息
+            m_messageBuffer.commit_write(static_cast<size_t>(bytesRead));
+            processReceivedData();
         } else if (bytesRead == 0) {
             // 读取到0字节，远程端已优雅关闭
             qDebug() << "Remote host closed the connection gracefully.";
@@ -136,42 +148,25 @@ void TcpClient::onSocketErrorOccurred(QAbstractSocket::SocketError error)
     emit errorOccurred(m_socket->errorString());
 }
 
-void TcpClient::processReceivedData(const QByteArray &data)
+void TcpClient::processReceivedData()
 {
-    // 1. 将收到的原始数据追加到消息缓冲区
-    m_messageBuffer.append_data(data.constData(), data.size());
-
-    // 2. 循环提取并处理所有完整的消息
-    std::vector<std::string> completeMessages;
-    while (true) {
-        completeMessages.clear(); // 清空上次的结果
-        size_t extractedCount = m_messageBuffer.extract_messages(completeMessages);
-
-        if (extractedCount == 0) {
-            // 没有提取到完整消息，说明数据还不完整，等待下次接收
-            break;
-        }
-
-        // 3. 处理每一个提取出的完整消息
-        for (const auto& msg : completeMessages) {
-            ProtocolParser::ParseResult result = ProtocolParser::parse_message(msg);
-            if (result.success) {
-                // 成功解析，发出信号
-                qDebug() << "Successfully parsed a message, type:" << result.type;
-                emit protocolMessageReceived(result);
-            } else {
-                // 解析失败，可能是协议错误或数据损坏
-                qWarning() << "Failed to parse a message. Raw data (hex):"
-                           << QByteArray(msg.data(), msg.size()).toHex().constData();
-                // 可选：如果协议错误严重，可以断开连接
-                // emit errorOccurred("Protocol error: invalid message format.");
-                // disconnectFromServer();
-                // return;
-            }
+    // 循环提取并处理所有完整的消息（帧视图指向缓冲区，下次读取前有效）
+    std::string_view msg;
+    while (m_messageBuffer.next_frame(msg)) {
+        ProtocolParser::ParseResult result = ProtocolParser::parse_message(std::string(msg));
+        if (result.success) {
+            // 成功解析，发出信号
+            qDebug() << "Successfully parsed a message, type:" << result.type;
+            emit protocolMessageReceived(result);
+        } else {
+            // 解析失败，可能是协议错误或数据损坏
+            qWarning() << "Failed to parse a message. Raw data (hex):"
+                       << QByteArray(msg.data(), static_cast<int>(msg.size())).toHex().constData();
+            // 可选：如果协议错误严重，可以断开连接
+            // emit errorOccurred("Protocol error: invalid message format.");
+            // disconnectFromServer();
+            // return;
         }
-
-        // 4. 如果缓冲区提取后还有残留数据，且还能继续提取，则继续循环
-        // (extract_messages 内部已处理，此处while循环条件保证继续尝试)
     }
 
     // 5. (重要) 安全阀：检查缓冲区是否异常增长（防止恶意或错误数据）
@@ -18,8 +18,8 @@ public:
     bool connectToServer(const QString& host, quint16 port);
     // 断开连接
     void disconnectFromServer();
-    // 发送原始数据（已打包的消息）
-    qint64 sendData(const QByteArray& data);
+    // 发送原始数据（已打包的消息）；使用v2时requestId写入帧头，服务端回复时带回
+    qint64 sendData(const QByteArray& data, quint32 requestId = 0);
     // 发送协议消息（自动打包）
     bool sendProtocolMessage(ProtocolParser::ClientType client_type,
         ProtocolParser::MessageType message_type,
@@ -27,6 +27,7 @@ public:
                              const QString& payload = "");
 
     bool isConnected() const;
+    uint8_t protocolVersion() const { return m_protocolVersion; }
 
     // 新增：启动/停止自动心跳
     void startHeartbeat(const QString& equipmentId = "qt_client", int intervalSeconds = 5);
@@ -48,7 +49,7 @@ private slots:
     void onSocketErrorOccurred(QAbstractSocket::SocketError error);
 private:
     // 新增：一个专门用于处理接收数据的私有方法
-    void processReceivedData(const QByteArray &data);
+    void processReceivedData();
     QTcpSocket* m_socket;
     MessageBuffer m_messageBuffer; // 用于处理消息边界
     // 新增：防止在极端情况下递归处理导致栈溢出
@@ -58,6 +59,9 @@ private:
     QTimer* m_heartbeatTimer;          // 心跳定时器
     int m_heartbeatInterval;           // 心跳间隔（秒）
     QString m_lastEquipmentId;         // 用于心跳的设备ID
+
+    // 发送使用的协议版本，环境变量EMS_PROTOCOL_VERSION=2时用二进制协议v2
+    uint8_t m_protocolVersion;
 };
 
 #endif // TCPCLIENT_H
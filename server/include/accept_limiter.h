@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+
+// 按来源IP限制新连接速率的令牌桶表：每个IP每秒补充rate个令牌，
+// 最多积累burst个，accept一个连接消耗一个。
+// 不加锁，每个Reactor持有一份，只在所属线程使用。
+class AcceptRateLimiter {
+public:
+  // rate_per_second为0表示不限速
+  void configure(double rate_per_second, double burst);
+  bool enabled() const { return rate_per_ms_ > 0; }
+
+  // ip为网络字节序的IPv4地址；令牌不足时返回false
+  bool allow(uint32_t ip, uint64_t now_ms);
+
+  // 删除令牌已经补满的条目（等同于从未出现过），防止表无限增长
+  void prune(uint64_t now_ms);
+
+  size_t size() const { return buckets_.size(); }
+
+private:
+  struct Bucket {
+    double tokens = 0;
+    uint64_t last_ms = 0;
+  };
+
+  double rate_per_ms_ = 0;
+  double burst_ = 0;
+  std::unordered_map<uint32_t, Bucket> buckets_;
+};
@@ -1,13 +1,41 @@
 #pragma once
 
+#include "epoll.h"
 #include "equipment.h"
+#include "message_buffer.h"
+#include "output_queue.h"
 #include "protocol_parser.h"
+#include "shm_channel.h"
+#include <atomic>
+#include <cstdint>
+#include <functional>
 #include <memory>
+#include <mutex>
 #include <shared_mutex>
 #include <unordered_map>
 #include <vector>
+
+// 连接所属事件循环提供的可写通知：有未写完的数据时开启，写完后关闭。
+// epoll后端对应EPOLLOUT；io_uring后端对应一次性的POLLOUT请求，
+// 每次通知后需要重新开启（oneshot）
+class WriteInterest {
+public:
+  virtual ~WriteInterest() = default;
+  virtual bool set_write_interest(int fd, bool enable) = 0;
+  virtual bool write_interest_oneshot() const { return false; }
+};
+
 class ConnectionManager {
+private:
+  struct OutboundState;
+
 public:
+  // 客户端连接注册到epoll的事件，EPOLLOUT只在有待发送数据时临时追加
+  // （io_uring后端不使用）
+  static constexpr uint32_t CONNECTION_EVENTS = EPOLLIN | EPOLLET | EPOLLRDHUP;
+  // 连接表容量上限（fd数）
+  static constexpr size_t MAX_TABLE_FDS = size_t{1} << 22;
+
   // 用户信息结构
   struct UserInfo {
     std::string username;
@@ -15,6 +43,45 @@ public:
     int user_id;
   };
 
+  // 每个fd一条连接记录，按fd下标存放在分页的连续数组中。
+  // 记录地址在进程生命周期内不变（fd复用时原地重置），epoll的data.ptr
+  // 直接指向它；generation在每次复用时递增，持有旧fd的一方据此识别过期连接。
+  // 原子字段可以无锁读取；equipment、user_info、outbound受connection_rw_lock_
+  // 保护；message_buffer和heartbeat_timer只由连接所属的Reactor线程访问
+  struct Connection {
+    int fd = -1;
+    std::atomic<uint32_t> generation{0};
+    std::atomic<bool> in_use{false};
+    std::atomic<bool> healthy{false};
+    std::atomic<time_t> last_heartbeat{0};
+    std::atomic<ProtocolParser::ClientType> client_type{
+        ProtocolParser::CLIENT_UNKNOWN};
+    std::atomic<int> reactor_id{-1}; // 所属Reactor，注册到事件循环时设置
+
+    std::shared_ptr<Equipment> equipment; // Qt客户端为nullptr
+    // 网关连接上后续上线的其他设备（equipment是首个上线的设备）
+    std::vector<std::shared_ptr<Equipment>> gateway_equipments;
+    bool has_user_info = false;
+    UserInfo user_info;
+    std::shared_ptr<OutboundState> outbound;
+
+    std::unique_ptr<MessageBuffer> message_buffer;
+    // 非空表示共享内存通道连接：fd是本端eventfd，数据经由共享内存收发
+    std::shared_ptr<ShmChannel> shm_channel;
+    uint64_t heartbeat_timer = 0; // TimerWheel::TimerId
+    bool read_ready = false;      // 已在所属Reactor的就绪队列中等待继续读取
+    // 饥饿统计：读预算用完、被推迟到下一轮的次数
+    std::atomic<uint64_t> read_deferrals{0};
+  };
+
+  ConnectionManager();
+  ~ConnectionManager();
+  ConnectionManager(const ConnectionManager &) = delete;
+  ConnectionManager &operator=(const ConnectionManager &) = delete;
+
+  // 按fd取连接记录（无锁、无哈希查找），fd未使用时返回nullptr
+  Connection *get_connection(int fd) const;
+
   // 设置连接的用户信息
   void set_user_info(int fd, const std::string &username,
                      const std::string &role, int user_id);
@@ -23,9 +90,14 @@ public:
   bool get_user_info(int fd, UserInfo &user_info);
 
   // 连接管理
-  void add_connection(int fd, std::shared_ptr<Equipment> equipment,
+  // write_interest 为连接所属的事件循环，用于按需开关可写通知
+  // shm_channel 非空时连接的读写经由共享内存（fd为通道的eventfd）
+  // fd超出连接表容量或已存在时返回false
+  bool add_connection(int fd, std::shared_ptr<Equipment> equipment,
                       ProtocolParser::ClientType client_type =
-                          ProtocolParser::CLIENT_QT_CLIENT);
+                          ProtocolParser::CLIENT_QT_CLIENT,
+                      WriteInterest *write_interest = nullptr,
+                      std::shared_ptr<ShmChannel> shm_channel = nullptr);
   void remove_connection(int fd);
   void close_all_connections();
 
@@ -35,11 +107,22 @@ public:
   get_equipment_by_id(const std::string &Equipment_id);
   int get_fd_by_equipment_id(const std::string &equipment_id);
   std::vector<std::shared_ptr<Equipment>> get_all_equipments();
+  // 设备已在fd上上线（连接绑定的设备中有它，且它当前映射到这个fd）。
+  // 设备发来的消息自带设备ID，处理前用它确认不是冒充其他设备
+  bool is_equipment_bound(int fd, const std::string &equipment_id) const;
+  // 限速等按设备计数时用的设备ID：claimed_id已在fd上上线时就是它，
+  // 否则是连接上首个上线的设备；连接还没有设备上线时返回空
+  std::string get_bound_equipment_id(int fd,
+                                     const std::string &claimed_id) const;
+  // fd上已上线且仍映射到它的全部设备；网关连接有多个，Qt连接为空
+  std::vector<std::shared_ptr<Equipment>> get_bound_equipments(int fd) const;
 
   // 状态管理
   void update_heartbeat(int fd);
   void update_qt_client_heartbeat(int fd);
   void check_heartbeat_timeout(int timeout_seconds = 60);
+  // 单个连接的心跳定时器到期：标记为不健康（不清理）
+  void handle_heartbeat_timeout(int fd);
   bool is_connection_healthy(int fd) const;
   bool is_equipment_connection_healthy(const std::string &equipment_id) const;
   //连接状态查询
@@ -67,12 +150,14 @@ public:
   std::vector<std::pair<int, std::shared_ptr<Equipment>>>
   get_all_connections() const;
 
-  // 控制命令转发
+  // 控制命令转发；request_id放在parameters第一段（"request_id|parameters"），
+  // 非0时也随v2帧头发给设备，设备在响应中带回
   bool
   send_control_to_simulator(ProtocolParser::ClientType client_type,
                             const std::string &equipment_id,
                             ProtocolParser::ControlCommandType command_type,
-                            const std::string &parameters = "");
+                            const std::string &parameters = "",
+                            uint32_t request_id = 0);
 
   bool send_batch_control_to_simulator(
       ProtocolParser::ClientType client_type,
@@ -80,21 +165,146 @@ public:
       ProtocolParser::ControlCommandType command_type,
       const std::string &parameters = "");
 
+  // ============ 出站队列 ============
+  // 水位配置：超过high_watermark视为拥塞，回落到low_watermark以下解除；
+  // 拥塞持续超过slow_consumer_timeout_seconds，或积压超过max_pending_bytes，
+  // 则判定为慢消费者并断开
+  void set_output_limits(size_t low_watermark, size_t high_watermark,
+                         size_t max_pending_bytes,
+                         int slow_consumer_timeout_seconds);
+  // 不小于threshold字节的消息在TCP连接上用MSG_ZEROCOPY发送，0表示关闭。
+  // 只影响之后建立的连接
+  void set_zerocopy_threshold(size_t threshold);
+
+  // 所有发往客户端的数据都经过这里：按顺序入队并尽量立即写出，
+  // 写不完的部分等待可写通知继续发送。返回false表示连接不可用。
+  // 消息按v1打包，连接协商为v2时在这里转换，帧头带上request_id
+  // （回复请求时为请求方的请求ID，主动推送为0；v1连接没有这个字段）
+  bool send_message(int fd, std::vector<char> message, uint32_t request_id = 0);
+
+  // 设置连接的协议版本（上线/登录握手时按客户端使用的版本设置）
+  void set_protocol_version(int fd, uint8_t version);
+
+  // 广播：把同一份已序列化的消息放入所有client_type连接的出站队列，
+  // 各连接共享缓冲区，不逐个重新打包或拷贝。filter不为空时只发给它返回
+  // true的连接（在持有连接表读锁时调用，不能再调用本类的加锁接口）。
+  // 返回成功入队的连接数
+  using BroadcastFilter = std::function<bool(const Connection &)>;
+  size_t broadcast(const OutputQueue::SharedBuffer &message,
+                   ProtocolParser::ClientType client_type,
+                   const BroadcastFilter &filter = nullptr);
+
+  // 可写事件处理，返回false表示连接出错需要关闭
+  bool handle_writable(int fd);
+
+  // EPOLLERR处理：读取错误队列中的零拷贝完成通知并释放已发送的消息。
+  // 返回true表示只是完成通知，连接本身没有错误
+  bool handle_error_queue(int fd);
+
+  // 写合并：begin_write_batch之后当前线程的send_message只入队，
+  // 由flush_write_batch对每个涉及的连接做一次sendmsg批量写出。
+  // 事件循环在每轮处理前后调用
+  void begin_write_batch();
+  void flush_write_batch();
+
+  // 写合并统计：累计写出的消息数与sendmsg调用次数，
+  // 以及零拷贝发送次数和其中被内核退回为拷贝的次数
+  struct WriteStats {
+    uint64_t messages = 0;
+    uint64_t syscalls = 0;
+    uint64_t zerocopy_sends = 0;
+    uint64_t zerocopy_copied = 0;
+  };
+  WriteStats get_write_stats() const;
+
+  // 断开长时间拥塞的慢消费者（由维护任务周期调用）
+  void check_slow_consumers();
+
+  // 获取连接待发送的字节数
+  size_t get_pending_output_bytes(int fd) const;
+
+  // 获取连接因读预算用完被推迟的次数
+  uint64_t get_read_deferrals(int fd) const;
+
   // 获取连接类型
   ProtocolParser::ClientType get_client_type(int fd) const;
 
-  // 更新连接类型（主要用于设备上线时从Qt类型转为设备类型）
+  // 更新连接类型（设备上线时从Qt类型转为设备类型，
+  // 或为设备端口上尚未绑定设备的连接绑定设备）。
+  // 已绑定设备的连接再上线其他设备时作为网关，追加到gateway_equipments
   bool update_connection_to_equipment(int fd,
                                       std::shared_ptr<Equipment> equipment);
 
 private:
+  // 单个连接的出站状态，由自身的mutex保护（任意线程都可能向某个连接发送）。
+  // 加锁顺序：先OutboundState::mutex，再connection_rw_lock_
+  struct OutboundState {
+    std::mutex mutex;
+    OutputQueue queue;
+    WriteInterest *write_interest = nullptr;
+    std::shared_ptr<ShmChannel> shm_channel; // 非空时写入共享内存而不是fd
+    bool write_armed = false; // 已开启可写通知
+    time_t congested_since = 0; // 超过高水位的时间，0表示未拥塞
+    bool closing = false;       // 连接已关闭或已被判定需要断开
+    bool flush_scheduled = false; // 已登记到某个线程的写合并批次
+    uint8_t protocol_version = ProtocolParser::PROTOCOL_V1;
+  };
+
+  // 当前线程的写合并批次
+  struct WriteBatch {
+    bool active = false;
+    std::vector<std::pair<int, std::shared_ptr<OutboundState>>> pending;
+  };
+  static thread_local WriteBatch write_batch_;
+
+  // 连接表按页分配，每页1024条记录；页分配后不再释放，保证记录地址稳定
+  static constexpr int TABLE_PAGE_BITS = 10;
+  static constexpr size_t TABLE_PAGE_SIZE = size_t{1} << TABLE_PAGE_BITS;
+
+  Connection *slot_for(int fd) const;
+  // 取fd对应的记录，所在页不存在时分配（需持有写锁）
+  Connection *allocate_slot_locked(int fd);
+  // 关闭fd并重置记录（需持有写锁）
+  void release_connection_locked(Connection &conn);
+  // 遍历所有使用中的连接（需持有锁）
+  template <typename Func> void for_each_connection_locked(Func &&func) const {
+    for (int fd = 0; fd <= max_fd_; ++fd) {
+      Connection *conn = slot_for(fd);
+      if (conn && conn->in_use.load(std::memory_order_relaxed)) {
+        func(*conn);
+      }
+    }
+  }
+
+  std::shared_ptr<OutboundState> get_outbound(int fd) const;
+  // 以下函数要求调用方已持有state.mutex
+  // 消息入队后的发送调度：等待可写通知、登记写合并批次或立即写出
+  bool schedule_flush(int fd, const std::shared_ptr<OutboundState> &state);
+  bool flush_outbound(int fd, OutboundState &state);
+  void record_flush_stats(const OutputQueue::FlushStats &stats);
+  bool apply_flush_result(int fd, OutboundState &state,
+                          OutputQueue::FlushResult result);
+  bool update_congestion(int fd, OutboundState &state);
+  void disconnect_slow_consumer(int fd, OutboundState &state,
+                                const char *reason);
+
   mutable std::shared_mutex connection_rw_lock_;
-  std::unordered_map<int, ProtocolParser::ClientType>
-      client_types_; // fd -> ClientType
-  std::unordered_map<int, std::shared_ptr<Equipment>>
-      connections_;                                      // fd -> 设备
-  std::unordered_map<int, time_t> heartbeat_times_;      // fd -> 心跳时间
+  // fd -> 连接记录（分页），页指针可以无锁读取
+  std::unique_ptr<std::atomic<Connection *>[]> table_pages_;
+  size_t table_page_count_ = 0;
+  int max_fd_ = -1;             // 使用过的最大fd，遍历的上界
+  std::atomic<size_t> connection_count_{0}; // 使用中的连接数，可无锁读取
   std::unordered_map<std::string, int> equipment_to_fd_; // 设备ID -> fd
-  std::unordered_map<int, bool> connection_healthy_; // fd -> 连接健康状态
-  std::unordered_map<int, UserInfo> fd_to_user_info_; // fd -> 用户信息
+
+  // 出站水位配置
+  size_t output_low_watermark_ = 64 * 1024;
+  size_t output_high_watermark_ = 1024 * 1024;
+  size_t output_max_pending_bytes_ = 8 * 1024 * 1024;
+  int slow_consumer_timeout_seconds_ = 10;
+  size_t zerocopy_threshold_ = 0;
+
+  std::atomic<uint64_t> written_messages_{0};
+  std::atomic<uint64_t> write_syscalls_{0};
+  std::atomic<uint64_t> zerocopy_sends_{0};
+  std::atomic<uint64_t> zerocopy_copied_{0};
 };
\ No newline at end of file
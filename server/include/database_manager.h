@@ -1,6 +1,7 @@
 #pragma once
 
 #include <memory>
+#include <mutex>
 #include <mysql/mysql.h>
 #include <string>
 #include <vector>
@@ -42,6 +43,18 @@ public:
   bool update_equipment_energy_total(const std::string &equipment_id,
                                      double energy_increment);
 
+  // 批量功耗上报中的一条
+  struct PowerLogEntry {
+    std::string equipment_id;
+    double power_value = 0;
+    std::string timestamp;
+    double energy_increment = 0; // 为0时不累加总能耗（设备未开机）
+  };
+  // 一条多行INSERT写入全部功耗日志
+  bool insert_power_logs(const std::vector<PowerLogEntry> &entries);
+  // 一条UPDATE累加各设备总能耗，同一设备出现多次时增量相加
+  bool update_equipment_energy_totals(const std::vector<PowerLogEntry> &entries);
+
   // 能耗统计查询（所有设备）
   std::string get_energy_statistics_all(const std::string &timeRange,
                                         const std::string &startDate,
@@ -122,6 +135,10 @@ public:
 private:
   bool initialize_tables(); // 初始化数据库表
 
+  // 同一个MYSQL连接会被多个Reactor线程使用，所有访问mysql_conn_的操作串行化
+  // （递归锁：部分操作内部会再调用execute_query/execute_update）。
+  // 服务器为设备消息和Qt客户端请求各建一个实例，两边互不等待
+  mutable std::recursive_mutex db_mutex_;
   MYSQL *mysql_conn_;
   std::string host_;
   std::string user_;
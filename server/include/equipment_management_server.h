@@ -6,21 +6,31 @@
 #include "equipment_manager.h"
 #include "message_buffer.h"
 #include "protocol_parser.h"
+#include "reactor.h"
+#include "server_config.h"
 
+#include <atomic>
 #include <memory>
+#include <mutex>
+#include <netinet/in.h>
+#include <shared_mutex>
 #include <string>
+#include <string_view>
 #include <thread>
 #include <unordered_map>
+#include <vector>
 
 class EquipmentManagementServer {
 public:
   EquipmentManagementServer()
       : equipment_manager_(std::make_unique<EquipmentManager>()),
         connections_manager_(std::make_unique<ConnectionManager>()),
-        db_manager_(std::make_unique<DatabaseManager>()) {}
+        db_manager_(std::make_unique<DatabaseManager>()),
+        console_db_manager_(std::make_unique<DatabaseManager>()) {}
   ~EquipmentManagementServer();
   //初始化
   bool init(int server_port);
+  bool init(const ServerConfig &config);
   bool start();
   void stop();
   bool is_running() const { return is_running_; }
@@ -34,16 +44,87 @@ public:
   std::shared_ptr<Equipment>
   handle_qt_status_query(const std::string &equipment_id);
 
+  // 任意线程调用：把任务投递到fd所属的Reactor线程执行，
+  // 执行前fd已关闭（或被新连接复用）时任务被丢弃
+  bool post_to_connection(int fd, TaskQueue::Task task);
+
 private:
-  // 网络事件处理
-  bool process_events(int nfds, struct epoll_event *evs);
-  void handle_client_data(int fd);
-  bool accept_new_connection();
+  // 网络事件处理（每个Reactor线程独立运行）
+  bool create_reactor(Reactor &reactor);
+  // 在Reactor上增加Unix域监听socket（config_.unix_socket_path）
+  bool create_unix_listener(Reactor &reactor);
+  // 在Reactor上增加功耗上报UDP socket（config_.udp_port）
+  bool create_udp_listener(Reactor &reactor);
+  // 在Reactor上增加共享内存通道的握手socket（config_.shm_socket_path）
+  bool create_shm_listener(Reactor &reactor);
+  // 接受模拟器的通道申请：建立共享内存通道，fd经握手socket传过去
+  void accept_shm_channels(Reactor &reactor);
+  bool open_shm_channel(int socket_fd);
+  // 共享内存通道的eventfd可读：读取新数据并继续发送积压数据
+  void handle_shm_event(Reactor &reactor, ConnectionManager::Connection &conn);
+  // 在连接所属的Reactor上关闭连接（必要时投递过去）
+  void close_connection_on_owner(Reactor &reactor, int fd);
+  // 批量接收UDP功耗上报，认证后放入批量队列
+  void receive_udp_reports(Reactor &reactor);
+  // 设备上线时生成UDP上报令牌，与当前TCP会话（fd+代数）绑定
+  std::string issue_udp_token(int fd, const std::string &equipment_id);
+  // 令牌、来源地址和TCP会话都有效时返回会话的fd和代数
+  bool authenticate_udp_report(const std::string &equipment_id,
+                               std::string_view token, uint32_t source_ip,
+                               int &fd, uint32_t &generation);
+  // 把RLIMIT_NOFILE软限制提升到wanted（0表示硬限制），返回生效的值
+  size_t raise_open_file_limit(int wanted);
+  // 运行全局周期任务的Reactor：有Qt Reactor组时取其中第一个，否则为0号
+  Reactor &background_reactor();
+  // 按配置设置各类客户端的消息限速策略
+  void configure_message_limiter(MessageRateLimiter &limiter) const;
+  void run_reactor(Reactor &reactor);
+  bool process_events(Reactor &reactor, int nfds, struct epoll_event *evs);
+  void handle_client_data(Reactor &reactor, int fd);
+  bool accept_new_connection(Reactor &reactor);
+  // 准入检查（连接数上限、单IP限速），不通过时直接RST关闭并返回false。
+  // peer为空时需要限速才调用getpeername
+  bool admit_connection(Reactor &reactor, int client_fd,
+                        const struct sockaddr_in *peer);
+  void reject_connection(int client_fd);
+  // shm_channel非空时client_fd为共享内存通道的eventfd
+  bool register_client_connection(
+      Reactor &reactor, int client_fd,
+      std::shared_ptr<ShmChannel> shm_channel = nullptr);
+  // io_uring后端的事件循环
+  void run_reactor_uring(Reactor &reactor);
+  void process_completions(Reactor &reactor,
+                           const IoUring::Completion *completions, int count);
+  // 把收到的字节交给消息缓冲区并处理完整消息，连接被关闭时返回false
+  bool consume_client_data(Reactor &reactor, int fd, const char *data,
+                           size_t len);
+  // 处理缓冲区中的完整帧，最多frame_budget个（并相应扣减），
+  // 连接被关闭时返回false
+  bool dispatch_client_frames(Reactor &reactor, int fd,
+                              MessageBuffer *msg_buffer, size_t &frame_budget);
+  // 读预算用完：记一次推迟并放入所属Reactor的就绪队列
+  void defer_client_read(Reactor &reactor, int fd);
+  // 处理就绪队列中的连接，每个连接再给一轮预算
+  void run_ready_connections(Reactor &reactor);
+
+  // 按优先级处理本轮放入队列的消息，跳过已关闭连接的消息
+  void drain_priority_lanes(Reactor &reactor);
 
   // 消息处理
-  void process_single_message(int fd, const std::string &message);
+  // 限速检查后分发；超限的消息按策略丢弃、延后或断开连接
+  void process_single_message(Reactor &reactor, PriorityLanes::Item &item);
+  // 扣除一条消息的令牌。可以立即处理时返回true；
+  // 延后处理（已安排定时器）或超限断开（已关闭连接）时返回false
+  bool admit_message(Reactor &reactor, int fd, uint32_t generation,
+                     const ProtocolParser::ParseResult &message,
+                     uint32_t coalesced);
+  // coalesced：过载时被合并掉的同设备旧消息数（见PriorityLanes::coalesce）。
+  // 处理期间current_request_记录请求方，处理器的回复带回其请求ID
+  void dispatch_message(int fd, const ProtocolParser::ParseResult &parse_result,
+                        uint32_t coalesced);
   void process_equipment_message(int fd,
-                                 const ProtocolParser::ParseResult &result);
+                                 const ProtocolParser::ParseResult &result,
+                                 uint32_t coalesced);
   void process_qt_client_message(int fd,
                                  const ProtocolParser::ParseResult &result);
 
@@ -62,9 +143,10 @@ private:
                                const std::string &payload);
   void handle_status_update(int fd, const std::string &equipment_id,
                             const std::string &payload);
+  // 处理设备控制响应：按请求ID取出等待表中的Qt请求并转发
   void handle_control_command_response_from_simulator(
-      int fd, const std::string &equipment_id,
-      const std::string &payload); //处理设备控制响应
+      int fd, const std::string &equipment_id, const std::string &payload,
+      uint32_t request_id);
   void handle_heartbeat(int fd, const std::string &equipment_id);
 
   //处理智能告警ack确认
@@ -76,17 +158,38 @@ private:
   // 处理Qt客户端心跳
   void handle_qt_heartbeat(int fd, const std::string &client_identifier);
 
+  // shed_samples：过载时合并掉的该设备更早的上报数，能耗按本次功率补算
   void handle_power_report(int fd, const std::string &equipment_id,
-                           const std::string &payload);
+                           const std::string &payload, uint32_t shed_samples);
+  // 解析功耗上报、判断阈值告警并刷新心跳，要写库的内容填到entry，
+  // 由调用方单条或批量写入。格式错误返回false
+  bool evaluate_power_report(int fd, const std::string &equipment_id,
+                             const std::string &payload, uint32_t shed_samples,
+                             DatabaseManager::PowerLogEntry &entry);
+  // BATCH：只接受已上线设备连接发来的本设备消息，逐条限速和处理，
+  // 功耗日志合并成一次多行写入
+  void handle_batch(int fd, const std::string &payload);
 
   // 连接管理
-  void handle_connection_close(int fd);
+  void handle_connection_close(Reactor &reactor, int fd);
   void perform_maintenance_tasks();
+  // 各优先级队列的深度、处理数和等待时间分布（汇总所有Reactor）
+  void print_priority_lane_stats();
+  // 各Reactor的过载状态和累计合并的遥测消息数
+  void print_overload_stats();
+  // 消息限速丢弃、延后和断开的累计数
+  void print_message_limiter_stats();
+
+  // 发送给客户端：经由连接的出站队列，写不完的部分等待EPOLLOUT继续发送。
+  // fd是正在处理的请求的发起方时，v2回复带上该请求的ID
+  bool send_to_client(int fd, std::vector<char> message);
 
   void reset_all_equipment_on_shutdown();
 
   //数据库
   bool initialize_database();
+  // 当前线程正在处理Qt客户端请求时返回控制台连接，否则返回设备连接
+  DatabaseManager *db() const;
 
   // 消息缓冲区管理
   MessageBuffer *get_message_buffer(int fd);
@@ -106,9 +209,28 @@ private:
                              ProtocolParser::ControlCommandType command_type,
                              const std::string &parameters = "");
 
-  bool send_control_command_response_to_qt_client(
-      int qt_fd, const std::string &equipment_id, bool sucess,
-      const std::string &reason);
+  // 转发给设备、等待设备响应的Qt请求（控制命令），键为服务器分配的请求ID。
+  // 请求ID随控制命令发给设备（v2帧头和parameters第一段），设备在响应中带回。
+  // Qt连接所属的Reactor登记，设备连接所属的Reactor取出
+  struct PendingRequest {
+    int fd = -1;             // 发起请求的Qt连接
+    uint32_t generation = 0; // 该连接的代数，fd被复用后不再回复
+    uint32_t request_id = 0; // Qt客户端的请求ID，回复时带回
+    std::string equipment_id;
+    std::string command;
+    uint64_t expire_ms = 0;
+  };
+  // 登记当前请求，返回发给设备的请求ID（表满时为0）
+  uint32_t add_pending_request(int fd, const std::string &equipment_id,
+                               const std::string &command);
+  // 只取出发给equipment_id的请求
+  bool take_pending_request(uint32_t id, const std::string &equipment_id,
+                            PendingRequest &request);
+  // 等待超时的请求回复失败（周期任务）
+  void expire_pending_requests();
+  // 回复设备往返请求的发起方；其连接已关闭或fd被复用时不发送
+  bool reply_to_request(const PendingRequest &request,
+                        std::vector<char> message);
 
   std::vector<std::string>
   get_equipment_control_capabilities(const std::string &equipment_id);
@@ -132,7 +254,11 @@ private:
                                 const std::string &payload);
   void handle_reservation_approve(int fd, const std::string &place_id,
                                   const std::string &payload);
-  void check_heartbeat_timeout();
+  // 定时任务：周期任务挂在0号Reactor上，心跳定时器挂在连接所属的Reactor上
+  void schedule_periodic_tasks(Reactor &reactor);
+  void arm_heartbeat_timer(Reactor &reactor, int fd);
+  // 收到心跳后重置超时（在连接所属的Reactor线程调用）
+  void refresh_heartbeat_timer(int fd);
 
   void handle_qt_place_list_query(int fd);
 
@@ -140,13 +266,16 @@ private:
   void handle_qt_energy_query(int fd, const std::string &equipment_id,
                               const std::string &payload);
 
-  void check_qt_client_heartbeat_timeout(int timeout_seconds);
-
   // 发送告警给所有Qt客户端
   void send_alert_to_all_qt_clients(const std::string &alarm_type,
                                     const std::string &equipment_id,
                                     const std::string &severity,
                                     const std::string &message);
+  // 告警去重窗口：(设备ID, 告警类型)在窗口内且未确认时不重复生成
+  bool in_alarm_window(const std::string &key);
+  void open_alarm_window(const std::string &key, int alarm_id,
+                         int window_seconds);
+  void close_alarm_window(int alarm_id);
   //阈值相关函数
   // 从数据库加载阈值
   void load_thresholds_from_db();
@@ -161,15 +290,91 @@ private:
                                    const std::string &payload);
 
   //成员变量
-  const int MAXCLIENTFDS = 1024;
-  int server_fd_;
+  // 连接数上限自动计算时为其他用途预留的fd数
+  static constexpr size_t RESERVED_FDS = 64;
+  // io_uring后端参数：提交队列深度、接收缓冲区数量（2的幂）和大小
+  static constexpr unsigned URING_QUEUE_DEPTH = 1024;
+  static constexpr unsigned URING_BUFFER_COUNT = 2048;
+  static constexpr unsigned URING_BUFFER_SIZE = 2048;
+  // 定时任务参数
+  static constexpr uint64_t MAINTENANCE_INTERVAL_MS = 5000;
+  static constexpr uint64_t SLOW_CONSUMER_CHECK_INTERVAL_MS = 1000;
+  static constexpr uint64_t THRESHOLD_RELOAD_INTERVAL_MS = 60 * 1000;
+  static constexpr uint64_t EQUIPMENT_HEARTBEAT_TIMEOUT_MS = 60 * 1000;
+  static constexpr uint64_t QT_HEARTBEAT_TIMEOUT_MS = 180 * 1000;
+  static constexpr int ALARM_DEDUP_WINDOW_SECONDS = 5 * 60;
+  // 设备没有单独设置能耗阈值时使用（W）
+  static constexpr float DEFAULT_POWER_THRESHOLD_W = 200.0f;
+  static constexpr uint64_t ACCEPT_LIMITER_PRUNE_INTERVAL_MS = 60 * 1000;
+  // 设备往返请求：等待设备响应的时间、超时检查间隔和同时等待的上限
+  static constexpr uint64_t PENDING_REQUEST_TIMEOUT_MS = 10 * 1000;
+  static constexpr uint64_t PENDING_REQUEST_CHECK_INTERVAL_MS = 1000;
+  static constexpr size_t MAX_PENDING_REQUESTS = 65536;
+  // 每轮最多调用recvmmsg的次数（每次最多UdpBatchSocket::BATCH_SIZE个数据报）
+  static constexpr int UDP_BATCHES_PER_TURN = 16;
+  ServerConfig config_;
   int server_port_;
   std::atomic<bool> is_running_{false}; // 添加运行状态标志
-  std::thread server_thread_;           // 添加服务器线程
+  // 准入控制拒绝的连接数
+  std::atomic<uint64_t> rejected_connections_full_{0};
+  std::atomic<uint64_t> rejected_connections_rate_{0};
+  // 分组部署时，发到不对应端口的消息数（例如Qt消息发到设备端口）
+  std::atomic<uint64_t> misrouted_messages_{0};
+  // UDP功耗上报：设备上线时发放的令牌（equipment_id -> 会话），
+  // 上线在设备所属Reactor写入，接收UDP的Reactor读取
+  struct UdpSession {
+    std::string token;
+    int fd = -1;
+    uint32_t generation = 0;
+    uint32_t peer_ip = 0; // TCP会话的对端IP（网络字节序），0表示Unix域socket
+  };
+  mutable std::shared_mutex udp_sessions_lock_;
+  std::unordered_map<std::string, UdpSession> udp_sessions_;
+  std::atomic<uint64_t> udp_accepted_{0};
+  std::atomic<uint64_t> udp_rejected_{0};
+  std::atomic<uint64_t> udp_batches_{0};
+  // BATCH帧数、其中的子消息数，以及格式错误或类型不支持而丢弃的数量
+  std::atomic<uint64_t> batch_frames_{0};
+  std::atomic<uint64_t> batch_messages_{0};
+  std::atomic<uint64_t> batch_rejected_{0};
+  // 共享内存通道：分配Reactor的轮询位置（只在第一个Reactor线程访问）和累计数
+  size_t next_shm_reactor_ = 0;
+  std::atomic<uint64_t> shm_channels_opened_{0};
+  // 过载时合并（丢弃中间值）的遥测消息数
+  std::atomic<uint64_t> shed_power_reports_{0};
+  std::atomic<uint64_t> shed_status_updates_{0};
+  // 每个Reactor一个事件循环线程，连接固定归属于接受它的Reactor
+  std::vector<std::unique_ptr<Reactor>> reactors_;
   std::unique_ptr<EquipmentManager> equipment_manager_;
   std::unique_ptr<ConnectionManager> connections_manager_;
+  // 设备消息和定时任务使用的数据库连接
   std::unique_ptr<DatabaseManager> db_manager_;
-  std::unordered_map<int, std::unique_ptr<MessageBuffer>> message_buffers_;
+  // Qt客户端请求（统计查询、预约等）使用的独立连接。每个连接内部串行，
+  // 控制台的慢查询不会让设备Reactor的写库等在同一把锁上
+  std::unique_ptr<DatabaseManager> console_db_manager_;
+  bool console_db_connected_ = false; // 启动时连接，失败时退回共用db_manager_
+  // 阈值缓存会被所有Reactor线程读取，设置阈值时写入
+  mutable std::shared_mutex thresholds_rw_lock_;
   std::unordered_map<std::string, float>
       power_thresholds_; // 阈值缓存 (equipment_id -> power_threshold)
+  // 告警去重窗口，任意Reactor线程都会访问
+  struct AlarmWindow {
+    int alarm_id;
+    uint64_t expire_ms;
+  };
+  std::mutex alarm_windows_mutex_;
+  std::unordered_map<std::string, AlarmWindow> alarm_windows_;
+  // 正在处理的消息的来源连接和请求ID（v1为0），dispatch_message设置，
+  // send_to_client回复该连接时使用
+  struct RequestContext {
+    int fd = -1;
+    uint32_t request_id = 0;
+    bool console = false; // 请求来自Qt客户端，数据库操作走控制台连接
+  };
+  static thread_local RequestContext current_request_;
+  // 设备往返请求的等待表，见PendingRequest
+  std::mutex pending_requests_mutex_;
+  std::unordered_map<uint32_t, PendingRequest> pending_requests_;
+  uint32_t next_pending_request_id_ = 1;
+  std::atomic<uint64_t> pending_requests_expired_{0};
 };
\ No newline at end of file
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "protocol_parser.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// 按客户端类型配置的消息令牌桶：每条连接一个桶，设备消息另外按
+// equipment_id再限一次（设备断线重连换了连接也共用额度）。
+// 令牌不足时按策略处理：丢弃、延后处理或断开连接。
+// 延后处理时令牌可以透支，最多透支MAX_DELAY_MS的量，超过则丢弃。
+//
+// 每个Reactor持有一份，连接桶不加锁，只在所属线程使用；设备桶表由所有
+// Reactor共用（见share_equipment_buckets），设备重连到其他Reactor、
+// UDP上报在接收它的Reactor上处理时扣的都是同一个桶，按设备ID分片加锁。
+// 统计字段可跨线程读取。
+class MessageRateLimiter {
+public:
+  enum Action { ACTION_DROP, ACTION_DELAY, ACTION_DISCONNECT };
+  enum Decision { ALLOW, DELAY, DROP, DISCONNECT };
+
+  struct Result {
+    Decision decision;
+    uint64_t delay_ms; // decision为DELAY时的等待时间
+  };
+
+  struct Stats {
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<uint64_t> delayed{0};
+    std::atomic<uint64_t> disconnected{0};
+  };
+
+  static constexpr uint64_t MAX_DELAY_MS = 1000;
+
+  // "drop" / "delay" / "disconnect"，无法识别时返回false
+  static bool parse_action(const std::string &name, Action &action);
+
+  // rate_per_second为0表示该类型客户端不限速
+  void configure(ProtocolParser::ClientType type, double rate_per_second,
+                 double burst, Action action);
+  bool enabled(ProtocolParser::ClientType type) const;
+
+  // 与other共用设备桶表（各Reactor的限速配置相同）
+  void share_equipment_buckets(const MessageRateLimiter &other);
+
+  // 检查一条消息是否可以处理，并扣除令牌。
+  // equipment_id必须是已验证的设备（连接上已上线的设备），为空时只限连接
+  Result check(ProtocolParser::ClientType type, int fd, uint32_t generation,
+               const std::string &equipment_id, uint64_t now_ms);
+
+  // 删除令牌已经补满的桶，防止表无限增长
+  void prune(uint64_t now_ms);
+
+  const Stats &stats() const { return stats_; }
+
+private:
+  struct Policy {
+    double rate_per_ms = 0;
+    double burst = 1;
+    Action action = ACTION_DROP;
+  };
+  struct Bucket {
+    double tokens = 0;
+    uint64_t last_ms = 0;
+    uint32_t generation = 0; // 连接桶：fd复用后重新计算
+    ProtocolParser::ClientType type = ProtocolParser::CLIENT_UNKNOWN;
+  };
+
+  static constexpr size_t POLICY_COUNT = 3; // 按ClientType下标
+  static constexpr size_t EQUIPMENT_SHARDS = 16;
+  struct EquipmentShard {
+    std::mutex mutex;
+    std::unordered_map<std::string, Bucket> buckets;
+  };
+  using EquipmentBuckets = std::array<EquipmentShard, EQUIPMENT_SHARDS>;
+
+  const Policy *policy_for(ProtocolParser::ClientType type) const;
+  static void refill(Bucket &bucket, const Policy &policy, uint64_t now_ms);
+
+  std::array<Policy, POLICY_COUNT> policies_{};
+  std::unordered_map<int, Bucket> connection_buckets_;
+  std::shared_ptr<EquipmentBuckets> equipment_buckets_ =
+      std::make_shared<EquipmentBuckets>();
+  Stats stats_;
+};
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// 事件循环过载判断：根据每轮处理耗时（平滑后作为循环延迟）和
+// 优先级队列中积压的消息数决定是否进入过载状态。
+// 任一指标超过阈值进入过载，两者都回落到阈值一半才退出，避免来回抖动。
+// 过载期间服务器对遥测消息（功耗上报、状态上报）按设备合并，只处理最新一条。
+//
+// 不加锁，每个Reactor持有一份，只在所属线程更新；状态和统计可跨线程读取。
+class OverloadController {
+public:
+  // lag_us / queue_depth为0表示不使用该指标，两者都为0时不会进入过载
+  void configure(uint64_t lag_us, size_t queue_depth);
+
+  // 记录一轮事件循环的处理耗时（不含等待）
+  void record_iteration(uint64_t busy_us);
+  // 根据当前积压更新过载状态，返回是否过载
+  bool evaluate(size_t queue_depth);
+
+  bool overloaded() const { return overloaded_.load(std::memory_order_relaxed); }
+  uint64_t lag_us() const { return lag_us_.load(std::memory_order_relaxed); }
+  // 进入过载的次数
+  uint64_t episodes() const { return episodes_.load(std::memory_order_relaxed); }
+
+private:
+  uint64_t lag_threshold_us_ = 0;
+  size_t depth_threshold_ = 0;
+  std::atomic<uint64_t> lag_us_{0};
+  std::atomic<bool> overloaded_{false};
+  std::atomic<uint64_t> episodes_{0};
+};
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "protocol_parser.h"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+
+// 按消息类型分级的待处理队列。事件循环每轮先把收到的帧解析后放入对应队列，
+// 再按优先级处理：交互类（控制、登录、查询）和心跳全部处理，普通和批量遥测
+// （状态和功耗上报，会同步写数据库）每轮有上限，剩余的留到下一轮，
+// 让下一轮新到的交互请求先处理。
+// 饥饿保护：低优先级队首等待超过MAX_WAIT_US时不受每轮上限限制。
+//
+// 队列只由所属Reactor线程访问；统计字段是原子的，维护任务可以跨线程读取。
+class PriorityLanes {
+public:
+  enum Lane { LANE_INTERACTIVE = 0, LANE_NORMAL = 1, LANE_BULK = 2 };
+  static constexpr int LANE_COUNT = 3;
+
+  struct Item {
+    int fd;
+    uint32_t generation; // 入队时连接记录的代数，处理前据此丢弃已关闭连接的消息
+    uint64_t enqueue_us;
+    ProtocolParser::ParseResult message;
+    // 过载时被合并掉的同设备同类型旧消息数（见coalesce）
+    uint32_t coalesced = 0;
+  };
+  using Handler = std::function<void(Item &)>;
+
+  // 等待时间直方图的桶上限（微秒），最后一个桶为超过1秒
+  static constexpr std::array<uint64_t, 5> WAIT_BUCKET_LIMITS_US = {
+      100, 1000, 10 * 1000, 100 * 1000, 1000 * 1000};
+  static constexpr size_t WAIT_BUCKETS = WAIT_BUCKET_LIMITS_US.size() + 1;
+
+  // 普通/批量队列每轮最多处理的消息数，以及队首最长等待时间
+  static constexpr size_t LANE_BATCH_LIMIT = 256;
+  static constexpr uint64_t MAX_WAIT_US = 100 * 1000;
+
+  struct LaneStats {
+    std::atomic<uint64_t> depth{0};
+    std::atomic<uint64_t> max_depth{0};
+    std::atomic<uint64_t> processed{0};
+    std::array<std::atomic<uint64_t>, WAIT_BUCKETS> wait_histogram{};
+  };
+
+  static Lane classify(ProtocolParser::MessageType type);
+  static uint64_t now_us();
+
+  void push(Lane lane, Item item);
+  bool empty() const;
+  size_t depth(Lane lane) const { return queues_[lane].size(); }
+
+  // 同一设备（equipment_id）的type类型消息只保留最新一条，
+  // 被丢弃的条数累加到保留条目的coalesced上，返回丢弃的条数
+  size_t coalesce(Lane lane, ProtocolParser::MessageType type);
+
+  // 按优先级处理，返回处理的消息数
+  size_t drain(const Handler &handler);
+
+  const LaneStats &stats(Lane lane) const { return stats_[lane]; }
+  static const char *lane_name(Lane lane);
+
+private:
+  void record_wait(Lane lane, uint64_t wait_us);
+
+  std::array<std::deque<Item>, LANE_COUNT> queues_;
+  std::array<LaneStats, LANE_COUNT> stats_;
+};
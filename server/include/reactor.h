@@ -0,0 +1,125 @@
+#pragma once
+
+#include "accept_limiter.h"
+#include "connection_manager.h"
+#include "epoll.h"
+#include "io_uring.h"
+#include "message_rate_limiter.h"
+#include "overload_controller.h"
+#include "priority_lanes.h"
+#include "task_queue.h"
+#include "timer_wheel.h"
+#include "udp_batch.h"
+
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// 单个事件循环：独立的epoll实例（或io_uring）、独立的监听socket
+// （SO_REUSEPORT）和线程。
+// 连接由接受它的Reactor负责整个生命周期，不在Reactor之间迁移，
+// 因此连接记录中的消息缓冲区和心跳定时器只会被所属线程访问，无需加锁。
+// epoll后端的连接事件data.ptr指向ConnectionManager中的连接记录，
+// TCP监听socket的data.ptr为空，Unix域监听socket的为&unix_listen_fd，
+// UDP socket的为udp.get()，共享内存握手socket的为&shm_listen_fd，
+// 任务队列eventfd的data.ptr为&tasks。
+// 共享内存通道的连接以本端eventfd作为连接fd，事件与socket连接相同。
+struct Reactor : public WriteInterest {
+  // io_uring请求类型，编码在user_data的高8位
+  enum UringOp : uint8_t {
+    URING_OP_ACCEPT = 1,
+    URING_OP_RECV = 2,
+    URING_OP_POLLOUT = 3,
+    URING_OP_CANCEL = 4,
+    URING_OP_TASK = 5, // 任务队列eventfd可读
+    URING_OP_UDP = 6,  // 功耗上报UDP socket可读
+    URING_OP_SHM_ACCEPT = 7, // 共享内存握手socket可accept
+    URING_OP_SHM = 8         // 共享内存通道的eventfd可读
+  };
+
+  // 处理的客户端类型：默认设备和Qt客户端共用；配置了Qt端口时分为两组，
+  // 各自监听自己的端口，控制台查询不会延误设备心跳
+  enum Role { ROLE_SHARED, ROLE_EQUIPMENT, ROLE_QT };
+
+  int id = 0;
+  Role role = ROLE_SHARED;
+  int port = 0; // 监听端口
+  int listen_fd = -1;
+  // 同机网关/模拟器使用的Unix域监听socket（只有第一个Reactor有），
+  // epoll的data.ptr为&unix_listen_fd
+  int unix_listen_fd = -1;
+  // 功耗上报UDP socket（只有第一个Reactor有），epoll的data.ptr为udp.get()
+  std::unique_ptr<UdpBatchSocket> udp;
+  // 模拟器申请共享内存通道的Unix域socket（只有第一个Reactor有），
+  // epoll的data.ptr为&shm_listen_fd
+  int shm_listen_fd = -1;
+  Epoll epoll;
+  // 非空表示该Reactor使用io_uring后端，此时epoll不使用
+  std::unique_ptr<IoUring> uring;
+  std::thread thread;
+  ConnectionManager *connections = nullptr; // 连接表，取epoll data.ptr和连接代数
+  // 本Reactor的定时器（心跳超时、周期任务），只在所属线程访问
+  TimerWheel timers;
+  // 其他线程投递给本Reactor的任务，事件循环被eventfd唤醒后执行
+  TaskQueue tasks;
+  // 按来源IP的accept限速（速率已按Reactor数量均分）
+  AcceptRateLimiter accept_limiter;
+  // 按连接和设备的消息限速
+  MessageRateLimiter message_limiter;
+  // 上一轮accept达到批量上限，监听队列中可能还有连接（ET不会再通知）
+  bool accept_pending = false;
+  // 读预算用完、仍有数据待处理的连接及其代数，下一轮继续读取（只在所属线程访问）
+  std::vector<std::pair<ConnectionManager::Connection *, uint32_t>>
+      ready_connections;
+  // 本轮解析出的消息，按类型分级后处理（只在所属线程访问，统计可跨线程读）
+  PriorityLanes lanes;
+  // 根据循环耗时和积压判断是否过载，过载时合并遥测消息
+  OverloadController overload;
+
+  // 当前线程正在运行的Reactor（非Reactor线程为nullptr），
+  // 供消息处理中需要访问所属事件循环的地方使用
+  static thread_local Reactor *current;
+
+  // 本Reactor是否处理该类型客户端的消息
+  bool accepts(ProtocolParser::ClientType type) const {
+    switch (role) {
+    case ROLE_EQUIPMENT:
+      return type == ProtocolParser::CLIENT_EQUIPMENT;
+    case ROLE_QT:
+      return type == ProtocolParser::CLIENT_QT_CLIENT;
+    default:
+      return true;
+    }
+  }
+
+  // 任意线程调用：把任务投递到本Reactor线程执行
+  bool post(TaskQueue::Task task) { return tasks.post(std::move(task)); }
+  // 把任务队列的eventfd挂到事件后端上（epoll的data.ptr为&tasks）
+  bool watch_task_queue();
+  // 事件循环线程调用：执行已投递的任务，io_uring下重新提交poll请求
+  void run_posted_tasks();
+
+  // 事件等待的超时：最近的定时器到期时间，但不超过max_ms
+  int next_timeout_ms(int max_ms) const;
+
+  // 把已登记到ConnectionManager的连接加入事件循环 / 从事件循环移除
+  // （只在所属线程调用）。
+  // io_uring下fd关闭后仍可能收到旧请求的完成事件，
+  // user_data中带上连接记录的代数，用来区分fd复用前后的连接
+  bool attach_connection(int fd);
+  void detach_connection(int fd);
+
+  // WriteInterest：任意线程都可能调用
+  bool set_write_interest(int fd, bool enable) override;
+  bool write_interest_oneshot() const override { return uring != nullptr; }
+
+  // user_data编解码：op(8位) | generation(24位) | fd(32位)
+  static uint64_t encode_user_data(UringOp op, uint32_t generation, int fd);
+  static UringOp user_data_op(uint64_t user_data);
+  static uint32_t user_data_generation(uint64_t user_data);
+  static int user_data_fd(uint64_t user_data);
+  // 完成事件是否属于fd上当前的连接（而不是已关闭的旧连接）
+  bool is_current_connection(uint64_t user_data) const;
+};
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// 服务器运行参数，默认值可通过环境变量覆盖（见 from_env）
+struct ServerConfig {
+  int server_port = 9000;
+  // Reactor（事件循环线程）数量，0 表示按CPU核数自动选择
+  int reactor_count = 0;
+  // 事件后端："epoll"（默认）或 "io_uring"，不支持时回退到epoll
+  std::string io_backend = "epoll";
+  // Qt客户端单独的监听端口，0表示与设备共用server_port和Reactor。
+  // 设置后设备由reactor_count个Reactor处理，Qt客户端由qt_reactor_count个处理
+  int qt_port = 0;
+  int qt_reactor_count = 1;
+  // 同机进程使用的Unix域socket路径，空表示不监听。
+  // 由第一个Reactor（分组时为设备组）处理，协议与TCP端口相同
+  std::string unix_socket_path;
+  // 功耗上报的UDP端口，0表示不启用。由第一个Reactor用recvmmsg批量接收，
+  // 设备须先通过TCP上线，用上线响应中的令牌认证
+  int udp_port = 0;
+  // 同机压测用的共享内存通道：模拟器连接该Unix域socket申请通道，
+  // 每个通道一对环形缓冲区（每个方向shm_ring_bytes字节），空表示不启用
+  std::string shm_socket_path;
+  size_t shm_ring_bytes = 256 * 1024;
+
+  // 出站队列水位（字节）：超过高水位视为拥塞，回落到低水位以下解除
+  size_t output_low_watermark = 64 * 1024;
+  size_t output_high_watermark = 1024 * 1024;
+  // 单连接待发送数据上限，超过立即断开
+  size_t output_max_pending_bytes = 8 * 1024 * 1024;
+  // 持续拥塞超过该秒数的慢消费者会被断开
+  int slow_consumer_timeout_seconds = 10;
+  // 不小于该字节数的出站消息用MSG_ZEROCOPY发送（仅TCP连接），0表示不使用。
+  // 零拷贝要锁定页面并等待完成通知，小消息直接拷贝更便宜
+  size_t zerocopy_threshold = 128 * 1024;
+
+  // 读预算：每个连接在一轮事件循环中最多读取的字节数和处理的消息数，
+  // 用完后排到其他就绪连接之后继续（epoll后端）
+  size_t read_budget_bytes = 64 * 1024;
+  size_t read_budget_messages = 64;
+
+  // 进程可打开的文件数（RLIMIT_NOFILE），启动时提升软限制；
+  // 0表示提升到硬限制
+  int max_open_files = 0;
+  // 每个Reactor单次epoll_wait最多取的事件数（事件数组按负载增长到该值）
+  int epoll_max_events = 4096;
+
+  // 准入控制：连接数上限（0表示按文件数限制留出余量后自动计算）、listen队列长度、
+  // 每个Reactor每轮最多accept的连接数，以及单个来源IP的新建连接速率
+  // （每秒，0表示不限）和突发上限。超出的连接直接RST关闭
+  int max_connections = 0;
+  int listen_backlog = 4096;
+  int accept_batch = 64;
+  int accept_rate_per_ip = 50;
+  int accept_burst_per_ip = 100;
+
+  // 过载控制：事件循环平均每轮耗时（毫秒）或普通/批量消息积压数超过阈值时
+  // 进入过载，按设备合并功耗上报和状态上报，只处理最新值。0表示不使用该指标
+  int overload_lag_ms = 50;
+  size_t overload_queue_depth = 4096;
+
+  // 消息限速：每条连接（设备另按equipment_id）每秒消息数（0表示不限）、
+  // 突发上限，以及超限时的处理方式："drop"丢弃、"delay"延后处理、
+  // "disconnect"断开连接
+  double equipment_msg_rate = 20;
+  double equipment_msg_burst = 100;
+  std::string equipment_msg_action = "delay";
+  double qt_msg_rate = 50;
+  double qt_msg_burst = 200;
+  std::string qt_msg_action = "drop";
+
+  // 从环境变量加载配置：
+  //   EMS_PORT                   监听端口
+  //   EMS_REACTORS               Reactor线程数
+  //   EMS_IO_BACKEND             事件后端（epoll / io_uring）
+  //   EMS_QT_PORT                Qt客户端监听端口
+  //   EMS_QT_REACTORS            Qt客户端Reactor线程数
+  //   EMS_UNIX_SOCKET            Unix域socket路径
+  //   EMS_UDP_PORT               功耗上报UDP端口
+  //   EMS_SHM_SOCKET             共享内存通道的握手socket路径
+  //   EMS_SHM_RING_BYTES         共享内存通道每个方向的环大小
+  //   EMS_OUTPUT_LOW_WATERMARK   出站低水位
+  //   EMS_OUTPUT_HIGH_WATERMARK  出站高水位
+  //   EMS_OUTPUT_MAX_BYTES       单连接待发送上限
+  //   EMS_SLOW_CONSUMER_TIMEOUT  慢消费者超时秒数
+  //   EMS_ZEROCOPY_THRESHOLD     零拷贝发送的消息大小下限
+  //   EMS_READ_BUDGET_BYTES      每轮每连接读取字节上限
+  //   EMS_READ_BUDGET_MESSAGES   每轮每连接处理消息上限
+  //   EMS_MAX_OPEN_FILES         RLIMIT_NOFILE目标值
+  //   EMS_EPOLL_MAX_EVENTS       单次epoll_wait事件数上限
+  //   EMS_MAX_CONNECTIONS        连接数上限
+  //   EMS_LISTEN_BACKLOG         listen队列长度
+  //   EMS_ACCEPT_BATCH           每轮accept上限
+  //   EMS_ACCEPT_RATE_PER_IP     单IP每秒新建连接数
+  //   EMS_ACCEPT_BURST_PER_IP    单IP突发新建连接数
+  //   EMS_OVERLOAD_LAG_MS        过载判定的循环延迟（毫秒）
+  //   EMS_OVERLOAD_QUEUE_DEPTH   过载判定的消息积压数
+  //   EMS_MSG_RATE_EQUIPMENT     设备每秒消息数
+  //   EMS_MSG_BURST_EQUIPMENT    设备突发消息数
+  //   EMS_MSG_ACTION_EQUIPMENT   设备超限处理方式
+  //   EMS_MSG_RATE_QT            Qt客户端每秒消息数
+  //   EMS_MSG_BURST_QT           Qt客户端突发消息数
+  //   EMS_MSG_ACTION_QT          Qt客户端超限处理方式
+  static ServerConfig from_env();
+};
@@ -0,0 +1,44 @@
+#include "accept_limiter.h"
+
+#include <algorithm>
+
+void AcceptRateLimiter::configure(double rate_per_second, double burst) {
+  rate_per_ms_ = rate_per_second > 0 ? rate_per_second / 1000.0 : 0;
+  burst_ = std::max(burst, 1.0);
+  buckets_.clear();
+}
+
+bool AcceptRateLimiter::allow(uint32_t ip, uint64_t now_ms) {
+  if (!enabled()) {
+    return true;
+  }
+  auto [it, inserted] = buckets_.try_emplace(ip);
+  Bucket &bucket = it->second;
+  if (inserted) {
+    bucket.tokens = burst_;
+  } else if (now_ms > bucket.last_ms) {
+    bucket.tokens = std::min(
+        burst_, bucket.tokens + (now_ms - bucket.last_ms) * rate_per_ms_);
+  }
+  bucket.last_ms = now_ms;
+
+  if (bucket.tokens < 1.0) {
+    return false;
+  }
+  bucket.tokens -= 1.0;
+  return true;
+}
+
+void AcceptRateLimiter::prune(uint64_t now_ms) {
+  for (auto it = buckets_.begin(); it != buckets_.end();) {
+    const Bucket &bucket = it->second;
+    double refill = now_ms > bucket.last_ms
+                        ? (now_ms - bucket.last_ms) * rate_per_ms_
+                        : 0;
+    if (bucket.tokens + refill >= burst_) {
+      it = buckets_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
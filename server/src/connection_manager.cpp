@@ -1,118 +1,207 @@
 #include "connection_manager.h"
+#include <algorithm>
 #include <iostream>
 #include <sys/socket.h>
 #include <unistd.h>
+
+thread_local ConnectionManager::WriteBatch ConnectionManager::write_batch_;
+
+ConnectionManager::ConnectionManager() {
+  // 页指针数组按最大容量一次分配（每页一个指针，共几十KB），
+  // 记录页按需分配，启动后再提升RLIMIT_NOFILE也不受影响
+  table_page_count_ = MAX_TABLE_FDS / TABLE_PAGE_SIZE;
+  table_pages_ =
+      std::make_unique<std::atomic<Connection *>[]>(table_page_count_);
+  for (size_t i = 0; i < table_page_count_; ++i) {
+    table_pages_[i].store(nullptr, std::memory_order_relaxed);
+  }
+}
+
+ConnectionManager::~ConnectionManager() {
+  for (size_t i = 0; i < table_page_count_; ++i) {
+    delete[] table_pages_[i].load(std::memory_order_relaxed);
+  }
+}
+
+ConnectionManager::Connection *ConnectionManager::slot_for(int fd) const {
+  if (fd < 0) {
+    return nullptr;
+  }
+  size_t page = static_cast<size_t>(fd) >> TABLE_PAGE_BITS;
+  if (page >= table_page_count_) {
+    return nullptr;
+  }
+  Connection *records = table_pages_[page].load(std::memory_order_acquire);
+  if (!records) {
+    return nullptr;
+  }
+  return &records[static_cast<size_t>(fd) & (TABLE_PAGE_SIZE - 1)];
+}
+
+ConnectionManager::Connection *
+ConnectionManager::allocate_slot_locked(int fd) {
+  if (fd < 0) {
+    return nullptr;
+  }
+  size_t page = static_cast<size_t>(fd) >> TABLE_PAGE_BITS;
+  if (page >= table_page_count_) {
+    return nullptr;
+  }
+  Connection *records = table_pages_[page].load(std::memory_order_relaxed);
+  if (!records) {
+    records = new Connection[TABLE_PAGE_SIZE];
+    for (size_t i = 0; i < TABLE_PAGE_SIZE; ++i) {
+      records[i].fd = static_cast<int>((page << TABLE_PAGE_BITS) + i);
+    }
+    table_pages_[page].store(records, std::memory_order_release);
+  }
+  return &records[static_cast<size_t>(fd) & (TABLE_PAGE_SIZE - 1)];
+}
+
+ConnectionManager::Connection *ConnectionManager::get_connection(int fd) const {
+  Connection *conn = slot_for(fd);
+  if (!conn || !conn->in_use.load(std::memory_order_acquire)) {
+    return nullptr;
+  }
+  return conn;
+}
+
 void ConnectionManager::set_user_info(int fd, const std::string &username,
                                       const std::string &role, int user_id) {
   std::unique_lock lock(connection_rw_lock_);
-  UserInfo info;
-  info.username = username;
-  info.role = role;
-  info.user_id = user_id;
-  fd_to_user_info_[fd] = info;
+  Connection *conn = get_connection(fd);
+  if (!conn) {
+    return;
+  }
+  conn->user_info.username = username;
+  conn->user_info.role = role;
+  conn->user_info.user_id = user_id;
+  conn->has_user_info = true;
 }
 
 bool ConnectionManager::get_user_info(int fd, UserInfo &user_info) {
   std::shared_lock lock(connection_rw_lock_);
-  auto it = fd_to_user_info_.find(fd);
-  if (it != fd_to_user_info_.end()) {
-    user_info = it->second;
+  Connection *conn = get_connection(fd);
+  if (conn && conn->has_user_info) {
+    user_info = conn->user_info;
     return true;
   }
   return false;
 }
 
 // 连接管理
-void ConnectionManager::add_connection(int fd,
+bool ConnectionManager::add_connection(int fd,
                                        std::shared_ptr<Equipment> equipment,
-                                       ProtocolParser::ClientType client_type) {
+                                       ProtocolParser::ClientType client_type,
+                                       WriteInterest *write_interest,
+                                       std::shared_ptr<ShmChannel> shm_channel) {
   std::unique_lock lock(connection_rw_lock_);
-  auto it1 = connections_.find(fd);
   if (fd < 0) {
     std::cout << "fd invalid..." << std::endl;
-    return;
-  } else if (it1 != connections_.end()) {
-    std::cout << "fd already in connections_..." << std::endl;
-    return;
-  } else {
-    //添加到映射
-    auto [it2, inserted2] = connections_.emplace(fd, equipment);
-    if (inserted2) {
-      std::cout << "connections_ insert sucess... quipement_id is" << fd
-                << std::endl;
-    } else {
-      std::cout << "connections_ insert failed..." << std::endl;
-    }
-
-    auto [it3, inserted3] = heartbeat_times_.emplace(fd, time(nullptr));
-    if (inserted3) {
-      std::cout << "heartbeat_times_ insert sucess... quipement_id is" << fd
-                << std::endl;
-    } else {
-      std::cout << "heartbeat_times_ insert failed..." << std::endl;
-    }
+    return false;
+  }
+  Connection *conn = allocate_slot_locked(fd);
+  if (!conn) {
+    std::cout << "fd超出连接表容量: " << fd << std::endl;
+    return false;
+  }
+  if (conn->in_use.load(std::memory_order_relaxed)) {
+    std::cout << "fd already in connections..." << std::endl;
+    return false;
+  }
 
-    auto [it4, inserted4] = client_types_.emplace(fd, client_type);
-    if (inserted4) {
-      std::cout << "client_types_ insert sucess... quipement_id is" << fd
-                << std::endl;
-    } else {
-      std::cout << "equipment_to_fd_ insert failed..." << std::endl;
-    }
-    auto [it5, inserted5] = connection_healthy_.emplace(fd, true);
-    if (inserted5) {
-      std::cout << "connection_healthy_ insert sucess... quipement_id is" << fd
-                << std::endl;
-    } else {
-      std::cout << "connection_healthy_insert failed..." << std::endl;
-    }
+  // 原地重置记录，代数加一使旧fd的引用失效
+  conn->generation.fetch_add(1, std::memory_order_relaxed);
+  conn->healthy.store(true, std::memory_order_relaxed);
+  conn->last_heartbeat.store(time(nullptr), std::memory_order_relaxed);
+  conn->client_type.store(client_type, std::memory_order_relaxed);
+  conn->reactor_id.store(-1, std::memory_order_relaxed);
+  conn->equipment = equipment;
+  conn->gateway_equipments.clear();
+  conn->has_user_info = false;
+  conn->user_info = UserInfo{};
+  conn->outbound = std::make_shared<OutboundState>();
+  conn->outbound->write_interest = write_interest;
+  conn->outbound->shm_channel = shm_channel;
+  // Unix域socket不支持SO_ZEROCOPY，setsockopt失败时保持普通发送
+  int zerocopy = 1;
+  if (!shm_channel && zerocopy_threshold_ > 0 &&
+      setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &zerocopy, sizeof(zerocopy)) ==
+          0) {
+    conn->outbound->queue.set_zerocopy_threshold(zerocopy_threshold_);
   }
+  conn->message_buffer.reset();
+  conn->shm_channel = std::move(shm_channel);
+  conn->heartbeat_timer = 0;
+  conn->read_ready = false;
+  conn->read_deferrals.store(0, std::memory_order_relaxed);
+  conn->in_use.store(true, std::memory_order_release);
+  connection_count_++;
+  max_fd_ = std::max(max_fd_, fd);
+
   // 只有设备端连接且设备指针不为空时才加入equipment_to_fd_映射
   if (client_type == ProtocolParser::CLIENT_EQUIPMENT && equipment) {
-    auto [it6, inserted6] =
-        equipment_to_fd_.emplace(equipment->get_equipment_id(), fd);
-    if (inserted6) {
-      std::cout << "equipment_to_fd_ insert sucess... quipement_id is" << fd
-                << std::endl;
-    } else {
-      std::cout << "connection_healthy_insert failed..." << std::endl;
-    }
+    equipment_to_fd_[equipment->get_equipment_id()] = fd;
     std::cout << "设备连接添加: fd=" << fd << " -> "
               << equipment->get_equipment_id() << std::endl;
   } else {
     std::cout << "Qt客户端连接添加: fd=" << fd << std::endl;
   }
+  return true;
 }
+
+void ConnectionManager::release_connection_locked(Connection &conn) {
+  // 如果是设备连接，从equipment_to_fd_中移除（网关连接上的每个设备）
+  if (conn.client_type.load(std::memory_order_relaxed) ==
+          ProtocolParser::CLIENT_EQUIPMENT &&
+      conn.equipment) {
+    auto unmap = [this, &conn](const std::shared_ptr<Equipment> &equipment) {
+      const std::string &equipment_id = equipment->get_equipment_id();
+      auto it = equipment_to_fd_.find(equipment_id);
+      if (it != equipment_to_fd_.end() && it->second == conn.fd) {
+        equipment_to_fd_.erase(it);
+      }
+      std::cout << "移除设备连接映射: " << equipment_id << " -> fd=" << conn.fd
+                << std::endl;
+    };
+    unmap(conn.equipment);
+    for (const auto &equipment : conn.gateway_equipments) {
+      unmap(equipment);
+    }
+  }
+  conn.in_use.store(false, std::memory_order_release);
+  conn.healthy.store(false, std::memory_order_relaxed);
+  conn.client_type.store(ProtocolParser::CLIENT_UNKNOWN,
+                         std::memory_order_relaxed);
+  conn.equipment.reset();
+  conn.gateway_equipments.clear();
+  conn.outbound.reset();
+  conn.message_buffer.reset();
+  // 通道析构时标记关闭并通知对端（出站队列可能仍短暂持有引用）
+  conn.shm_channel.reset();
+  conn.heartbeat_timer = 0;
+  connection_count_--;
+  close(conn.fd);
+}
+
 void ConnectionManager::remove_connection(int fd) {
+  // 先标记出站队列关闭，之后其他线程的send_message不会再写这个fd
+  auto outbound = get_outbound(fd);
+  if (outbound) {
+    std::lock_guard<std::mutex> state_lock(outbound->mutex);
+    outbound->closing = true;
+    outbound->queue.clear();
+  }
+
   std::unique_lock lock(connection_rw_lock_);
-  auto it = connections_.find(fd);
+  Connection *conn = get_connection(fd);
   if (fd < 0) {
     std::cout << "fd invalid..." << std::endl;
-  } else if (it != connections_.end()) {
-    // 获取连接类型和设备指针
-    auto client_type_it = client_types_.find(fd);
-    ProtocolParser::ClientType client_type = ProtocolParser::CLIENT_UNKNOWN;
-    if (client_type_it != client_types_.end()) {
-      client_type = client_type_it->second;
-    }
-
-    // 如果是设备连接，从equipment_to_fd_中移除
-    if (client_type == ProtocolParser::CLIENT_EQUIPMENT && it->second) {
-      // 安全地获取设备ID
-      std::string equipment_id = it->second->get_equipment_id();
-      equipment_to_fd_.erase(equipment_id);
-      std::cout << "移除设备连接映射: " << equipment_id << " -> fd=" << fd
-                << std::endl;
-    }
-    //从所有映射中移除
-    connections_.erase(it);
-    heartbeat_times_.erase(fd);
-    connection_healthy_.erase(fd);
-    client_types_.erase(fd);
-    close(fd);
+  } else if (conn) {
+    release_connection_locked(*conn);
     std::cout << "连接完全清理: fd=" << fd << std::endl;
   } else {
-    std::cout << "remove_connection failed fd not in connections_..."
+    std::cout << "remove_connection failed fd not in connections..."
               << std::endl;
   }
 }
@@ -120,17 +209,10 @@ void ConnectionManager::remove_connection(int fd) {
 void ConnectionManager::close_all_connections() {
   std::unique_lock lock(connection_rw_lock_);
 
-  // 关闭所有文件描述符
-  for (const auto &[fd, equipment] : connections_) {
-    close(fd);
-  }
-
-  // 清空所有映射
-  connections_.clear();
-  heartbeat_times_.clear();
+  // 关闭所有文件描述符并重置记录
+  for_each_connection_locked(
+      [this](Connection &conn) { release_connection_locked(conn); });
   equipment_to_fd_.clear();
-  connection_healthy_.clear();
-  client_types_.clear();
 
   std::cout << "所有连接已关闭" << std::endl;
 }
@@ -148,102 +230,168 @@ std::shared_ptr<Equipment> ConnectionManager::get_equipment_by_fd(int fd) {
   if (fd <= 0) {
     return nullptr;
   }
-  auto it = connections_.find(fd);
-  if (it != connections_.end()) {
-    return it->second; // 可能为nullptr（Qt连接）
+  Connection *conn = get_connection(fd);
+  return conn ? conn->equipment : nullptr; // 可能为nullptr（Qt连接）
+}
+
+bool ConnectionManager::is_equipment_bound(
+    int fd, const std::string &equipment_id) const {
+  std::shared_lock lock(connection_rw_lock_);
+  Connection *conn = get_connection(fd);
+  if (!conn || !conn->equipment) {
+    return false;
+  }
+  auto it = equipment_to_fd_.find(equipment_id);
+  if (it == equipment_to_fd_.end() || it->second != fd) {
+    return false;
+  }
+  if (conn->equipment->get_equipment_id() == equipment_id) {
+    return true;
   }
-  return nullptr;
+  for (const auto &equipment : conn->gateway_equipments) {
+    if (equipment->get_equipment_id() == equipment_id) {
+      return true;
+    }
+  }
+  return false;
+}
+
+std::string
+ConnectionManager::get_bound_equipment_id(int fd,
+                                          const std::string &claimed_id) const {
+  if (is_equipment_bound(fd, claimed_id)) {
+    return claimed_id;
+  }
+  std::shared_lock lock(connection_rw_lock_);
+  Connection *conn = get_connection(fd);
+  return conn && conn->equipment ? conn->equipment->get_equipment_id() : "";
+}
+
+std::vector<std::shared_ptr<Equipment>>
+ConnectionManager::get_bound_equipments(int fd) const {
+  std::shared_lock lock(connection_rw_lock_);
+  std::vector<std::shared_ptr<Equipment>> equipments;
+  Connection *conn = get_connection(fd);
+  if (!conn || !conn->equipment) {
+    return equipments;
+  }
+  // 设备已在别的连接上重新上线时映射指向新连接，不再算这条连接的
+  auto add_if_mapped = [&](const std::shared_ptr<Equipment> &equipment) {
+    auto it = equipment_to_fd_.find(equipment->get_equipment_id());
+    if (it != equipment_to_fd_.end() && it->second == fd) {
+      equipments.push_back(equipment);
+    }
+  };
+  add_if_mapped(conn->equipment);
+  for (const auto &equipment : conn->gateway_equipments) {
+    add_if_mapped(equipment);
+  }
+  return equipments;
 }
 
 std::shared_ptr<Equipment>
 ConnectionManager::get_equipment_by_id(const std::string &equipment_id) {
   std::shared_lock lock(connection_rw_lock_);
-  for (const auto &[fd, equipment] : connections_) {
-    if (equipment->get_equipment_id() == equipment_id) {
-      return equipment;
-    }
+  auto it = equipment_to_fd_.find(equipment_id);
+  if (it == equipment_to_fd_.end()) {
+    return nullptr;
   }
-  return nullptr;
+  Connection *conn = get_connection(it->second);
+  return conn ? conn->equipment : nullptr;
 }
 std::vector<std::shared_ptr<Equipment>>
 ConnectionManager::get_all_equipments() {
   std::shared_lock lock(connection_rw_lock_);
   std::vector<std::shared_ptr<Equipment>> all_equipments{};
-  for (const auto &[fd, equipment] : connections_) {
-    all_equipments.emplace_back(equipment);
-  }
+  for_each_connection_locked([&all_equipments](Connection &conn) {
+    all_equipments.emplace_back(conn.equipment);
+  });
   return all_equipments;
 }
 
-// 更新心跳时间
+// 更新心跳时间：只写记录中的原子字段，不需要写锁
 void ConnectionManager::update_heartbeat(int fd) {
-  std::unique_lock lock(connection_rw_lock_);
-  auto it = heartbeat_times_.find(fd);
-  if (it != heartbeat_times_.end()) {
-    it->second = time(nullptr);
-    connection_healthy_[fd] = true; // 标记健康
-
-    auto equip_it = connections_.find(fd);
-    if (equip_it != connections_.end() && equip_it->second) {
-      equip_it->second->update_heartbeat(); // 仅设备端有该操作
+  Connection *conn = get_connection(fd);
+  if (!conn) {
+    return;
+  }
+  conn->last_heartbeat.store(time(nullptr), std::memory_order_relaxed);
+  conn->healthy.store(true, std::memory_order_relaxed); // 标记健康
+
+  if (conn->client_type.load(std::memory_order_relaxed) ==
+      ProtocolParser::CLIENT_EQUIPMENT) {
+    std::shared_lock lock(connection_rw_lock_);
+    if (conn->equipment) {
+      conn->equipment->update_heartbeat(); // 仅设备端有该操作
+    }
+    // 网关的心跳代表它下面所有设备的连接仍然存活
+    for (const auto &equipment : conn->gateway_equipments) {
+      equipment->update_heartbeat();
     }
   }
 }
 
 void ConnectionManager::update_qt_client_heartbeat(int fd) {
-  std::unique_lock lock(connection_rw_lock_);
-
-  // 1. 更新心跳时间戳
-  auto it = heartbeat_times_.find(fd);
-  if (it != heartbeat_times_.end()) {
-    it->second = time(nullptr);
-  }
-
-  // 2. 标记连接健康
-  auto healthy_it = connection_healthy_.find(fd);
-  if (healthy_it != connection_healthy_.end()) {
-    healthy_it->second = true;
+  Connection *conn = get_connection(fd);
+  if (!conn) {
+    return;
   }
-
-  // 3. 关键：不访问Equipment指针！因为Qt客户端的equipment是nullptr
-  // 设备心跳的update_heartbeat()会调用equipment->update_heartbeat()，
-  // 但Qt客户端没有对应的Equipment对象
+  // 更新心跳时间戳并标记连接健康。
+  // 不访问Equipment指针：Qt客户端没有对应的Equipment对象
+  conn->last_heartbeat.store(time(nullptr), std::memory_order_relaxed);
+  conn->healthy.store(true, std::memory_order_relaxed);
 
   std::cout << "Qt客户端心跳已更新: fd=" << fd << std::endl;
 }
 
 // 检查心跳超时
 void ConnectionManager::check_heartbeat_timeout(int timeout_seconds) {
-  std::unique_lock lock(connection_rw_lock_);
+  std::shared_lock lock(connection_rw_lock_);
   time_t current_time = time(nullptr);
-  std::vector<int> timeout_fds;
 
-  for (const auto &[fd, last_heartbeat] : heartbeat_times_) {
+  for_each_connection_locked([&](Connection &conn) {
+    time_t last_heartbeat = conn.last_heartbeat.load(std::memory_order_relaxed);
     if (current_time - last_heartbeat > timeout_seconds) {
-      std::cout << "心跳超时: fd=" << fd << ", 最后心跳: " << last_heartbeat
-                << std::endl;
+      std::cout << "心跳超时: fd=" << conn.fd
+                << ", 最后心跳: " << last_heartbeat << std::endl;
 
       // 标记连接为不健康
-      connection_healthy_[fd] = false;
-      timeout_fds.push_back(fd);
+      conn.healthy.store(false, std::memory_order_relaxed);
 
       // 安全地获取设备信息（仅当设备连接时）
-      auto equip_it = connections_.find(fd);
-      if (equip_it != connections_.end() && equip_it->second) {
-        std::cout << "设备连接不健康: " << equip_it->second->get_equipment_id()
+      if (conn.equipment) {
+        std::cout << "设备连接不健康: " << conn.equipment->get_equipment_id()
                   << std::endl;
       } else {
-        std::cout << "Qt客户端连接不健康: fd=" << fd << std::endl;
+        std::cout << "Qt客户端连接不健康: fd=" << conn.fd << std::endl;
       }
     }
-  }
+  });
   // 注意：这里不自动移除连接，由上层决定是否关闭
 }
 
-bool ConnectionManager::is_connection_healthy(int fd) const {
+void ConnectionManager::handle_heartbeat_timeout(int fd) {
   std::shared_lock lock(connection_rw_lock_);
-  auto it = connection_healthy_.find(fd);
-  return (it != connection_healthy_.end()) ? it->second : false;
+  Connection *conn = get_connection(fd);
+  if (!conn) {
+    return;
+  }
+  std::cout << "心跳超时: fd=" << fd << ", 最后心跳: "
+            << conn->last_heartbeat.load(std::memory_order_relaxed)
+            << std::endl;
+  conn->healthy.store(false, std::memory_order_relaxed);
+
+  if (conn->equipment) {
+    std::cout << "设备连接不健康: " << conn->equipment->get_equipment_id()
+              << std::endl;
+  } else {
+    std::cout << "Qt客户端连接不健康: fd=" << fd << std::endl;
+  }
+}
+
+bool ConnectionManager::is_connection_healthy(int fd) const {
+  Connection *conn = get_connection(fd);
+  return conn && conn->healthy.load(std::memory_order_relaxed);
 }
 
 bool ConnectionManager::is_equipment_connection_healthy(
@@ -253,57 +401,41 @@ bool ConnectionManager::is_equipment_connection_healthy(
   if (fd_it == equipment_to_fd_.end()) {
     return false;
   }
-
-  auto healthy_it = connection_healthy_.find(fd_it->second);
-  return (healthy_it != connection_healthy_.end()) ? healthy_it->second : false;
+  return is_connection_healthy(fd_it->second);
 }
 
 //设备连接状态查询
 bool ConnectionManager::is_equipment_connected(
     const std::string &equipment_id) const {
-  std::shared_lock lock(connection_rw_lock_);
-  auto it = equipment_to_fd_.find(equipment_id);
-  if (it == equipment_to_fd_.end()) {
-    return false;
-  }
-
-  int fd = it->second;
-  auto healthy_it = connection_healthy_.find(fd);
-  return (healthy_it != connection_healthy_.end()) ? healthy_it->second : false;
+  return is_equipment_connection_healthy(equipment_id);
 }
 
 //连接健康状态查询
 bool ConnectionManager::is_connection_alive(int fd) const {
-  std::shared_lock lock(connection_rw_lock_);
-  auto conn_it = connections_.find(fd);
-  if (conn_it == connections_.end()) {
-    return false;
-  }
-  auto it = connection_healthy_.find(fd);
-  return (it != connection_healthy_.end()) ? it->second : false;
+  return is_connection_healthy(fd);
 }
 
 size_t ConnectionManager::get_connection_count() const {
-  std::shared_lock lock(connection_rw_lock_);
-  return connections_.size();
+  return connection_count_.load(std::memory_order_relaxed);
 }
 
 void ConnectionManager::print_connections() const {
   std::shared_lock lock(connection_rw_lock_);
-  std::cout << "当前连接数: " << connections_.size() << std::endl;
-  for (const auto &[fd, equipment] : connections_) {
-    bool healthy = connection_healthy_.at(fd);
-    auto client_type_it = client_types_.find(fd);
+  std::cout << "当前连接数: " << connection_count_ << std::endl;
+  for_each_connection_locked([](Connection &conn) {
+    bool healthy = conn.healthy.load(std::memory_order_relaxed);
     ProtocolParser::ClientType client_type =
-        client_type_it != client_types_.end() ? client_type_it->second
-                                              : ProtocolParser::CLIENT_UNKNOWN;
+        conn.client_type.load(std::memory_order_relaxed);
 
-    std::cout << "fd=" << fd << ", 类型=";
+    std::cout << "fd=" << conn.fd << ", 类型=";
     if (client_type == ProtocolParser::CLIENT_EQUIPMENT) {
       std::cout << "设备端";
-      if (equipment) {
-        std::cout << ", 设备=" << equipment->get_equipment_id()
-                  << ", 状态=" << equipment->get_status();
+      if (conn.equipment) {
+        std::cout << ", 设备=" << conn.equipment->get_equipment_id()
+                  << ", 状态=" << conn.equipment->get_status();
+        if (!conn.gateway_equipments.empty()) {
+          std::cout << ", 网关设备数=" << conn.gateway_equipments.size() + 1;
+        }
       } else {
         std::cout << ", 设备指针为空";
       }
@@ -312,13 +444,14 @@ void ConnectionManager::print_connections() const {
     } else {
       std::cout << "未知";
     }
-    std::cout << ", 连接健康=" << (healthy ? "是" : "否") << std::endl;
-  }
+    std::cout << ", 连接健康=" << (healthy ? "是" : "否") << ", 读推迟="
+              << conn.read_deferrals.load(std::memory_order_relaxed)
+              << std::endl;
+  });
 }
 
 bool ConnectionManager::is_connection_exist(int fd) const {
-  std::shared_lock lock(connection_rw_lock_);
-  return connections_.find(fd) != connections_.end();
+  return get_connection(fd) != nullptr;
 }
 
 std::vector<int> ConnectionManager::get_timeout_fds() const {
@@ -326,11 +459,12 @@ std::vector<int> ConnectionManager::get_timeout_fds() const {
   std::vector<int> timeout_fds;
   time_t current_time = time(nullptr);
 
-  for (const auto &[fd, last_heartbeat] : heartbeat_times_) {
-    if (current_time - last_heartbeat > 60) { // 60秒超时
-      timeout_fds.push_back(fd);
+  for_each_connection_locked([&](Connection &conn) {
+    if (current_time - conn.last_heartbeat.load(std::memory_order_relaxed) >
+        60) { // 60秒超时
+      timeout_fds.push_back(conn.fd);
     }
-  }
+  });
   return timeout_fds;
 }
 
@@ -338,26 +472,25 @@ std::vector<int> ConnectionManager::get_qt_client_connections() const {
   std::shared_lock lock(connection_rw_lock_);
   std::vector<int> qt_fds;
 
-  for (const auto &[fd, client_type] : client_types_) {
-    if (client_type == ProtocolParser::CLIENT_QT_CLIENT) {
-      qt_fds.push_back(fd);
+  for_each_connection_locked([&qt_fds](Connection &conn) {
+    if (conn.client_type.load(std::memory_order_relaxed) ==
+        ProtocolParser::CLIENT_QT_CLIENT) {
+      qt_fds.push_back(conn.fd);
     }
-  }
+  });
 
   return qt_fds;
 }
 
 time_t ConnectionManager::get_last_heartbeat(int fd) const {
-  std::shared_lock lock(connection_rw_lock_);
-  auto it = heartbeat_times_.find(fd);
-  return (it != heartbeat_times_.end()) ? it->second : 0;
+  Connection *conn = get_connection(fd);
+  return conn ? conn->last_heartbeat.load(std::memory_order_relaxed) : 0;
 }
 
 void ConnectionManager::mark_connection_unhealthy(int fd) {
-  std::unique_lock lock(connection_rw_lock_);
-  auto it = connection_healthy_.find(fd);
-  if (it != connection_healthy_.end()) {
-    it->second = false;
+  Connection *conn = get_connection(fd);
+  if (conn) {
+    conn->healthy.store(false, std::memory_order_relaxed);
     std::cout << "连接已标记为不健康: fd=" << fd << std::endl;
   }
 }
@@ -366,71 +499,44 @@ std::vector<std::pair<int, std::shared_ptr<Equipment>>>
 ConnectionManager::get_all_connections() const {
   std::shared_lock lock(connection_rw_lock_);
   std::vector<std::pair<int, std::shared_ptr<Equipment>>> result;
-  for (const auto &conn : connections_) {
-    result.push_back(conn);
-  }
+  for_each_connection_locked([&result](Connection &conn) {
+    result.emplace_back(conn.fd, conn.equipment);
+  });
   return result;
 }
 
 bool ConnectionManager::send_control_to_simulator(
     ProtocolParser::ClientType client_type, const std::string &equipment_id,
     ProtocolParser::ControlCommandType command_type,
-    const std::string &parameters) {
-  std::shared_lock lock(connection_rw_lock_);
-
-  // 查找设备对应的fd
-  auto fd_it = equipment_to_fd_.find(equipment_id);
-  if (fd_it == equipment_to_fd_.end()) {
-    std::cout << "设备未连接: " << equipment_id << std::endl;
-    return false;
-  }
-
-  int fd = fd_it->second;
-
-  // 检查连接是否健康
-  auto healthy_it = connection_healthy_.find(fd);
-  if (healthy_it == connection_healthy_.end() || !healthy_it->second) {
-    std::cout << "连接不健康，无法发送控制命令: " << equipment_id << std::endl;
-    return false;
-  }
+    const std::string &parameters, uint32_t request_id) {
+  int fd = -1;
+  {
+    std::shared_lock lock(connection_rw_lock_);
 
-  // 检查文件描述符是否仍然有效
-  if (fd <= 0) {
-    std::cout << "无效的文件描述符: " << fd << " for " << equipment_id
-              << std::endl;
-    connection_healthy_[fd] = false;
-    return false;
-  }
-
-  // 尝试发送心跳测试连接是否真的可用
-  struct timeval tv;
-  tv.tv_sec = 1;
-  tv.tv_usec = 0;
+    // 查找设备对应的fd
+    auto fd_it = equipment_to_fd_.find(equipment_id);
+    if (fd_it == equipment_to_fd_.end()) {
+      std::cout << "设备未连接: " << equipment_id << std::endl;
+      return false;
+    }
+    fd = fd_it->second;
 
-  if (setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) < 0) {
-    std::cout << "设置socket选项失败: " << equipment_id << std::endl;
+    // 检查连接是否健康
+    if (!is_connection_healthy(fd)) {
+      std::cout << "连接不健康，无法发送控制命令: " << equipment_id
+                << std::endl;
+      return false;
+    }
   }
 
-  // 构建控制命令
+  // 构建控制命令，parameters第一段是请求ID（v1设备从这里取）
   std::vector<char> control_msg = ProtocolParser::build_control_command(
-      client_type, equipment_id, command_type, parameters);
-
-  // 发送给设备
-  ssize_t bytes_sent =
-      send(fd, control_msg.data(), control_msg.size(), MSG_NOSIGNAL);
+      client_type, equipment_id, command_type,
+      std::to_string(request_id) + "|" + parameters);
 
-  if (bytes_sent <= 0) {
+  // 入队发送给设备，写失败时send_message会标记连接不健康
+  if (!send_message(fd, std::move(control_msg), request_id)) {
     std::cout << "控制命令发送失败: " << equipment_id << std::endl;
-
-    // 标记连接为不健康
-    connection_healthy_[fd] = false;
-
-    // 如果连接彻底断开，移除连接
-    if (errno == EPIPE || errno == ECONNRESET) {
-      std::cout << "连接已断开，移除: " << equipment_id << std::endl;
-      // 这里不直接移除，由上层调用remove_connection
-      return false;
-    }
     return false;
   }
   std::cout << "控制命令已发送: " << equipment_id
@@ -445,33 +551,33 @@ bool ConnectionManager::send_batch_control_to_simulator(
     const std::vector<std::string> &equipment_ids,
     ProtocolParser::ControlCommandType command_type,
     const std::string &parameters) {
-
-  std::shared_lock lock(connection_rw_lock_);
   bool all_success = true;
 
   for (const auto &equipment_id : equipment_ids) {
-    auto fd_it = equipment_to_fd_.find(equipment_id);
-    if (fd_it == equipment_to_fd_.end()) {
-      std::cout << "设备未连接: " << equipment_id << std::endl;
-      all_success = false;
-      continue;
-    }
-
-    int fd = fd_it->second;
+    int fd = -1;
+    {
+      std::shared_lock lock(connection_rw_lock_);
+      auto fd_it = equipment_to_fd_.find(equipment_id);
+      if (fd_it == equipment_to_fd_.end()) {
+        std::cout << "设备未连接: " << equipment_id << std::endl;
+        all_success = false;
+        continue;
+      }
+      fd = fd_it->second;
 
-    if (!connection_healthy_.at(fd)) {
-      std::cout << "连接不健康，跳过: " << equipment_id << std::endl;
-      all_success = false;
-      continue;
+      if (!is_connection_healthy(fd)) {
+        std::cout << "连接不健康，跳过: " << equipment_id << std::endl;
+        all_success = false;
+        continue;
+      }
     }
 
+    // 批量命令不等待响应，请求ID为0
     std::vector<char> control_msg = ProtocolParser::build_control_command(
-        client_type, equipment_id, command_type, parameters);
+        client_type, equipment_id, command_type, "0|" + parameters);
 
-    ssize_t bytes_sent = send(fd, control_msg.data(), control_msg.size(), 0);
-    if (bytes_sent <= 0) {
+    if (!send_message(fd, std::move(control_msg))) {
       std::cout << "控制命令发送失败: " << equipment_id << std::endl;
-      connection_healthy_[fd] = false;
       all_success = false;
     } else {
       std::cout << "控制命令已发送: " << equipment_id << std::endl;
@@ -481,43 +587,355 @@ bool ConnectionManager::send_batch_control_to_simulator(
   return all_success;
 }
 
-ProtocolParser::ClientType ConnectionManager::get_client_type(int fd) const {
+// ============ 出站队列 ============
+void ConnectionManager::set_output_limits(size_t low_watermark,
+                                          size_t high_watermark,
+                                          size_t max_pending_bytes,
+                                          int slow_consumer_timeout_seconds) {
+  std::unique_lock lock(connection_rw_lock_);
+  output_low_watermark_ = low_watermark;
+  output_high_watermark_ = high_watermark;
+  output_max_pending_bytes_ = max_pending_bytes;
+  slow_consumer_timeout_seconds_ = slow_consumer_timeout_seconds;
+}
+
+void ConnectionManager::set_zerocopy_threshold(size_t threshold) {
+  std::unique_lock lock(connection_rw_lock_);
+  zerocopy_threshold_ = threshold;
+}
+
+std::shared_ptr<ConnectionManager::OutboundState>
+ConnectionManager::get_outbound(int fd) const {
   std::shared_lock lock(connection_rw_lock_);
-  auto it = client_types_.find(fd);
-  if (it != client_types_.end()) {
-    return it->second;
+  Connection *conn = get_connection(fd);
+  return conn ? conn->outbound : nullptr;
+}
+
+bool ConnectionManager::send_message(int fd, std::vector<char> message,
+                                     uint32_t request_id) {
+  auto outbound = get_outbound(fd);
+  if (!outbound) {
+    std::cout << "发送失败，连接不存在: fd=" << fd << std::endl;
+    return false;
+  }
+
+  std::lock_guard<std::mutex> state_lock(outbound->mutex);
+  if (outbound->closing) {
+    return false;
+  }
+  if (outbound->protocol_version == ProtocolParser::PROTOCOL_V2) {
+    std::vector<char> converted =
+        ProtocolParser::convert_to_v2(message, request_id);
+    if (!converted.empty()) {
+      message = std::move(converted);
+    }
+  }
+  outbound->queue.push(std::move(message));
+  return schedule_flush(fd, outbound);
+}
+
+void ConnectionManager::set_protocol_version(int fd, uint8_t version) {
+  auto outbound = get_outbound(fd);
+  if (!outbound) {
+    return;
+  }
+  std::lock_guard<std::mutex> state_lock(outbound->mutex);
+  outbound->protocol_version = version;
+}
+
+size_t ConnectionManager::broadcast(const OutputQueue::SharedBuffer &message,
+                                    ProtocolParser::ClientType client_type,
+                                    const BroadcastFilter &filter) {
+  std::vector<std::pair<int, std::shared_ptr<OutboundState>>> targets;
+  {
+    std::shared_lock lock(connection_rw_lock_);
+    for_each_connection_locked([&](Connection &conn) {
+      if (conn.client_type.load(std::memory_order_relaxed) == client_type &&
+          conn.outbound && (!filter || filter(conn))) {
+        targets.emplace_back(conn.fd, conn.outbound);
+      }
+    });
+  }
+
+  size_t sent = 0;
+  OutputQueue::SharedBuffer v2_message; // 第一个v2连接需要时才转换，之后共享
+  for (auto &[fd, outbound] : targets) {
+    std::lock_guard<std::mutex> state_lock(outbound->mutex);
+    if (outbound->closing) {
+      continue;
+    }
+    if (outbound->protocol_version == ProtocolParser::PROTOCOL_V2) {
+      if (!v2_message) {
+        auto converted = ProtocolParser::convert_to_v2(*message);
+        v2_message = converted.empty()
+                         ? message
+                         : std::make_shared<const std::vector<char>>(
+                               std::move(converted));
+      }
+      outbound->queue.push(v2_message);
+    } else {
+      outbound->queue.push(message);
+    }
+    if (schedule_flush(fd, outbound)) {
+      sent++;
+    }
+  }
+  return sent;
+}
+
+bool ConnectionManager::schedule_flush(
+    int fd, const std::shared_ptr<OutboundState> &state) {
+  // 已经在等待可写通知时直接排队，保证消息顺序
+  if (state->write_armed) {
+    return update_congestion(fd, *state);
+  }
+  // 处于写合并批次中：登记连接，本轮结束时统一写出
+  if (write_batch_.active) {
+    if (!state->flush_scheduled) {
+      state->flush_scheduled = true;
+      write_batch_.pending.emplace_back(fd, state);
+    }
+    return update_congestion(fd, *state);
+  }
+  return flush_outbound(fd, *state);
+}
+
+void ConnectionManager::begin_write_batch() { write_batch_.active = true; }
+
+void ConnectionManager::flush_write_batch() {
+  write_batch_.active = false;
+  for (auto &[fd, outbound] : write_batch_.pending) {
+    std::lock_guard<std::mutex> state_lock(outbound->mutex);
+    outbound->flush_scheduled = false;
+    // 已关闭，或期间被其他线程开启了可写通知，由可写事件负责发送
+    if (outbound->closing || outbound->write_armed) {
+      continue;
+    }
+    flush_outbound(fd, *outbound);
+  }
+  write_batch_.pending.clear();
+}
+
+ConnectionManager::WriteStats ConnectionManager::get_write_stats() const {
+  WriteStats stats;
+  stats.messages = written_messages_.load(std::memory_order_relaxed);
+  stats.syscalls = write_syscalls_.load(std::memory_order_relaxed);
+  stats.zerocopy_sends = zerocopy_sends_.load(std::memory_order_relaxed);
+  stats.zerocopy_copied = zerocopy_copied_.load(std::memory_order_relaxed);
+  return stats;
+}
+
+void ConnectionManager::record_flush_stats(
+    const OutputQueue::FlushStats &stats) {
+  written_messages_.fetch_add(stats.messages, std::memory_order_relaxed);
+  write_syscalls_.fetch_add(stats.syscalls, std::memory_order_relaxed);
+  if (stats.zerocopy_sends > 0 || stats.zerocopy_copied > 0) {
+    zerocopy_sends_.fetch_add(stats.zerocopy_sends, std::memory_order_relaxed);
+    zerocopy_copied_.fetch_add(stats.zerocopy_copied,
+                               std::memory_order_relaxed);
+  }
+}
+
+bool ConnectionManager::flush_outbound(int fd, OutboundState &state) {
+  OutputQueue::FlushStats stats;
+  OutputQueue::FlushResult result =
+      state.shm_channel
+          ? state.queue.flush(
+                [&state](const struct iovec *iov, int iov_count) {
+                  return state.shm_channel->writev(iov, iov_count);
+                },
+                &stats)
+          : state.queue.flush(fd, &stats);
+  record_flush_stats(stats);
+  return apply_flush_result(fd, state, result);
+}
+
+bool ConnectionManager::handle_error_queue(int fd) {
+  auto outbound = get_outbound(fd);
+  if (!outbound) {
+    return false;
+  }
+  std::lock_guard<std::mutex> state_lock(outbound->mutex);
+  if (outbound->closing || !outbound->queue.zerocopy_enabled()) {
+    return false;
+  }
+  OutputQueue::FlushStats stats;
+  outbound->queue.reap_zerocopy(fd, &stats);
+  record_flush_stats(stats);
+  // 错误队列读空后仍有EPOLLERR说明是真正的连接错误
+  int error = 0;
+  socklen_t len = sizeof(error);
+  return getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &len) == 0 && error == 0;
+}
+
+bool ConnectionManager::handle_writable(int fd) {
+  auto outbound = get_outbound(fd);
+  if (!outbound) {
+    return true; // 连接已移除，忽略残留事件
+  }
+
+  std::lock_guard<std::mutex> state_lock(outbound->mutex);
+  if (outbound->closing) {
+    return false;
+  }
+  // 一次性通知触发后即失效，写不完时需要重新开启
+  if (outbound->write_interest &&
+      outbound->write_interest->write_interest_oneshot()) {
+    outbound->write_armed = false;
+  }
+  return flush_outbound(fd, *outbound);
+}
+
+bool ConnectionManager::apply_flush_result(int fd, OutboundState &state,
+                                           OutputQueue::FlushResult result) {
+  switch (result) {
+  case OutputQueue::FLUSH_DRAINED:
+    // 全部写完，关闭可写通知避免空转
+    if (state.write_armed && state.write_interest) {
+      state.write_interest->set_write_interest(fd, false);
+    }
+    state.write_armed = false;
+    state.congested_since = 0;
+    return true;
+
+  case OutputQueue::FLUSH_PENDING:
+    // 内核发送缓冲区已满，等待可写事件继续发送
+    if (!state.write_armed && state.write_interest) {
+      state.write_armed = state.write_interest->set_write_interest(fd, true);
+    }
+    return update_congestion(fd, state);
+
+  case OutputQueue::FLUSH_ERROR:
+  default:
+    std::cout << "出站数据写入失败: fd=" << fd << std::endl;
+    mark_connection_unhealthy(fd);
+    state.queue.clear();
+    state.closing = true;
+    shutdown(fd, SHUT_RDWR);
+    return false;
   }
-  return ProtocolParser::CLIENT_UNKNOWN;
+}
+
+bool ConnectionManager::update_congestion(int fd, OutboundState &state) {
+  size_t pending = state.queue.pending_bytes();
+  if (pending > output_max_pending_bytes_) {
+    disconnect_slow_consumer(fd, state, "待发送数据超过上限");
+    return false;
+  }
+
+  if (pending >= output_high_watermark_) {
+    if (state.congested_since == 0) {
+      state.congested_since = time(nullptr);
+      std::cout << "连接出站拥塞: fd=" << fd << ", 待发送=" << pending
+                << " 字节" << std::endl;
+    }
+  } else if (pending <= output_low_watermark_) {
+    state.congested_since = 0;
+  }
+  return true;
+}
+
+void ConnectionManager::disconnect_slow_consumer(int fd, OutboundState &state,
+                                                 const char *reason) {
+  std::cout << "断开慢消费者: fd=" << fd << ", 原因: " << reason
+            << ", 待发送=" << state.queue.pending_bytes() << " 字节"
+            << std::endl;
+  state.queue.clear();
+  state.closing = true;
+  mark_connection_unhealthy(fd);
+  // 只关闭读写方向，由所属Reactor收到EPOLLRDHUP/EPOLLHUP后统一清理
+  shutdown(fd, SHUT_RDWR);
+}
+
+void ConnectionManager::check_slow_consumers() {
+  std::vector<std::pair<int, std::shared_ptr<OutboundState>>> states;
+  {
+    std::shared_lock lock(connection_rw_lock_);
+    for_each_connection_locked([&states](Connection &conn) {
+      if (conn.outbound) {
+        states.emplace_back(conn.fd, conn.outbound);
+      }
+    });
+  }
+
+  time_t now = time(nullptr);
+  for (auto &[fd, state] : states) {
+    std::lock_guard<std::mutex> state_lock(state->mutex);
+    if (state->closing || state->congested_since == 0) {
+      continue;
+    }
+    if (now - state->congested_since > slow_consumer_timeout_seconds_) {
+      disconnect_slow_consumer(fd, *state, "拥塞超时");
+    }
+  }
+}
+
+uint64_t ConnectionManager::get_read_deferrals(int fd) const {
+  Connection *conn = get_connection(fd);
+  return conn ? conn->read_deferrals.load(std::memory_order_relaxed) : 0;
+}
+
+size_t ConnectionManager::get_pending_output_bytes(int fd) const {
+  auto outbound = get_outbound(fd);
+  if (!outbound) {
+    return 0;
+  }
+  std::lock_guard<std::mutex> state_lock(outbound->mutex);
+  return outbound->queue.pending_bytes();
+}
+
+ProtocolParser::ClientType ConnectionManager::get_client_type(int fd) const {
+  Connection *conn = get_connection(fd);
+  return conn ? conn->client_type.load(std::memory_order_relaxed)
+              : ProtocolParser::CLIENT_UNKNOWN;
 }
 
 bool ConnectionManager::update_connection_to_equipment(
     int fd, std::shared_ptr<Equipment> equipment) {
   std::unique_lock lock(connection_rw_lock_);
 
-  auto conn_it = connections_.find(fd);
-  if (conn_it == connections_.end()) {
+  Connection *conn = get_connection(fd);
+  if (!conn) {
     return false;
   }
 
-  // 检查当前是否是Qt客户端连接
-  auto client_type_it = client_types_.find(fd);
-  if (client_type_it == client_types_.end() ||
-      client_type_it->second != ProtocolParser::CLIENT_QT_CLIENT) {
-    return false; // 不是Qt客户端连接，不能转换
-  }
-
   if (!equipment) {
     return false; // 设备指针不能为空
   }
+  const std::string &equipment_id = equipment->get_equipment_id();
+
+  ProtocolParser::ClientType type =
+      conn->client_type.load(std::memory_order_relaxed);
+  if (type == ProtocolParser::CLIENT_EQUIPMENT && conn->equipment) {
+    // 已绑定设备的连接作为网关，为其后的设备逐个上线
+    bool bound = conn->equipment->get_equipment_id() == equipment_id;
+    for (const auto &gateway_equipment : conn->gateway_equipments) {
+      bound = bound || gateway_equipment->get_equipment_id() == equipment_id;
+    }
+    if (!bound) {
+      conn->gateway_equipments.push_back(equipment);
+    }
+    equipment_to_fd_[equipment_id] = fd;
+    std::cout << "网关连接上线设备: fd=" << fd << " -> " << equipment_id
+              << std::endl;
+    return true;
+  }
+
+  // 可转换的连接：默认类型的Qt客户端连接，或设备端口上还未绑定设备的连接
+  if (type != ProtocolParser::CLIENT_QT_CLIENT &&
+      type != ProtocolParser::CLIENT_EQUIPMENT) {
+    return false; // 类型未知，不能转换
+  }
 
   // 更新连接类型和设备指针
-  conn_it->second = equipment;
-  client_type_it->second = ProtocolParser::CLIENT_EQUIPMENT;
+  conn->equipment = equipment;
+  conn->client_type.store(ProtocolParser::CLIENT_EQUIPMENT,
+                          std::memory_order_relaxed);
 
   // 添加到equipment_to_fd_映射
-  equipment_to_fd_[equipment->get_equipment_id()] = fd;
+  equipment_to_fd_[equipment_id] = fd;
 
-  std::cout << "连接类型更新为设备: fd=" << fd << " -> "
-            << equipment->get_equipment_id() << std::endl;
+  std::cout << "连接类型更新为设备: fd=" << fd << " -> " << equipment_id
+            << std::endl;
   return true;
-}
\ No newline at end of file
+}
@@ -1,5 +1,6 @@
 #include "database_manager.h"
 #include <iostream>
+#include <map>
 #include <sstream>
 
 DatabaseManager::DatabaseManager() : mysql_conn_(nullptr), port_(3306) {
@@ -11,6 +12,7 @@ DatabaseManager::~DatabaseManager() { disconnect(); }
 bool DatabaseManager::connect(const std::string &host, const std::string &user,
                               const std::string &password,
                               const std::string &database, int port) {
+  std::lock_guard<std::recursive_mutex> lock(db_mutex_);
   host_ = host;
   user_ = user;
   password_ = password;
@@ -31,6 +33,7 @@ bool DatabaseManager::connect(const std::string &host, const std::string &user,
 }
 
 void DatabaseManager::disconnect() {
+  std::lock_guard<std::recursive_mutex> lock(db_mutex_);
   if (mysql_conn_) {
     mysql_close(mysql_conn_);
     mysql_conn_ = nullptr;
@@ -38,6 +41,7 @@ void DatabaseManager::disconnect() {
 }
 
 bool DatabaseManager::is_connected() const {
+  std::lock_guard<std::recursive_mutex> lock(db_mutex_);
   return mysql_conn_ != nullptr && mysql_ping(mysql_conn_) == 0;
 }
 
@@ -100,6 +104,7 @@ bool DatabaseManager::log_equipment_status(const std::string &equipment_id,
 
 std::vector<std::vector<std::string>>
 DatabaseManager::execute_query(const std::string &query) {
+  std::lock_guard<std::recursive_mutex> lock(db_mutex_);
   std::vector<std::vector<std::string>> results;
 
   if (mysql_query(mysql_conn_, query.c_str()) != 0) {
@@ -128,6 +133,7 @@ DatabaseManager::execute_query(const std::string &query) {
 }
 
 bool DatabaseManager::execute_update(const std::string &query) {
+  std::lock_guard<std::recursive_mutex> lock(db_mutex_);
   if (mysql_query(mysql_conn_, query.c_str()) != 0) {
     std::cerr << "更新执行失败: " << mysql_error(mysql_conn_) << std::endl;
     return false;
@@ -143,6 +149,7 @@ bool DatabaseManager::initialize_tables() {
 }
 
 std::string DatabaseManager::get_last_error() const {
+  std::lock_guard<std::recursive_mutex> lock(db_mutex_);
   return mysql_error(mysql_conn_);
 }
 
@@ -316,6 +323,8 @@ bool DatabaseManager::update_reservation_status(int reservation_id,
                       "' WHERE id = " + std::to_string(reservation_id) +
                       " AND place_id = '" + place_id + "'";
 
+  // execute_update与mysql_affected_rows之间不能被其他线程的语句插入
+  std::lock_guard<std::recursive_mutex> lock(db_mutex_);
   bool success = execute_update(query);
 
   if (success && mysql_affected_rows(mysql_conn_) == 0) {
@@ -460,6 +469,63 @@ bool DatabaseManager::update_equipment_energy_total(
   return execute_update(sql);
 }
 
+namespace {
+// 追加带单引号的字符串字面量；批量语句的值来自网络，转义单引号和反斜杠
+void append_quoted(std::string &sql, const std::string &value) {
+  sql += '\'';
+  for (char c : value) {
+    if (c == '\'' || c == '\\') {
+      sql += c;
+    }
+    sql += c;
+  }
+  sql += '\'';
+}
+} // namespace
+
+bool DatabaseManager::insert_power_logs(
+    const std::vector<PowerLogEntry> &entries) {
+  if (entries.empty()) {
+    return true;
+  }
+  std::string sql = "INSERT INTO energy_logs (equipment_id, power_consumption, "
+                    "timestamp) VALUES ";
+  for (size_t i = 0; i < entries.size(); ++i) {
+    sql += i > 0 ? ", (" : "(";
+    append_quoted(sql, entries[i].equipment_id);
+    sql += ", " + std::to_string(entries[i].power_value) + ", ";
+    append_quoted(sql, entries[i].timestamp);
+    sql += ')';
+  }
+  return execute_update(sql);
+}
+
+bool DatabaseManager::update_equipment_energy_totals(
+    const std::vector<PowerLogEntry> &entries) {
+  std::map<std::string, double> increments;
+  for (const auto &entry : entries) {
+    if (entry.energy_increment > 0) {
+      increments[entry.equipment_id] += entry.energy_increment;
+    }
+  }
+  if (increments.empty()) {
+    return true;
+  }
+  // UPDATE ... SET energy_total = energy_total + CASE equipment_id WHEN ...
+  std::string sql =
+      "UPDATE equipments SET energy_total = energy_total + CASE equipment_id";
+  std::string ids;
+  for (const auto &[equipment_id, increment] : increments) {
+    sql += " WHEN ";
+    append_quoted(sql, equipment_id);
+    sql += " THEN " + std::to_string(increment);
+    ids += ids.empty() ? "" : ", ";
+    append_quoted(ids, equipment_id);
+  }
+  sql += " ELSE 0 END WHERE equipment_id IN (" + ids + ")";
+  return execute_update(sql);
+}
+
 std::string
 DatabaseManager::get_energy_statistics_all(const std::string &timeRange,
                                            const std::string &startDate,
@@ -575,6 +641,7 @@ int DatabaseManager::insert_alarm(const std::string &alarm_type,
                                   const std::string &equipment_id,
                                   const std::string &severity,
                                   const std::string &message) {
+  std::lock_guard<std::recursive_mutex> lock(db_mutex_);
   if (!is_connected())
     return 0;
   std::string sql =
@@ -591,6 +658,7 @@ int DatabaseManager::insert_alarm(const std::string &alarm_type,
 }
 
 bool DatabaseManager::update_alarm_acknowledged(int alarm_id) {
+  std::lock_guard<std::recursive_mutex> lock(db_mutex_);
   if (!is_connected())
     return false;
   std::string sql = "UPDATE alarms SET is_acknowledged = TRUE WHERE id = " +
@@ -1,16 +1,21 @@
+#include <algorithm>
 #include <arpa/inet.h>
+#include <charconv>
 #include <chrono>
+#include <cstdint>
 #include <fcntl.h>
 #include <iomanip>
 #include <iostream>
 #include <memory>
 #include <netinet/in.h>
-#include <optional>
+#include <poll.h>
+#include <random>
 #include <set>
 #include <sstream>
 #include <string.h>
 #include <string_view>
 #include <sys/epoll.h>
+#include <sys/resource.h>
 #include <sys/socket.h>
 #include <system_error>
 #include <unistd.h>
@@ -19,35 +24,356 @@
 #include "connection_manager.h"
 #include "epoll.h"
 #include "equipment_management_server.h"
+#include "message_schema.h"
 #include "protocol_parser.h"
 #include "socket.h"
 
+namespace {
+
+// 按字段表解码payload，格式错误的消息都在这里记录并拒绝
+template <typename Schema>
+bool decode_payload(message_schema::Decoded<Schema> &message,
+                    const std::string &payload) {
+  message_schema::DecodeStatus status = message.decode(payload);
+  if (status != message_schema::DECODE_OK) {
+    std::cout << "消息格式错误: 类型=" << Schema::type
+              << " 字段=" << message.error_field() << " 错误码=" << status
+              << " payload: " << payload << std::endl;
+    return false;
+  }
+  return true;
+}
+
+// 控制命令类型对应的命令名，与设备控制响应中的命令名一致
+const char *control_command_name(ProtocolParser::ControlCommandType type) {
+  switch (type) {
+  case ProtocolParser::TURN_ON:
+    return "turn_on";
+  case ProtocolParser::TURN_OFF:
+    return "turn_off";
+  case ProtocolParser::RESTART:
+    return "restart";
+  case ProtocolParser::ADJUST_SETTINGS:
+    return "adjust_settings";
+  default:
+    return "unknown";
+  }
+}
+
+} // namespace
+
+thread_local EquipmentManagementServer::RequestContext
+    EquipmentManagementServer::current_request_;
+
 EquipmentManagementServer::~EquipmentManagementServer() { stop(); }
 bool EquipmentManagementServer::init(int server_port) {
-  // socket部分
-  server_port_ = server_port;
-  // create server_fd
+  ServerConfig config = ServerConfig::from_env();
+  config.server_port = server_port;
+  return init(config);
+}
+
+bool EquipmentManagementServer::init(const ServerConfig &config) {
+  config_ = config;
+  server_port_ = config.server_port;
+  // 连接数上限默认由文件数限制决定，留出数据库、日志、epoll等使用的余量
+  size_t open_files = raise_open_file_limit(config_.max_open_files);
+  if (config_.max_connections <= 0) {
+    config_.max_connections = static_cast<int>(
+        open_files > RESERVED_FDS ? open_files - RESERVED_FDS : open_files / 2);
+  }
+  std::cout << "文件数限制=" << open_files
+            << ", 连接数上限=" << config_.max_connections << std::endl;
+  connections_manager_->set_output_limits(
+      config.output_low_watermark, config.output_high_watermark,
+      config.output_max_pending_bytes, config.slow_consumer_timeout_seconds);
+  connections_manager_->set_zerocopy_threshold(config.zerocopy_threshold);
+
+  int reactor_count = config.reactor_count;
+  if (reactor_count <= 0) {
+    reactor_count = static_cast<int>(std::thread::hardware_concurrency());
+    if (reactor_count <= 0) {
+      reactor_count = 1;
+    }
+  }
+
+  // 配置了Qt端口时，设备和Qt客户端由各自的Reactor组处理：
+  // 控制台的慢查询不会占用设备消息（心跳）的处理线程
+  struct ReactorGroup {
+    Reactor::Role role;
+    int port;
+    int count;
+  };
+  std::vector<ReactorGroup> groups;
+  if (config_.qt_port > 0 && config_.qt_port != server_port_) {
+    groups.push_back({Reactor::ROLE_EQUIPMENT, server_port_, reactor_count});
+    groups.push_back({Reactor::ROLE_QT, config_.qt_port,
+                      std::max(config_.qt_reactor_count, 1)});
+  } else {
+    groups.push_back({Reactor::ROLE_SHARED, server_port_, reactor_count});
+  }
+
+  // 每个Reactor拥有独立的epoll实例和监听socket（SO_REUSEPORT），
+  // 由内核把新连接分发到各个监听socket，避免单线程accept成为瓶颈
+  reactors_.clear();
+  for (const ReactorGroup &group : groups) {
+    for (int i = 0; i < group.count; ++i) {
+      auto reactor = std::make_unique<Reactor>();
+      reactor->id = static_cast<int>(reactors_.size());
+      reactor->role = group.role;
+      reactor->port = group.port;
+      // SO_REUSEPORT按四元组分发，同一IP的连接会分散到同一端口的各个Reactor
+      reactor->accept_limiter.configure(
+          static_cast<double>(config_.accept_rate_per_ip) / group.count,
+          static_cast<double>(config_.accept_burst_per_ip) / group.count);
+      configure_message_limiter(reactor->message_limiter);
+      // 设备桶全局共用：设备重连到别的Reactor、UDP上报都扣同一份额度
+      if (!reactors_.empty()) {
+        reactor->message_limiter.share_equipment_buckets(
+            reactors_.front()->message_limiter);
+      }
+      reactor->overload.configure(
+          static_cast<uint64_t>(config_.overload_lag_ms) * 1000,
+          config_.overload_queue_depth);
+      if (!create_reactor(*reactor)) {
+        std::cerr << "Reactor " << reactor->id << " 初始化失败" << std::endl;
+        reactors_.clear();
+        return false;
+      }
+      // Unix域socket不支持SO_REUSEPORT，只由第一个Reactor（设备组）监听
+      if (reactors_.empty() && !config_.unix_socket_path.empty() &&
+          !create_unix_listener(*reactor)) {
+        reactors_.clear();
+        return false;
+      }
+      // 功耗上报UDP socket同样只由第一个Reactor接收
+      if (reactors_.empty() && config_.udp_port > 0 &&
+          !create_udp_listener(*reactor)) {
+        reactors_.clear();
+        return false;
+      }
+      // 共享内存通道的握手也在第一个Reactor，通道建立后分给各设备Reactor
+      if (reactors_.empty() && !config_.shm_socket_path.empty() &&
+          !create_shm_listener(*reactor)) {
+        reactors_.clear();
+        return false;
+      }
+      reactors_.push_back(std::move(reactor));
+    }
+  }
+  std::cout << "服务器初始化完成: 端口=" << server_port_;
+  if (groups.size() > 1) {
+    std::cout << " (设备Reactor=" << groups[0].count << "), Qt端口="
+              << config_.qt_port << " (Qt Reactor=" << groups[1].count << ")"
+              << std::endl;
+  } else {
+    std::cout << ", Reactor数量=" << reactors_.size() << std::endl;
+  }
+  return true;
+}
+
+Reactor &EquipmentManagementServer::background_reactor() {
+  // 分组时放到Qt Reactor上，维护和阈值加载等数据库操作不占用设备线程
+  for (auto &reactor : reactors_) {
+    if (reactor->role == Reactor::ROLE_QT) {
+      return *reactor;
+    }
+  }
+  return *reactors_[0];
+}
+
+size_t EquipmentManagementServer::raise_open_file_limit(int wanted) {
+  struct rlimit limit {};
+  if (getrlimit(RLIMIT_NOFILE, &limit) != 0) {
+    std::cerr << "getrlimit失败: " << strerror(errno) << std::endl;
+    return 1024;
+  }
+  rlim_t target = wanted > 0 ? static_cast<rlim_t>(wanted) : limit.rlim_max;
+  if (target == RLIM_INFINITY) {
+    target = static_cast<rlim_t>(ConnectionManager::MAX_TABLE_FDS);
+  }
+  if (target > limit.rlim_cur) {
+    struct rlimit raised = limit;
+    raised.rlim_cur = target;
+    // 超过硬限制时需要CAP_SYS_RESOURCE，失败后退回到硬限制
+    if (target > limit.rlim_max) {
+      raised.rlim_max = target;
+    }
+    if (setrlimit(RLIMIT_NOFILE, &raised) != 0) {
+      raised.rlim_cur = limit.rlim_max;
+      raised.rlim_max = limit.rlim_max;
+      if (setrlimit(RLIMIT_NOFILE, &raised) != 0) {
+        std::cerr << "提升文件数限制失败: " << strerror(errno) << std::endl;
+        return static_cast<size_t>(limit.rlim_cur);
+      }
+    }
+    limit = raised;
+  }
+  return static_cast<size_t>(
+      std::min<rlim_t>(limit.rlim_cur, ConnectionManager::MAX_TABLE_FDS));
+}
+
+void EquipmentManagementServer::configure_message_limiter(
+    MessageRateLimiter &limiter) const {
+  struct ClientPolicy {
+    ProtocolParser::ClientType type;
+    double rate;
+    double burst;
+    const std::string &action;
+  };
+  const ClientPolicy policies[] = {
+      {ProtocolParser::CLIENT_EQUIPMENT, config_.equipment_msg_rate,
+       config_.equipment_msg_burst, config_.equipment_msg_action},
+      {ProtocolParser::CLIENT_QT_CLIENT, config_.qt_msg_rate,
+       config_.qt_msg_burst, config_.qt_msg_action},
+  };
+  for (const auto &policy : policies) {
+    MessageRateLimiter::Action action;
+    if (!MessageRateLimiter::parse_action(policy.action, action)) {
+      std::cerr << "未知的限速处理方式: " << policy.action << "，按drop处理"
+                << std::endl;
+      action = MessageRateLimiter::ACTION_DROP;
+    }
+    limiter.configure(policy.type, policy.rate, policy.burst, action);
+  }
+}
+
+bool EquipmentManagementServer::create_reactor(Reactor &reactor) {
+  // create listen fd
   Socket server_socket{};
-  server_fd_ = server_socket.create_socket();
+  reactor.listen_fd = server_socket.create_socket();
+  if (reactor.listen_fd < 0) {
+    return false;
+  }
   //设置地址重用
-  if (!server_socket.set_socket_option(server_fd_)) {
+  if (!server_socket.set_socket_option(reactor.listen_fd)) {
     std::error_code ec(errno, std::system_category());
     std::cerr << "set_socket_option failed..." << ec.message() << std::endl;
   }
+  // 多个Reactor共享同一端口
+  if (!server_socket.set_reuse_port(reactor.listen_fd)) {
+    close(reactor.listen_fd);
+    reactor.listen_fd = -1;
+    return false;
+  }
   // set listenFd nonblock
-  server_socket.set_nonblock(server_fd_);
-  // blind
-  server_socket.bind_server_socket(server_fd_, server_port_);
-  // listen
-  server_socket.listen_socket(server_fd_);
+  server_socket.set_nonblock(reactor.listen_fd);
+  // bind + listen
+  if (!server_socket.bind_server_socket(reactor.listen_fd, reactor.port) ||
+      !server_socket.listen_socket(reactor.listen_fd,
+                                   config_.listen_backlog)) {
+    close(reactor.listen_fd);
+    reactor.listen_fd = -1;
+    return false;
+  }
+  reactor.connections = connections_manager_.get();
+  reactor.epoll.set_max_events(config_.epoll_max_events);
+  // io_uring后端：accept/recv都以multishot请求提交，不再需要epoll
+  if (config_.io_backend == "io_uring") {
+    auto uring = std::make_unique<IoUring>();
+    if (uring->initialize(URING_QUEUE_DEPTH) &&
+        uring->setup_buffer_ring(URING_BUFFER_COUNT, URING_BUFFER_SIZE) &&
+        uring->submit_multishot_accept(
+            reactor.listen_fd,
+            Reactor::encode_user_data(Reactor::URING_OP_ACCEPT, 0,
+                                      reactor.listen_fd))) {
+      reactor.uring = std::move(uring);
+      return reactor.watch_task_queue();
+    }
+    std::cerr << "Reactor " << reactor.id << " io_uring初始化失败，回退到epoll"
+              << std::endl;
+  }
   // create epfd and put listenFd into epoll
-  //获取Epoll单例
-  Epoll &ep = Epoll::get_instance();
-  if (!ep.initialize()) {
+  if (!reactor.epoll.initialize()) {
+    close(reactor.listen_fd);
+    reactor.listen_fd = -1;
+    return false;
+  }
+  // 监听socket的data.ptr为空，用来和连接记录区分
+  return reactor.epoll.add_epoll(reactor.listen_fd, EPOLLIN | EPOLLET,
+                                 nullptr) &&
+         reactor.watch_task_queue();
+}
+
+bool EquipmentManagementServer::create_unix_listener(Reactor &reactor) {
+  const std::string &path = config_.unix_socket_path;
+  int fd = Socket::create_unix_socket();
+  if (fd < 0) {
+    return false;
+  }
+  Socket server_socket{};
+  if (!Socket::set_nonblock(fd) || !Socket::bind_unix_socket(fd, path) ||
+      !server_socket.listen_socket(fd, config_.listen_backlog)) {
+    close(fd);
+    return false;
+  }
+  bool registered =
+      reactor.uring
+          ? reactor.uring->submit_multishot_accept(
+                fd, Reactor::encode_user_data(Reactor::URING_OP_ACCEPT, 0, fd))
+          : reactor.epoll.add_epoll(fd, EPOLLIN | EPOLLET,
+                                    &reactor.unix_listen_fd);
+  if (!registered) {
+    std::cerr << "Unix域监听socket注册失败: " << path << std::endl;
+    close(fd);
+    unlink(path.c_str());
     return false;
   }
-  // add_epoll
-  ep.add_epoll(server_fd_, EPOLLIN | EPOLLET);
+  reactor.unix_listen_fd = fd;
+  std::cout << "Reactor " << reactor.id << " 监听Unix域socket: " << path
+            << std::endl;
+  return true;
+}
+
+bool EquipmentManagementServer::create_udp_listener(Reactor &reactor) {
+  auto udp = std::make_unique<UdpBatchSocket>();
+  if (!udp->bind(config_.udp_port)) {
+    return false;
+  }
+  // 水平触发：每轮只收有限批数，剩余的下一轮继续
+  bool registered =
+      reactor.uring
+          ? reactor.uring->submit_poll(
+                udp->fd(), POLLIN,
+                Reactor::encode_user_data(Reactor::URING_OP_UDP, 0, udp->fd()))
+          : reactor.epoll.add_epoll(udp->fd(), EPOLLIN, udp.get());
+  if (!registered) {
+    std::cerr << "UDP socket注册失败: 端口=" << config_.udp_port << std::endl;
+    return false;
+  }
+  reactor.udp = std::move(udp);
+  std::cout << "Reactor " << reactor.id
+            << " 接收UDP功耗上报: 端口=" << config_.udp_port << std::endl;
+  return true;
+}
+
+bool EquipmentManagementServer::create_shm_listener(Reactor &reactor) {
+  const std::string &path = config_.shm_socket_path;
+  int fd = Socket::create_unix_socket();
+  if (fd < 0) {
+    return false;
+  }
+  Socket server_socket{};
+  if (!Socket::set_nonblock(fd) || !Socket::bind_unix_socket(fd, path) ||
+      !server_socket.listen_socket(fd, config_.listen_backlog)) {
+    close(fd);
+    return false;
+  }
+  // 水平触发：每轮最多处理accept_batch个申请，剩余的下一轮继续
+  bool registered =
+      reactor.uring
+          ? reactor.uring->submit_poll(
+                fd, POLLIN,
+                Reactor::encode_user_data(Reactor::URING_OP_SHM_ACCEPT, 0, fd))
+          : reactor.epoll.add_epoll(fd, EPOLLIN, &reactor.shm_listen_fd);
+  if (!registered) {
+    std::cerr << "共享内存握手socket注册失败: " << path << std::endl;
+    close(fd);
+    unlink(path.c_str());
+    return false;
+  }
+  reactor.shm_listen_fd = fd;
+  std::cout << "Reactor " << reactor.id << " 接受共享内存通道: " << path
+            << " (每方向 " << config_.shm_ring_bytes << " 字节)" << std::endl;
   return true;
 }
 
@@ -56,60 +382,231 @@ bool EquipmentManagementServer::start() {
     std::cout << "服务器已经在运行" << std::endl;
     return true;
   }
+  if (reactors_.empty()) {
+    std::cerr << "服务器未初始化，请先调用init" << std::endl;
+    return false;
+  }
 
   // 初始化数据库
   if (!initialize_database()) {
     std::cerr << "数据库初始化失败，服务器启动中止" << std::endl;
     return false;
   }
-  // 启动服务器线程
+  // 全局周期任务挂在后台Reactor的时间轮上
+  schedule_periodic_tasks(background_reactor());
+  // 各Reactor定期清理accept限速表
+  for (auto &reactor : reactors_) {
+    Reactor *r = reactor.get();
+    r->timers.schedule_every(ACCEPT_LIMITER_PRUNE_INTERVAL_MS, [r]() {
+      r->accept_limiter.prune(TimerWheel::now_ms());
+      r->message_limiter.prune(TimerWheel::now_ms());
+    });
+  }
+
+  // 每个Reactor启动一个事件循环线程
   is_running_ = true;
-  server_thread_ = std::thread([this]() {
-    // 获取Epoll单例
-    Epoll &ep = Epoll::get_instance();
-    if (!ep.initialize()) {
-      std::cerr << "Epoll初始化失败" << std::endl;
-      return;
-    }
+  for (auto &reactor : reactors_) {
+    Reactor *r = reactor.get();
+    r->thread = std::thread([this, r]() { run_reactor(*r); });
+  }
 
-    int max_events = ep.get_epoll_max_events();
-    struct epoll_event *evs = new epoll_event[max_events]{};
-    std::cout << "设备管理服务器启动成功，开始事件循环..." << std::endl;
+  std::cout << "服务器启动成功" << std::endl;
+  return true;
+}
 
-    while (is_running_) {
-      int nfds = ep.wait_events(evs, 100); // 100ms超时
+void EquipmentManagementServer::run_reactor(Reactor &reactor) {
+  if (reactor.uring) {
+    run_reactor_uring(reactor);
+    return;
+  }
 
-      if (nfds < 0) {
-        if (errno == EINTR && is_running_) {
-          continue;
-        }
-        std::cerr << "epoll_wait错误: " << std::endl;
-        break;
-      } else if (nfds == 0) {
-        // 超时，检查运行状态
+  std::cout << "Reactor " << reactor.id << " 启动成功，开始事件循环..."
+            << std::endl;
+  Reactor::current = &reactor;
+
+  while (is_running_) {
+    // 等到最近的定时器到期，最多100ms以便及时检查运行状态；
+    // 有连接在就绪队列中等待继续读取、还有未accept的连接、
+    // 或优先级队列中还有留到下一轮的消息时不阻塞
+    int timeout = (reactor.ready_connections.empty() &&
+                   !reactor.accept_pending && reactor.lanes.empty())
+                      ? reactor.next_timeout_ms(100)
+                      : 0;
+    int nfds = reactor.epoll.wait(timeout);
+
+    if (nfds < 0) {
+      if (errno == EINTR && is_running_) {
         continue;
       }
+      std::cerr << "epoll_wait错误: " << std::endl;
+      break;
+    }
 
-      // 处理事件
-      if (!process_events(nfds, evs)) {
-        std::cerr << "事件处理失败..." << std::endl;
-        break;
+    // 本轮产生的响应先入队，处理完后按连接合并写出
+    uint64_t iteration_start = PriorityLanes::now_us();
+    connections_manager_->begin_write_batch();
+
+    // 上一轮没有accept完的连接，每轮只处理一批
+    if (reactor.accept_pending && !accept_new_connection(reactor)) {
+      std::cerr << "接受新连接失败" << std::endl;
+    }
+
+    // 处理事件
+    if (nfds > 0 && !process_events(reactor, nfds, reactor.epoll.events())) {
+      std::cerr << "事件处理失败..." << std::endl;
+      connections_manager_->flush_write_batch();
+      break;
+    }
+    // 上一轮读预算用完的连接，排在本轮新事件之后继续处理
+    run_ready_connections(reactor);
+    // 本轮收到的消息按优先级处理
+    drain_priority_lanes(reactor);
+
+    // 执行到期的定时器：心跳超时、维护任务等
+    reactor.timers.advance(TimerWheel::now_ms());
+
+    connections_manager_->flush_write_batch();
+    reactor.overload.record_iteration(PriorityLanes::now_us() - iteration_start);
+  }
+
+  Reactor::current = nullptr;
+  std::cout << "Reactor " << reactor.id << " 线程退出" << std::endl;
+}
+
+void EquipmentManagementServer::run_reactor_uring(Reactor &reactor) {
+  std::vector<IoUring::Completion> completions(URING_QUEUE_DEPTH);
+  std::cout << "Reactor " << reactor.id
+            << " 启动成功（io_uring），开始事件循环..." << std::endl;
+  Reactor::current = &reactor;
+
+  while (is_running_) {
+    // 共享内存连接读预算用完时进入就绪队列，此时不阻塞
+    int count = reactor.uring->wait_completions(
+        completions.data(), static_cast<int>(completions.size()),
+        (reactor.lanes.empty() && reactor.ready_connections.empty())
+            ? reactor.next_timeout_ms(100)
+            : 0);
+    if (count < 0) {
+      std::cerr << "io_uring等待完成事件错误: " << strerror(errno)
+                << std::endl;
+      break;
+    }
+
+    uint64_t iteration_start = PriorityLanes::now_us();
+    connections_manager_->begin_write_batch();
+    process_completions(reactor, completions.data(), count);
+    run_ready_connections(reactor);
+    drain_priority_lanes(reactor);
+    reactor.timers.advance(TimerWheel::now_ms());
+    connections_manager_->flush_write_batch();
+    reactor.overload.record_iteration(PriorityLanes::now_us() - iteration_start);
+  }
+  Reactor::current = nullptr;
+  std::cout << "Reactor " << reactor.id << " 线程退出" << std::endl;
+}
+
+void EquipmentManagementServer::process_completions(
+    Reactor &reactor, const IoUring::Completion *completions, int count) {
+  for (int i = 0; i < count; i++) {
+    const IoUring::Completion &c = completions[i];
+    int fd = Reactor::user_data_fd(c.user_data);
+
+    switch (Reactor::user_data_op(c.user_data)) {
+    case Reactor::URING_OP_ACCEPT:
+      // multishot accept不带对端地址，需要限速时再取
+      if (c.res >= 0 && admit_connection(reactor, c.res, nullptr)) {
+        register_client_connection(reactor, c.res);
+      } else if (c.res < 0) {
+        std::cerr << "accept失败: " << strerror(-c.res) << std::endl;
       }
+      // multishot accept被内核终止时重新提交（TCP或Unix域监听socket）
+      if (!c.has_more()) {
+        reactor.uring->submit_multishot_accept(
+            fd, Reactor::encode_user_data(Reactor::URING_OP_ACCEPT, 0, fd));
+      }
+      break;
 
-      // 定期执行维护任务
-      static int loop_count = 0;
-      if (++loop_count >= 10) {
-        perform_maintenance_tasks();
-        loop_count = 0;
+    case Reactor::URING_OP_RECV: {
+      bool current = reactor.is_current_connection(c.user_data);
+      bool alive = current;
+      if (c.has_buffer()) {
+        if (current && c.res > 0) {
+          alive = consume_client_data(reactor, fd,
+                                      reactor.uring->buffer_data(c.buffer_id()),
+                                      static_cast<size_t>(c.res));
+        }
+        reactor.uring->recycle_buffer(c.buffer_id());
+      }
+      if (!alive) {
+        break; // 已关闭连接的残留事件
       }
+
+      if (c.res == 0) {
+        std::cout << "客户端主动关闭连接: fd=" << fd << std::endl;
+        handle_connection_close(reactor, fd);
+      } else if (c.res < 0 && c.res != -ENOBUFS) {
+        std::cerr << "接收数据错误: fd=" << fd << ", " << strerror(-c.res)
+                  << std::endl;
+        handle_connection_close(reactor, fd);
+      } else if (!c.has_more()) {
+        // 缓冲区耗尽（ENOBUFS）或内核结束了multishot，重新提交
+        reactor.uring->submit_multishot_recv(
+            fd, Reactor::encode_user_data(
+                    Reactor::URING_OP_RECV,
+                    Reactor::user_data_generation(c.user_data), fd));
+      }
+      break;
     }
 
-    delete[] evs;
-    std::cout << "服务器线程退出" << std::endl;
-  });
+    case Reactor::URING_OP_POLLOUT:
+      if (!reactor.is_current_connection(c.user_data)) {
+        break; // 已关闭连接的残留事件
+      }
+      if (c.res >= 0 && !connections_manager_->handle_writable(fd)) {
+        std::cerr << "出站数据发送失败,关闭fd: " << fd << std::endl;
+        handle_connection_close(reactor, fd);
+      }
+      break;
 
-  std::cout << "服务器启动成功" << std::endl;
-  return true;
+    case Reactor::URING_OP_TASK:
+      reactor.run_posted_tasks();
+      break;
+
+    case Reactor::URING_OP_UDP:
+      receive_udp_reports(reactor);
+      // poll请求是一次性的；还有未读的数据报时会立即再次完成
+      reactor.uring->submit_poll(
+          fd, POLLIN, Reactor::encode_user_data(Reactor::URING_OP_UDP, 0, fd));
+      break;
+
+    case Reactor::URING_OP_SHM_ACCEPT:
+      accept_shm_channels(reactor);
+      reactor.uring->submit_poll(
+          fd, POLLIN,
+          Reactor::encode_user_data(Reactor::URING_OP_SHM_ACCEPT, 0, fd));
+      break;
+
+    case Reactor::URING_OP_SHM: {
+      ConnectionManager::Connection *conn =
+          connections_manager_->get_connection(fd);
+      if (!conn || !conn->in_use.load(std::memory_order_acquire) ||
+          !reactor.is_current_connection(c.user_data)) {
+        break; // 已关闭连接的残留事件
+      }
+      handle_shm_event(reactor, *conn);
+      // poll请求是一次性的，连接仍在时重新提交
+      if (conn->in_use.load(std::memory_order_acquire) &&
+          reactor.is_current_connection(c.user_data)) {
+        reactor.uring->submit_poll(fd, POLLIN, c.user_data);
+      }
+      break;
+    }
+
+    case Reactor::URING_OP_CANCEL:
+    default:
+      break;
+    }
+  }
 }
 
 void EquipmentManagementServer::stop() {
@@ -120,19 +617,33 @@ void EquipmentManagementServer::stop() {
   std::cout << "正在停止服务器..." << std::endl;
   is_running_ = false;
 
-  // 等待服务器线程结束
-  if (server_thread_.joinable()) {
-    server_thread_.join();
-    std::cout << "服务器线程已停止" << std::endl;
+  // 等待所有Reactor线程结束
+  for (auto &reactor : reactors_) {
+    if (reactor->thread.joinable()) {
+      reactor->thread.join();
+    }
   }
+  std::cout << "服务器线程已停止" << std::endl;
 
   // 重置所有设备状态
   reset_all_equipment_on_shutdown();
 
-  // 关闭服务器socket
-  if (server_fd_ > 0) {
-    close(server_fd_);
-    server_fd_ = -1;
+  // 关闭所有监听socket
+  for (auto &reactor : reactors_) {
+    if (reactor->listen_fd > 0) {
+      close(reactor->listen_fd);
+      reactor->listen_fd = -1;
+    }
+    if (reactor->unix_listen_fd >= 0) {
+      close(reactor->unix_listen_fd);
+      reactor->unix_listen_fd = -1;
+      unlink(config_.unix_socket_path.c_str());
+    }
+    if (reactor->shm_listen_fd >= 0) {
+      close(reactor->shm_listen_fd);
+      reactor->shm_listen_fd = -1;
+      unlink(config_.shm_socket_path.c_str());
+    }
   }
 
   std::cout << "服务器已完全停止" << std::endl;
@@ -155,6 +666,11 @@ bool EquipmentManagementServer::initialize_database() {
   }
 
   std::cout << "数据库连接成功!" << std::endl;
+  console_db_connected_ =
+      console_db_manager_->connect(host, user, password, database);
+  if (!console_db_connected_) {
+    std::cerr << "控制台数据库连接失败，Qt客户端请求与设备共用连接" << std::endl;
+  }
 
   // 从数据库初始化设备管理器（从 equipments 表）
   if (!equipment_manager_->initialize_from_database(db_manager_.get())) {
@@ -170,44 +686,99 @@ bool EquipmentManagementServer::initialize_database() {
   return true;
 }
 
+DatabaseManager *EquipmentManagementServer::db() const {
+  return current_request_.console && console_db_connected_
+             ? console_db_manager_.get()
+             : db_manager_.get();
+}
+
 MessageBuffer *EquipmentManagementServer::get_message_buffer(int fd) {
-  auto it = message_buffers_.find(fd);
-  if (it == message_buffers_.end()) {
+  // 缓冲区挂在连接记录上，只由连接所属的Reactor线程访问
+  ConnectionManager::Connection *conn = connections_manager_->get_connection(fd);
+  if (!conn) {
+    return nullptr;
+  }
+  if (!conn->message_buffer) {
     //为新连接创建缓冲区
-    auto buffer = std::make_unique<MessageBuffer>();
-    auto result = message_buffers_.emplace(fd, std::move(buffer));
-    return result.first->second.get();
+    conn->message_buffer = std::make_unique<MessageBuffer>();
   }
-  return it->second.get();
+  return conn->message_buffer.get();
 }
 
-bool EquipmentManagementServer::process_events(int nfds,
+bool EquipmentManagementServer::process_events(Reactor &reactor, int nfds,
                                                struct epoll_event *evs) {
   for (int i = 0; i < nfds; i++) {
-    int event_fd = evs[i].data.fd;
+    // 其他线程投递的任务
+    if (evs[i].data.ptr == &reactor.tasks) {
+      reactor.run_posted_tasks();
+      continue;
+    }
+    if (reactor.udp && evs[i].data.ptr == reactor.udp.get()) {
+      receive_udp_reports(reactor);
+      continue;
+    }
+    if (evs[i].data.ptr == &reactor.shm_listen_fd) {
+      accept_shm_channels(reactor);
+      continue;
+    }
+    auto *conn = static_cast<ConnectionManager::Connection *>(evs[i].data.ptr);
     uint32_t events = evs[i].events;
+
+    //服务器接受新连接（TCP监听socket的data.ptr为空，Unix域的为&unix_listen_fd）
+    if (!conn || evs[i].data.ptr == &reactor.unix_listen_fd) {
+      if (!accept_new_connection(reactor)) {
+        std::cerr << "接受新连接失败" << std::endl;
+      }
+      continue;
+    }
+
+    int event_fd = conn->fd;
     // 记录调试信息
     std::cout << "处理事件: fd=" << event_fd << ", events=0x" << std::hex
               << events << std::dec << std::endl;
+    // 同一批事件中连接可能已被关闭
+    if (!conn->in_use.load(std::memory_order_acquire)) {
+      continue;
+    }
+    if (conn->shm_channel) {
+      handle_shm_event(reactor, *conn);
+      continue;
+    }
+    // 零拷贝发送的完成通知也以EPOLLERR报告，读完错误队列后按其余事件处理
+    if ((events & EPOLLERR) && !(events & EPOLLHUP) &&
+        connections_manager_->handle_error_queue(event_fd)) {
+      events &= ~static_cast<uint32_t>(EPOLLERR);
+      if (!(events & (EPOLLIN | EPOLLOUT))) {
+        continue;
+      }
+    }
     //检查错误事件
     if (events & (EPOLLERR | EPOLLHUP)) {
       std::cerr << "连接错误或挂起,关闭fd: " << event_fd << std::endl;
-      handle_connection_close(event_fd);
+      handle_connection_close(reactor, event_fd);
       continue;
     }
-    //服务器接受新连接
-    if (event_fd == server_fd_) {
-      if (!accept_new_connection()) {
-        std::cerr << "接受新连接失败" << std::endl;
+    if (events & (EPOLLIN | EPOLLOUT)) {
+      // 先发送积压的出站数据，再处理新请求
+      if ((events & EPOLLOUT) &&
+          !connections_manager_->handle_writable(event_fd)) {
+        std::cerr << "出站数据发送失败,关闭fd: " << event_fd << std::endl;
+        handle_connection_close(reactor, event_fd);
+        continue;
+      }
+      if (!(events & EPOLLIN)) {
+        continue;
       }
-
-    } else if (events & EPOLLIN) {
       // 在处理前检查连接是否仍然有效
-      if (!connections_manager_->is_connection_alive(event_fd)) {
+      if (!conn->healthy.load(std::memory_order_relaxed)) {
         std::cout << "连接已关闭，跳过可读事件: fd=" << event_fd << std::endl;
         continue;
       }
-      handle_client_data(event_fd);
+      // 已在就绪队列中的连接等轮到它时再读
+      if (conn->read_ready) {
+        continue;
+      }
+      handle_client_data(reactor, event_fd);
     } else {
       std::cout << "未处理的事件类型: 0x" << std::hex << events << std::dec
                 << std::endl;
@@ -216,68 +787,341 @@ bool EquipmentManagementServer::process_events(int nfds,
   return true;
 }
 
-void EquipmentManagementServer::handle_client_data(int fd) {
-  char recv_buffer[2048]; // 系统级接收缓冲区
+void EquipmentManagementServer::handle_client_data(Reactor &reactor, int fd) {
+  MessageBuffer *msg_buffer = get_message_buffer(fd);
+  if (!msg_buffer) {
+    return;
+  }
+  // 共享内存通道连接从环形缓冲区读，分帧和解析与socket相同
+  ConnectionManager::Connection *conn = connections_manager_->get_connection(fd);
+  ShmChannel *shm_channel = conn ? conn->shm_channel.get() : nullptr;
 
-  // 一直收：能读多少读多少
-  while (true) {
-    int bytes_received = recv(fd, recv_buffer, sizeof(recv_buffer), 0);
+  // 每轮的读取字节数和处理消息数有上限，用完后放入就绪队列，
+  // 让同一批的其他连接先处理，避免单个连接占满整轮事件循环
+  size_t byte_budget = config_.read_budget_bytes;
+  size_t frame_budget = config_.read_budget_messages;
 
-    if (bytes_received > 0) {
-      // 追加到应用层缓冲区
-      MessageBuffer *msg_buffer = get_message_buffer(fd);
-      msg_buffer->append_data(recv_buffer, bytes_received);
-
-      // 循环解析：尝试提取所有完整消息
-      std::vector<std::string> complete_messages;
-      size_t extracted_count = msg_buffer->extract_messages(complete_messages);
+  // 先处理上一轮因预算用完留在缓冲区中的帧
+  if (!dispatch_client_frames(reactor, fd, msg_buffer, frame_budget)) {
+    return;
+  }
 
-      // 处理所有完整消息
-      for (const auto &message : complete_messages) {
-        process_single_message(fd, message);
-      }
+  // 直接读进连接的消息缓冲区，直到EAGAIN或预算用完
+  while (frame_budget > 0 && byte_budget > 0) {
+    ssize_t bytes_received =
+        shm_channel
+            ? msg_buffer->read_with(
+                  [shm_channel](const struct iovec *iov, int iov_count) {
+                    return shm_channel->readv(iov, iov_count);
+                  })
+            : msg_buffer->read_from_fd(fd);
 
-      // 检查缓冲区是否异常
-      if (msg_buffer->is_too_large()) {
-        std::cerr << "连接 " << fd << " 缓冲区异常，关闭连接" << std::endl;
-        handle_connection_close(fd);
+    if (bytes_received > 0) {
+      byte_budget -= std::min(static_cast<size_t>(bytes_received), byte_budget);
+      if (!dispatch_client_frames(reactor, fd, msg_buffer, frame_budget)) {
         return;
       }
-
     } else if (bytes_received == 0) {
       // 连接正常关闭
       std::cout << "客户端主动关闭连接: fd=" << fd << std::endl;
-      handle_connection_close(fd);
+      handle_connection_close(reactor, fd);
       return;
     } else {
       // 错误处理
       if (errno == EAGAIN || errno == EWOULDBLOCK) {
-        // 非阻塞模式下没有更多数据可读，正常退出循环
-        break;
+        // 非阻塞模式下没有更多数据可读，等待下一次边沿通知；
+        // 空闲期间不保留接收缓冲区
+        msg_buffer->release_if_empty();
+        return;
       } else {
         // 真正的错误
         std::cerr << "接收数据错误: fd=" << fd << std::endl;
-        handle_connection_close(fd);
+        handle_connection_close(reactor, fd);
         return;
       }
     }
   }
+
+  // ET模式下不会再收到通知，由就绪队列保证下一轮继续
+  defer_client_read(reactor, fd);
+}
+
+void EquipmentManagementServer::handle_shm_event(
+    Reactor &reactor, ConnectionManager::Connection &conn) {
+  int fd = conn.fd;
+  uint32_t generation = conn.generation.load(std::memory_order_acquire);
+  // eventfd同时表示"有新数据"和"对端腾出了空间"：先读（读空时清零计数），
+  // 再发送积压的出站数据，之后到达的通知会再次触发事件
+  if (!conn.read_ready && conn.healthy.load(std::memory_order_relaxed)) {
+    handle_client_data(reactor, fd);
+  }
+  if (conn.in_use.load(std::memory_order_acquire) &&
+      conn.generation.load(std::memory_order_acquire) == generation &&
+      !connections_manager_->handle_writable(fd)) {
+    std::cerr << "出站数据发送失败,关闭fd: " << fd << std::endl;
+    handle_connection_close(reactor, fd);
+  }
+}
+
+void EquipmentManagementServer::accept_shm_channels(Reactor &reactor) {
+  for (int i = 0; i < config_.accept_batch; ++i) {
+    int socket_fd = accept4(reactor.shm_listen_fd, nullptr, nullptr,
+                            SOCK_CLOEXEC);
+    if (socket_fd < 0) {
+      if (errno == EINTR || errno == ECONNABORTED) {
+        continue;
+      }
+      if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        std::cerr << "共享内存通道accept失败: " << strerror(errno) << std::endl;
+      }
+      return;
+    }
+    // 连接数上限同样适用；握手socket只用来传递fd，之后即关闭
+    if (admit_connection(reactor, socket_fd, nullptr)) {
+      open_shm_channel(socket_fd);
+      close(socket_fd);
+    }
+  }
+}
+
+bool EquipmentManagementServer::open_shm_channel(int socket_fd) {
+  std::shared_ptr<ShmChannel> channel =
+      ShmChannel::create(config_.shm_ring_bytes);
+  if (!channel) {
+    return false;
+  }
+  int fd = channel->notify_fd();
+  if (!channel->send_handshake(socket_fd)) {
+    close(fd);
+    return false;
+  }
+  // 按轮询分给处理设备的Reactor，连接注册必须在所属线程执行
+  std::vector<Reactor *> targets;
+  for (auto &reactor : reactors_) {
+    if (reactor->accepts(ProtocolParser::CLIENT_EQUIPMENT)) {
+      targets.push_back(reactor.get());
+    }
+  }
+  Reactor *target = targets[next_shm_reactor_++ % targets.size()];
+  bool posted = target->post([this, fd, channel]() {
+    register_client_connection(*Reactor::current, fd, channel);
+  });
+  if (!posted) {
+    close(fd);
+    return false;
+  }
+  shm_channels_opened_.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+void EquipmentManagementServer::defer_client_read(Reactor &reactor, int fd) {
+  ConnectionManager::Connection *conn = connections_manager_->get_connection(fd);
+  if (!conn) {
+    return;
+  }
+  conn->read_deferrals.fetch_add(1, std::memory_order_relaxed);
+  if (!conn->read_ready) {
+    conn->read_ready = true;
+    reactor.ready_connections.emplace_back(
+        conn, conn->generation.load(std::memory_order_acquire));
+  }
+}
+
+void EquipmentManagementServer::run_ready_connections(Reactor &reactor) {
+  if (reactor.ready_connections.empty()) {
+    return;
+  }
+  // 本轮处理期间再次用完预算的连接进入新的队列，下一轮处理
+  std::vector<std::pair<ConnectionManager::Connection *, uint32_t>> ready;
+  ready.swap(reactor.ready_connections);
+  for (auto &[conn, generation] : ready) {
+    // 期间连接可能已关闭，或fd已被新连接复用（复用时read_ready已重置）
+    if (!conn->in_use.load(std::memory_order_acquire) ||
+        conn->generation.load(std::memory_order_acquire) != generation) {
+      continue;
+    }
+    conn->read_ready = false;
+    if (!conn->healthy.load(std::memory_order_relaxed)) {
+      continue;
+    }
+    handle_client_data(reactor, conn->fd);
+  }
+}
+
+bool EquipmentManagementServer::consume_client_data(Reactor &reactor, int fd,
+                                                    const char *data,
+                                                    size_t len) {
+  // provided buffer要归还给内核，只能追加到应用层缓冲区
+  MessageBuffer *msg_buffer = get_message_buffer(fd);
+  if (!msg_buffer) {
+    return false;
+  }
+  msg_buffer->append_data(data, len);
+  // multishot recv不能暂停，收到的帧全部处理，不受读预算限制
+  size_t frame_budget = SIZE_MAX;
+  if (!dispatch_client_frames(reactor, fd, msg_buffer, frame_budget)) {
+    return false;
+  }
+  msg_buffer->release_if_empty();
+  return true;
+}
+
+bool EquipmentManagementServer::dispatch_client_frames(
+    Reactor &reactor, int fd, MessageBuffer *msg_buffer,
+    size_t &frame_budget) {
+  // 逐帧解析后按消息类型放入优先级队列，本轮事件处理完后统一处理
+  ConnectionManager::Connection *conn = connections_manager_->get_connection(fd);
+  uint32_t generation =
+      conn ? conn->generation.load(std::memory_order_acquire) : 0;
+  std::string_view frame;
+  while (frame_budget > 0 && msg_buffer->next_frame(frame)) {
+    frame_budget--;
+    // 直接在帧上解析，入队时只拷贝设备ID和payload
+    auto parse_result = ProtocolParser::parse_message(frame);
+    if (!parse_result.success) {
+      std::cout << "协议解析失败: " << frame << std::endl;
+      continue;
+    }
+    PriorityLanes::Lane lane = PriorityLanes::classify(parse_result.type);
+    reactor.lanes.push(lane, {fd, generation, PriorityLanes::now_us(),
+                              std::move(parse_result)});
+  }
+
+  // 检查缓冲区是否异常
+  if (msg_buffer->is_too_large()) {
+    std::cerr << "连接 " << fd << " 缓冲区异常，关闭连接" << std::endl;
+    handle_connection_close(reactor, fd);
+    return false;
+  }
+  return true;
+}
+
+void EquipmentManagementServer::drain_priority_lanes(Reactor &reactor) {
+  // 过载时同一设备积压的遥测只处理最新一条；控制和告警相关消息不受影响。
+  // 队列为空时也要评估，负载下降后才能及时解除过载
+  size_t backlog = reactor.lanes.depth(PriorityLanes::LANE_NORMAL) +
+                   reactor.lanes.depth(PriorityLanes::LANE_BULK);
+  bool was_overloaded = reactor.overload.overloaded();
+  if (reactor.overload.evaluate(backlog)) {
+    if (!was_overloaded) {
+      std::cerr << "Reactor " << reactor.id
+                << " 过载，开始合并遥测消息: 循环延迟="
+                << reactor.overload.lag_us() << "us, 积压=" << backlog
+                << std::endl;
+    }
+    shed_power_reports_.fetch_add(
+        reactor.lanes.coalesce(PriorityLanes::LANE_BULK,
+                               ProtocolParser::POWER_REPORT),
+        std::memory_order_relaxed);
+    shed_status_updates_.fetch_add(
+        reactor.lanes.coalesce(PriorityLanes::LANE_NORMAL,
+                               ProtocolParser::STATUS_UPDATE),
+        std::memory_order_relaxed);
+  } else if (was_overloaded) {
+    std::cout << "Reactor " << reactor.id << " 解除过载" << std::endl;
+  }
+  if (reactor.lanes.empty()) {
+    return;
+  }
+  reactor.lanes.drain([this, &reactor](PriorityLanes::Item &item) {
+    // 入队后连接可能已关闭，或fd已被新连接复用
+    ConnectionManager::Connection *conn =
+        connections_manager_->get_connection(item.fd);
+    if (!conn || !conn->in_use.load(std::memory_order_acquire) ||
+        conn->generation.load(std::memory_order_acquire) != item.generation) {
+      return;
+    }
+    process_single_message(reactor, item);
+  });
 }
 
 void EquipmentManagementServer::process_single_message(
-    int fd, const std::string &message) {
-  // 使用你原有的消息解析逻辑
-  auto parse_result = ProtocolParser::parse_message(message);
+    Reactor &reactor, PriorityLanes::Item &item) {
+  const ProtocolParser::ParseResult &message = item.message;
+  // 分组部署时只处理本端口对应类型的客户端消息
+  if (!reactor.accepts(message.client_type)) {
+    misrouted_messages_.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  // BATCH外层不扣令牌，由handle_batch按子消息逐条限速
+  if (message.type == ProtocolParser::BATCH ||
+      admit_message(reactor, item.fd, item.generation, message,
+                    item.coalesced)) {
+    dispatch_message(item.fd, message, item.coalesced);
+  }
+}
+
+bool EquipmentManagementServer::admit_message(
+    Reactor &reactor, int fd, uint32_t generation,
+    const ProtocolParser::ParseResult &message, uint32_t coalesced) {
+  // 先按客户端类型和设备限速，防止单个异常客户端占满数据库。
+  // 设备桶按连接上已上线的设备计：帧里的设备ID未经验证，
+  // 按它扣令牌会让任意连接耗尽别的设备的额度
+  std::string equipment_id;
+  if (message.client_type == ProtocolParser::CLIENT_EQUIPMENT &&
+      reactor.message_limiter.enabled(message.client_type)) {
+    equipment_id =
+        connections_manager_->get_bound_equipment_id(fd, message.equipment_id);
+  }
+  auto result = reactor.message_limiter.check(
+      message.client_type, fd, generation, equipment_id, TimerWheel::now_ms());
+  switch (result.decision) {
+  case MessageRateLimiter::ALLOW:
+    return true;
+  case MessageRateLimiter::DELAY:
+    // 延后到补足令牌时处理，届时连接可能已关闭或fd已复用
+    reactor.timers.schedule(result.delay_ms, [this, fd, generation, message,
+                                              coalesced]() {
+      ConnectionManager::Connection *conn =
+          connections_manager_->get_connection(fd);
+      if (conn && conn->in_use.load(std::memory_order_acquire) &&
+          conn->generation.load(std::memory_order_acquire) == generation) {
+        dispatch_message(fd, message, coalesced);
+      }
+    });
+    break;
+  case MessageRateLimiter::DROP:
+    break;
+  case MessageRateLimiter::DISCONNECT:
+    std::cerr << "连接 " << fd << " 消息速率超限，断开连接: "
+              << message.equipment_id << std::endl;
+    close_connection_on_owner(reactor, fd);
+    break;
+  }
+  return false;
+}
 
-  if (!parse_result.success) {
-    std::cout << "协议解析失败: " << message << std::endl;
+void EquipmentManagementServer::close_connection_on_owner(Reactor &reactor,
+                                                          int fd) {
+  // UDP上报在接收它的Reactor上处理，连接可能属于其他Reactor
+  ConnectionManager::Connection *conn = connections_manager_->get_connection(fd);
+  if (conn && conn->reactor_id.load(std::memory_order_acquire) != reactor.id) {
+    post_to_connection(fd, [this, fd]() {
+      handle_connection_close(*Reactor::current, fd);
+    });
     return;
   }
+  handle_connection_close(reactor, fd);
+}
+
+void EquipmentManagementServer::dispatch_message(
+    int fd, const ProtocolParser::ParseResult &parse_result,
+    uint32_t coalesced) {
+  // 协议版本协商：上线/登录消息用哪个版本，之后就用哪个版本回复
+  if (parse_result.type == ProtocolParser::EQUIPMENT_ONLINE ||
+      parse_result.type == ProtocolParser::QT_CLIENT_LOGIN) {
+    connections_manager_->set_protocol_version(fd, parse_result.version);
+  }
+  // 处理器同步回复，回复时从这里取请求ID
+  RequestContext previous = current_request_;
+  current_request_ = {fd, parse_result.request_id,
+                      parse_result.client_type ==
+                          ProtocolParser::CLIENT_QT_CLIENT};
   // 根据客户端类型分流处理
   switch (parse_result.client_type) {
   case ProtocolParser::CLIENT_EQUIPMENT:
     // 设备模拟端的消息处理
-    process_equipment_message(fd, parse_result);
+    process_equipment_message(fd, parse_result, coalesced);
     break;
   case ProtocolParser::CLIENT_QT_CLIENT:
     // Qt客户端的消息处理
@@ -287,10 +1131,12 @@ void EquipmentManagementServer::process_single_message(
     std::cout << "未知客户端类型: " << parse_result.client_type << std::endl;
     break;
   }
+  current_request_ = previous;
 }
 
 void EquipmentManagementServer::process_equipment_message(
-    int fd, const ProtocolParser::ParseResult &parse_result) {
+    int fd, const ProtocolParser::ParseResult &parse_result,
+    uint32_t coalesced) {
   // 根据消息类型分发处理
   switch (parse_result.type) {
   case ProtocolParser::EQUIPMENT_ONLINE:
@@ -302,13 +1148,18 @@ void EquipmentManagementServer::process_equipment_message(
     break;
   case ProtocolParser::CONTROL_RESPONSE:
     handle_control_command_response_from_simulator(
-        fd, parse_result.equipment_id, parse_result.payload);
+        fd, parse_result.equipment_id, parse_result.payload,
+        parse_result.request_id);
     break;
   case ProtocolParser::HEARTBEAT:
     handle_heartbeat(fd, parse_result.equipment_id);
     break;
   case ProtocolParser::POWER_REPORT:
-    handle_power_report(fd, parse_result.equipment_id, parse_result.payload);
+    handle_power_report(fd, parse_result.equipment_id, parse_result.payload,
+                        coalesced);
+    break;
+  case ProtocolParser::BATCH:
+    handle_batch(fd, parse_result.payload);
     break;
   default:
     std::cout << "未知消息类型: " << parse_result.type << " from fd=" << fd
@@ -417,25 +1268,26 @@ void EquipmentManagementServer::handle_qt_client_login(
     std::vector<char> response =
         ProtocolParser::build_qt_login_response_message(
             ProtocolParser::CLIENT_QT_CLIENT, true, "already_logged_in");
-    send(fd, response.data(), response.size(), 0);
+    send_to_client(fd, std::move(response));
     return;
   }
 
   std::cout << "处理Qt客户端登录请求，fd: " << fd << std::endl;
 
-  // 1. 解析payload，格式应为: "username|password"
-  auto parts = ProtocolParser::split_string(payload, '|');
-  if (parts.size() < 2) {
-    std::cout << "登录请求格式错误" << std::endl;
+  // 1. 解析payload
+  message_schema::Decoded<message_schema::QtClientLogin> login;
+  if (!decode_payload(login, payload)) {
     std::vector<char> response =
         ProtocolParser::build_qt_login_response_message(
             ProtocolParser::CLIENT_QT_CLIENT, false, "请求格式错误");
-    send(fd, response.data(), response.size(), 0);
+    send_to_client(fd, std::move(response));
     return;
   }
 
-  std::string username = parts[0];
-  std::string password = parts[1]; // 当前客户端发送的是明文密码
+  using Login = message_schema::QtClientLogin;
+  std::string username(login.text<Login::USERNAME>());
+  // 当前客户端发送的是明文密码
+  std::string_view password = login.text<Login::PASSWORD>();
 
   // 2. 查询数据库验证用户
   bool authSuccess = false;
@@ -443,8 +1295,8 @@ void EquipmentManagementServer::handle_qt_client_login(
   int user_id = -1;
 
   std::string db_password_hash;
-  if (db_manager_->is_connected()) {
-    if (db_manager_->get_user_info(username, db_password_hash, role, user_id)) {
+  if (db()->is_connected()) {
+    if (db()->get_user_info(username, db_password_hash, role, user_id)) {
       // 简化验证：直接比较明文（实际项目应使用密码哈希比较）
       if (password == db_password_hash) {
         authSuccess = true;
@@ -467,19 +1319,19 @@ void EquipmentManagementServer::handle_qt_client_login(
         ProtocolParser::build_qt_login_response_message(
             ProtocolParser::CLIENT_QT_CLIENT, true, successPayload);
 
-    ssize_t bytes_sent = send(fd, response.data(), response.size(), 0);
-    if (bytes_sent > 0) {
+    bool sent = send_to_client(fd, std::move(response));
+    if (sent) {
       std::cout << "已发送登录成功响应: user_id=" << user_id
                 << ", username=" << username << std::endl;
     } else {
-      std::cerr << "发送登录响应失败: " << strerror(errno) << std::endl;
+      std::cerr << "发送登录响应失败: fd=" << fd << std::endl;
     }
   } else {
     // 失败响应保持不变
     std::vector<char> response =
         ProtocolParser::build_qt_login_response_message(
             ProtocolParser::CLIENT_QT_CLIENT, false, "用户名或密码错误");
-    send(fd, response.data(), response.size(), 0);
+    send_to_client(fd, std::move(response));
   }
 }
 
@@ -502,37 +1354,45 @@ void EquipmentManagementServer::handle_qt_equipment_List_query(int fd) {
   }
 
   // 3. 构建并发送协议响应消息
-  std::string payload = payload_stream.str();
-  std::vector<char> response = ProtocolParser::pack_message(
-      std::to_string(ProtocolParser::CLIENT_QT_CLIENT) + "|" +
-      std::to_string(
-          static_cast<int>(ProtocolParser::QT_EQUIPMENT_LIST_RESPONSE)) +
-      "||" + payload // 注意：设备ID字段留空，payload在第三个字段
-  );
-
-  send(fd, response.data(), response.size(), 0);
+  // 注意：设备ID字段留空
+  std::vector<char> response =
+      message_schema::build<message_schema::QtEquipmentListResponse>(
+          ProtocolParser::CLIENT_QT_CLIENT, "", payload_stream.str());
+
+  send_to_client(fd, std::move(response));
   std::cout << "已发送设备列表响应，包含 " << all_equipments.size() << " 个设备"
             << std::endl;
 }
 
 // 新增：处理设备控制响应
 void EquipmentManagementServer::handle_control_command_response_from_simulator(
-    int fd, const std::string &equipment_id, const std::string &payload) {
+    int fd, const std::string &equipment_id, const std::string &payload,
+    uint32_t request_id) {
   std::cout << "收到设备控制响应: " << equipment_id << " -> " << payload
             << std::endl;
+  // 只接受设备在自己连接上发来的响应，否则任意连接都能猜请求ID，
+  // 替其他设备回复操作员，并改写其电源状态
+  if (!connections_manager_->is_equipment_bound(fd, equipment_id)) {
+    std::cerr << "控制响应的设备ID与连接不符，丢弃: fd=" << fd
+              << " equipment_id=" << equipment_id << std::endl;
+    return;
+  }
 
-  // 解析响应 (格式: "qt_fd|success|turn_on|result_message" 或
-  // "qt_fd|fail|turn_on|result_message")
-  auto parts = ProtocolParser::split_string(payload, '|');
-  if (parts.size() < 4) {
-    std::cout << "控制响应格式错误: " << payload << std::endl;
+  using Response = message_schema::ControlResponse;
+  message_schema::Decoded<Response> response;
+  if (!decode_payload(response, payload)) {
     return;
   }
 
-  std::string qt_fd = parts[0];
-  bool success = (parts[1] == "success");
-  std::string command = parts[2];
-  const std::string result_message = parts[3];
+  // v2设备在帧头带回请求ID，v1设备只在payload的request_id字段带回
+  if (request_id == 0) {
+    std::string_view id_text = response.text<Response::REQUEST_ID>();
+    std::from_chars(id_text.data(), id_text.data() + id_text.size(),
+                    request_id);
+  }
+  bool success = response.text<Response::RESULT>() == "success";
+  std::string command(response.text<Response::COMMAND>());
+  std::string_view result_message = response.text<Response::MESSAGE>();
 
   if (success) {
     // 控制成功，只更新设备电源状态，不改变在线状态
@@ -545,17 +1405,16 @@ void EquipmentManagementServer::handle_control_command_response_from_simulator(
     }
 
     // 记录到数据库
-    if (db_manager_->is_connected()) {
+    if (db()->is_connected()) {
       auto equipment = equipment_manager_->get_equipment(equipment_id);
       if (equipment) {
-        db_manager_->update_equipment_status(equipment_id,
-                                             equipment->get_status(),
-                                             equipment->get_power_state());
+        db()->update_equipment_status(equipment_id, equipment->get_status(),
+                                      equipment->get_power_state());
 
         // 记录控制日志
-        db_manager_->log_equipment_status(equipment_id, equipment->get_status(),
-                                          equipment->get_power_state(),
-                                          "control_success:" + command);
+        db()->log_equipment_status(equipment_id, equipment->get_status(),
+                                   equipment->get_power_state(),
+                                   "control_success:" + command);
       }
     }
 
@@ -566,16 +1425,21 @@ void EquipmentManagementServer::handle_control_command_response_from_simulator(
               << result_message << std::endl;
   }
 
-  // 通知Qt客户端的逻辑
-  if (!send_control_command_response_to_qt_client(
-          std::stoi(qt_fd), equipment_id, success, payload)) {
-    std::cout << "send_control_command_response_to_qt_client failed..."
-              << std::endl;
+  // 通知发起请求的Qt客户端，request_id换成Qt端自己的请求ID
+  PendingRequest request;
+  if (!take_pending_request(request_id, equipment_id, request)) {
+    std::cout << "控制响应没有对应的请求（已超时或未知）: " << equipment_id
+              << " request_id=" << request_id << std::endl;
     return;
   }
-  std::cout << "send_control_command_response_to_qt_client sucess..."
-            << std::endl;
-  return;
+  bool sent = reply_to_request(
+      request, message_schema::build<Response>(
+                   ProtocolParser::CLIENT_QT_CLIENT, equipment_id,
+                   std::to_string(request.request_id),
+                   response.text<Response::RESULT>(), command, result_message));
+  std::cout << "to qt_client控制响应处理: " << equipment_id
+            << " fd=" << request.fd
+            << (sent ? " (响应已发送)" : " (响应发送失败)") << std::endl;
 }
 
 // Qt客户端接口实现
@@ -588,9 +1452,39 @@ bool EquipmentManagementServer::handle_qt_control_request(
             << " 命令: " << static_cast<int>(command_type)
             << " 参数: " << parameters << std::endl;
 
-  // 通过ConnectionManager转发给设备
-  return connections_manager_->send_control_to_simulator(
-      ProtocolParser::CLIENT_QT_CLIENT, equipment_id, command_type, parameters);
+  // 可能在Reactor之外的线程调用，转交给设备连接所属的Reactor转发
+  int fd = connections_manager_->get_fd_by_equipment_id(equipment_id);
+  if (fd < 0) {
+    std::cout << "设备未连接: " << equipment_id << std::endl;
+    return false;
+  }
+  return post_to_connection(fd, [this, equipment_id, command_type,
+                                 parameters]() {
+    connections_manager_->send_control_to_simulator(
+        ProtocolParser::CLIENT_QT_CLIENT, equipment_id, command_type,
+        parameters);
+  });
+}
+
+bool EquipmentManagementServer::post_to_connection(int fd,
+                                                   TaskQueue::Task task) {
+  ConnectionManager::Connection *conn = connections_manager_->get_connection(fd);
+  if (!conn) {
+    return false;
+  }
+  int reactor_id = conn->reactor_id.load(std::memory_order_acquire);
+  if (reactor_id < 0 || reactor_id >= static_cast<int>(reactors_.size())) {
+    return false;
+  }
+  // 执行时fd可能已被关闭并复用，代数不一致则丢弃
+  uint32_t generation = conn->generation.load(std::memory_order_acquire);
+  return reactors_[reactor_id]->post(
+      [conn, generation, task = std::move(task)]() {
+        if (conn->in_use.load(std::memory_order_acquire) &&
+            conn->generation.load(std::memory_order_acquire) == generation) {
+          task();
+        }
+      });
 }
 
 std::shared_ptr<Equipment> EquipmentManagementServer::handle_qt_status_query(
@@ -614,13 +1508,13 @@ void EquipmentManagementServer::update_equipment_status_and_db(
   }
 
   // 更新数据库
-  if (db_manager_->is_connected()) {
+  if (db()->is_connected()) {
     bool db_success =
-        db_manager_->update_equipment_status(equipment_id, status, power_state);
+        db()->update_equipment_status(equipment_id, status, power_state);
 
     if (db_success && !log_message.empty()) {
-      db_manager_->log_equipment_status(equipment_id, status, power_state,
-                                        log_message);
+      db()->log_equipment_status(equipment_id, status, power_state,
+                                 log_message);
     }
   }
 }
@@ -645,13 +1539,10 @@ void EquipmentManagementServer::handle_equipment_online(
   std::cout << "DEBUG: 开始解析payload: " << payload << std::endl;
 
   // 解析payload获取设备信息 (格式: "classroom_101|projector")
-  auto parts = ProtocolParser::split_string(payload, '|');
-  if (parts.size() < 2) {
-    std::cout << "设备注册数据格式错误" << std::endl;
+  message_schema::Decoded<message_schema::EquipmentOnline> online;
+  if (!decode_payload(online, payload)) {
     return;
   }
-  std::string location = parts[0];
-  std::string equipment_type = parts[1];
 
   // 检查设备是否在EquipmentManager中（是否已注册）
   auto equipment = equipment_manager_->get_equipment(equipment_id);
@@ -659,8 +1550,8 @@ void EquipmentManagementServer::handle_equipment_online(
     std::cout << "设备未注册，拒绝上线: " << equipment_id << std::endl;
     // 发送上线失败响应
     std::vector<char> response = ProtocolParser::build_online_response(
-        ProtocolParser::CLIENT_EQUIPMENT, false);
-    send(fd, response.data(), response.size(), 0);
+        ProtocolParser::CLIENT_EQUIPMENT, equipment_id, false);
+    send_to_client(fd, std::move(response));
     return;
   }
 
@@ -669,6 +1560,8 @@ void EquipmentManagementServer::handle_equipment_online(
     std::cout << "连接类型更新失败: " << equipment_id << std::endl;
     return;
   }
+  // 设备端的心跳超时更短，按新类型重新计时
+  refresh_heartbeat_timer(fd);
 
   // 设备已注册，添加到连接管理
   connections_manager_->add_connection(fd, equipment);
@@ -677,13 +1570,13 @@ void EquipmentManagementServer::handle_equipment_online(
   equipment_manager_->update_equipment_status(equipment_id, "online");
 
   // 更新数据库中的设备状态
-  if (db_manager_->is_connected()) {
-    bool update_success = db_manager_->update_equipment_status(
+  if (db()->is_connected()) {
+    bool update_success = db()->update_equipment_status(
         equipment_id, "online",
         equipment->get_power_state()); // 保持原有电源状态
     if (update_success) {
       // 修复：使用普通字符串而不是JSON
-      bool log_success = db_manager_->log_equipment_status(
+      bool log_success = db()->log_equipment_status(
           equipment_id, "online", equipment->get_power_state(), "设备上线成功");
 
       if (!log_success) {
@@ -698,12 +1591,14 @@ void EquipmentManagementServer::handle_equipment_online(
     }
   }
 
-  // 发送上线成功响应
+  // 发送上线成功响应；启用UDP上报时附带本次会话的令牌
+  std::string udp_token =
+      config_.udp_port > 0 ? issue_udp_token(fd, equipment_id) : "";
   std::vector<char> response = ProtocolParser::build_online_response(
-      ProtocolParser::CLIENT_EQUIPMENT, true);
-  ssize_t bytes_sent = send(fd, response.data(), response.size(), 0);
+      ProtocolParser::CLIENT_EQUIPMENT, equipment_id, true, udp_token);
+  bool sent = send_to_client(fd, std::move(response));
 
-  if (bytes_sent <= 0) {
+  if (!sent) {
     std::cerr << "上线响应发送失败: " << equipment_id << std::endl;
   } else {
     std::cout << "上线响应已发送: " << equipment_id << std::endl;
@@ -717,27 +1612,22 @@ void EquipmentManagementServer::handle_status_update(
     int fd, const std::string &equipment_id, const std::string &payload) {
   std::cout << "处理状态更新: " << equipment_id << " payload: " << payload
             << std::endl;
-  //解析状态数据(格式: "online|on|45")
-  auto parts = ProtocolParser::split_string(payload, '|');
-  if (parts.size() < 2) {
-    std::cout << "状态数据格式错误" << std::endl;
+  //解析状态数据(格式: "online|on|45")，第三段为额外数据（如温度），暂未使用
+  using Update = message_schema::StatusUpdate;
+  message_schema::Decoded<Update> update;
+  if (!decode_payload(update, payload)) {
     return;
   }
 
-  std::string status = parts[0];
-  std::string power_state = parts[1];
-  std::string additional_data = "";
-
-  // 如果有额外数据（如温度）
-  if (parts.size() > 2) {
-    additional_data = parts[2];
-  }
+  std::string status(update.text<Update::STATUS>());
+  std::string power_state(update.text<Update::POWER_STATE>());
 
   update_equipment_status_and_db(equipment_id, status, power_state,
                                  "设备主动上报状态");
 
   //更新心跳时间
   connections_manager_->update_heartbeat(fd);
+  refresh_heartbeat_timer(fd);
   std::cout << "设备状态更新: " << equipment_id << " -> " << status << ","
             << power_state << std::endl;
 }
@@ -749,30 +1639,39 @@ void EquipmentManagementServer::handle_qt_client_control_command(
   std::cout << "处理控制命令: " << equipment_id << " payload: " << payload
             << std::endl;
 
-  // 解析控制命令（格式: "command_type|parameters"）
-  auto parts = ProtocolParser::split_string(payload, '|');
-  if (parts.size() < 1) {
-    std::cout << "控制命令格式错误" << std::endl;
-    return;
-  }
-  int command_type_num;
-  try {
-    command_type_num = std::stoi(parts[0]);
-  } catch (const std::exception &e) {
-    std::cout << "控制命令类型解析错误: " << parts[0] << std::endl;
+  using Request = message_schema::QtControlRequest;
+  message_schema::Decoded<Request> request;
+  if (!decode_payload(request, payload)) {
     return;
   }
 
   ProtocolParser::ControlCommandType command_type =
-      static_cast<ProtocolParser::ControlCommandType>(command_type_num);
-  std::string parameters =
-      std::to_string(qt_fd) + (parts.size() > 1 ? parts[1] : "");
-
+      static_cast<ProtocolParser::ControlCommandType>(
+          request.integer<Request::COMMAND_TYPE>());
+  std::string command = control_command_name(command_type);
+  auto reply_fail = [&](std::string_view reason) {
+    send_to_client(qt_fd,
+                   message_schema::build<message_schema::ControlResponse>(
+                       ProtocolParser::CLIENT_QT_CLIENT, equipment_id,
+                       std::to_string(current_request_.request_id), "fail",
+                       command, reason));
+  };
+
+  // 登记到等待表，设备在控制响应中带回请求ID，据此找到发起请求的Qt连接
+  uint32_t pending_id = add_pending_request(qt_fd, equipment_id, command);
+  if (pending_id == 0) {
+    reply_fail("服务器繁忙");
+    return;
+  }
   // 执行控制命令
   bool success = connections_manager_->send_control_to_simulator(
-      ProtocolParser::CLIENT_EQUIPMENT, equipment_id, command_type, parameters);
+      ProtocolParser::CLIENT_EQUIPMENT, equipment_id, command_type,
+      std::string(request.text<Request::PARAMETERS>()), pending_id);
   if (!success) {
     std::cout << "send_control_to_simulator failed..." << std::endl;
+    PendingRequest unused;
+    take_pending_request(pending_id, equipment_id, unused);
+    reply_fail("发送命令失败");
     return;
   }
   std::cout << "send_control_to_simulator success" << std::endl;
@@ -783,9 +1682,10 @@ void EquipmentManagementServer::handle_my_control_query(
   // 1. 获取用户信息
   ConnectionManager::UserInfo user;
   if (!connections_manager_->get_user_info(fd, user)) {
-    std::vector<char> resp = ProtocolParser::build_my_control_response(
-        ProtocolParser::CLIENT_QT_CLIENT, "fail|用户未登录");
-    send(fd, resp.data(), resp.size(), 0);
+    std::vector<char> resp =
+        message_schema::build<message_schema::QtMyControlResponse>(
+            ProtocolParser::CLIENT_QT_CLIENT, "", "fail", "用户未登录");
+    send_to_client(fd, std::move(resp));
     return;
   }
 
@@ -799,7 +1699,7 @@ void EquipmentManagementServer::handle_my_control_query(
                     "AND r.status = 'approved' "
                     "AND r.start_time <= NOW() "
                     "AND r.end_time >= NOW()";
-  auto results = db_manager_->execute_query(sql);
+  auto results = db()->execute_query(sql);
 
   // 3. 收集设备ID（去重）
   std::set<std::string> equipment_ids;
@@ -830,7 +1730,7 @@ void EquipmentManagementServer::handle_my_control_query(
     std::string name_sql = "SELECT equipment_name, equipment_type, location "
                            "FROM equipments WHERE equipment_id = '" +
                            eq_id + "'";
-    auto name_result = db_manager_->execute_query(name_sql);
+    auto name_result = db()->execute_query(name_sql);
     std::string eq_name = eq_id, eq_type = "unknown", location = "";
     if (!name_result.empty() && name_result[0].size() >= 3) {
       eq_name = name_result[0][0];
@@ -849,34 +1749,37 @@ void EquipmentManagementServer::handle_my_control_query(
   }
 
   // 5. 发送响应
-  std::string payload_data = "success|" + data.str();
-  std::vector<char> resp = ProtocolParser::build_my_control_response(
-      ProtocolParser::CLIENT_QT_CLIENT, payload_data);
-  send(fd, resp.data(), resp.size(), 0);
+  std::vector<char> resp =
+      message_schema::build<message_schema::QtMyControlResponse>(
+          ProtocolParser::CLIENT_QT_CLIENT, "", "success", data.str());
+  send_to_client(fd, std::move(resp));
 }
 
 void EquipmentManagementServer::handle_my_control_request(
     int fd, const std::string &payload) {
-  // 解析 payload: 设备ID|命令|参数
-  auto parts = ProtocolParser::split_string(payload, '|');
-  if (parts.size() < 2) {
-    std::vector<char> resp = ProtocolParser::build_control_response(
-        ProtocolParser::CLIENT_QT_CLIENT, "", false, "fail|格式错误");
-    send(fd, resp.data(), resp.size(), 0);
+  using Request = message_schema::QtMyControlRequest;
+  message_schema::Decoded<Request> request;
+  bool decoded = decode_payload(request, payload);
+  std::string equipment_id(request.text<Request::EQUIPMENT_ID>());
+  std::string command(request.text<Request::COMMAND>());
+  std::string_view parameters = request.text<Request::PARAMETERS>();
+
+  // 失败响应与设备返回的控制响应格式相同，Qt端按同一种方式显示
+  auto reply_fail = [&](std::string_view reason) {
+    send_to_client(fd, message_schema::build<message_schema::ControlResponse>(
+                           ProtocolParser::CLIENT_QT_CLIENT, equipment_id,
+                           std::to_string(current_request_.request_id),
+                           "fail", command, reason));
+  };
+  if (!decoded) {
+    reply_fail("格式错误");
     return;
   }
 
-  std::string equipment_id = parts[0];
-  std::string command = parts[1];
-  std::string parameters = (parts.size() > 2) ? parts[2] : "";
-
   // 获取用户信息
   ConnectionManager::UserInfo user;
   if (!connections_manager_->get_user_info(fd, user)) {
-    std::vector<char> resp = ProtocolParser::build_control_response(
-        ProtocolParser::CLIENT_QT_CLIENT, equipment_id, false,
-        "fail|用户未登录");
-    send(fd, resp.data(), resp.size(), 0);
+    reply_fail("用户未登录");
     return;
   }
 
@@ -891,21 +1794,15 @@ void EquipmentManagementServer::handle_my_control_request(
                           "AND r.end_time >= NOW() "
                           "AND FIND_IN_SET('" +
                           equipment_id + "', p.equipment_ids) > 0";
-  auto result = db_manager_->execute_query(check_sql);
+  auto result = db()->execute_query(check_sql);
   if (result.empty() || result[0][0] == "0") {
-    std::vector<char> resp = ProtocolParser::build_control_response(
-        ProtocolParser::CLIENT_QT_CLIENT, equipment_id, false,
-        "fail|无权控制或不在预约时间内");
-    send(fd, resp.data(), resp.size(), 0);
+    reply_fail("无权控制或不在预约时间内");
     return;
   }
 
   // 检查设备是否在线
   if (!connections_manager_->is_equipment_connected(equipment_id)) {
-    std::vector<char> resp = ProtocolParser::build_control_response(
-        ProtocolParser::CLIENT_QT_CLIENT, equipment_id, false,
-        "fail|设备不在线");
-    send(fd, resp.data(), resp.size(), 0);
+    reply_fail("设备不在线");
     return;
   }
 
@@ -918,24 +1815,26 @@ void EquipmentManagementServer::handle_my_control_request(
   else if (command == "restart")
     cmd_type = ProtocolParser::RESTART;
   else {
-    std::vector<char> resp = ProtocolParser::build_control_response(
-        ProtocolParser::CLIENT_QT_CLIENT, equipment_id, false,
-        "fail|不支持的命令");
-    send(fd, resp.data(), resp.size(), 0);
+    reply_fail("不支持的命令");
     return;
   }
 
-  // 转发给设备，并附上当前fd以便设备返回时能识别
-  std::string full_params =
-      std::to_string(fd) + "|" + command + "|" + parameters;
+  // 登记到等待表后转发给设备，设备返回时按请求ID找到本连接
+  uint32_t pending_id = add_pending_request(fd, equipment_id, command);
+  if (pending_id == 0) {
+    reply_fail("服务器繁忙");
+    return;
+  }
+  std::string full_params = command + "|";
+  full_params += parameters;
   bool success = connections_manager_->send_control_to_simulator(
-      ProtocolParser::CLIENT_EQUIPMENT, equipment_id, cmd_type, full_params);
+      ProtocolParser::CLIENT_EQUIPMENT, equipment_id, cmd_type, full_params,
+      pending_id);
 
   if (!success) {
-    std::vector<char> resp = ProtocolParser::build_control_response(
-        ProtocolParser::CLIENT_QT_CLIENT, equipment_id, false,
-        "fail|发送命令失败");
-    send(fd, resp.data(), resp.size(), 0);
+    PendingRequest unused;
+    take_pending_request(pending_id, equipment_id, unused);
+    reply_fail("发送命令失败");
   }
   // 成功时不立即响应，等待设备返回后通过
   // handle_control_command_response_from_simulator 转发
@@ -946,13 +1845,14 @@ void EquipmentManagementServer::handle_heartbeat(
     int fd, const std::string &equipment_id) {
   //更新心跳时间
   connections_manager_->update_heartbeat(fd);
+  refresh_heartbeat_timer(fd);
 
   // 发送心跳响应
   std::vector<char> response = ProtocolParser::build_heartbeat_response(
       ProtocolParser::CLIENT_EQUIPMENT);
-  ssize_t bytes_sent = send(fd, response.data(), response.size(), 0);
+  bool sent = send_to_client(fd, std::move(response));
 
-  if (bytes_sent > 0) {
+  if (sent) {
     std::cout << "心跳处理: " << equipment_id << " fd=" << fd << " (响应已发送)"
               << std::endl;
   } else {
@@ -967,16 +1867,17 @@ void EquipmentManagementServer::handle_qt_alert_ack(
   std::cout << "收到Qt端告警确认: equipment_id=" << equipment_id
             << " payload=" << payload << std::endl;
 
-  int alarm_id = 0;
-  try {
-    alarm_id = std::stoi(payload);
-  } catch (const std::exception &e) {
-    std::cerr << "告警确认ID解析失败: " << e.what() << std::endl;
+  using Ack = message_schema::QtAlertAck;
+  message_schema::Decoded<Ack> ack;
+  if (!decode_payload(ack, payload)) {
     return;
   }
+  int alarm_id = ack.integer<Ack::ALARM_ID>();
 
-  if (db_manager_->update_alarm_acknowledged(alarm_id)) {
+  if (db()->update_alarm_acknowledged(alarm_id)) {
     std::cout << "告警 " << alarm_id << " 已标记为已处理" << std::endl;
+    // 已确认的告警不再抑制同类新告警
+    close_alarm_window(alarm_id);
     // 可选：向客户端发送确认响应（可暂不实现）
   } else {
     std::cerr << "告警 " << alarm_id << " 标记处理失败" << std::endl;
@@ -985,7 +1886,7 @@ void EquipmentManagementServer::handle_qt_alert_ack(
 
 void EquipmentManagementServer::handle_qt_alarm_query(int fd) {
   std::cout << "处理Qt客户端告警列表查询, fd=" << fd << std::endl;
-  auto alarms = db_manager_->get_unacknowledged_alarms();
+  auto alarms = db()->get_unacknowledged_alarms();
 
   std::stringstream ss;
   for (size_t i = 0; i < alarms.size(); ++i) {
@@ -1001,7 +1902,7 @@ void EquipmentManagementServer::handle_qt_alarm_query(int fd) {
 
   std::vector<char> response = ProtocolParser::build_alarm_query_response(
       ProtocolParser::CLIENT_QT_CLIENT, true, ss.str());
-  send(fd, response.data(), response.size(), 0);
+  send_to_client(fd, std::move(response));
   std::cout << "已发送告警列表响应，共 " << alarms.size() << " 条" << std::endl;
 }
 
@@ -1013,23 +1914,21 @@ void EquipmentManagementServer::handle_qt_heartbeat(
 
   // 使用新的Qt客户端专用心跳更新函数
   connections_manager_->update_qt_client_heartbeat(fd);
+  refresh_heartbeat_timer(fd);
 
   // 2. 构建响应（携带当前时间戳）
   std::string timestamp = get_current_time();
 
-  std::vector<char> response = ProtocolParser::pack_message(
-      ProtocolParser::build_message_body(ProtocolParser::CLIENT_QT_CLIENT,
-                                         ProtocolParser::QT_HEARTBEAT_RESPONSE,
-                                         client_identifier, {timestamp}));
+  std::vector<char> response = ProtocolParser::build_qt_heartbeat_response(
+      ProtocolParser::CLIENT_QT_CLIENT, client_identifier, timestamp);
 
   // 3. 发送响应（带有效性检查）
   if (fd > 0 && connections_manager_->is_connection_alive(fd)) {
-    ssize_t bytes_sent =
-        send(fd, response.data(), response.size(), MSG_NOSIGNAL);
-    if (bytes_sent > 0) {
+    bool sent = send_to_client(fd, std::move(response));
+    if (sent) {
       std::cout << "Qt客户端心跳响应已发送: " << client_identifier << std::endl;
     } else {
-      std::cerr << "Qt客户端心跳响应发送失败: " << strerror(errno) << std::endl;
+      std::cerr << "Qt客户端心跳响应发送失败: fd=" << fd << std::endl;
     }
   } else {
     std::cout << "跳过无效连接的Qt心跳响应: fd=" << fd << std::endl;
@@ -1037,102 +1936,320 @@ void EquipmentManagementServer::handle_qt_heartbeat(
 }
 
 void EquipmentManagementServer::handle_power_report(
-    int fd, const std::string &equipment_id, const std::string &payload) {
+    int fd, const std::string &equipment_id, const std::string &payload,
+    uint32_t shed_samples) {
+  DatabaseManager::PowerLogEntry entry;
+  if (!evaluate_power_report(fd, equipment_id, payload, shed_samples, entry)) {
+    return;
+  }
+  // 写入原始功耗日志表，开机时累加设备总能耗
+  if (db()->is_connected()) {
+    db()->insert_power_log(equipment_id, entry.power_value, entry.timestamp);
+  }
+  if (entry.energy_increment > 0) {
+    db()->update_equipment_energy_total(equipment_id, entry.energy_increment);
+  }
+}
+
+bool EquipmentManagementServer::evaluate_power_report(
+    int fd, const std::string &equipment_id, const std::string &payload,
+    uint32_t shed_samples, DatabaseManager::PowerLogEntry &entry) {
 
   std::cout << "处理功耗报告: " << equipment_id << " payload: " << payload
             << std::endl;
 
   // 解析功耗数据格式: "power_state|power_value|timestamp"
-  auto parts = ProtocolParser::split_string(payload, '|');
-  if (parts.size() < 3) {
-    std::cout << "功耗报告格式错误" << std::endl;
-    return;
+  using Report = message_schema::PowerReport;
+  message_schema::Decoded<Report> report;
+  if (!decode_payload(report, payload)) {
+    return false;
   }
 
-  std::string power_state = parts[0];
-  std::string power_value_str = parts[1];
-  std::string timestamp = parts[2];
+  std::string_view power_state = report.text<Report::POWER_STATE>();
+  std::string power_value_str(report.text<Report::POWER_VALUE>());
+  const double power_value = report.integer<Report::POWER_VALUE>();
+  entry.equipment_id = equipment_id;
+  entry.power_value = power_value;
+  entry.timestamp = std::string(report.text<Report::TIMESTAMP>());
 
   try {
-    double power_value = std::stod(power_value_str);
-    // 阈值判断
-    auto it = power_thresholds_.find(equipment_id);
-    if (it != power_thresholds_.end() && power_value > it->second) {
+    // 阈值判断：设备设置了阈值用设备的，否则用默认阈值
+    float threshold = DEFAULT_POWER_THRESHOLD_W;
+    {
+      std::shared_lock lock(thresholds_rw_lock_);
+      auto it = power_thresholds_.find(equipment_id);
+      if (it != power_thresholds_.end()) {
+        threshold = it->second;
+      }
+    }
+    if (power_value > threshold) {
       std::string message = "设备能耗超标: " + equipment_id +
                             " 当前功耗: " + power_value_str +
-                            "W (阈值: " + std::to_string(it->second) + "W)";
-
-      // 写入数据库
-      db_manager_->insert_alarm("energy_threshold", equipment_id, "warning",
-                                message);
+                            "W (阈值: " + std::to_string(threshold) + "W)";
 
-      // 发送告警给所有Qt客户端
+      // 去重和写库都在send_alert_to_all_qt_clients中，窗口内的重复告警不写库
       send_alert_to_all_qt_clients("energy_threshold", equipment_id, "warning",
                                    message);
     }
-    // 1. 写入原始功耗日志表
-    if (db_manager_->is_connected()) {
-      db_manager_->insert_power_log(equipment_id, power_value, timestamp);
-    }
 
-    // 2. 累加设备总能耗（简单累加，后续可优化为精确计算）
-    // 假设每次上报间隔为5秒，能耗增量 = 功率 × 5 / 3600 / 10 (0.1kWh)
-    double energy_increment = power_value * 5.0 / 3600.0 / 10.0;
+    // 累加设备总能耗（简单累加，后续可优化为精确计算）
+    // 假设每次上报间隔为5秒，能耗增量 = 功率 × 5 / 3600 / 10 (0.1kWh)。
+    // 过载时合并掉的上报按本次功率补算，保证总能耗不因丢弃而偏小
+    double energy_increment =
+        power_value * 5.0 * (1 + shed_samples) / 3600.0 / 10.0;
     if (power_state == "on") {
-      db_manager_->update_equipment_energy_total(equipment_id,
-                                                 energy_increment);
+      entry.energy_increment = energy_increment;
     }
 
-    std::cout << "  记录功耗: " << power_value << "W, 时间: " << timestamp
-              << ", 能耗增量: " << energy_increment << " (0.1kWh)" << std::endl;
+    std::cout << "  记录功耗: " << power_value << "W, 时间: " << entry.timestamp
+              << ", 能耗增量: " << energy_increment << " (0.1kWh)";
+    if (shed_samples > 0) {
+      std::cout << ", 含合并的上报: " << shed_samples;
+    }
+    std::cout << std::endl;
 
-    // 3. 更新心跳时间
+    // 更新心跳时间
     connections_manager_->update_heartbeat(fd);
+    refresh_heartbeat_timer(fd);
 
   } catch (const std::exception &e) {
     std::cerr << "解析功耗值失败: " << e.what() << std::endl;
   }
+  return true;
+}
 
-  try {
-    double power_value = std::stod(power_value_str);
-    double threshold = 200.0; // 阈值200W，可根据设备类型调整
+void EquipmentManagementServer::handle_batch(int fd,
+                                             const std::string &payload) {
+  // 只接受已上线设备连接发来的批量；子消息必须属于在这条连接上上线的设备
+  // （网关连接为多个设备逐个上线），否则任意连接都能替其他设备刷新心跳、写入功耗
+  std::vector<std::shared_ptr<Equipment>> bound =
+      connections_manager_->get_bound_equipments(fd);
+  ConnectionManager::Connection *conn = connections_manager_->get_connection(fd);
+  if (bound.empty() || !conn || !Reactor::current) {
+    std::cerr << "批量消息只接受已上线的设备连接，整帧丢弃: fd=" << fd
+              << std::endl;
+    batch_rejected_.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  auto is_bound = [&bound](const std::string &equipment_id) {
+    return std::any_of(bound.begin(), bound.end(),
+                       [&equipment_id](const std::shared_ptr<Equipment> &e) {
+                         return e->get_equipment_id() == equipment_id;
+                       });
+  };
+  uint32_t generation = conn->generation.load(std::memory_order_acquire);
+
+  std::vector<std::string_view> bodies;
+  if (!ProtocolParser::split_batch(payload, bodies)) {
+    std::cerr << "批量消息格式错误，整帧丢弃: fd=" << fd
+              << " 长度=" << payload.size() << std::endl;
+    batch_rejected_.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  batch_frames_.fetch_add(1, std::memory_order_relaxed);
+  batch_messages_.fetch_add(bodies.size(), std::memory_order_relaxed);
+
+  // 功耗上报攒起来最后一次多行写库；心跳刷新整条连接，整批回复一次
+  std::vector<DatabaseManager::PowerLogEntry> power_logs;
+  std::string heartbeat;
+  for (std::string_view body : bodies) {
+    ProtocolParser::ParseResult message = ProtocolParser::parse_message(body);
+    if (!message.success ||
+        message.client_type != ProtocolParser::CLIENT_EQUIPMENT ||
+        !is_bound(message.equipment_id)) {
+      batch_rejected_.fetch_add(1, std::memory_order_relaxed);
+      continue;
+    }
+    if (message.type != ProtocolParser::HEARTBEAT &&
+        message.type != ProtocolParser::STATUS_UPDATE &&
+        message.type != ProtocolParser::POWER_REPORT) {
+      // 上线、控制响应等需要逐条处理或应答的消息不能放进批量
+      std::cerr << "批量消息中不支持的类型: " << message.type
+                << " fd=" << fd << std::endl;
+      batch_rejected_.fetch_add(1, std::memory_order_relaxed);
+      continue;
+    }
+    // 每条子消息按单独发送一样扣令牌，批量不能绕过限速；
+    // 被延后的子消息到时按单条消息处理
+    if (!admit_message(*Reactor::current, fd, generation, message, 0)) {
+      if (!conn->in_use.load(std::memory_order_acquire) ||
+          conn->generation.load(std::memory_order_acquire) != generation) {
+        return; // 超限断开，其余子消息不再处理
+      }
+      continue;
+    }
+    switch (message.type) {
+    case ProtocolParser::HEARTBEAT:
+      heartbeat = message.equipment_id;
+      break;
+    case ProtocolParser::STATUS_UPDATE:
+      handle_status_update(fd, message.equipment_id, message.payload);
+      break;
+    case ProtocolParser::POWER_REPORT: {
+      DatabaseManager::PowerLogEntry entry;
+      if (evaluate_power_report(fd, message.equipment_id, message.payload, 0,
+                                entry)) {
+        power_logs.push_back(std::move(entry));
+      }
+      break;
+    }
+    default:
+      break;
+    }
+  }
 
-    if (power_value > threshold) {
-      std::string message = "设备能耗超标: " + equipment_id +
-                            " 当前功耗: " + power_value_str + "W";
+  if (!power_logs.empty() && db()->is_connected()) {
+    db()->insert_power_logs(power_logs);
+    db()->update_equipment_energy_totals(power_logs);
+  }
+  if (!heartbeat.empty()) {
+    handle_heartbeat(fd, heartbeat);
+  }
+}
 
-      // 写入数据库
-      db_manager_->insert_alarm("energy_threshold", equipment_id, "warning",
-                                message);
+void EquipmentManagementServer::schedule_periodic_tasks(Reactor &reactor) {
+  reactor.timers.schedule_every(MAINTENANCE_INTERVAL_MS,
+                                [this]() { perform_maintenance_tasks(); });
+  // 断开出站数据长期积压的慢消费者
+  reactor.timers.schedule_every(SLOW_CONSUMER_CHECK_INTERVAL_MS, [this]() {
+    connections_manager_->check_slow_consumers();
+  });
+  // 其他途径修改的阈值定期同步到缓存
+  reactor.timers.schedule_every(THRESHOLD_RELOAD_INTERVAL_MS,
+                                [this]() { load_thresholds_from_db(); });
+  // 设备迟迟不响应的控制请求回复超时
+  reactor.timers.schedule_every(PENDING_REQUEST_CHECK_INTERVAL_MS,
+                                [this]() { expire_pending_requests(); });
+}
 
-      // 发送告警
-      send_alert_to_all_qt_clients("energy_threshold", equipment_id, "warning",
-                                   message);
+void EquipmentManagementServer::arm_heartbeat_timer(Reactor &reactor, int fd) {
+  ConnectionManager::Connection *conn = connections_manager_->get_connection(fd);
+  if (!conn) {
+    return;
+  }
+  // Qt客户端的超时更宽松
+  uint64_t timeout_ms = conn->client_type.load(std::memory_order_relaxed) ==
+                                ProtocolParser::CLIENT_EQUIPMENT
+                            ? EQUIPMENT_HEARTBEAT_TIMEOUT_MS
+                            : QT_HEARTBEAT_TIMEOUT_MS;
+
+  if (conn->heartbeat_timer &&
+      reactor.timers.reschedule(conn->heartbeat_timer, timeout_ms)) {
+    return;
+  }
+  uint32_t generation = conn->generation.load(std::memory_order_acquire);
+  conn->heartbeat_timer = reactor.timers.schedule(timeout_ms, [this, conn,
+                                                               generation]() {
+    // 记录已被复用说明连接早已关闭
+    if (conn->generation.load(std::memory_order_acquire) != generation) {
+      return;
     }
-  } catch (const std::exception &e) {
-    std::cerr << "能耗阈值判断失败: " << e.what() << std::endl;
+    conn->heartbeat_timer = 0;
+    // 仅标记为不健康，不主动清理，收到新的心跳后重新计时
+    connections_manager_->handle_heartbeat_timeout(conn->fd);
+  });
+}
+
+void EquipmentManagementServer::refresh_heartbeat_timer(int fd) {
+  // 心跳定时器只能由连接所属的Reactor线程操作；
+  // UDP功耗上报在接收它的Reactor上处理，不刷新TCP连接的定时器
+  ConnectionManager::Connection *conn = connections_manager_->get_connection(fd);
+  if (Reactor::current && conn &&
+      conn->reactor_id.load(std::memory_order_acquire) ==
+          Reactor::current->id) {
+    arm_heartbeat_timer(*Reactor::current, fd);
   }
 }
 
-void EquipmentManagementServer::check_heartbeat_timeout() {
-  connections_manager_->check_heartbeat_timeout(60);
-  check_qt_client_heartbeat_timeout(180);
+void EquipmentManagementServer::receive_udp_reports(Reactor &reactor) {
+  uint64_t now_us = PriorityLanes::now_us();
+  int received = reactor.udp->receive(
+      [this, &reactor, now_us](std::string_view datagram,
+                               const sockaddr_in &source) {
+        std::string_view body;
+        std::string_view token;
+        if (!ProtocolParser::split_udp_token(datagram, body, token)) {
+          udp_rejected_.fetch_add(1, std::memory_order_relaxed);
+          return;
+        }
+        ProtocolParser::ParseResult message =
+            ProtocolParser::parse_message(body);
+        if (!message.success || message.type != ProtocolParser::POWER_REPORT ||
+            message.client_type != ProtocolParser::CLIENT_EQUIPMENT) {
+          udp_rejected_.fetch_add(1, std::memory_order_relaxed);
+          return;
+        }
+        int fd = -1;
+        uint32_t generation = 0;
+        if (!authenticate_udp_report(message.equipment_id, token,
+                                     source.sin_addr.s_addr, fd, generation)) {
+          udp_rejected_.fetch_add(1, std::memory_order_relaxed);
+          return;
+        }
+        // 与TCP收到的功耗上报进入同一批量队列，过载合并和限速同样生效
+        udp_accepted_.fetch_add(1, std::memory_order_relaxed);
+        reactor.lanes.push(PriorityLanes::LANE_BULK,
+                           {fd, generation, now_us, std::move(message)});
+      },
+      UDP_BATCHES_PER_TURN);
+  if (received > 0) {
+    udp_batches_.fetch_add(1, std::memory_order_relaxed);
+  }
+}
 
-  auto timeout_fds = connections_manager_->get_timeout_fds();
-  for (int fd : timeout_fds) {
-    auto equipment = connections_manager_->get_equipment_by_fd(fd);
-    if (equipment) {
-      std::string equipment_id = equipment->get_equipment_id();
-      std::string message = "设备离线超时: " + equipment_id;
-      // 直接调用 send_alert_to_all_qt_clients，它内部会处理插入和发送
-      send_alert_to_all_qt_clients("offline", equipment_id, "warning", message);
+std::string EquipmentManagementServer::issue_udp_token(
+    int fd, const std::string &equipment_id) {
+  ConnectionManager::Connection *conn = connections_manager_->get_connection(fd);
+  if (!conn) {
+    return "";
+  }
+  // 令牌不可预测即可，不需要密码学强度
+  static thread_local std::mt19937_64 rng{std::random_device{}()};
+  std::ostringstream token;
+  token << std::hex << std::setw(16) << std::setfill('0') << rng();
+
+  UdpSession session;
+  session.token = token.str();
+  session.fd = fd;
+  session.generation = conn->generation.load(std::memory_order_acquire);
+  // Unix域socket上线的设备没有IP，只接受本机发来的数据报
+  struct sockaddr_in peer {};
+  socklen_t len = sizeof(peer);
+  if (getpeername(fd, (struct sockaddr *)&peer, &len) == 0 &&
+      peer.sin_family == AF_INET) {
+    session.peer_ip = peer.sin_addr.s_addr;
+  }
+  std::unique_lock lock(udp_sessions_lock_);
+  udp_sessions_[equipment_id] = session;
+  return session.token;
+}
+
+bool EquipmentManagementServer::authenticate_udp_report(
+    const std::string &equipment_id, std::string_view token, uint32_t source_ip,
+    int &fd, uint32_t &generation) {
+  {
+    std::shared_lock lock(udp_sessions_lock_);
+    auto it = udp_sessions_.find(equipment_id);
+    if (it == udp_sessions_.end() || it->second.token != token) {
+      return false;
+    }
+    const UdpSession &session = it->second;
+    bool loopback = (ntohl(source_ip) >> 24) == 127;
+    if (session.peer_ip != 0 ? session.peer_ip != source_ip : !loopback) {
+      return false;
     }
+    fd = session.fd;
+    generation = session.generation;
   }
+  // 令牌随TCP会话失效：连接已关闭或fd已被复用
+  ConnectionManager::Connection *conn = connections_manager_->get_connection(fd);
+  return conn && conn->in_use.load(std::memory_order_acquire) &&
+         conn->generation.load(std::memory_order_acquire) == generation;
 }
 
 void EquipmentManagementServer::handle_qt_place_list_query(int fd) {
   // 明确：从数据库获取所有场所
-  auto places = db_manager_->get_all_places();
+  auto places = db()->get_all_places();
 
   // 明确：构建响应字符串 "place_id|place_name;..."
   std::stringstream ss;
@@ -1140,7 +2257,7 @@ void EquipmentManagementServer::handle_qt_place_list_query(int fd) {
     if (i > 0)
       ss << ";";
     std::string place_id = places[i][0];
-    auto equipment_ids = db_manager_->get_equipment_ids_by_place(place_id);
+    auto equipment_ids = db()->get_equipment_ids_by_place(place_id);
 
     ss << place_id << "|" << places[i][1] << "|";
 
@@ -1154,82 +2271,139 @@ void EquipmentManagementServer::handle_qt_place_list_query(int fd) {
 
   // 明确：构建协议响应消息
   std::vector<char> response =
-      ProtocolParser::pack_message(ProtocolParser::build_message_body(
-          ProtocolParser::CLIENT_QT_CLIENT,
-          ProtocolParser::QT_PLACE_LIST_RESPONSE, // 改动：使用枚举变量名
-          "",                                     // equipment_id为空
-          {ss.str()}));
+      message_schema::build<message_schema::QtPlaceListResponse>(
+          ProtocolParser::CLIENT_QT_CLIENT, "", ss.str()); // equipment_id为空
 
   // 明确：发送响应
-  ssize_t bytes_sent = send(fd, response.data(), response.size(), MSG_NOSIGNAL);
-  if (bytes_sent > 0) {
+  bool sent = send_to_client(fd, std::move(response));
+  if (sent) {
     std::cout << "场所列表响应已发送: " << places.size() << " 个场所"
               << std::endl;
   }
 }
 
-bool EquipmentManagementServer::accept_new_connection() {
+bool EquipmentManagementServer::accept_new_connection(Reactor &reactor) {
   int accepted_count = 0;
+  int rejected_count = 0;
   bool has_error = false;
+  reactor.accept_pending = false;
 
-  // ET模式下必须循环accept，直到没有更多连接
-  while (true) {
-    Socket server_socket{};
-    int client_fd = server_socket.accept_socket(server_fd_);
-
-    if (client_fd < 0) {
-      // 检查是否没有更多连接了
-      if (errno == EAGAIN || errno == EWOULDBLOCK) {
-        // 没有更多连接可接受，正常退出
-        if (accepted_count > 0) {
-          std::cout << "本次循环接受 " << accepted_count << " 个新连接"
-                    << std::endl;
+  // ET模式下要accept到EAGAIN为止，但每轮最多accept_batch个，
+  // 剩余的留到下一轮，重连风暴时已有连接的请求不会被长时间阻塞。
+  // TCP和Unix域监听socket共用每轮的额度
+  Socket server_socket{};
+  for (int listen_fd : {reactor.listen_fd, reactor.unix_listen_fd}) {
+    if (listen_fd < 0) {
+      continue;
+    }
+    bool drained = false;
+    bool listener_error = false;
+    while (accepted_count + rejected_count < config_.accept_batch) {
+      // Unix域socket的地址会被截断，admit_connection按地址族区分
+      struct sockaddr_in peer {};
+      int client_fd = server_socket.accept_socket(listen_fd, &peer);
+
+      if (client_fd < 0) {
+        // 检查是否没有更多连接了
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+          drained = true;
+          break;
         }
+        // 对端在accept前已断开，继续处理下一个
+        if (errno == EINTR || errno == ECONNABORTED) {
+          continue;
+        }
+        // 真正的错误（如fd耗尽），下一轮再试
+        std::cerr << "accept失败: " << strerror(errno) << std::endl;
+        listener_error = true;
         break;
       }
 
-      // 真正的错误
-      std::cerr << "accept失败: " << strerror(errno) << std::endl;
-      has_error = true;
-      break;
+      if (!admit_connection(reactor, client_fd, &peer)) {
+        rejected_count++;
+        continue;
+      }
+      accepted_count++;
+      register_client_connection(reactor, client_fd);
+    }
+    if (!drained && !listener_error) {
+      reactor.accept_pending = true;
     }
+    has_error = has_error || listener_error;
+  }
+  if (accepted_count > 0 || rejected_count > 0) {
+    std::cout << "Reactor " << reactor.id << " 本次接受 " << accepted_count
+              << " 个新连接，拒绝 " << rejected_count << " 个"
+              << (reactor.accept_pending ? "，剩余连接下一轮处理" : "")
+              << std::endl;
+  }
+  return !has_error; // 有错误返回false，无错误返回true
+}
 
-    accepted_count++;
+bool EquipmentManagementServer::admit_connection(
+    Reactor &reactor, int client_fd, const struct sockaddr_in *peer) {
+  // 超过连接数上限
+  if (config_.max_connections > 0 &&
+      connections_manager_->get_connection_count() >=
+          static_cast<size_t>(config_.max_connections)) {
+    rejected_connections_full_.fetch_add(1, std::memory_order_relaxed);
+    reject_connection(client_fd);
+    return false;
+  }
 
-    // 设置非阻塞
-    Socket client_socket{};
-    if (!client_socket.set_nonblock(client_fd)) {
-      std::cerr << "设置非阻塞失败: " << client_fd << std::endl;
-      close(client_fd);
-      continue; // 继续接受其他连接
+  // 同一来源IP新建连接过快（Unix域socket来自本机，不限速）
+  if (reactor.accept_limiter.enabled()) {
+    struct sockaddr_in addr {};
+    if (!peer) {
+      socklen_t len = sizeof(addr);
+      getpeername(client_fd, (struct sockaddr *)&addr, &len);
+      peer = &addr;
     }
-
-    // 注册到epoll（ET模式）
-    Epoll &ep = Epoll::get_instance();
-    if (!ep.add_epoll(client_fd, EPOLLIN | EPOLLET | EPOLLRDHUP)) {
-      std::cerr << "epoll注册失败: " << client_fd << std::endl;
-      close(client_fd);
-      continue;
+    if (peer->sin_family == AF_INET &&
+        !reactor.accept_limiter.allow(peer->sin_addr.s_addr,
+                                      TimerWheel::now_ms())) {
+      rejected_connections_rate_.fetch_add(1, std::memory_order_relaxed);
+      reject_connection(client_fd);
+      return false;
     }
+  }
+  return true;
+}
 
-    // 获取客户端信息
-    struct sockaddr_in client_addr;
-    socklen_t client_len = sizeof(client_addr);
-    if (getpeername(client_fd, (struct sockaddr *)&client_addr, &client_len) ==
-        0) {
+void EquipmentManagementServer::reject_connection(int client_fd) {
+  // linger=0：关闭时直接发RST，不进入TIME_WAIT，客户端立即得知被拒绝
+  struct linger reset {};
+  reset.l_onoff = 1;
+  reset.l_linger = 0;
+  setsockopt(client_fd, SOL_SOCKET, SO_LINGER, &reset, sizeof(reset));
+  close(client_fd);
+}
 
-      // 将新连接添加到连接管理器，默认类型为Qt客户端
-      connections_manager_->add_connection(client_fd, nullptr,
-                                           ProtocolParser::CLIENT_QT_CLIENT);
-      std::cout << "新客户端连接[" << accepted_count << "]: fd=" << client_fd
-                << ", IP=" << inet_ntoa(client_addr.sin_addr)
-                << ", Port=" << ntohs(client_addr.sin_port) << std::endl;
-    } else {
-      std::cout << "新客户端连接[" << accepted_count << "]: fd=" << client_fd
-                << " (无法获取地址)" << std::endl;
-    }
+bool EquipmentManagementServer::register_client_connection(
+    Reactor &reactor, int client_fd, std::shared_ptr<ShmChannel> shm_channel) {
+  // 先在连接表中建立记录，事件注册要用到它。
+  // 设备端口上的连接按设备处理，其余默认为Qt客户端
+  ProtocolParser::ClientType client_type =
+      reactor.role == Reactor::ROLE_EQUIPMENT ? ProtocolParser::CLIENT_EQUIPMENT
+                                              : ProtocolParser::CLIENT_QT_CLIENT;
+  if (!connections_manager_->add_connection(client_fd, nullptr, client_type,
+                                            &reactor, std::move(shm_channel))) {
+    std::cerr << "连接表已满: " << client_fd << std::endl;
+    reject_connection(client_fd);
+    return false;
   }
-  return !has_error; // 有错误返回false，无错误返回true
+
+  // 注册到当前Reactor的事件循环，连接此后固定由该Reactor处理
+  if (!reactor.attach_connection(client_fd)) {
+    std::cerr << "事件循环注册失败: " << client_fd << std::endl;
+    // remove_connection已关闭fd，再次close可能关掉其他线程刚accept到的同号fd
+    connections_manager_->remove_connection(client_fd);
+    return false;
+  }
+  connections_manager_->get_connection(client_fd)->reactor_id.store(
+      reactor.id, std::memory_order_release);
+  arm_heartbeat_timer(reactor, client_fd);
+  return true;
 }
 
 void EquipmentManagementServer::handle_qt_energy_query(
@@ -1239,82 +2413,44 @@ void EquipmentManagementServer::handle_qt_energy_query(
             << " payload=" << payload << std::endl;
 
   // 解析payload: "timeRange|startDate|endDate"
-  auto parts = ProtocolParser::split_string(payload, '|');
-  if (parts.size() < 3) {
-    // 错误响应 - 使用协议函数构建
-    std::vector<char> response =
-        ProtocolParser::pack_message(ProtocolParser::build_message_body(
-            ProtocolParser::CLIENT_QT_CLIENT,
-            ProtocolParser::QT_ENERGY_RESPONSE,
-            "response", // 错误时equipment_id填response
-            {"fail", "数据格式错误"}));
-    send(fd, response.data(), response.size(), 0);
+  using Query = message_schema::QtEnergyQuery;
+  message_schema::Decoded<Query> query;
+  if (!decode_payload(query, payload)) {
+    // 错误时equipment_id填response
+    send_to_client(fd,
+                   message_schema::build<message_schema::QtEnergyResponse>(
+                       ProtocolParser::CLIENT_QT_CLIENT, "response",
+                       "fail|数据格式错误"));
     return;
   }
 
-  std::string timeRange = parts[0];
-  std::string startDate = parts[1];
-  std::string endDate = parts[2];
+  std::string timeRange(query.text<Query::TIME_RANGE>());
+  std::string startDate(query.text<Query::START_DATE>());
+  std::string endDate(query.text<Query::END_DATE>());
 
   // 查询数据库
   std::string data;
   if (equipment_id == "all" || equipment_id.empty()) {
     data =
-        db_manager_->get_energy_statistics_all(timeRange, startDate, endDate);
+        db()->get_energy_statistics_all(timeRange, startDate, endDate);
   } else {
-    data = db_manager_->get_energy_statistics_by_equipment(
+    data = db()->get_energy_statistics_by_equipment(
         equipment_id, timeRange, startDate, endDate);
   }
 
   std::cout << "[调试] 查询结果数据: " << data << std::endl;
 
-  // 成功响应 - 使用协议函数构建
+  // 成功响应，聚合数据作为单个字段
   std::vector<char> response =
-      ProtocolParser::pack_message(ProtocolParser::build_message_body(
-          ProtocolParser::CLIENT_QT_CLIENT, ProtocolParser::QT_ENERGY_RESPONSE,
-          equipment_id, {data} // 将聚合数据作为单个字段
-          ));
-
-  ssize_t bytes_sent = send(fd, response.data(), response.size(), 0);
-  if (bytes_sent > 0) {
-    std::cout << "能耗查询响应已发送: " << bytes_sent << " 字节" << std::endl;
-  } else {
-    std::cerr << "能耗查询响应发送失败: " << strerror(errno) << std::endl;
-  }
-}
-
-void EquipmentManagementServer::check_qt_client_heartbeat_timeout(
-    int timeout_seconds) {
-  // 获取所有连接
-  auto all_connections =
-      connections_manager_->get_all_connections(); // 需要添加此函数
+      message_schema::build<message_schema::QtEnergyResponse>(
+          ProtocolParser::CLIENT_QT_CLIENT, equipment_id, data);
 
-  time_t current_time = time(nullptr);
-  int timeout_count = 0;
-
-  for (const auto &conn : all_connections) {
-    int fd = conn.first;
-    auto client_type = connections_manager_->get_client_type(fd);
-
-    // 只检查Qt客户端
-    if (client_type == ProtocolParser::CLIENT_QT_CLIENT) {
-      if (connections_manager_->is_connection_healthy(fd)) {
-        auto last_heartbeat = connections_manager_->get_last_heartbeat(fd);
-        if (current_time - last_heartbeat > timeout_seconds) {
-          std::cout << "Qt客户端心跳超时: fd=" << fd
-                    << ", 最后心跳: " << last_heartbeat << std::endl;
-          timeout_count++;
-
-          // 关键：仅标记为不健康，**不主动清理**
-          connections_manager_->mark_connection_unhealthy(fd);
-        }
-      }
-    }
-  }
-
-  if (timeout_count > 0) {
-    std::cout << "检测到" << timeout_count
-              << "个Qt客户端心跳超时（仅标记，不清理）" << std::endl;
+  size_t response_size = response.size();
+  bool sent = send_to_client(fd, std::move(response));
+  if (sent) {
+    std::cout << "能耗查询响应已入队: " << response_size << " 字节" << std::endl;
+  } else {
+    std::cerr << "能耗查询响应发送失败: fd=" << fd << std::endl;
   }
 }
 
@@ -1322,13 +2458,32 @@ void EquipmentManagementServer::send_alert_to_all_qt_clients(
     const std::string &alarm_type, const std::string &equipment_id,
     const std::string &severity, const std::string &message) {
 
-  // 检查最近5分钟内是否有未处理的同类告警
-  std::string check_sql = "SELECT COUNT(*) FROM alarms WHERE equipment_id = '" +
-                          equipment_id + "' AND alarm_type = '" + alarm_type +
-                          "' AND is_acknowledged = FALSE AND created_time > "
-                          "NOW() - INTERVAL 5 MINUTE";
-  auto result = db_manager_->execute_query(check_sql);
-  if (!result.empty() && std::stoi(result[0][0]) > 0) {
+  // 去重窗口内已有未处理的同类告警则跳过
+  std::string window_key = equipment_id + "|" + alarm_type;
+  if (in_alarm_window(window_key)) {
+    std::cout << "设备 " << equipment_id << " 在最近5分钟内已有未处理的 "
+              << alarm_type << " 告警，跳过生成" << std::endl;
+    return;
+  }
+
+  // 内存中没有（例如服务器刚重启）时再查数据库
+  std::string check_sql =
+      "SELECT id, TIMESTAMPDIFF(SECOND, created_time, NOW()) FROM alarms "
+      "WHERE equipment_id = '" +
+      equipment_id + "' AND alarm_type = '" + alarm_type +
+      "' AND is_acknowledged = FALSE AND created_time > "
+      "NOW() - INTERVAL 5 MINUTE ORDER BY created_time DESC LIMIT 1";
+  auto result = db()->execute_query(check_sql);
+  if (!result.empty() && result[0].size() >= 2) {
+    int existing_id = 0;
+    int age_seconds = 0;
+    try {
+      existing_id = std::stoi(result[0][0]);
+      age_seconds = std::stoi(result[0][1]);
+    } catch (...) {
+    }
+    open_alarm_window(window_key, existing_id,
+                      ALARM_DEDUP_WINDOW_SECONDS - age_seconds);
     std::cout << "设备 " << equipment_id << " 在最近5分钟内已有未处理的 "
               << alarm_type << " 告警，跳过生成" << std::endl;
     return;
@@ -1336,38 +2491,85 @@ void EquipmentManagementServer::send_alert_to_all_qt_clients(
 
   // 插入新告警并获取ID
   int alarm_id =
-      db_manager_->insert_alarm(alarm_type, equipment_id, severity, message);
+      db()->insert_alarm(alarm_type, equipment_id, severity, message);
   if (alarm_id <= 0) {
     std::cerr << "插入告警失败，无法发送" << std::endl;
     return;
   }
+  open_alarm_window(window_key, alarm_id, ALARM_DEDUP_WINDOW_SECONDS);
+
+  // 告警只打包一次，所有在线Qt客户端共享同一份缓冲区
+  auto alert_msg = std::make_shared<const std::vector<char>>(
+      ProtocolParser::build_alert_message(ProtocolParser::CLIENT_QT_CLIENT,
+                                          equipment_id, alarm_id, alarm_type,
+                                          severity, message));
+  size_t sent = connections_manager_->broadcast(
+      alert_msg, ProtocolParser::CLIENT_QT_CLIENT,
+      [](const ConnectionManager::Connection &conn) {
+        return conn.healthy.load(std::memory_order_relaxed);
+      });
+  std::cout << "告警已发送给 " << sent << " 个Qt客户端" << std::endl;
+}
 
-  // 发送给所有在线Qt客户端
-  auto qt_connections = connections_manager_->get_qt_client_connections();
-  for (int fd : qt_connections) {
-    if (fd > 0 && connections_manager_->is_connection_alive(fd)) {
-      std::vector<char> alert_msg = ProtocolParser::build_alert_message(
-          ProtocolParser::CLIENT_QT_CLIENT, equipment_id, alarm_id, alarm_type,
-          severity, message);
-      ssize_t bytes_sent =
-          send(fd, alert_msg.data(), alert_msg.size(), MSG_NOSIGNAL);
-      if (bytes_sent > 0) {
-        std::cout << "告警已发送给Qt客户端 fd=" << fd << std::endl;
+bool EquipmentManagementServer::in_alarm_window(const std::string &key) {
+  std::lock_guard<std::mutex> lock(alarm_windows_mutex_);
+  auto it = alarm_windows_.find(key);
+  return it != alarm_windows_.end() &&
+         it->second.expire_ms > TimerWheel::now_ms();
+}
+
+void EquipmentManagementServer::open_alarm_window(const std::string &key,
+                                                  int alarm_id,
+                                                  int window_seconds) {
+  if (window_seconds <= 0) {
+    return;
+  }
+  uint64_t window_ms = static_cast<uint64_t>(window_seconds) * 1000;
+  uint64_t expire_ms = TimerWheel::now_ms() + window_ms;
+  {
+    std::lock_guard<std::mutex> lock(alarm_windows_mutex_);
+    alarm_windows_[key] = AlarmWindow{alarm_id, expire_ms};
+  }
+
+  // 到期清理挂在当前Reactor的时间轮上；不在Reactor线程时投递给0号Reactor
+  auto schedule_cleanup = [this, key, expire_ms, window_ms](Reactor &reactor) {
+    reactor.timers.schedule(window_ms, [this, key, expire_ms]() {
+      std::lock_guard<std::mutex> lock(alarm_windows_mutex_);
+      auto it = alarm_windows_.find(key);
+      if (it != alarm_windows_.end() && it->second.expire_ms == expire_ms) {
+        alarm_windows_.erase(it);
       }
+    });
+  };
+  if (Reactor::current) {
+    schedule_cleanup(*Reactor::current);
+  } else if (!reactors_.empty()) {
+    Reactor *reactor = &background_reactor();
+    reactor->post([schedule_cleanup, reactor]() { schedule_cleanup(*reactor); });
+  }
+}
+
+void EquipmentManagementServer::close_alarm_window(int alarm_id) {
+  std::lock_guard<std::mutex> lock(alarm_windows_mutex_);
+  for (auto it = alarm_windows_.begin(); it != alarm_windows_.end(); ++it) {
+    if (it->second.alarm_id == alarm_id) {
+      alarm_windows_.erase(it);
+      return;
     }
   }
 }
 
 void EquipmentManagementServer::load_thresholds_from_db() {
-  if (!db_manager_ || !db_manager_->is_connected()) {
+  if (!db_manager_ || !db()->is_connected()) {
     std::cerr << "数据库未连接，无法加载阈值" << std::endl;
     return;
   }
 
   std::string query = "SELECT equipment_id, threshold_value FROM thresholds "
                       "WHERE threshold_type = 'power_threshold'";
-  auto results = db_manager_->execute_query(query);
+  auto results = db()->execute_query(query);
 
+  std::unique_lock lock(thresholds_rw_lock_);
   power_thresholds_.clear();
   for (const auto &row : results) {
     if (row.size() >= 2) {
@@ -1389,22 +2591,24 @@ void EquipmentManagementServer::handle_set_threshold(
     int fd, const std::string &equipment_id, const std::string &payload) {
 
   // 解析 payload，格式: "equipment_id|threshold_value"
-  auto parts = ProtocolParser::split_string(payload, '|');
-  if (parts.size() < 2) {
+  using Request = message_schema::QtSetThreshold;
+  message_schema::Decoded<Request> request;
+  if (!decode_payload(request, payload)) {
     std::vector<char> response = ProtocolParser::build_set_threshold_response(
         ProtocolParser::CLIENT_QT_CLIENT, false, "格式错误");
-    send(fd, response.data(), response.size(), 0);
+    send_to_client(fd, std::move(response));
     return;
   }
 
-  std::string target_eq = parts[0];
+  std::string target_eq(request.text<Request::EQUIPMENT_ID>());
   float threshold_value;
   try {
-    threshold_value = std::stof(parts[1]);
+    threshold_value =
+        std::stof(std::string(request.text<Request::THRESHOLD>()));
   } catch (...) {
     std::vector<char> response = ProtocolParser::build_set_threshold_response(
         ProtocolParser::CLIENT_QT_CLIENT, false, "阈值数值无效");
-    send(fd, response.data(), response.size(), 0);
+    send_to_client(fd, std::move(response));
     return;
   }
 
@@ -1413,54 +2617,57 @@ void EquipmentManagementServer::handle_set_threshold(
   if (!equipment) {
     std::vector<char> response = ProtocolParser::build_set_threshold_response(
         ProtocolParser::CLIENT_QT_CLIENT, false, "设备不存在");
-    send(fd, response.data(), response.size(), 0);
+    send_to_client(fd, std::move(response));
     return;
   }
 
   // 写入数据库（使用 REPLACE INTO，因为表有唯一约束）
-  if (db_manager_->is_connected()) {
+  if (db()->is_connected()) {
     // 注意：需要转义 equipment_id 防止 SQL 注入，但这里简化处理
     std::string query = "REPLACE INTO thresholds (equipment_id, "
                         "threshold_type, threshold_value) VALUES ('" +
                         target_eq + "', 'power_threshold', " +
                         std::to_string(threshold_value) + ")";
-    if (!db_manager_->execute_update(query)) {
+    if (!db()->execute_update(query)) {
       std::vector<char> response = ProtocolParser::build_set_threshold_response(
           ProtocolParser::CLIENT_QT_CLIENT, false, "数据库错误");
-      send(fd, response.data(), response.size(), 0);
+      send_to_client(fd, std::move(response));
       return;
     }
   } else {
     std::vector<char> response = ProtocolParser::build_set_threshold_response(
         ProtocolParser::CLIENT_QT_CLIENT, false, "数据库未连接");
-    send(fd, response.data(), response.size(), 0);
+    send_to_client(fd, std::move(response));
     return;
   }
 
   // 更新内存缓存
-  power_thresholds_[target_eq] = threshold_value;
+  {
+    std::unique_lock lock(thresholds_rw_lock_);
+    power_thresholds_[target_eq] = threshold_value;
+  }
 
   // 发送成功响应
   std::vector<char> response = ProtocolParser::build_set_threshold_response(
       ProtocolParser::CLIENT_QT_CLIENT, true, "阈值设置成功");
-  send(fd, response.data(), response.size(), 0);
+  send_to_client(fd, std::move(response));
 
   std::cout << "阈值设置成功: " << target_eq << " = " << threshold_value
             << std::endl;
 }
 
 void EquipmentManagementServer::handle_get_all_thresholds(int fd) {
-  if (!db_manager_->is_connected()) {
+  if (!db()->is_connected()) {
     std::vector<char> response =
         ProtocolParser::build_get_all_thresholds_response(
             ProtocolParser::CLIENT_QT_CLIENT, false, "数据库未连接");
-    send(fd, response.data(), response.size(), 0);
+    send_to_client(fd, std::move(response));
     return;
   }
 
   std::string query = "SELECT equipment_id, threshold_value FROM thresholds "
                       "WHERE threshold_type = 'power_threshold'";
-  auto results = db_manager_->execute_query(query);
+  auto results = db()->execute_query(query);
 
   std::stringstream ss;
   for (size_t i = 0; i < results.size(); ++i) {
@@ -1472,7 +2679,7 @@ void EquipmentManagementServer::handle_get_all_thresholds(int fd) {
   std::vector<char> response =
       ProtocolParser::build_get_all_thresholds_response(
           ProtocolParser::CLIENT_QT_CLIENT, true, ss.str());
-  send(fd, response.data(), response.size(), 0);
+  send_to_client(fd, std::move(response));
   std::cout << "已发送所有阈值数据: " << results.size() << " 条" << std::endl;
 }
 
@@ -1484,12 +2691,12 @@ void EquipmentManagementServer::handle_my_reservation_query(
   if (!connections_manager_->get_user_info(fd, user_info)) {
     std::vector<char> response =
         ProtocolParser::build_my_reservation_response(false, "用户未登录");
-    send(fd, response.data(), response.size(), 0);
+    send_to_client(fd, std::move(response));
     return;
   }
 
   // 从数据库获取该用户的所有预约记录
-  auto reservations = db_manager_->get_my_reservations(user_info.user_id);
+  auto reservations = db()->get_my_reservations(user_info.user_id);
 
   // 构建响应数据
   std::string data;
@@ -1507,10 +2714,11 @@ void EquipmentManagementServer::handle_my_reservation_query(
 
   std::vector<char> response =
       ProtocolParser::build_my_reservation_response(true, data);
-  send(fd, response.data(), response.size(), 0);
+  send_to_client(fd, std::move(response));
 }
 
-void EquipmentManagementServer::handle_connection_close(int fd) {
+void EquipmentManagementServer::handle_connection_close(Reactor &reactor,
+                                                        int fd) {
   // 先检查文件描述符是否有效
   if (fd <= 0) {
     std::cout << "无效的文件描述符: " << fd << std::endl;
@@ -1523,49 +2731,46 @@ void EquipmentManagementServer::handle_connection_close(int fd) {
     return; // 连接已经被清理，直接返回
   }
 
-  // 第二步：获取设备信息（必须在移除连接之前）
-  auto equipment = connections_manager_->get_equipment_by_fd(fd);
-  std::string equipment_id;
-  bool is_equipment_connection = false;
+  // 第二步：获取设备信息（必须在移除连接之前）。
+  // 网关连接上有多个设备；已在别的连接上重新上线的设备不算离线
+  auto equipments = connections_manager_->get_bound_equipments(fd);
+  if (equipments.empty()) {
+    std::cout << "Qt客户端连接关闭: fd=" << fd << std::endl;
+  }
 
-  if (equipment) {
-    equipment_id = equipment->get_equipment_id();
+  for (const auto &equipment : equipments) {
+    const std::string &equipment_id = equipment->get_equipment_id();
     std::cout << "设备离线: " << equipment_id << std::endl;
-    is_equipment_connection = true;
 
     // ===== 新增：立即生成离线告警并推送 =====
     std::string message = "设备离线: " + equipment_id;
-    db_manager_->insert_alarm("offline", equipment_id, "warning", message);
     send_alert_to_all_qt_clients("offline", equipment_id, "warning", message);
     // =========================================
 
     // 更新设备状态为离线
-    equipment_manager_->update_equipment_status(equipment->get_equipment_id(),
-                                                "offline");
+    equipment_manager_->update_equipment_status(equipment_id, "offline");
 
     // 更新数据库
-    if (db_manager_->is_connected()) {
-      auto eq =
-          equipment_manager_->get_equipment(equipment->get_equipment_id());
+    if (db()->is_connected()) {
+      auto eq = equipment_manager_->get_equipment(equipment_id);
       if (eq) {
-        db_manager_->update_equipment_status(equipment->get_equipment_id(),
-                                             "offline", eq->get_power_state());
-        db_manager_->log_equipment_status(equipment->get_equipment_id(),
-                                          "offline", eq->get_power_state(),
-                                          "连接关闭");
+        db()->update_equipment_status(equipment_id, "offline",
+                                      eq->get_power_state());
+        db()->log_equipment_status(equipment_id, "offline",
+                                   eq->get_power_state(), "连接关闭");
       }
     }
-  } else {
-    std::cout << "Qt客户端连接关闭: fd=" << fd << std::endl;
   }
 
   // 第三步：清理资源（必须按照正确顺序）
-  message_buffers_.erase(fd);
-  // 从epoll中移除
-  Epoll &ep = Epoll::get_instance();
-  if (ep.is_initialized()) {
-    ep.delete_epoll(fd);
-  }
+  // 消息缓冲区随连接记录一起释放，心跳定时器需要先取消
+  ConnectionManager::Connection *conn = connections_manager_->get_connection(fd);
+  if (conn && conn->heartbeat_timer) {
+    reactor.timers.cancel(conn->heartbeat_timer);
+    conn->heartbeat_timer = 0;
+  }
+  // 从所属Reactor的事件循环中移除
+  reactor.detach_connection(fd);
   // 从ConnectionManager中移除（如果存在）
   // 注意：remove_connection会自己检查连接是否存在
   connections_manager_->remove_connection(fd);
@@ -1573,26 +2778,221 @@ void EquipmentManagementServer::handle_connection_close(int fd) {
   std::cout << "连接完全清理: fd=" << fd << std::endl;
 }
 
-void EquipmentManagementServer::perform_maintenance_tasks() {
-  // 检查心跳超时
-  connections_manager_->check_heartbeat_timeout(60);
+bool EquipmentManagementServer::send_to_client(int fd,
+                                               std::vector<char> message) {
+  uint32_t request_id =
+      fd == current_request_.fd ? current_request_.request_id : 0;
+  return connections_manager_->send_message(fd, std::move(message),
+                                            request_id);
+}
+
+uint32_t EquipmentManagementServer::add_pending_request(
+    int fd, const std::string &equipment_id, const std::string &command) {
+  ConnectionManager::Connection *conn = connections_manager_->get_connection(fd);
+  if (!conn) {
+    return 0;
+  }
+  PendingRequest request;
+  request.fd = fd;
+  request.generation = conn->generation.load(std::memory_order_acquire);
+  request.request_id = fd == current_request_.fd ? current_request_.request_id
+                                                 : 0;
+  request.equipment_id = equipment_id;
+  request.command = command;
+  request.expire_ms = TimerWheel::now_ms() + PENDING_REQUEST_TIMEOUT_MS;
+
+  std::lock_guard<std::mutex> lock(pending_requests_mutex_);
+  if (pending_requests_.size() >= MAX_PENDING_REQUESTS) {
+    return 0;
+  }
+  // 0表示没有请求ID，回绕时跳过；仍被占用的ID（等待超过一轮回绕）也跳过
+  uint32_t id;
+  do {
+    id = next_pending_request_id_++;
+  } while (id == 0 || pending_requests_.count(id) > 0);
+  pending_requests_.emplace(id, std::move(request));
+  return id;
+}
 
-  // 新增：检查Qt客户端心跳超时（180秒，更宽松）
-  // 注意：Qt客户端的超时**不清理连接**，只做日志记录
-  check_qt_client_heartbeat_timeout(180);
+bool EquipmentManagementServer::take_pending_request(
+    uint32_t id, const std::string &equipment_id, PendingRequest &request) {
+  std::lock_guard<std::mutex> lock(pending_requests_mutex_);
+  auto it = pending_requests_.find(id);
+  // 发给其他设备的请求不取出，留给它自己的响应或超时处理
+  if (it == pending_requests_.end() ||
+      it->second.equipment_id != equipment_id) {
+    return false;
+  }
+  request = std::move(it->second);
+  pending_requests_.erase(it);
+  return true;
+}
+
+void EquipmentManagementServer::expire_pending_requests() {
+  uint64_t now = TimerWheel::now_ms();
+  std::vector<PendingRequest> expired;
+  {
+    std::lock_guard<std::mutex> lock(pending_requests_mutex_);
+    for (auto it = pending_requests_.begin(); it != pending_requests_.end();) {
+      if (it->second.expire_ms <= now) {
+        expired.push_back(std::move(it->second));
+        it = pending_requests_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+  for (const PendingRequest &request : expired) {
+    std::cout << "设备响应超时: " << request.equipment_id << " "
+              << request.command << " fd=" << request.fd << std::endl;
+    reply_to_request(request,
+                     message_schema::build<message_schema::ControlResponse>(
+                         ProtocolParser::CLIENT_QT_CLIENT, request.equipment_id,
+                         std::to_string(request.request_id), "fail",
+                         request.command, "设备响应超时"));
+  }
+  pending_requests_expired_.fetch_add(expired.size(),
+                                      std::memory_order_relaxed);
+}
+
+bool EquipmentManagementServer::reply_to_request(
+    const PendingRequest &request, std::vector<char> message) {
+  // 等待设备期间Qt连接可能已关闭，fd也可能已分给新连接
+  ConnectionManager::Connection *conn =
+      connections_manager_->get_connection(request.fd);
+  if (!conn || !conn->in_use.load(std::memory_order_acquire) ||
+      conn->generation.load(std::memory_order_acquire) != request.generation) {
+    return false;
+  }
+  return connections_manager_->send_message(request.fd, std::move(message),
+                                            request.request_id);
+}
+
+void EquipmentManagementServer::perform_maintenance_tasks() {
+  // 心跳超时由每个连接的定时器处理，慢消费者检查有单独的定时器
+
+  // 写合并效果：平均每次sendmsg写出的消息数
+  auto write_stats = connections_manager_->get_write_stats();
+  if (write_stats.syscalls > 0) {
+    std::cout << "出站写合并: 消息=" << write_stats.messages
+              << ", sendmsg=" << write_stats.syscalls << ", 平均每次="
+              << static_cast<double>(write_stats.messages) /
+                     write_stats.syscalls
+              << std::endl;
+  }
+  if (write_stats.zerocopy_sends > 0) {
+    std::cout << "零拷贝发送: sendmsg=" << write_stats.zerocopy_sends
+              << ", 内核退回拷贝=" << write_stats.zerocopy_copied << std::endl;
+  }
 
   // 打印当前状态
   std::cout << "=== 系统状态 ===" << std::endl;
   std::cout << "活跃连接: " << connections_manager_->get_connection_count()
             << std::endl;
+  std::cout << "拒绝连接: 超出上限="
+            << rejected_connections_full_.load(std::memory_order_relaxed)
+            << ", 单IP限速="
+            << rejected_connections_rate_.load(std::memory_order_relaxed)
+            << std::endl;
   std::cout << "注册设备: " << equipment_manager_->get_equipment_count()
             << std::endl;
+  if (uint64_t misrouted = misrouted_messages_.load(std::memory_order_relaxed)) {
+    std::cout << "端口与客户端类型不符而丢弃的消息: " << misrouted << std::endl;
+  }
+  print_priority_lane_stats();
+  print_overload_stats();
+  print_message_limiter_stats();
+  if (!config_.shm_socket_path.empty()) {
+    std::cout << "共享内存通道: 已建立="
+              << shm_channels_opened_.load(std::memory_order_relaxed)
+              << std::endl;
+  }
+  if (uint64_t frames = batch_frames_.load(std::memory_order_relaxed)) {
+    std::cout << "批量消息: 帧=" << frames << ", 子消息="
+              << batch_messages_.load(std::memory_order_relaxed) << ", 拒绝="
+              << batch_rejected_.load(std::memory_order_relaxed) << std::endl;
+  }
+  size_t pending = 0;
+  {
+    std::lock_guard<std::mutex> lock(pending_requests_mutex_);
+    pending = pending_requests_.size();
+  }
+  uint64_t expired = pending_requests_expired_.load(std::memory_order_relaxed);
+  if (pending > 0 || expired > 0) {
+    std::cout << "等待设备响应的请求: " << pending << ", 累计超时=" << expired
+              << std::endl;
+  }
+  if (config_.udp_port > 0) {
+    uint64_t batches = udp_batches_.load(std::memory_order_relaxed);
+    uint64_t accepted = udp_accepted_.load(std::memory_order_relaxed);
+    std::cout << "UDP功耗上报: 接受=" << accepted << ", 拒绝="
+              << udp_rejected_.load(std::memory_order_relaxed)
+              << ", 接收轮数=" << batches << std::endl;
+  }
 
   // 可选：打印详细连接信息
   connections_manager_->print_connections();
   std::cout << "=================" << std::endl;
 }
 
+void EquipmentManagementServer::print_priority_lane_stats() {
+  // 各Reactor的统计相加；等待时间直方图的桶: <100us <1ms <10ms <100ms <1s >=1s
+  for (int i = 0; i < PriorityLanes::LANE_COUNT; ++i) {
+    auto lane = static_cast<PriorityLanes::Lane>(i);
+    uint64_t depth = 0;
+    uint64_t max_depth = 0;
+    uint64_t processed = 0;
+    std::array<uint64_t, PriorityLanes::WAIT_BUCKETS> histogram{};
+    for (const auto &reactor : reactors_) {
+      const PriorityLanes::LaneStats &stats = reactor->lanes.stats(lane);
+      depth += stats.depth.load(std::memory_order_relaxed);
+      max_depth =
+          std::max(max_depth, stats.max_depth.load(std::memory_order_relaxed));
+      processed += stats.processed.load(std::memory_order_relaxed);
+      for (size_t b = 0; b < histogram.size(); ++b) {
+        histogram[b] += stats.wait_histogram[b].load(std::memory_order_relaxed);
+      }
+    }
+    std::cout << "消息队列[" << PriorityLanes::lane_name(lane)
+              << "]: 当前=" << depth << ", 最大=" << max_depth
+              << ", 已处理=" << processed << ", 等待分布=";
+    for (size_t b = 0; b < histogram.size(); ++b) {
+      std::cout << (b > 0 ? "/" : "") << histogram[b];
+    }
+    std::cout << std::endl;
+  }
+}
+
+void EquipmentManagementServer::print_overload_stats() {
+  std::cout << "过载控制: ";
+  for (const auto &reactor : reactors_) {
+    std::cout << "Reactor" << reactor->id << "["
+              << (reactor->overload.overloaded() ? "过载" : "正常")
+              << ", 延迟=" << reactor->overload.lag_us()
+              << "us, 过载次数=" << reactor->overload.episodes() << "] ";
+  }
+  // 合并掉的功耗上报已按保留的那条补算能耗，这里的数量用于核对总能耗
+  std::cout << "已合并功耗上报="
+            << shed_power_reports_.load(std::memory_order_relaxed)
+            << ", 已合并状态上报="
+            << shed_status_updates_.load(std::memory_order_relaxed)
+            << std::endl;
+}
+
+void EquipmentManagementServer::print_message_limiter_stats() {
+  uint64_t dropped = 0;
+  uint64_t delayed = 0;
+  uint64_t disconnected = 0;
+  for (const auto &reactor : reactors_) {
+    const auto &stats = reactor->message_limiter.stats();
+    dropped += stats.dropped.load(std::memory_order_relaxed);
+    delayed += stats.delayed.load(std::memory_order_relaxed);
+    disconnected += stats.disconnected.load(std::memory_order_relaxed);
+  }
+  std::cout << "消息限速: 丢弃=" << dropped << ", 延后=" << delayed
+            << ", 断开=" << disconnected << std::endl;
+}
+
 // 2. 添加服务器停止时的状态重置方法
 void EquipmentManagementServer::reset_all_equipment_on_shutdown() {
   std::cout << "服务器停止，重置所有设备状态..." << std::endl;
@@ -1601,12 +3001,12 @@ void EquipmentManagementServer::reset_all_equipment_on_shutdown() {
   equipment_manager_->reset_all_equipment_status();
 
   // 2. 更新数据库中所有设备状态为离线且电源关闭
-  if (db_manager_->is_connected()) {
+  if (db()->is_connected()) {
     // 获取所有设备ID
     auto all_equipments = equipment_manager_->get_all_equipments();
 
     for (const auto &equipment : all_equipments) {
-      bool success = db_manager_->update_equipment_status(
+      bool success = db()->update_equipment_status(
           equipment->get_equipment_id(), "offline", "off");
 
       if (success) {
@@ -1631,27 +3031,26 @@ void EquipmentManagementServer::handle_reservation_apply(
   std::cout << "处理预约申请: place_id=" << equipment_id
             << " payload: " << payload << std::endl;
 
-  // 解析payload格式保持不变: "user_id|start_time|end_time|purpose"
-  auto parts = ProtocolParser::split_string(payload, '|');
-  if (parts.size() < 4) {
-    std::cout << "预约申请数据格式错误" << std::endl;
+  // 解析payload: "user_id|start_time|end_time|purpose"，purpose可以包含'|'
+  using Apply = message_schema::ReservationApply;
+  message_schema::Decoded<Apply> apply;
+  if (!decode_payload(apply, payload)) {
     std::vector<char> response = ProtocolParser::build_reservation_response(
         ProtocolParser::CLIENT_QT_CLIENT, false, "数据格式错误");
-    send(fd, response.data(), response.size(), 0);
+    send_to_client(fd, std::move(response));
     return;
   }
 
-  std::string user_id_str = parts[0];
-  std::string start_time = parts[1];
-  std::string end_time = parts[2];
-  std::string purpose = parts[3];
+  std::string start_time(apply.text<Apply::START_TIME>());
+  std::string end_time(apply.text<Apply::END_TIME>());
+  std::string purpose(apply.text<Apply::PURPOSE>());
 
   // 验证用户是否存在
-  int user_id = std::stoi(user_id_str);
+  int user_id = apply.integer<Apply::USER_ID>();
   if (!validate_user_exists(user_id)) {
     std::vector<char> response = ProtocolParser::build_reservation_response(
         ProtocolParser::CLIENT_QT_CLIENT, false, "用户不存在");
-    send(fd, response.data(), response.size(), 0);
+    send_to_client(fd, std::move(response));
     return;
   }
 
@@ -1660,7 +3059,7 @@ void EquipmentManagementServer::handle_reservation_apply(
   if (!connections_manager_->get_user_info(fd, user_info)) {
     std::vector<char> response = ProtocolParser::build_reservation_response(
         ProtocolParser::CLIENT_QT_CLIENT, false, "无法获取用户信息");
-    send(fd, response.data(), response.size(), 0);
+    send_to_client(fd, std::move(response));
     return;
   }
 
@@ -1676,11 +3075,11 @@ void EquipmentManagementServer::handle_reservation_apply(
   }
 
   // 检查场所是否存在（通过是否能查出设备来判断）
-  auto equipment_ids = db_manager_->get_equipment_ids_by_place(equipment_id);
+  auto equipment_ids = db()->get_equipment_ids_by_place(equipment_id);
   if (equipment_ids.empty()) {
     std::vector<char> response = ProtocolParser::build_reservation_response(
         ProtocolParser::CLIENT_QT_CLIENT, false, "场所不存在或场所内无设备");
-    send(fd, response.data(), response.size(), 0);
+    send_to_client(fd, std::move(response));
     return;
   }
 
@@ -1688,7 +3087,7 @@ void EquipmentManagementServer::handle_reservation_apply(
   if (check_place_reservation_conflict(equipment_id, start_time, end_time)) {
     std::vector<char> response = ProtocolParser::build_reservation_response(
         ProtocolParser::CLIENT_QT_CLIENT, false, "场所时间冲突");
-    send(fd, response.data(), response.size(), 0);
+    send_to_client(fd, std::move(response));
     return;
   }
   std::cout << "DEBUG: initial_status = [" << initial_status << "]"
@@ -1697,25 +3096,25 @@ void EquipmentManagementServer::handle_reservation_apply(
   std::cout << "DEBUG: place_id = [" << equipment_id << "]" << std::endl;
   std::cout << "DEBUG: user_id = " << user_id << std::endl;
   // 【修改】调用 add_reservation 时传入初始状态
-  if (db_manager_->is_connected()) {
-    bool success = db_manager_->add_reservation(
+  if (db()->is_connected()) {
+    bool success = db()->add_reservation(
         equipment_id, user_id, purpose, start_time, end_time, initial_status);
     if (success) {
       std::vector<char> response = ProtocolParser::build_reservation_response(
           ProtocolParser::CLIENT_QT_CLIENT, true, "预约申请提交成功");
-      send(fd, response.data(), response.size(), 0);
+      send_to_client(fd, std::move(response));
       std::cout << "预约申请成功: place_id=" << equipment_id << " by user "
                 << user_id << " 角色=" << user_info.role
                 << " 状态=" << initial_status << std::endl;
     } else {
       std::vector<char> response = ProtocolParser::build_reservation_response(
           ProtocolParser::CLIENT_QT_CLIENT, false, "数据库错误");
-      send(fd, response.data(), response.size(), 0);
+      send_to_client(fd, std::move(response));
     }
   } else {
     std::vector<char> response = ProtocolParser::build_reservation_response(
         ProtocolParser::CLIENT_QT_CLIENT, false, "系统错误");
-    send(fd, response.data(), response.size(), 0);
+    send_to_client(fd, std::move(response));
   }
 }
 
@@ -1729,11 +3128,11 @@ void EquipmentManagementServer::handle_reservation_query(
   ConnectionManager::UserInfo user_info;
   connections_manager_->get_user_info(fd, user_info); // 不检查返回值，只是记录
 
-  if (!db_manager_->is_connected()) {
+  if (!db()->is_connected()) {
     std::vector<char> response =
         ProtocolParser::build_reservation_query_response(
             ProtocolParser::CLIENT_QT_CLIENT, false, "数据库连接失败");
-    send(fd, response.data(), response.size(), 0);
+    send_to_client(fd, std::move(response));
     return;
   }
 
@@ -1741,9 +3140,9 @@ void EquipmentManagementServer::handle_reservation_query(
   std::string place_id = equipment_id;
   std::vector<std::vector<std::string>> reservations;
   if (place_id == "all" || place_id.empty()) {
-    reservations = db_manager_->get_all_reservations();
+    reservations = db()->get_all_reservations();
   } else {
-    reservations = db_manager_->get_reservations_by_place(place_id);
+    reservations = db()->get_reservations_by_place(place_id);
   }
 
   // 构建响应数据
@@ -1763,7 +3162,7 @@ void EquipmentManagementServer::handle_reservation_query(
 
   std::vector<char> response = ProtocolParser::build_reservation_query_response(
       ProtocolParser::CLIENT_QT_CLIENT, true, response_data);
-  send(fd, response.data(), response.size(), 0);
+  send_to_client(fd, std::move(response));
 
   std::cout << "返回预约查询结果: " << reservations.size()
             << " 条记录 (角色=" << user_info.role << ")" << std::endl;
@@ -1775,18 +3174,19 @@ void EquipmentManagementServer::handle_reservation_approve(
   std::cout << "处理预约审批: place_id=" << place_id << " payload: " << payload
             << std::endl;
 
-  // 解析payload格式: "reservation_id|action"
-  auto parts = ProtocolParser::split_string(payload, '|');
-  if (parts.size() < 2) {
+  // 解析payload格式: "reservation_id|action"，预约ID必须是整数
+  using Approve = message_schema::ReservationApprove;
+  message_schema::Decoded<Approve> approve;
+  if (!decode_payload(approve, payload)) {
     std::vector<char> response =
         ProtocolParser::build_reservation_approve_response(
             ProtocolParser::CLIENT_QT_CLIENT, false, "数据格式错误");
-    send(fd, response.data(), response.size(), 0);
+    send_to_client(fd, std::move(response));
     return;
   }
 
-  std::string reservation_id_str = parts[0];
-  std::string action = parts[1];
+  int reservation_id = approve.integer<Approve::RESERVATION_ID>();
+  std::string_view action = approve.text<Approve::ACTION>();
 
   // 【新增】获取当前审批人信息（角色、ID）
   ConnectionManager::UserInfo approver_info;
@@ -1794,31 +3194,19 @@ void EquipmentManagementServer::handle_reservation_approve(
     std::vector<char> response =
         ProtocolParser::build_reservation_approve_response(
             ProtocolParser::CLIENT_QT_CLIENT, false, "无法获取审批人信息");
-    send(fd, response.data(), response.size(), 0);
-    return;
-  }
-
-  // 解析预约ID
-  int reservation_id;
-  try {
-    reservation_id = std::stoi(reservation_id_str);
-  } catch (const std::exception &e) {
-    std::vector<char> response =
-        ProtocolParser::build_reservation_approve_response(
-            ProtocolParser::CLIENT_QT_CLIENT, false, "预约ID格式错误");
-    send(fd, response.data(), response.size(), 0);
+    send_to_client(fd, std::move(response));
     return;
   }
 
   // 【新增】查询当前预约记录，获取其状态和申请人
   std::string query = "SELECT user_id, status FROM reservations WHERE id = " +
-                      reservation_id_str;
-  auto result = db_manager_->execute_query(query);
+                      std::to_string(reservation_id);
+  auto result = db()->execute_query(query);
   if (result.empty()) {
     std::vector<char> response =
         ProtocolParser::build_reservation_approve_response(
             ProtocolParser::CLIENT_QT_CLIENT, false, "预约记录不存在");
-    send(fd, response.data(), response.size(), 0);
+    send_to_client(fd, std::move(response));
     return;
   }
   int applicant_id = std::stoi(result[0][0]);
@@ -1840,8 +3228,7 @@ void EquipmentManagementServer::handle_reservation_approve(
   } else if (approver_info.role == "teacher") {
     // 老师只能审批 pending_teacher 状态，且必须是自己学生的申请
     if (current_status == "pending_teacher") {
-      if (db_manager_->is_teacher_of_student(approver_info.user_id,
-                                             applicant_id)) {
+      if (db()->is_teacher_of_student(approver_info.user_id, applicant_id)) {
         allowed = true;
         target_status = (action == "approve") ? "pending_admin" : "rejected";
       } else {
@@ -1860,30 +3247,30 @@ void EquipmentManagementServer::handle_reservation_approve(
     std::vector<char> response =
         ProtocolParser::build_reservation_approve_response(
             ProtocolParser::CLIENT_QT_CLIENT, false, "权限不足或状态不可审批");
-    send(fd, response.data(), response.size(), 0);
+    send_to_client(fd, std::move(response));
     return;
   }
 
   // 验证场所存在性
-  auto equipment_ids = db_manager_->get_equipment_ids_by_place(place_id);
+  auto equipment_ids = db()->get_equipment_ids_by_place(place_id);
   if (equipment_ids.empty()) {
     std::vector<char> response =
         ProtocolParser::build_reservation_approve_response(
             ProtocolParser::CLIENT_QT_CLIENT, false,
             "场所不存在或场所内无设备");
-    send(fd, response.data(), response.size(), 0);
+    send_to_client(fd, std::move(response));
     return;
   }
 
   // 更新数据库预约状态
-  if (db_manager_->is_connected()) {
-    bool success = db_manager_->update_reservation_status(
+  if (db()->is_connected()) {
+    bool success = db()->update_reservation_status(
         reservation_id, target_status, place_id);
     if (!success) {
       std::vector<char> response =
           ProtocolParser::build_reservation_approve_response(
               ProtocolParser::CLIENT_QT_CLIENT, false, "数据库错误");
-      send(fd, response.data(), response.size(), 0);
+      send_to_client(fd, std::move(response));
       return;
     }
 
@@ -1896,10 +3283,10 @@ void EquipmentManagementServer::handle_reservation_approve(
         auto equipment = equipment_manager_->get_equipment(eq_id);
         if (equipment) {
           equipment_manager_->update_equipment_status(eq_id, "reserved");
-          if (db_manager_->is_connected()) {
-            db_manager_->log_equipment_status(eq_id, "reserved",
-                                              equipment->get_power_state(),
-                                              "预约审批通过，场所预留");
+          if (db()->is_connected()) {
+            db()->log_equipment_status(eq_id, "reserved",
+                                       equipment->get_power_state(),
+                                       "预约审批通过，场所预留");
           }
           std::cout << "设备状态更新为reserved: " << eq_id << std::endl;
         } else {
@@ -1913,7 +3300,7 @@ void EquipmentManagementServer::handle_reservation_approve(
     std::vector<char> response =
         ProtocolParser::build_reservation_approve_response(
             ProtocolParser::CLIENT_QT_CLIENT, true, "审批操作成功");
-    send(fd, response.data(), response.size(), 0);
+    send_to_client(fd, std::move(response));
     std::cout << "预约审批成功: reservation " << reservation_id << " -> "
               << target_status << " (place_id: " << place_id << ")"
               << std::endl;
@@ -1922,7 +3309,7 @@ void EquipmentManagementServer::handle_reservation_approve(
     std::vector<char> response =
         ProtocolParser::build_reservation_approve_response(
             ProtocolParser::CLIENT_QT_CLIENT, false, "系统错误");
-    send(fd, response.data(), response.size(), 0);
+    send_to_client(fd, std::move(response));
   }
 }
 
@@ -1942,9 +3329,9 @@ bool EquipmentManagementServer::validate_admin_permission(
 bool EquipmentManagementServer::check_place_reservation_conflict(
     const std::string &equipment_id, const std::string &start_time,
     const std::string &end_time) {
-  if (db_manager_->is_connected()) {
-    return db_manager_->check_place_reservation_conflict(equipment_id,
-                                                         start_time, end_time);
+  if (db()->is_connected()) {
+    return db()->check_place_reservation_conflict(equipment_id, start_time,
+                                                  end_time);
   }
   return false; // 数据库不可用时默认无冲突
 }
@@ -1969,27 +3356,6 @@ bool EquipmentManagementServer::send_batch_control_command(
       parameters);
 }
 
-bool EquipmentManagementServer::send_control_command_response_to_qt_client(
-    int qt_fd, const std::string &equipment_id, bool success,
-    const std::string &payload) {
-  // 发送控制指令响应
-  std::cout << payload << std::endl;
-  std::vector<char> response = ProtocolParser::build_control_response(
-      ProtocolParser::CLIENT_QT_CLIENT, equipment_id, success, payload);
-
-  ssize_t bytes_sent = send(qt_fd, response.data(), response.size(), 0);
-
-  if (bytes_sent > 0) {
-    std::cout << "to qt_client控制响应处理: " << equipment_id << " fd=" << qt_fd
-              << " (响应已发送)" << std::endl;
-    return true;
-  } else {
-    std::cout << "to qt_client控制响应处理: " << equipment_id << " fd=" << qt_fd
-              << " (响应发送失败)" << std::endl;
-    return false;
-  }
-}
-
 std::vector<std::string>
 EquipmentManagementServer::get_equipment_control_capabilities(
     const std::string &equipment_id) {
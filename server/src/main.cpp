@@ -3,9 +3,9 @@
 #include <system_error>
 #include <unistd.h>
 int main() {
-  //初始化Server
+  //初始化Server（端口、Reactor数量等可通过环境变量配置）
   EquipmentManagementServer server{};
-  if (!server.init(9000)) {
+  if (!server.init(ServerConfig::from_env())) {
     std::error_code ec(errno, std::system_category());
     std::cerr << "server init failed..." << ec.message() << std::endl;
     return -1;
@@ -0,0 +1,156 @@
+#include "message_rate_limiter.h"
+
+#include <algorithm>
+#include <iterator>
+
+bool MessageRateLimiter::parse_action(const std::string &name,
+                                      Action &action) {
+  if (name == "drop") {
+    action = ACTION_DROP;
+  } else if (name == "delay") {
+    action = ACTION_DELAY;
+  } else if (name == "disconnect") {
+    action = ACTION_DISCONNECT;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+void MessageRateLimiter::configure(ProtocolParser::ClientType type,
+                                   double rate_per_second, double burst,
+                                   Action action) {
+  if (static_cast<size_t>(type) >= POLICY_COUNT) {
+    return;
+  }
+  Policy &policy = policies_[type];
+  policy.rate_per_ms = rate_per_second > 0 ? rate_per_second / 1000.0 : 0;
+  policy.burst = std::max(burst, 1.0);
+  policy.action = action;
+}
+
+const MessageRateLimiter::Policy *
+MessageRateLimiter::policy_for(ProtocolParser::ClientType type) const {
+  if (static_cast<size_t>(type) >= POLICY_COUNT ||
+      policies_[type].rate_per_ms <= 0) {
+    return nullptr;
+  }
+  return &policies_[type];
+}
+
+bool MessageRateLimiter::enabled(ProtocolParser::ClientType type) const {
+  return policy_for(type) != nullptr;
+}
+
+void MessageRateLimiter::share_equipment_buckets(
+    const MessageRateLimiter &other) {
+  equipment_buckets_ = other.equipment_buckets_;
+}
+
+void MessageRateLimiter::refill(Bucket &bucket, const Policy &policy,
+                                uint64_t now_ms) {
+  if (now_ms > bucket.last_ms) {
+    bucket.tokens =
+        std::min(policy.burst,
+                 bucket.tokens + (now_ms - bucket.last_ms) * policy.rate_per_ms);
+  }
+  bucket.last_ms = now_ms;
+}
+
+MessageRateLimiter::Result
+MessageRateLimiter::check(ProtocolParser::ClientType type, int fd,
+                          uint32_t generation, const std::string &equipment_id,
+                          uint64_t now_ms) {
+  const Policy *policy = policy_for(type);
+  if (!policy) {
+    return {ALLOW, 0};
+  }
+
+  // 连接桶；fd已被新连接复用时重新开始
+  auto [conn_it, conn_inserted] = connection_buckets_.try_emplace(fd);
+  Bucket &conn_bucket = conn_it->second;
+  if (conn_inserted || conn_bucket.generation != generation ||
+      conn_bucket.type != type) {
+    conn_bucket.tokens = policy->burst;
+    conn_bucket.last_ms = now_ms;
+    conn_bucket.generation = generation;
+    conn_bucket.type = type;
+  }
+  refill(conn_bucket, *policy, now_ms);
+
+  // 设备另按equipment_id限速，桶表各Reactor共用，判断和扣除期间持有分片锁
+  Bucket *equipment_bucket = nullptr;
+  std::unique_lock<std::mutex> shard_lock;
+  if (type == ProtocolParser::CLIENT_EQUIPMENT && !equipment_id.empty()) {
+    EquipmentShard &shard =
+        (*equipment_buckets_)[std::hash<std::string>{}(equipment_id) %
+                              EQUIPMENT_SHARDS];
+    shard_lock = std::unique_lock<std::mutex>(shard.mutex);
+    auto [it, inserted] = shard.buckets.try_emplace(equipment_id);
+    equipment_bucket = &it->second;
+    if (inserted) {
+      equipment_bucket->tokens = policy->burst;
+      equipment_bucket->last_ms = now_ms;
+      equipment_bucket->type = type;
+    }
+    refill(*equipment_bucket, *policy, now_ms);
+  }
+
+  double tokens = conn_bucket.tokens;
+  if (equipment_bucket) {
+    tokens = std::min(tokens, equipment_bucket->tokens);
+  }
+
+  Result result{ALLOW, 0};
+  if (tokens < 1.0) {
+    switch (policy->action) {
+    case ACTION_DELAY: {
+      // 透支令牌，等到补足一个令牌时再处理
+      auto wait = static_cast<uint64_t>((1.0 - tokens) / policy->rate_per_ms);
+      if (wait > MAX_DELAY_MS) {
+        stats_.dropped.fetch_add(1, std::memory_order_relaxed);
+        return {DROP, 0};
+      }
+      stats_.delayed.fetch_add(1, std::memory_order_relaxed);
+      result = {DELAY, std::max<uint64_t>(wait, 1)};
+      break;
+    }
+    case ACTION_DISCONNECT:
+      stats_.disconnected.fetch_add(1, std::memory_order_relaxed);
+      connection_buckets_.erase(conn_it);
+      return {DISCONNECT, 0};
+    case ACTION_DROP:
+    default:
+      stats_.dropped.fetch_add(1, std::memory_order_relaxed);
+      return {DROP, 0};
+    }
+  }
+
+  conn_bucket.tokens -= 1.0;
+  if (equipment_bucket) {
+    equipment_bucket->tokens -= 1.0;
+  }
+  return result;
+}
+
+void MessageRateLimiter::prune(uint64_t now_ms) {
+  auto full = [this, now_ms](const Bucket &bucket) {
+    const Policy *policy = policy_for(bucket.type);
+    if (!policy) {
+      return true;
+    }
+    double refill = now_ms > bucket.last_ms
+                        ? (now_ms - bucket.last_ms) * policy->rate_per_ms
+                        : 0;
+    return bucket.tokens + refill >= policy->burst;
+  };
+  for (auto it = connection_buckets_.begin(); it != connection_buckets_.end();) {
+    it = full(it->second) ? connection_buckets_.erase(it) : std::next(it);
+  }
+  for (EquipmentShard &shard : *equipment_buckets_) {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    for (auto it = shard.buckets.begin(); it != shard.buckets.end();) {
+      it = full(it->second) ? shard.buckets.erase(it) : std::next(it);
+    }
+  }
+}
@@ -0,0 +1,35 @@
+#include "overload_controller.h"
+
+void OverloadController::configure(uint64_t lag_us, size_t queue_depth) {
+  lag_threshold_us_ = lag_us;
+  depth_threshold_ = queue_depth;
+}
+
+void OverloadController::record_iteration(uint64_t busy_us) {
+  // 指数平均（1/8），单轮偶发的慢操作不会立即触发过载
+  uint64_t lag = lag_us_.load(std::memory_order_relaxed);
+  lag = lag - lag / 8 + busy_us / 8;
+  lag_us_.store(lag, std::memory_order_relaxed);
+}
+
+bool OverloadController::evaluate(size_t queue_depth) {
+  uint64_t lag = lag_us_.load(std::memory_order_relaxed);
+  bool lag_high = lag_threshold_us_ > 0 && lag >= lag_threshold_us_;
+  bool depth_high = depth_threshold_ > 0 && queue_depth >= depth_threshold_;
+  bool overloaded = overloaded_.load(std::memory_order_relaxed);
+
+  if (!overloaded && (lag_high || depth_high)) {
+    overloaded_.store(true, std::memory_order_relaxed);
+    episodes_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  }
+  if (overloaded) {
+    bool lag_low = lag_threshold_us_ == 0 || lag <= lag_threshold_us_ / 2;
+    bool depth_low = depth_threshold_ == 0 || queue_depth <= depth_threshold_ / 2;
+    if (lag_low && depth_low) {
+      overloaded_.store(false, std::memory_order_relaxed);
+      return false;
+    }
+  }
+  return overloaded;
+}
@@ -0,0 +1,143 @@
+#include "priority_lanes.h"
+
+#include <chrono>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+PriorityLanes::Lane PriorityLanes::classify(ProtocolParser::MessageType type) {
+  switch (type) {
+  // 控制链路和用户操作：有人在等结果
+  case ProtocolParser::CONTROL_RESPONSE:
+  case ProtocolParser::QT_CONTROL_REQUEST:
+  case ProtocolParser::QT_MY_CONTROL_REQUEST:
+  case ProtocolParser::QT_CLIENT_LOGIN:
+  case ProtocolParser::QT_STATUS_QUERY:
+  case ProtocolParser::QT_EQUIPMENT_LIST_QUERY:
+  case ProtocolParser::QT_PLACE_LIST_QUERY:
+  case ProtocolParser::QT_ENERGY_QUERY:
+  case ProtocolParser::QT_ALERT_ACK:
+  case ProtocolParser::QT_ALARM_QUERY:
+  case ProtocolParser::QT_SET_THRESHOLD:
+  case ProtocolParser::QT_GET_ALL_THRESHOLDS:
+  case ProtocolParser::QT_MY_CONTROL_QUERY:
+  case ProtocolParser::MY_RESERVATION_QUERY:
+  case ProtocolParser::RESERVATION_APPLY:
+  case ProtocolParser::RESERVATION_QUERY:
+  case ProtocolParser::RESERVATION_APPROVE:
+  // 心跳只刷新内存中的时间戳，不写库，不能排在写库的遥测后面受每轮上限限制，
+  // 否则积压时会被误判为离线
+  case ProtocolParser::HEARTBEAT:
+  case ProtocolParser::QT_HEARTBEAT:
+    return LANE_INTERACTIVE;
+  // 周期性遥测
+  case ProtocolParser::POWER_REPORT:
+  case ProtocolParser::BATCH:
+    return LANE_BULK;
+  default:
+    return LANE_NORMAL;
+  }
+}
+
+uint64_t PriorityLanes::now_us() {
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now().time_since_epoch())
+          .count());
+}
+
+const char *PriorityLanes::lane_name(Lane lane) {
+  switch (lane) {
+  case LANE_INTERACTIVE:
+    return "交互";
+  case LANE_NORMAL:
+    return "普通";
+  case LANE_BULK:
+    return "批量";
+  }
+  return "未知";
+}
+
+void PriorityLanes::push(Lane lane, Item item) {
+  queues_[lane].push_back(std::move(item));
+  LaneStats &stats = stats_[lane];
+  uint64_t depth = queues_[lane].size();
+  stats.depth.store(depth, std::memory_order_relaxed);
+  if (depth > stats.max_depth.load(std::memory_order_relaxed)) {
+    stats.max_depth.store(depth, std::memory_order_relaxed);
+  }
+}
+
+bool PriorityLanes::empty() const {
+  for (const auto &queue : queues_) {
+    if (!queue.empty()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+size_t PriorityLanes::coalesce(Lane lane, ProtocolParser::MessageType type) {
+  std::deque<Item> &queue = queues_[lane];
+  // 从后往前扫描，第一次遇到的是该设备最新的一条
+  std::unordered_map<std::string, Item *> latest;
+  size_t shed = 0;
+  for (auto it = queue.rbegin(); it != queue.rend(); ++it) {
+    if (it->message.type != type) {
+      continue;
+    }
+    auto [pos, inserted] = latest.emplace(it->message.equipment_id, &*it);
+    if (!inserted) {
+      pos->second->coalesced += it->coalesced + 1;
+      it->fd = -1; // 标记删除
+      shed++;
+    }
+  }
+  if (shed > 0) {
+    // 只删除被合并的条目，其余消息保持原有顺序
+    std::deque<Item> kept;
+    for (Item &item : queue) {
+      if (item.fd >= 0) {
+        kept.push_back(std::move(item));
+      }
+    }
+    queue.swap(kept);
+    stats_[lane].depth.store(queue.size(), std::memory_order_relaxed);
+  }
+  return shed;
+}
+
+size_t PriorityLanes::drain(const Handler &handler) {
+  size_t total = 0;
+  for (int i = 0; i < LANE_COUNT; ++i) {
+    Lane lane = static_cast<Lane>(i);
+    std::deque<Item> &queue = queues_[lane];
+    size_t processed = 0;
+    while (!queue.empty()) {
+      uint64_t now = now_us();
+      uint64_t wait = now - queue.front().enqueue_us;
+      if (lane != LANE_INTERACTIVE && processed >= LANE_BATCH_LIMIT &&
+          wait < MAX_WAIT_US) {
+        break; // 剩余的留到下一轮
+      }
+      Item item = std::move(queue.front());
+      queue.pop_front();
+      record_wait(lane, wait);
+      handler(item);
+      processed++;
+    }
+    stats_[lane].depth.store(queue.size(), std::memory_order_relaxed);
+    stats_[lane].processed.fetch_add(processed, std::memory_order_relaxed);
+    total += processed;
+  }
+  return total;
+}
+
+void PriorityLanes::record_wait(Lane lane, uint64_t wait_us) {
+  size_t bucket = 0;
+  while (bucket < WAIT_BUCKET_LIMITS_US.size() &&
+         wait_us >= WAIT_BUCKET_LIMITS_US[bucket]) {
+    bucket++;
+  }
+  stats_[lane].wait_histogram[bucket].fetch_add(1, std::memory_order_relaxed);
+}
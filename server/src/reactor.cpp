@@ -0,0 +1,117 @@
+#include "reactor.h"
+
+#include <poll.h>
+#include <sys/epoll.h>
+
+thread_local Reactor *Reactor::current = nullptr;
+
+int Reactor::next_timeout_ms(int max_ms) const {
+  int timeout = timers.next_timeout_ms(TimerWheel::now_ms());
+  return (timeout < 0 || timeout > max_ms) ? max_ms : timeout;
+}
+
+bool Reactor::watch_task_queue() {
+  if (!tasks.initialize()) {
+    return false;
+  }
+  if (!uring) {
+    return epoll.add_epoll(tasks.event_fd(), EPOLLIN, &tasks);
+  }
+  return uring->submit_poll(
+      tasks.event_fd(), POLLIN,
+      encode_user_data(URING_OP_TASK, 0, tasks.event_fd()));
+}
+
+void Reactor::run_posted_tasks() {
+  tasks.run_pending();
+  if (uring) {
+    // poll请求是一次性的
+    uring->submit_poll(tasks.event_fd(), POLLIN,
+                       encode_user_data(URING_OP_TASK, 0, tasks.event_fd()));
+  }
+}
+
+bool Reactor::attach_connection(int fd) {
+  ConnectionManager::Connection *conn = connections->get_connection(fd);
+  if (!conn) {
+    return false;
+  }
+  if (!uring) {
+    // ET模式，连接此后固定由该Reactor处理
+    return epoll.add_epoll(fd, ConnectionManager::CONNECTION_EVENTS, conn);
+  }
+  if (conn->shm_channel) {
+    // eventfd不能recv，等可读后从共享内存读取
+    return uring->submit_poll(
+        fd, POLLIN, encode_user_data(URING_OP_SHM, conn->generation.load(), fd));
+  }
+  return uring->submit_multishot_recv(
+      fd, encode_user_data(URING_OP_RECV, conn->generation.load(), fd));
+}
+
+void Reactor::detach_connection(int fd) {
+  if (!uring) {
+    if (epoll.is_initialized()) {
+      epoll.delete_epoll(fd);
+    }
+    return;
+  }
+
+  // 未完成的recv/poll请求持有socket引用，必须在close之前取消
+  uring->submit_cancel_fd(fd, encode_user_data(URING_OP_CANCEL, 0, fd));
+  uring->flush_submissions();
+}
+
+bool Reactor::set_write_interest(int fd, bool enable) {
+  ConnectionManager::Connection *conn = connections->get_connection(fd);
+  if (!conn) {
+    return false;
+  }
+  // 共享内存通道的eventfd总是可写；对端读出数据后会写eventfd，
+  // 由可读事件负责继续发送
+  if (conn->shm_channel) {
+    return true;
+  }
+  if (!uring) {
+    uint32_t events = ConnectionManager::CONNECTION_EVENTS;
+    if (enable) {
+      events |= EPOLLOUT;
+    }
+    return epoll.modify_epoll(fd, events, conn);
+  }
+
+  // io_uring的poll请求完成后自动失效，关闭时无需操作
+  if (!enable) {
+    return true;
+  }
+  // 可能由其他线程调用，提交后立即flush，避免等到下一次wait
+  return uring->submit_poll(fd, POLLOUT,
+                            encode_user_data(URING_OP_POLLOUT,
+                                             conn->generation.load(), fd)) &&
+         uring->flush_submissions();
+}
+
+bool Reactor::is_current_connection(uint64_t user_data) const {
+  ConnectionManager::Connection *conn =
+      connections->get_connection(user_data_fd(user_data));
+  return conn &&
+         (conn->generation.load() & 0xFFFFFF) == user_data_generation(user_data);
+}
+
+uint64_t Reactor::encode_user_data(UringOp op, uint32_t generation, int fd) {
+  return (static_cast<uint64_t>(op) << 56) |
+         (static_cast<uint64_t>(generation & 0xFFFFFF) << 32) |
+         static_cast<uint32_t>(fd);
+}
+
+Reactor::UringOp Reactor::user_data_op(uint64_t user_data) {
+  return static_cast<UringOp>(user_data >> 56);
+}
+
+uint32_t Reactor::user_data_generation(uint64_t user_data) {
+  return static_cast<uint32_t>(user_data >> 32) & 0xFFFFFF;
+}
+
+int Reactor::user_data_fd(uint64_t user_data) {
+  return static_cast<int>(user_data & 0xFFFFFFFF);
+}
@@ -0,0 +1,102 @@
+#include "server_config.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+namespace {
+// 读取整型环境变量，不存在或格式错误时保持默认值
+void read_env_int(const char *name, int &value) {
+  const char *raw = std::getenv(name);
+  if (raw == nullptr || *raw == '\0') {
+    return;
+  }
+  try {
+    value = std::stoi(raw);
+  } catch (const std::exception &e) {
+    std::cerr << "环境变量 " << name << " 格式错误: " << raw << std::endl;
+  }
+}
+
+// 读取字节数类环境变量
+void read_env_size(const char *name, size_t &value) {
+  const char *raw = std::getenv(name);
+  if (raw == nullptr || *raw == '\0') {
+    return;
+  }
+  try {
+    value = static_cast<size_t>(std::stoull(raw));
+  } catch (const std::exception &e) {
+    std::cerr << "环境变量 " << name << " 格式错误: " << raw << std::endl;
+  }
+}
+
+void read_env_double(const char *name, double &value) {
+  const char *raw = std::getenv(name);
+  if (raw == nullptr || *raw == '\0') {
+    return;
+  }
+  try {
+    value = std::stod(raw);
+  } catch (const std::exception &e) {
+    std::cerr << "环境变量 " << name << " 格式错误: " << raw << std::endl;
+  }
+}
+
+void read_env_string(const char *name, std::string &value) {
+  const char *raw = std::getenv(name);
+  if (raw != nullptr && *raw != '\0') {
+    value = raw;
+  }
+}
+} // namespace
+
+ServerConfig ServerConfig::from_env() {
+  ServerConfig config{};
+  read_env_int("EMS_PORT", config.server_port);
+  read_env_int("EMS_REACTORS", config.reactor_count);
+  read_env_string("EMS_IO_BACKEND", config.io_backend);
+  read_env_int("EMS_QT_PORT", config.qt_port);
+  read_env_int("EMS_QT_REACTORS", config.qt_reactor_count);
+  read_env_string("EMS_UNIX_SOCKET", config.unix_socket_path);
+  read_env_int("EMS_UDP_PORT", config.udp_port);
+  read_env_string("EMS_SHM_SOCKET", config.shm_socket_path);
+  read_env_size("EMS_SHM_RING_BYTES", config.shm_ring_bytes);
+  read_env_size("EMS_OUTPUT_LOW_WATERMARK", config.output_low_watermark);
+  read_env_size("EMS_OUTPUT_HIGH_WATERMARK", config.output_high_watermark);
+  read_env_size("EMS_OUTPUT_MAX_BYTES", config.output_max_pending_bytes);
+  read_env_int("EMS_SLOW_CONSUMER_TIMEOUT",
+               config.slow_consumer_timeout_seconds);
+  read_env_size("EMS_ZEROCOPY_THRESHOLD", config.zerocopy_threshold);
+  read_env_size("EMS_READ_BUDGET_BYTES", config.read_budget_bytes);
+  read_env_size("EMS_READ_BUDGET_MESSAGES", config.read_budget_messages);
+  // 预算为0会让连接永远得不到处理
+  if (config.read_budget_bytes == 0) {
+    config.read_budget_bytes = 1;
+  }
+  if (config.read_budget_messages == 0) {
+    config.read_budget_messages = 1;
+  }
+  read_env_int("EMS_MAX_OPEN_FILES", config.max_open_files);
+  read_env_int("EMS_EPOLL_MAX_EVENTS", config.epoll_max_events);
+  read_env_int("EMS_MAX_CONNECTIONS", config.max_connections);
+  read_env_int("EMS_LISTEN_BACKLOG", config.listen_backlog);
+  read_env_int("EMS_ACCEPT_BATCH", config.accept_batch);
+  read_env_int("EMS_ACCEPT_RATE_PER_IP", config.accept_rate_per_ip);
+  read_env_int("EMS_ACCEPT_BURST_PER_IP", config.accept_burst_per_ip);
+  read_env_int("EMS_OVERLOAD_LAG_MS", config.overload_lag_ms);
+  read_env_size("EMS_OVERLOAD_QUEUE_DEPTH", config.overload_queue_depth);
+  read_env_double("EMS_MSG_RATE_EQUIPMENT", config.equipment_msg_rate);
+  read_env_double("EMS_MSG_BURST_EQUIPMENT", config.equipment_msg_burst);
+  read_env_string("EMS_MSG_ACTION_EQUIPMENT", config.equipment_msg_action);
+  read_env_double("EMS_MSG_RATE_QT", config.qt_msg_rate);
+  read_env_double("EMS_MSG_BURST_QT", config.qt_msg_burst);
+  read_env_string("EMS_MSG_ACTION_QT", config.qt_msg_action);
+  if (config.overload_lag_ms < 0) {
+    config.overload_lag_ms = 0;
+  }
+  if (config.accept_batch <= 0) {
+    config.accept_batch = 1;
+  }
+  return config;
+}
@@ -1,13 +1,12 @@
 #pragma once
-#include <mutex>
 #include <sys/epoll.h>
+#include <vector>
+// 每个事件循环（Reactor）持有自己的Epoll实例，不再是进程级单例
+// epoll_ctl 本身是线程安全的，因此这里不再加锁
 class Epoll {
 public:
-  //单例访问方法
-  static Epoll &get_instance() {
-    static Epoll instance{};
-    return instance;
-  }
+  explicit Epoll(int max_events = DEFAULT_MAX_EVENTS);
+  ~Epoll();
   //删除拷贝构造函数和赋值操作符
   Epoll(const Epoll &) = delete;
   Epoll &operator=(const Epoll &) = delete;
@@ -16,17 +15,28 @@ public:
   bool add_epoll(int fd, uint32_t event);
   bool delete_epoll(int fd);
   bool modify_epoll(int fd, uint32_t event);
+  // data.ptr版本：事件直接携带调用方的对象指针，省去按fd查找
+  bool add_epoll(int fd, uint32_t event, void *ptr);
+  bool modify_epoll(int fd, uint32_t event, void *ptr);
+  // 调用方提供事件数组（长度不小于get_epoll_max_events()）
   int wait_events(struct epoll_event *evs, int timeout);
+  // 使用内部事件数组等待，结果通过events()取得。数组从INITIAL_EVENTS开始，
+  // 返回满批时翻倍，直到max_events，高负载时一次取更多事件
+  int wait(int timeout);
+  struct epoll_event *events() { return events_.data(); }
+  void set_max_events(int max_events);
   //获取内部状态
   int get_epoll_fd() const { return epfd_; }
   bool is_initialized() const { return (epfd_ != -1); }
   int get_epoll_max_events() const { return max_events_; };
 
+  static constexpr int DEFAULT_MAX_EVENTS = 64;
+  static constexpr int INITIAL_EVENTS = 64;
+
 private:
-  Epoll() = default;
-  ~Epoll();
-  int max_events_ = 64;
+  int wait_events_into(struct epoll_event *evs, int count, int timeout);
+
+  int max_events_;
   int epfd_ = -1;
-  int server_fd_{};
-  mutable std::mutex epoll_mutex_;
-};
\ No newline at end of file
+  std::vector<struct epoll_event> events_;
+};
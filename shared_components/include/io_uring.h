@@ -0,0 +1,114 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// io_uring的最小封装（直接使用系统调用，不依赖liburing）。
+// 提供：multishot accept、基于provided buffer ring的multishot recv、
+// send、一次性poll，以及完成队列的批量收割。
+//
+// 线程模型：提交接口（submit_*、flush_submissions）可以在任意线程调用，
+// 内部用互斥锁保护提交队列；wait_completions和buffer相关接口
+// 只能由拥有该实例的事件循环线程调用。
+//
+// 编译时未定义EMS_HAVE_IO_URING（或内核不支持）时，initialize返回false，
+// 调用方应回退到Epoll。
+class IoUring {
+public:
+  // 一条完成事件
+  struct Completion {
+    uint64_t user_data;
+    int32_t res;
+    uint32_t flags;
+
+    // 该请求还会继续产生完成事件（multishot）
+    bool has_more() const;
+    // recv是否使用了provided buffer，以及对应的buffer id
+    bool has_buffer() const;
+    uint16_t buffer_id() const;
+  };
+
+  IoUring() = default;
+  ~IoUring();
+
+  IoUring(const IoUring &) = delete;
+  IoUring &operator=(const IoUring &) = delete;
+
+  // 当前构建和内核是否支持所需的io_uring特性
+  static bool is_supported();
+
+  // 创建ring，entries为提交队列深度
+  bool initialize(unsigned entries = 1024);
+  bool is_initialized() const { return ring_fd_ >= 0; }
+
+  // 注册provided buffer ring：count个大小为size的接收缓冲区，
+  // multishot recv由内核从中挑选缓冲区填充数据。
+  // buffer ring不可用时回退到IORING_OP_PROVIDE_BUFFERS
+  bool setup_buffer_ring(unsigned count, unsigned size);
+  const char *buffer_data(uint16_t buffer_id) const;
+  // 用完的缓冲区归还给内核
+  void recycle_buffer(uint16_t buffer_id);
+
+  // 以下提交接口只把请求写入提交队列，真正提交发生在
+  // flush_submissions或wait_completions中
+  bool submit_multishot_accept(int listen_fd, uint64_t user_data);
+  bool submit_multishot_recv(int fd, uint64_t user_data);
+  bool submit_send(int fd, const void *data, size_t len, uint64_t user_data);
+  bool submit_poll(int fd, uint32_t poll_mask, uint64_t user_data);
+  // 取消fd上所有未完成的请求（连接关闭前调用）
+  bool submit_cancel_fd(int fd, uint64_t user_data);
+
+  // 立即提交已排队的请求（非事件循环线程提交后需要调用）
+  bool flush_submissions();
+
+  // 提交排队请求并等待至少一个完成事件，最多收割max条。
+  // 超时返回0，出错返回-1
+  int wait_completions(Completion *out, int max, int timeout_ms);
+
+  // 内部请求（归还缓冲区、探测）的user_data，调用方不应使用
+  static constexpr uint64_t INTERNAL_USER_DATA = ~0ULL;
+
+private:
+  bool register_buffer_ring();
+  bool probe_buffer_select();
+  // 获取一个空闲的SQE（需持有sq_mutex_），队列满时先提交再重试
+  void *get_sqe_locked();
+  int enter(unsigned to_submit, unsigned min_complete, unsigned flags,
+            const void *arg, size_t arg_size);
+  int publish_locked();
+  int reap(Completion *out, int max);
+
+  int ring_fd_ = -1;
+
+  // 映射的ring内存
+  void *sq_ring_ = nullptr;
+  size_t sq_ring_size_ = 0;
+  void *cq_ring_ = nullptr;
+  size_t cq_ring_size_ = 0;
+  void *sqes_ = nullptr;
+  size_t sqes_size_ = 0;
+
+  // 提交队列
+  unsigned *sq_head_ = nullptr;
+  unsigned *sq_tail_ = nullptr;
+  unsigned *sq_array_ = nullptr;
+  unsigned sq_mask_ = 0;
+  unsigned sq_entries_ = 0;
+  unsigned sqe_tail_ = 0; // 本地已填写但未发布的队尾
+  std::mutex sq_mutex_;
+
+  // 完成队列
+  unsigned *cq_head_ = nullptr;
+  unsigned *cq_tail_ = nullptr;
+  unsigned cq_mask_ = 0;
+  void *cqes_ = nullptr;
+
+  // provided buffer ring
+  void *buf_ring_ = nullptr;
+  size_t buf_ring_size_ = 0;
+  unsigned buf_count_ = 0;
+  unsigned buf_size_ = 0;
+  std::vector<char> buf_storage_;
+  bool buffers_provided_ = false; // 使用PROVIDE_BUFFERS而不是buffer ring
+};
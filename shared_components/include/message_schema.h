@@ -0,0 +1,496 @@
+#pragma once
+#include "protocol_parser.h"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <array>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// 消息字段表：每种消息payload的字段顺序和类型只在这里声明一次。
+// 由字段表得到：
+//   build / build_into  直接把v1消息写进输出缓冲区，参数个数和类型在编译期检查
+//   Decoded<Schema>     带类型的解码结果，按字段枚举直接取值
+// 格式错误的消息统一在Decoded::decode中拒绝，处理器不再自己切分payload。
+namespace message_schema {
+
+enum FieldType : uint8_t {
+  TEXT, // 文本，v1中不能包含'|'
+  INT,  // 十进制整数（int范围）
+  REST  // 只能是最后一个字段：payload剩余的全部内容，可以包含'|'
+};
+
+struct Field {
+  const char *name;
+  FieldType type;
+  bool optional = false; // 只能出现在末尾，打包时为空则不写出
+};
+
+constexpr bool OPTIONAL = true;
+
+// REST只能是最后一个字段，可选字段之后不能再有必需字段
+template <size_t N>
+constexpr bool valid_layout(const std::array<Field, N> &fields) {
+  for (size_t i = 0; i < N; ++i) {
+    if (fields[i].type == REST && i + 1 != N) {
+      return false;
+    }
+    if (i > 0 && fields[i - 1].optional && !fields[i].optional) {
+      return false;
+    }
+  }
+  return true;
+}
+
+template <size_t N>
+constexpr size_t required_count(const std::array<Field, N> &fields) {
+  size_t count = 0;
+  while (count < N && !fields[count].optional) {
+    ++count;
+  }
+  return count;
+}
+
+enum DecodeStatus {
+  DECODE_OK = 0,
+  DECODE_MISSING_FIELD = 1, // 必需字段缺失
+  DECODE_EXTRA_FIELD = 2,   // 字段比字段表声明的多
+  DECODE_BAD_INT = 3        // 整数字段不是十进制整数
+};
+
+// ============ 带类型的解码 ============
+// 字段值是指向payload（或v2视图）的string_view，payload必须比解码结果活得久
+template <typename Schema> class Decoded {
+public:
+  static constexpr size_t FIELD_COUNT = Schema::fields.size();
+  static_assert(valid_layout(Schema::fields), "字段表不合法");
+
+  Decoded() = default;
+  // v2的REST字段可能指向rest_，拷贝后会悬空
+  Decoded(const Decoded &) = delete;
+  Decoded &operator=(const Decoded &) = delete;
+
+  // 解码v1格式的payload文本（ParseResult::payload，v2消息也已还原为此格式）
+  DecodeStatus decode(std::string_view payload) {
+    reset();
+    size_t start = 0;
+    // 与split_fields相同：末尾的分隔符不产生空字段
+    while (start < payload.size()) {
+      if (count_ == FIELD_COUNT) {
+        return DECODE_EXTRA_FIELD;
+      }
+      size_t end = payload.size();
+      if (Schema::fields[count_].type != REST) {
+        end = std::min(payload.find('|', start), payload.size());
+      }
+      DecodeStatus status =
+          set_field(count_, payload.substr(start, end - start));
+      if (status != DECODE_OK) {
+        return status;
+      }
+      start = end + 1;
+    }
+    return finish();
+  }
+
+  // 解码视图：v1取原文payload，v2直接使用已切好的字段
+  DecodeStatus decode(const ProtocolParser::MessageView &view) {
+    if (view.version != ProtocolParser::PROTOCOL_V2) {
+      return decode(view.payload);
+    }
+    reset();
+    const size_t total = view.payload_field_count();
+    for (size_t i = 0; i < total; ++i) {
+      if (count_ == FIELD_COUNT) {
+        return DECODE_EXTRA_FIELD;
+      }
+      std::string_view value = view.payload_field(i);
+      if (Schema::fields[count_].type == REST && i + 1 < total) {
+        // 发送方按'|'拆开了REST字段，拼回原文
+        rest_.assign(value);
+        for (size_t j = i + 1; j < total; ++j) {
+          rest_ += '|';
+          rest_ += view.payload_field(j);
+        }
+        value = rest_;
+        i = total;
+      }
+      DecodeStatus status = set_field(count_, value);
+      if (status != DECODE_OK) {
+        return status;
+      }
+    }
+    return finish();
+  }
+
+  // 字段原文；可选字段缺失时为空
+  template <size_t I> std::string_view text() const {
+    static_assert(I < FIELD_COUNT, "字段下标越界");
+    return values_[I];
+  }
+  template <size_t I> int integer() const {
+    static_assert(I < FIELD_COUNT && Schema::fields[I].type == INT,
+                  "不是整数字段");
+    return ints_[I];
+  }
+  template <size_t I> bool has() const {
+    static_assert(I < FIELD_COUNT, "字段下标越界");
+    return I < count_;
+  }
+  // 解码失败时出问题的字段名，字段过多时为"(多余字段)"
+  const char *error_field() const {
+    return error_index_ < FIELD_COUNT ? Schema::fields[error_index_].name
+                                      : "(多余字段)";
+  }
+
+private:
+  void reset() {
+    values_.fill({});
+    count_ = 0;
+    error_index_ = FIELD_COUNT;
+  }
+
+  DecodeStatus set_field(size_t index, std::string_view value) {
+    values_[index] = value;
+    if (Schema::fields[index].type == INT) {
+      const char *end = value.data() + value.size();
+      auto [ptr, ec] = std::from_chars(value.data(), end, ints_[index]);
+      if (ec != std::errc() || ptr != end) {
+        error_index_ = index;
+        return DECODE_BAD_INT;
+      }
+    }
+    ++count_;
+    return DECODE_OK;
+  }
+
+  DecodeStatus finish() {
+    if (count_ < required_count(Schema::fields)) {
+      error_index_ = count_;
+      return DECODE_MISSING_FIELD;
+    }
+    return DECODE_OK;
+  }
+
+  std::array<std::string_view, FIELD_COUNT> values_{};
+  std::array<int, FIELD_COUNT> ints_{};
+  size_t count_ = 0;
+  size_t error_index_ = FIELD_COUNT;
+  std::string rest_;
+};
+
+// ============ 打包 ============
+namespace detail {
+
+template <typename T>
+constexpr bool is_int_arg =
+    (std::is_integral_v<T> && !std::is_same_v<T, bool>) || std::is_enum_v<T>;
+template <typename T>
+constexpr bool is_text_arg = std::is_convertible_v<const T &, std::string_view>;
+
+template <typename T> size_t arg_size(const T &arg) {
+  if constexpr (is_int_arg<T>) {
+    return 20;
+  } else {
+    return std::string_view(arg).size();
+  }
+}
+
+template <typename T> bool arg_empty(const T &arg) {
+  if constexpr (is_int_arg<T>) {
+    return false;
+  } else {
+    return std::string_view(arg).empty();
+  }
+}
+
+inline void append_int(std::vector<char> &out, long long value) {
+  char buffer[24];
+  auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+  out.insert(out.end(), buffer, result.ptr);
+}
+
+template <typename T> void append_arg(std::vector<char> &out, const T &arg) {
+  if constexpr (is_int_arg<T>) {
+    append_int(out, static_cast<long long>(arg));
+  } else {
+    std::string_view text(arg);
+    out.insert(out.end(), text.begin(), text.end());
+  }
+}
+
+template <typename Schema, typename... Args, size_t... I>
+constexpr bool args_match(std::index_sequence<I...>) {
+  return ((Schema::fields[I].type == INT ? is_int_arg<Args>
+                                         : is_text_arg<Args>)&&...);
+}
+
+} // namespace detail
+
+// 把一条v1消息（含长度头）追加到out末尾。参数按字段表顺序给出，
+// 个数和类型在编译期检查；末尾为空的可选字段不写出
+template <typename Schema, typename... Args>
+void build_into(std::vector<char> &out, ProtocolParser::ClientType client_type,
+                std::string_view equipment_id, const Args &...args) {
+  static_assert(valid_layout(Schema::fields), "字段表不合法");
+  static_assert(sizeof...(Args) >= required_count(Schema::fields) &&
+                    sizeof...(Args) <= Schema::fields.size(),
+                "参数个数与字段表不符");
+  static_assert(detail::args_match<Schema, Args...>(
+                    std::index_sequence_for<Args...>{}),
+                "参数类型与字段表不符：整数字段需要整数，文本字段需要字符串");
+
+  constexpr size_t required = required_count(Schema::fields);
+  const bool empty[] = {false, detail::arg_empty(args)...};
+  size_t write_count = sizeof...(Args);
+  while (write_count > required && empty[write_count]) {
+    --write_count;
+  }
+
+  const size_t start = out.size();
+  const size_t needed = start + 4 + 2 * 20 + 2 + equipment_id.size() +
+                        (size_t{0} + ... + detail::arg_size(args)) +
+                        sizeof...(Args) + 1;
+  if (out.capacity() < needed) {
+    out.reserve(std::max(needed, out.capacity() * 2));
+  }
+  out.resize(start + 4); // 长度头最后填
+  detail::append_int(out, client_type);
+  out.push_back('|');
+  detail::append_int(out, Schema::type);
+  out.push_back('|');
+  out.insert(out.end(), equipment_id.begin(), equipment_id.end());
+  if (write_count == 0) {
+    out.push_back('|'); // 与build_message_body一致：空payload
+  } else {
+    size_t index = 0;
+    ((index++ < write_count
+          ? (out.push_back('|'), detail::append_arg(out, args))
+          : void()),
+     ...);
+  }
+  uint32_t net_len = htonl(static_cast<uint32_t>(out.size() - start - 4));
+  memcpy(out.data() + start, &net_len, 4);
+}
+
+template <typename Schema, typename... Args>
+std::vector<char> build(ProtocolParser::ClientType client_type,
+                        std::string_view equipment_id, const Args &...args) {
+  std::vector<char> out;
+  build_into<Schema>(out, client_type, equipment_id, args...);
+  return out;
+}
+
+// ============ 字段表 ============
+// 每个结构声明一种消息的payload：type为消息类型，枚举是字段下标，
+// fields是字段名和类型。同一消息类型两个方向的payload不同时分别声明
+// BATCH的payload是二进制的消息拼接，不在字段表中（见ProtocolParser::split_batch）
+using MT = ProtocolParser::MessageType;
+
+// 没有payload字段的消息
+template <MT Type> struct NoFields {
+  static constexpr MT type = Type;
+  static constexpr std::array<Field, 0> fields{};
+};
+
+// 结果响应: "success|说明" 或 "fail|原因"
+template <MT Type, bool MessageOptional> struct ResultResponse {
+  static constexpr MT type = Type;
+  enum { RESULT, MESSAGE };
+  static constexpr std::array fields{
+      Field{"result", TEXT}, Field{"message", REST, MessageOptional}};
+};
+
+// 记录列表响应：记录之间用';'分隔，记录内用'|'分隔，整体作为一个字段
+template <MT Type> struct RecordList {
+  static constexpr MT type = Type;
+  enum { RECORDS };
+  static constexpr std::array fields{Field{"records", REST, OPTIONAL}};
+};
+
+// 控制命令: "command_type|parameters"
+template <MT Type> struct Command {
+  static constexpr MT type = Type;
+  enum { COMMAND_TYPE, PARAMETERS };
+  static constexpr std::array fields{Field{"command_type", INT},
+                                     Field{"parameters", REST, OPTIONAL}};
+};
+
+// ---------- 设备 <-> 服务端 ----------
+struct EquipmentOnline {
+  static constexpr MT type = ProtocolParser::EQUIPMENT_ONLINE;
+  enum { LOCATION, EQUIPMENT_TYPE };
+  static constexpr std::array fields{Field{"location", TEXT},
+                                     Field{"equipment_type", TEXT}};
+};
+
+// 服务端开启UDP上报时带上会话令牌
+struct OnlineResponse {
+  static constexpr MT type = ProtocolParser::ONLINE_RESPONSE;
+  enum { RESULT, UDP_TOKEN };
+  static constexpr std::array fields{Field{"result", TEXT},
+                                     Field{"udp_token", TEXT, OPTIONAL}};
+};
+
+struct StatusUpdate {
+  static constexpr MT type = ProtocolParser::STATUS_UPDATE;
+  enum { STATUS, POWER_STATE, MORE_DATA };
+  static constexpr std::array fields{Field{"status", TEXT},
+                                     Field{"power_state", TEXT},
+                                     Field{"more_data", REST, OPTIONAL}};
+};
+
+using StatusQuery = NoFields<ProtocolParser::STATUS_QUERY>;
+
+struct StatusResponse {
+  static constexpr MT type = ProtocolParser::STATUS_RESPONSE;
+  enum { STATUS, POWER_STATE };
+  static constexpr std::array fields{Field{"status", TEXT},
+                                     Field{"power_state", TEXT}};
+};
+
+// parameters以服务器分配的请求ID开头，设备原样放进响应的request_id；
+// 服务器转发给Qt客户端时换成Qt端自己的请求ID（v1客户端为0）
+using ControlCommand = Command<ProtocolParser::CONTROL_COMMAND>;
+
+struct ControlResponse {
+  static constexpr MT type = ProtocolParser::CONTROL_RESPONSE;
+  enum { REQUEST_ID, RESULT, COMMAND, MESSAGE };
+  static constexpr std::array fields{
+      Field{"request_id", TEXT}, Field{"result", TEXT},
+      Field{"command", TEXT}, Field{"message", REST}};
+};
+
+using Heartbeat = NoFields<ProtocolParser::HEARTBEAT>;
+using HeartbeatResponse = NoFields<ProtocolParser::HEARTBEAT_RESPONSE>;
+
+struct PowerReport {
+  static constexpr MT type = ProtocolParser::POWER_REPORT;
+  enum { POWER_STATE, POWER_VALUE, TIMESTAMP };
+  static constexpr std::array fields{Field{"power_state", TEXT},
+                                     Field{"power_value", INT},
+                                     Field{"timestamp", TEXT}};
+};
+
+// ---------- Qt客户端 <-> 服务端 ----------
+struct QtClientLogin {
+  static constexpr MT type = ProtocolParser::QT_CLIENT_LOGIN;
+  enum { USERNAME, PASSWORD };
+  static constexpr std::array fields{Field{"username", TEXT},
+                                     Field{"password", TEXT}};
+};
+
+// 成功时message为"user_id|username|role"
+using QtLoginResponse =
+    ResultResponse<ProtocolParser::QT_LOGIN_RESPONSE, OPTIONAL>;
+
+using QtControlRequest = Command<ProtocolParser::QT_CONTROL_REQUEST>;
+
+struct QtEnergyQuery {
+  static constexpr MT type = ProtocolParser::QT_ENERGY_QUERY;
+  enum { TIME_RANGE, START_DATE, END_DATE };
+  static constexpr std::array fields{Field{"time_range", TEXT},
+                                     Field{"start_date", TEXT},
+                                     Field{"end_date", TEXT}};
+};
+
+// 失败时records为"fail|原因"
+using QtEnergyResponse = RecordList<ProtocolParser::QT_ENERGY_RESPONSE>;
+
+struct ReservationApply {
+  static constexpr MT type = ProtocolParser::RESERVATION_APPLY;
+  enum { USER_ID, START_TIME, END_TIME, PURPOSE };
+  static constexpr std::array fields{
+      Field{"user_id", INT}, Field{"start_time", TEXT},
+      Field{"end_time", TEXT}, Field{"purpose", REST}};
+};
+using ReservationApplyResponse =
+    ResultResponse<ProtocolParser::RESERVATION_APPLY, false>;
+
+using ReservationQuery = NoFields<ProtocolParser::RESERVATION_QUERY>;
+using ReservationQueryResponse =
+    ResultResponse<ProtocolParser::RESERVATION_QUERY, false>;
+
+struct ReservationApprove {
+  static constexpr MT type = ProtocolParser::RESERVATION_APPROVE;
+  enum { RESERVATION_ID, ACTION };
+  static constexpr std::array fields{Field{"reservation_id", INT},
+                                     Field{"action", TEXT}};
+};
+using ReservationApproveResponse =
+    ResultResponse<ProtocolParser::RESERVATION_APPROVE, false>;
+
+using QtEquipmentListQuery = NoFields<ProtocolParser::QT_EQUIPMENT_LIST_QUERY>;
+using QtEquipmentListResponse =
+    RecordList<ProtocolParser::QT_EQUIPMENT_LIST_RESPONSE>;
+
+using QtHeartbeat = NoFields<ProtocolParser::QT_HEARTBEAT>;
+
+struct QtHeartbeatResponse {
+  static constexpr MT type = ProtocolParser::QT_HEARTBEAT_RESPONSE;
+  enum { TIMESTAMP };
+  static constexpr std::array fields{Field{"timestamp", TEXT}};
+};
+
+struct QtAlertMessage {
+  static constexpr MT type = ProtocolParser::QT_ALERT_MESSAGE;
+  enum { ALARM_ID, ALARM_TYPE, SEVERITY, MESSAGE };
+  static constexpr std::array fields{
+      Field{"alarm_id", INT}, Field{"alarm_type", TEXT},
+      Field{"severity", TEXT}, Field{"message", REST}};
+};
+
+struct QtAlertAck {
+  static constexpr MT type = ProtocolParser::QT_ALERT_ACK;
+  enum { ALARM_ID };
+  static constexpr std::array fields{Field{"alarm_id", INT}};
+};
+
+using QtPlaceListResponse = RecordList<ProtocolParser::QT_PLACE_LIST_RESPONSE>;
+
+// 阈值为浮点数文本
+struct QtSetThreshold {
+  static constexpr MT type = ProtocolParser::QT_SET_THRESHOLD;
+  enum { EQUIPMENT_ID, THRESHOLD };
+  static constexpr std::array fields{Field{"equipment_id", TEXT},
+                                     Field{"threshold", TEXT}};
+};
+using QtSetThresholdResponse =
+    ResultResponse<ProtocolParser::QT_SET_THRESHOLD_RESPONSE, false>;
+
+using QtGetAllThresholds = NoFields<ProtocolParser::QT_GET_ALL_THRESHOLDS>;
+using QtGetAllThresholdsResponse =
+    ResultResponse<ProtocolParser::QT_GET_ALL_THRESHOLDS_RESPONSE, OPTIONAL>;
+
+using QtAlarmQuery = NoFields<ProtocolParser::QT_ALARM_QUERY>;
+using QtAlarmQueryResponse =
+    ResultResponse<ProtocolParser::QT_ALARM_QUERY_RESPONSE, OPTIONAL>;
+
+using MyReservationQuery = NoFields<ProtocolParser::MY_RESERVATION_QUERY>;
+using MyReservationResponse =
+    ResultResponse<ProtocolParser::MY_RESERVATION_RESPONSE, OPTIONAL>;
+
+struct QtMyControlQuery {
+  static constexpr MT type = ProtocolParser::QT_MY_CONTROL_QUERY;
+  enum { RESERVATION_ID };
+  static constexpr std::array fields{Field{"reservation_id", TEXT}};
+};
+using QtMyControlResponse =
+    ResultResponse<ProtocolParser::QT_MY_CONTROL_RESPONSE, OPTIONAL>;
+
+struct QtMyControlRequest {
+  static constexpr MT type = ProtocolParser::QT_MY_CONTROL_REQUEST;
+  enum { EQUIPMENT_ID, COMMAND, PARAMETERS };
+  static constexpr std::array fields{Field{"equipment_id", TEXT},
+                                     Field{"command", TEXT},
+                                     Field{"parameters", REST, OPTIONAL}};
+};
+
+} // namespace message_schema
@@ -0,0 +1,116 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <utility>
+#include <vector>
+
+// 单个连接的出站队列：按入队顺序保存待发送的消息，处理部分写。
+// 本类不加锁，由调用方（ConnectionManager）保证同一时刻只有一个线程操作。
+class OutputQueue {
+public:
+  enum FlushResult {
+    FLUSH_DRAINED = 0, // 队列已全部写入内核
+    FLUSH_PENDING = 1, // 内核发送缓冲区已满，剩余数据等待EPOLLOUT
+    FLUSH_ERROR = 2    // 连接出错（EPIPE/ECONNRESET等），应关闭连接
+  };
+
+  // 广播用的只读缓冲区：消息只序列化一次，由多个连接的队列共享
+  using SharedBuffer = std::shared_ptr<const std::vector<char>>;
+
+  // 追加一条完整的已打包消息
+  void push(std::vector<char> message);
+  // 追加一条共享消息，只增加引用计数，不拷贝内容
+  void push(SharedBuffer message);
+
+  // 单次flush的统计，用于观察合并写的效果
+  struct FlushStats {
+    size_t syscalls = 0; // sendmsg调用次数
+    size_t messages = 0; // 完整写出的消息数
+    size_t zerocopy_sends = 0;  // 带MSG_ZEROCOPY的sendmsg次数
+    size_t zerocopy_copied = 0; // 完成通知表明内核仍做了拷贝的发送次数
+  };
+
+  // 一次sendmsg最多合并的消息数
+  static constexpr int MAX_IOVECS = 64;
+  // 队列写空时容量超过该值则释放，避免突发后长期占用内存
+  static constexpr size_t RETAINED_CAPACITY = 16;
+
+  // 尽可能多地写入fd：多条消息通过iovec合并为一次sendmsg，
+  // 遇到EAGAIN时保留剩余数据
+  FlushResult flush(int fd, FlushStats *stats = nullptr);
+
+  // 同flush(fd)，写出方式换成writer（语义同非阻塞socket的writev），
+  // 用于共享内存通道等非socket传输
+  using Writer = std::function<ssize_t(const struct iovec *, int)>;
+  FlushResult flush(const Writer &writer, FlushStats *stats = nullptr);
+
+  // 零拷贝发送：不小于threshold字节的消息单独用sendmsg(MSG_ZEROCOPY)写出，
+  // 0表示关闭。socket需要先开启SO_ZEROCOPY，只对flush(fd)生效。
+  // 内核在发送完成前直接引用消息内存，消息写出后移到在途列表，
+  // 收到错误队列中的完成通知（reap_zerocopy）后才释放
+  void set_zerocopy_threshold(size_t threshold) {
+    zerocopy_threshold_ = threshold;
+  }
+  bool zerocopy_enabled() const { return zerocopy_threshold_ > 0; }
+  // 读取fd错误队列中的零拷贝完成通知并释放对应消息，返回通知条数。
+  // flush(fd)开始时会自动调用；EPOLLERR时也应调用，否则通知会一直积压
+  size_t reap_zerocopy(int fd, FlushStats *stats = nullptr);
+  // 已写入内核、等待完成通知的零拷贝消息数
+  size_t zerocopy_inflight() const { return zerocopy_inflight_.size(); }
+
+  // 待发送字节数（包含队首消息中未发送的部分）
+  size_t pending_bytes() const { return pending_bytes_; }
+  size_t pending_messages() const { return messages_.size() - head_; }
+  bool empty() const { return head_ == messages_.size(); }
+
+  // 清空待发送和在途的消息
+  void clear();
+
+private:
+  // 队列元素：独占的消息或共享的广播缓冲区（二者取其一）
+  struct Entry {
+    std::vector<char> owned;
+    SharedBuffer shared;
+    bool zerocopy = false;     // 至少有一部分经零拷贝写出
+    uint32_t zerocopy_seq = 0; // 最后一次零拷贝发送的序号
+    const char *data() const { return shared ? shared->data() : owned.data(); }
+    size_t size() const { return shared ? shared->size() : owned.size(); }
+  };
+
+  // fd为-1时不使用零拷贝
+  FlushResult flush_impl(const Writer &writer, int zerocopy_fd,
+                         FlushStats *stats);
+  // 零拷贝发送队首的大消息，ENOBUFS时退回普通拷贝发送
+  ssize_t send_zerocopy(int fd, FlushStats *stats);
+  bool is_large(const Entry &entry) const {
+    return zerocopy_threshold_ > 0 && entry.size() >= zerocopy_threshold_;
+  }
+  // 序号seq之前（含）的零拷贝发送是否都已完成（序号按uint32回绕比较）
+  bool zerocopy_completed(uint32_t seq) const {
+    return static_cast<int32_t>(seq - zerocopy_done_) < 0;
+  }
+  void complete_zerocopy(uint32_t lo, uint32_t hi);
+  void pop_front();
+  void compact();
+  // 待发送部分写空后的重置，不影响在途的零拷贝消息
+  void reset_pending();
+
+  // [head_, size)为待发送的消息。用vector而不是deque：空队列不分配内存
+  // （deque即使为空也会分配数百字节），大量空闲连接时可以省下不少内存
+  std::vector<Entry> messages_;
+  size_t head_ = 0;
+  size_t head_offset_ = 0; // 队首消息已发送的字节数
+  size_t pending_bytes_ = 0;
+
+  size_t zerocopy_threshold_ = 0;
+  // 内核为每次零拷贝sendmsg分配的序号从0递增；[0, zerocopy_done_)已完成，
+  // 之后不连续的已完成区间暂存在zerocopy_ranges_中
+  uint32_t zerocopy_next_ = 0;
+  uint32_t zerocopy_done_ = 0;
+  std::vector<std::pair<uint32_t, uint32_t>> zerocopy_ranges_;
+  std::vector<Entry> zerocopy_inflight_; // 按发送顺序
+};
@@ -1,5 +1,9 @@
 #pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
 #include <string>
+#include <string_view>
 #include <vector>
 
 class ProtocolParser {
@@ -42,6 +46,9 @@ public:
     QT_ENERGY_QUERY = 18,    // Qt客户端 -> 服务器：查询能耗
     QT_ENERGY_RESPONSE = 19, // 服务器 -> Qt客户端：返回能耗数据
 
+    // 设备→服务器：一帧携带多条遥测消息（见build_batch_message）
+    BATCH = 20,
+
     // ===== Qt客户端专用消息 =====
     QT_CLIENT_LOGIN = 100,         // Qt客户端 -> 服务器：登录请求
     QT_LOGIN_RESPONSE = 101,       // 服务器 -> Qt客户端：登录响应
@@ -85,20 +92,108 @@ public:
     GET_STATUS = 5
   };
 
+  // ============ 协议版本 ============
+  // v1：长度头 + 文本消息体"客户端类型|消息类型|设备ID|字段|字段..."
+  // v2：长度头 + 二进制消息体（网络字节序）：
+  //   u8 版本(=2) | u8 客户端类型 | u8 消息类型 | u32 请求ID |
+  //   varint 设备ID长度 | 设备ID | u8 字段数 | 字段...
+  // 每个字段是一个varint标记，最低位为FieldKind：FIELD_STRING的标记为
+  // 长度<<1，后跟字节，可以包含'|'；FIELD_INT的标记为(zigzag值<<1)|1，
+  // 整数绝对值需小于2^62，否则按字符串编码。
+  // v1消息体总是以数字字符开头，第一个字节即可区分两种格式。
+  // 版本在设备上线（EQUIPMENT_ONLINE）或Qt登录（QT_CLIENT_LOGIN）时协商：
+  // 客户端用v2发送握手消息，服务端此后对该连接的所有消息都用v2回复，
+  // 仍发v1握手的旧客户端不受影响
+  static constexpr uint8_t PROTOCOL_V1 = 1;
+  static constexpr uint8_t PROTOCOL_V2 = 2;
+  enum FieldKind : uint8_t { FIELD_STRING = 0, FIELD_INT = 1 };
+
   // ============ 解析结果结构 ============
+  // 持有字段内容，可以放进队列延后处理。v2消息的payload按v1格式
+  // 用'|'拼接，整数字段还原为十进制文本
   struct ParseResult {
-    ClientType client_type;
-    MessageType type;
+    ClientType client_type = CLIENT_UNKNOWN;
+    MessageType type = UNKNOWN_TYPE;
     std::string equipment_id;
     std::string payload;
-    bool success;
+    bool success = false;
+    uint8_t version = PROTOCOL_V1;
+    uint32_t request_id = 0; // 只有v2携带
+  };
+
+  // ============ 零分配解析 ============
+  enum ParseStatus {
+    PARSE_OK = 0,
+    PARSE_TOO_FEW_FIELDS = 1,   // 不足"客户端类型|消息类型|设备ID"三段
+    PARSE_BAD_CLIENT_TYPE = 2,  // 客户端类型不是整数
+    PARSE_BAD_MESSAGE_TYPE = 3, // 消息类型不是整数或超出范围
+    PARSE_TRUNCATED = 4,        // v2消息体比声明的字段短
+    PARSE_BAD_FIELD = 5         // v2字段数超过MAX_FIELDS或字段后有多余数据
+  };
+
+  // 一条消息最多切出的字段数，超出的部分不再切分，整体留在最后一个字段中
+  static constexpr size_t MAX_FIELDS = 32;
+  using Fields = std::array<std::string_view, MAX_FIELDS>;
+
+  // 只做切分、不拷贝的解析结果：各字段都是原始数据的视图，
+  // 原始数据（通常是MessageBuffer中的帧）被消费或覆盖后失效。
+  // v2的整数字段格式化到本对象内的缓冲区，视图指向它，因此不能拷贝
+  struct MessageView {
+    ClientType client_type = CLIENT_UNKNOWN;
+    MessageType type = UNKNOWN_TYPE;
+    uint8_t version = PROTOCOL_V1;
+    uint32_t request_id = 0;
+    std::string_view equipment_id;
+    // 设备ID之后的原文，与ParseResult::payload相同；v2没有对应的原文，
+    // 为空，需要时用payload_text()拼接
+    std::string_view payload;
+    Fields fields; // 全部字段，前三个为消息头（v2中前两个为空）
+    size_t field_count = 0;
+    uint32_t int_fields = 0; // v2中第i个字段为FIELD_INT时第i位为1
+    char int_text[MAX_FIELDS][24];
+
+    MessageView() = default;
+    MessageView(const MessageView &) = delete;
+    MessageView &operator=(const MessageView &) = delete;
+
+    std::string payload_text() const;
+
+    size_t payload_field_count() const {
+      return field_count > 3 ? field_count - 3 : 0;
+    }
+    // payload中的第index个字段，不存在时为空
+    std::string_view payload_field(size_t index) const {
+      return index < payload_field_count() ? fields[index + 3]
+                                           : std::string_view{};
+    }
   };
 
   // ============ 基础消息操作 ============
   static std::vector<char> pack_message(const std::string &body);
-  static ParseResult parse_message(const std::string &data);
+  // 解析到视图，不分配内存、不抛异常
+  static ParseStatus parse_message(std::string_view data, MessageView &view);
+  // 解析并拷贝字段，失败时success为false
+  static ParseResult parse_message(std::string_view data);
   static std::vector<std::string> split_string(const std::string &str,
                                                char delimiter);
+  // 按delimiter切分到fields，返回字段数。与split_string规则相同
+  // （末尾的分隔符不产生空字段），超过MAX_FIELDS时最后一个字段包含剩余全部内容
+  static size_t split_fields(std::string_view str, char delimiter,
+                             Fields &fields);
+  // 整个字段都是十进制整数时返回true（不接受空白和多余字符）
+  static bool parse_int(std::string_view field, int &value);
+
+  // ============ v2编码 ============
+  // 按v2编码并加长度头。payload字段中规范形式的十进制整数（无前导零、
+  // 无正号）编码为FIELD_INT，其余为FIELD_STRING，解码得到的文本与原字段相同。
+  // 字段数超过MAX_FIELDS - 3时返回空
+  static std::vector<char>
+  pack_message_v2(ClientType client_type, MessageType type,
+                  uint32_t request_id, std::string_view equipment_id,
+                  const std::string_view *fields, size_t field_count);
+  // 把已打包的v1消息转换为v2，格式错误时返回空
+  static std::vector<char> convert_to_v2(const std::vector<char> &packed,
+                                         uint32_t request_id = 0);
   // Qt客户端登录相关
   static std::vector<char>
   build_qt_login_message(ProtocolParser::ClientType client_type,
@@ -143,8 +238,12 @@ public:
   build_online_message(ClientType client_type, const std::string &equipment_id,
                        const std::string &location,
                        const std::string &equipment_type);
-  static std::vector<char> build_online_response(ClientType client_type,
-                                                 bool success);
+  // udp_token非空时附在"success"之后（"success|token"），
+  // 设备用它通过UDP上报功耗（见build_udp_power_report）。
+  // 设备ID是上线的设备，网关连接靠它区分是哪个设备的响应
+  static std::vector<char>
+  build_online_response(ClientType client_type, const std::string &equipment_id,
+                        bool success, const std::string &udp_token = "");
 
   // ============登录消息构建 ============
   static std::vector<char>
@@ -224,6 +323,32 @@ public:
                              const std::string &equipment_id,
                              const std::string &power_state, int power_value,
                              const std::string &timestamp);
+  // UDP功耗上报：一个数据报一条消息，不带长度头，消息体与
+  // build_power_report_message相同，末尾追加上线时拿到的会话令牌
+  static std::string build_udp_power_report(const std::string &equipment_id,
+                                            const std::string &power_state,
+                                            int power_value,
+                                            const std::string &timestamp,
+                                            const std::string &udp_token);
+  // 拆出UDP数据报末尾的会话令牌，格式错误返回false
+  static bool split_udp_token(std::string_view datagram,
+                              std::string_view &body, std::string_view &token);
+
+  // ============ 批量消息 ============
+  // BATCH的payload是若干条完整消息的拼接，每条带自己的4字节长度头，
+  // 可以是v1或v2。payload是二进制数据，不按'|'切分；消息头的设备ID留空。
+  // 只能在已上线设备的连接上发送，子消息的设备ID必须是在这条连接上
+  // 上线的设备（网关连接为下挂的每个设备发EQUIPMENT_ONLINE后可混装），
+  // 且只用于心跳、状态上报和功耗上报这类不需要逐条应答的遥测
+  static constexpr size_t MAX_BATCH_MESSAGES = 256;
+  // messages为已打包（带长度头）的消息，超过MAX_BATCH_MESSAGES条时返回空
+  static std::vector<char>
+  build_batch_message(ClientType client_type,
+                      const std::vector<std::vector<char>> &messages);
+  // 取出payload中各条消息的消息体（不含长度头），视图指向payload。
+  // 长度头越界、空消息或超过MAX_BATCH_MESSAGES条时返回false
+  static bool split_batch(std::string_view payload,
+                          std::vector<std::string_view> &bodies);
 
   // ============ 告警系统消息实现 ============
   static std::vector<char>
@@ -245,4 +370,7 @@ public:
   build_message_body(ClientType client_type, MessageType type,
                      const std::string &equipment_id,
                      const std::vector<std::string> &fields = {});
+
+private:
+  static ParseStatus parse_message_v2(std::string_view data, MessageView &view);
 };
@@ -0,0 +1,96 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+// 共享内存中的单生产者单消费者字节环。head/tail只增不减，按容量取模定位，
+// 容量必须是2的幂。帧边界由上层（长度头 + MessageBuffer）负责，这里只搬字节。
+class ShmRing {
+public:
+  // 位于共享内存开头，生产者和消费者的位置分在不同缓存行
+  struct Header {
+    alignas(64) std::atomic<uint64_t> head{0}; // 写入位置（生产者）
+    alignas(64) std::atomic<uint64_t> tail{0}; // 读取位置（消费者）
+    // 消费者读空后即将等待eventfd / 生产者因环满等待对端腾出空间
+    alignas(64) std::atomic<uint32_t> reader_waiting{0};
+    std::atomic<uint32_t> writer_waiting{0};
+    std::atomic<uint32_t> closed{0}; // 生产者已关闭，读完剩余数据即结束
+  };
+
+  // 一个环占用的共享内存大小（头部 + 数据区）
+  static size_t region_size(size_t capacity) {
+    return sizeof(Header) + capacity;
+  }
+
+  void attach(void *region, size_t capacity);
+
+  // 尽可能多地写入/读出，返回实际字节数（环满/环空时为0）
+  size_t write(const struct iovec *iov, int iov_count);
+  size_t read(const struct iovec *iov, int iov_count);
+
+  Header *header() const { return header_; }
+
+private:
+  Header *header_ = nullptr;
+  char *data_ = nullptr;
+  size_t capacity_ = 0;
+};
+
+// 同机进程之间的共享内存通道：memfd中放一对ShmRing（客户端→服务端、服务端→客户端），
+// 每个方向配一个eventfd，用于通知读端有新数据、通知写端有空闲空间。
+// 读写接口与非阻塞socket的readv/writev一致，可以直接接在MessageBuffer和
+// OutputQueue下面，上层的分帧和解析不需要区分传输方式。
+//
+// 读端读空后才登记等待（reader_waiting），写端只在对端登记过时写eventfd，
+// 持续有数据时不产生系统调用。
+//
+// 服务端create后通过Unix域socket把memfd和两个eventfd发给客户端（SCM_RIGHTS）。
+// notify_fd()是本端等待的eventfd，由使用方当作连接fd注册到事件循环并负责关闭；
+// 其余fd和映射由通道对象管理，析构时标记本端写入方向关闭并通知对端。
+// 每个方向只能有一个线程读、一个线程写。
+class ShmChannel {
+public:
+  static constexpr size_t DEFAULT_RING_BYTES = 256 * 1024;
+
+  ~ShmChannel();
+  ShmChannel(const ShmChannel &) = delete;
+  ShmChannel &operator=(const ShmChannel &) = delete;
+
+  // 服务端：创建共享内存和eventfd，ring_bytes向上取整为2的幂
+  static std::unique_ptr<ShmChannel> create(size_t ring_bytes =
+                                                DEFAULT_RING_BYTES);
+  // 服务端：把共享内存和eventfd发给客户端，发送后不再持有memfd
+  bool send_handshake(int socket_fd);
+  // 客户端：从Unix域socket接收服务端发来的通道
+  static std::unique_ptr<ShmChannel> receive_handshake(int socket_fd);
+
+  int notify_fd() const { return notify_fd_; }
+
+  // 语义同非阻塞socket：>0 字节数；0 对端已关闭且数据读完；
+  // -1 且errno为EAGAIN表示暂无数据/空间，EPIPE表示对端已关闭
+  ssize_t readv(const struct iovec *iov, int iov_count);
+  ssize_t writev(const struct iovec *iov, int iov_count);
+
+  // 统计：写eventfd唤醒对端的次数
+  uint64_t notifications() const {
+    return notifications_.load(std::memory_order_relaxed);
+  }
+
+private:
+  ShmChannel() = default;
+  // 映射共享内存；服务端读客户端→服务端的环，客户端相反
+  bool map(size_t ring_bytes, bool server_side);
+  void notify_peer();
+
+  void *region_ = nullptr;
+  size_t region_size_ = 0;
+  int memfd_ = -1;
+  int notify_fd_ = -1; // 本端等待的eventfd（使用方负责关闭）
+  int peer_fd_ = -1;   // 对端等待的eventfd
+  ShmRing incoming_;
+  ShmRing outgoing_;
+  std::atomic<uint64_t> notifications_{0};
+};
@@ -1,5 +1,7 @@
 #pragma once
 #include <iostream>
+#include <netinet/in.h>
+#include <string>
 class Socket {
 public:
   Socket() = default;
@@ -8,11 +10,20 @@ public:
   static bool connect_to_socket(int fd, std::string address, std::uint16_t port,
                                 int timeout_ms = 5000);
   bool bind_server_socket(int fd, int port);
-  int accept_socket(int server_fd);
-  bool listen_socket(int fd);
+  // peer不为空时返回对端地址（来自accept4，无需再调用getpeername）
+  int accept_socket(int server_fd, struct sockaddr_in *peer = nullptr);
+  bool listen_socket(int fd, int backlog = DEFAULT_BACKLOG);
   static bool set_socket_option(int fd);
+  // 允许多个监听socket绑定同一端口，由内核在它们之间分发新连接
+  static bool set_reuse_port(int fd);
   static bool set_nonblock(int fd);
 
-private:
-  int max_clients_ = 1024;
+  // Unix域流式socket：同机的网关、模拟器使用，帧格式与TCP相同
+  static int create_unix_socket();
+  // 绑定到文件系统路径，先删除上次运行遗留的socket文件
+  static bool bind_unix_socket(int fd, const std::string &path);
+  // 非阻塞fd上连接，监听队列满时返回false（errno为EAGAIN）
+  static bool connect_to_unix_socket(int fd, const std::string &path);
+
+  static constexpr int DEFAULT_BACKLOG = 1024;
 };
\ No newline at end of file
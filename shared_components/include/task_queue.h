@@ -0,0 +1,48 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <functional>
+
+// 事件循环的跨线程任务队列：多生产者单消费者，无锁链表 + eventfd唤醒。
+// 任意线程都可以post一个闭包，事件循环在下一次唤醒时按投递顺序执行。
+// event_fd()注册到epoll（或io_uring的poll请求），可读时调用run_pending。
+//
+// 只有队列由空变为非空后的第一次post会写eventfd，
+// 连续投递不会产生多余的系统调用。
+class TaskQueue {
+public:
+  using Task = std::function<void()>;
+
+  TaskQueue();
+  ~TaskQueue();
+  TaskQueue(const TaskQueue &) = delete;
+  TaskQueue &operator=(const TaskQueue &) = delete;
+
+  // 创建eventfd（非阻塞）
+  bool initialize();
+  int event_fd() const { return event_fd_; }
+
+  // 任意线程调用；队列未初始化时返回false
+  bool post(Task task);
+
+  // 只能由事件循环线程调用：执行最多max_tasks个任务，返回执行的数量。
+  // 还有剩余任务时重新写eventfd，保证下一轮继续处理
+  size_t run_pending(size_t max_tasks = MAX_TASKS_PER_RUN);
+
+  static constexpr size_t MAX_TASKS_PER_RUN = 1024;
+
+private:
+  struct Node {
+    std::atomic<Node *> next{nullptr};
+    Task task;
+  };
+
+  // 取出一个任务（消费者线程），队列为空或生产者尚未链接完成时返回false
+  bool pop(Task &task);
+  void notify();
+
+  int event_fd_ = -1;
+  std::atomic<Node *> head_; // 生产者交换head_追加节点
+  Node *tail_;               // 消费者持有的哨兵节点
+  std::atomic<bool> notified_{false};
+};
@@ -0,0 +1,75 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// 分层时间轮：4层，第0层256个槽，其余每层64个槽。
+// 添加、重置、取消定时器都是O(1)，推进时只处理到期槽中的定时器，
+// 高层的定时器在低层转完一圈时逐级下放。
+//
+// 线程模型：不加锁，只能由拥有它的事件循环线程使用。
+// 回调在advance中执行，回调里可以再添加、重置或取消定时器。
+class TimerWheel {
+public:
+  // 高32位为代数，低32位为节点下标；0表示无效
+  using TimerId = uint64_t;
+  using Callback = std::function<void()>;
+
+  explicit TimerWheel(uint32_t tick_ms = 100);
+
+  // 单次定时器：delay_ms后执行
+  TimerId schedule(uint64_t delay_ms, Callback callback);
+  // 周期定时器：每interval_ms执行一次，直到取消
+  TimerId schedule_every(uint64_t interval_ms, Callback callback);
+  // 把定时器的到期时间重置为delay_ms之后（周期定时器同时保持原周期）。
+  // 定时器已到期或已取消时返回false
+  bool reschedule(TimerId id, uint64_t delay_ms);
+  bool cancel(TimerId id);
+
+  // 推进到now_ms并执行所有到期的回调，返回执行的数量
+  size_t advance(uint64_t now_ms);
+
+  // 距离下一个定时器到期还有多少毫秒，给epoll_wait等做超时；
+  // 没有定时器返回-1
+  int next_timeout_ms(uint64_t now_ms) const;
+
+  size_t size() const { return active_count_; }
+
+  // 单调时钟的毫秒数
+  static uint64_t now_ms();
+
+private:
+  static constexpr int LEVELS = 4;
+  static constexpr int ROOT_BITS = 8;
+  static constexpr int LEVEL_BITS = 6;
+  static constexpr uint64_t ROOT_SLOTS = 1ULL << ROOT_BITS;
+  static constexpr uint64_t LEVEL_SLOTS = 1ULL << LEVEL_BITS;
+  static constexpr int32_t NIL = -1;
+
+  struct Node {
+    uint64_t expire_tick = 0;
+    uint64_t interval_ticks = 0; // 0表示单次定时器
+    Callback callback;
+    uint32_t generation = 1;
+    int32_t prev = NIL;
+    int32_t next = NIL;
+    int32_t slot = NIL; // 所在槽（slot_heads_下标），NIL表示未挂在轮上
+  };
+
+  TimerId add(uint64_t delay_ms, uint64_t interval_ms, Callback callback);
+  Node *lookup(TimerId id);
+  uint64_t to_ticks(uint64_t ms) const;
+  void link(int32_t index);
+  void unlink(int32_t index);
+  void release(int32_t index);
+  void cascade(int level);
+  size_t step();
+
+  uint32_t tick_ms_;
+  uint64_t start_ms_;
+  uint64_t current_tick_ = 0;
+  size_t active_count_ = 0;
+  std::vector<Node> nodes_;
+  std::vector<int32_t> free_nodes_;
+  std::vector<int32_t> slot_heads_; // 第0层在前，随后依次是第1~3层
+};
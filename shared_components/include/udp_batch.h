@@ -0,0 +1,57 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <netinet/in.h>
+#include <string>
+#include <string_view>
+#include <sys/socket.h>
+#include <vector>
+
+// 批量收发UDP数据报：recvmmsg/sendmmsg一次系统调用处理一批。
+// 用于功耗上报这类允许丢失的遥测，一个数据报就是一条消息体，不需要长度头。
+// 非阻塞；不加锁，同一个对象只能由一个线程使用。
+class UdpBatchSocket {
+public:
+  static constexpr size_t BATCH_SIZE = 64;
+  static constexpr size_t MAX_DATAGRAM_SIZE = 512;
+  static constexpr int DEFAULT_RECV_BUFFER = 4 * 1024 * 1024;
+
+  // datagram只在回调期间有效
+  using Handler =
+      std::function<void(std::string_view datagram, const sockaddr_in &source)>;
+
+  UdpBatchSocket();
+  ~UdpBatchSocket();
+  UdpBatchSocket(const UdpBatchSocket &) = delete;
+  UdpBatchSocket &operator=(const UdpBatchSocket &) = delete;
+
+  // 服务端：绑定端口，接收缓冲区调大以容纳突发
+  bool bind(int port, int recv_buffer_bytes = DEFAULT_RECV_BUFFER);
+  // 客户端：connect到服务端地址，之后send_batch不需要再指定地址
+  bool connect(const std::string &address, uint16_t port);
+  int fd() const { return fd_; }
+
+  // 最多接收max_batches批，返回收到的数据报数（超长被截断的不算），
+  // 出错返回-1。返回值等于max_batches * BATCH_SIZE时可能还有剩余
+  int receive(const Handler &handler, int max_batches);
+
+  // 发送一批数据报，返回成功发出的数量（发送缓冲区满时提前返回）
+  size_t send_batch(const std::vector<std::string> &datagrams);
+
+  // 统计：recvmmsg调用次数和收到的数据报数
+  uint64_t receive_calls() const { return receive_calls_; }
+  uint64_t received_datagrams() const { return received_datagrams_; }
+
+private:
+  bool open_socket();
+
+  int fd_ = -1;
+  std::vector<char> buffers_; // BATCH_SIZE个MAX_DATAGRAM_SIZE的接收区
+  std::array<struct mmsghdr, BATCH_SIZE> messages_{};
+  std::array<struct iovec, BATCH_SIZE> iovecs_{};
+  std::array<struct sockaddr_in, BATCH_SIZE> sources_{};
+  uint64_t receive_calls_ = 0;
+  uint64_t received_datagrams_ = 0;
+};
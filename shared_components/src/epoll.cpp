@@ -1,10 +1,19 @@
 #include "epoll.h"
-#include "socket.h"
 
+#include <algorithm>
 #include <iostream>
 #include <sys/epoll.h>
 #include <system_error>
 #include <unistd.h>
+Epoll::Epoll(int max_events) : max_events_(std::max(max_events, 1)) {}
+
+void Epoll::set_max_events(int max_events) {
+  max_events_ = std::max(max_events, 1);
+  if (static_cast<int>(events_.size()) > max_events_) {
+    events_.resize(max_events_);
+  }
+}
+
 Epoll::~Epoll() {
   if (epfd_ != -1) {
     close(epfd_);
@@ -26,7 +35,6 @@ bool Epoll::initialize() {
 }
 
 bool Epoll::add_epoll(int fd, uint32_t event) {
-  std::lock_guard<std::mutex> lock(epoll_mutex_);
   struct epoll_event ev {};
   ev.data.fd = fd;
   ev.events = event;
@@ -37,8 +45,18 @@ bool Epoll::add_epoll(int fd, uint32_t event) {
   }
   return true;
 }
+bool Epoll::add_epoll(int fd, uint32_t event, void *ptr) {
+  struct epoll_event ev {};
+  ev.data.ptr = ptr;
+  ev.events = event;
+  if (epoll_ctl(epfd_, EPOLL_CTL_ADD, fd, &ev) == -1) {
+    std::error_code ec(errno, std::system_category());
+    std::cerr << "epoll_ctl add failed..." << ec.message() << std::endl;
+    return false;
+  }
+  return true;
+}
 bool Epoll::delete_epoll(int fd) {
-  std::lock_guard<std::mutex> lock(epoll_mutex_);
   // 检查文件描述符是否有效
   if (fd <= 0) {
     return false;
@@ -56,7 +74,6 @@ bool Epoll::delete_epoll(int fd) {
   return true;
 }
 bool Epoll::modify_epoll(int fd, uint32_t event) {
-  std::lock_guard<std::mutex> lock(epoll_mutex_);
   // 检查文件描述符是否有效
   if (fd <= 0) {
     return false;
@@ -64,21 +81,36 @@ bool Epoll::modify_epoll(int fd, uint32_t event) {
   struct epoll_event ev {};
   ev.events = event;
   ev.data.fd = fd;
-  std::cout << "DEBUG modify_epoll: fd=" << fd << ", events=0x" << std::hex
-            << event << std::dec << std::endl;
   if (epoll_ctl(epfd_, EPOLL_CTL_MOD, fd, &ev) == -1) {
     std::error_code ec(errno, std::system_category());
     std::cerr << "epoll_ctl mod failed..." << ec.message() << std::endl;
     return false;
   }
-  std::cout << "DEBUG modify_epoll: success" << std::endl;
+  return true;
+}
+bool Epoll::modify_epoll(int fd, uint32_t event, void *ptr) {
+  if (fd <= 0) {
+    return false;
+  }
+  struct epoll_event ev {};
+  ev.events = event;
+  ev.data.ptr = ptr;
+  if (epoll_ctl(epfd_, EPOLL_CTL_MOD, fd, &ev) == -1) {
+    std::error_code ec(errno, std::system_category());
+    std::cerr << "epoll_ctl mod failed..." << ec.message() << std::endl;
+    return false;
+  }
   return true;
 }
 int Epoll::wait_events(struct epoll_event *evs, int timeout) {
+  return wait_events_into(evs, max_events_, timeout);
+}
+
+int Epoll::wait_events_into(struct epoll_event *evs, int count, int timeout) {
   if (epfd_ < 0) {
     return -1;
   }
-  int nfds = epoll_wait(epfd_, evs, max_events_, timeout);
+  int nfds = epoll_wait(epfd_, evs, count, timeout);
   if (nfds < 0) {
     if (errno == EINTR) {
       //被信号中断
@@ -89,4 +121,18 @@ int Epoll::wait_events(struct epoll_event *evs, int timeout) {
     return -1;
   }
   return nfds;
-}
\ No newline at end of file
+}
+
+int Epoll::wait(int timeout) {
+  if (events_.empty()) {
+    events_.resize(std::min(INITIAL_EVENTS, max_events_));
+  }
+  int nfds = wait_events_into(events_.data(), static_cast<int>(events_.size()),
+                              timeout);
+  // 满批说明还有就绪事件没取到，下一次多取一些
+  if (nfds == static_cast<int>(events_.size()) && nfds < max_events_) {
+    events_.resize(std::min(static_cast<size_t>(max_events_),
+                            events_.size() * 2));
+  }
+  return nfds;
+}
@@ -0,0 +1,520 @@
+#include "io_uring.h"
+
+#include <iostream>
+
+#ifdef EMS_HAVE_IO_URING
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <linux/io_uring.h>
+#include <linux/time_types.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+constexpr uint16_t BUFFER_GROUP_ID = 0;
+
+int sys_io_uring_setup(unsigned entries, struct io_uring_params *params) {
+  return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete,
+                       unsigned flags, const void *arg, size_t arg_size) {
+  return static_cast<int>(syscall(__NR_io_uring_enter, fd, to_submit,
+                                  min_complete, flags, arg, arg_size));
+}
+
+int sys_io_uring_register(int fd, unsigned opcode, void *arg,
+                          unsigned nr_args) {
+  return static_cast<int>(
+      syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+}
+
+// 与内核共享的队列指针需要acquire/release语义
+unsigned load_acquire(const unsigned *p) {
+  return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+void store_release(unsigned *p, unsigned v) {
+  __atomic_store_n(p, v, __ATOMIC_RELEASE);
+}
+} // namespace
+
+bool IoUring::Completion::has_more() const {
+  return (flags & IORING_CQE_F_MORE) != 0;
+}
+bool IoUring::Completion::has_buffer() const {
+  return (flags & IORING_CQE_F_BUFFER) != 0;
+}
+uint16_t IoUring::Completion::buffer_id() const {
+  return static_cast<uint16_t>(flags >> IORING_CQE_BUFFER_SHIFT);
+}
+
+IoUring::~IoUring() {
+  if (buf_ring_) {
+    munmap(buf_ring_, buf_ring_size_);
+  }
+  if (sqes_) {
+    munmap(sqes_, sqes_size_);
+  }
+  if (cq_ring_ && cq_ring_ != sq_ring_) {
+    munmap(cq_ring_, cq_ring_size_);
+  }
+  if (sq_ring_) {
+    munmap(sq_ring_, sq_ring_size_);
+  }
+  if (ring_fd_ >= 0) {
+    close(ring_fd_);
+  }
+}
+
+bool IoUring::is_supported() {
+  IoUring probe;
+  return probe.initialize(8);
+}
+
+bool IoUring::initialize(unsigned entries) {
+  if (ring_fd_ >= 0) {
+    return true;
+  }
+
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  // multishot请求会持续产生完成事件，完成队列开大一些避免溢出
+  params.flags = IORING_SETUP_CQSIZE;
+  params.cq_entries = entries * 4;
+
+  int fd = sys_io_uring_setup(entries, &params);
+  if (fd < 0) {
+    std::cerr << "io_uring_setup失败: " << strerror(errno) << std::endl;
+    return false;
+  }
+  // 需要带超时的等待（EXT_ARG，5.11+）
+  if (!(params.features & IORING_FEAT_EXT_ARG)) {
+    std::cerr << "内核不支持IORING_FEAT_EXT_ARG" << std::endl;
+    close(fd);
+    return false;
+  }
+  ring_fd_ = fd;
+
+  sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  cq_ring_size_ =
+      params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+  if (single_mmap) {
+    sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+  }
+
+  sq_ring_ = mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+  if (sq_ring_ == MAP_FAILED) {
+    sq_ring_ = nullptr;
+    std::cerr << "映射SQ ring失败: " << strerror(errno) << std::endl;
+    return false;
+  }
+  if (single_mmap) {
+    cq_ring_ = sq_ring_;
+  } else {
+    cq_ring_ = mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    if (cq_ring_ == MAP_FAILED) {
+      cq_ring_ = nullptr;
+      std::cerr << "映射CQ ring失败: " << strerror(errno) << std::endl;
+      return false;
+    }
+  }
+  sqes_size_ = params.sq_entries * sizeof(struct io_uring_sqe);
+  sqes_ = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE,
+               MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+  if (sqes_ == MAP_FAILED) {
+    sqes_ = nullptr;
+    std::cerr << "映射SQE数组失败: " << strerror(errno) << std::endl;
+    return false;
+  }
+
+  char *sq = static_cast<char *>(sq_ring_);
+  sq_head_ = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+  sq_tail_ = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+  sq_mask_ = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+  sq_entries_ = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_entries);
+  sq_array_ = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+  sqe_tail_ = *sq_tail_;
+
+  char *cq = static_cast<char *>(cq_ring_);
+  cq_head_ = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+  cq_tail_ = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+  cq_mask_ = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+  cqes_ = cq + params.cq_off.cqes;
+  return true;
+}
+
+bool IoUring::setup_buffer_ring(unsigned count, unsigned size) {
+  // 内核要求数量为2的幂，且不超过32768
+  if (ring_fd_ < 0 || count == 0 || (count & (count - 1)) != 0 ||
+      count > 32768) {
+    return false;
+  }
+  buf_count_ = count;
+  buf_size_ = size;
+  buf_storage_.assign(static_cast<size_t>(count) * size, 0);
+
+  if (register_buffer_ring() && probe_buffer_select()) {
+    return true;
+  }
+
+  // 部分内核注册成功但无法从ring中选取缓冲区，
+  // 回退到IORING_OP_PROVIDE_BUFFERS逐个归还缓冲区
+  if (buf_ring_) {
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.bgid = BUFFER_GROUP_ID;
+    sys_io_uring_register(ring_fd_, IORING_UNREGISTER_PBUF_RING, &reg, 1);
+    munmap(buf_ring_, buf_ring_size_);
+    buf_ring_ = nullptr;
+  }
+  std::cout << "buffer ring不可用，使用PROVIDE_BUFFERS提供接收缓冲区"
+            << std::endl;
+  {
+    std::lock_guard<std::mutex> lock(sq_mutex_);
+    auto *sqe = static_cast<struct io_uring_sqe *>(get_sqe_locked());
+    if (!sqe) {
+      return false;
+    }
+    sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+    sqe->fd = static_cast<int>(count);
+    sqe->addr = reinterpret_cast<uint64_t>(buf_storage_.data());
+    sqe->len = size;
+    sqe->buf_group = BUFFER_GROUP_ID;
+    sqe->off = 0;
+    sqe->user_data = INTERNAL_USER_DATA;
+  }
+  buffers_provided_ = flush_submissions();
+  return buffers_provided_ && probe_buffer_select();
+}
+
+bool IoUring::register_buffer_ring() {
+  buf_ring_size_ = buf_count_ * sizeof(struct io_uring_buf);
+  void *ring = mmap(nullptr, buf_ring_size_, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (ring == MAP_FAILED) {
+    std::cerr << "分配buffer ring失败: " << strerror(errno) << std::endl;
+    return false;
+  }
+
+  struct io_uring_buf_reg reg;
+  memset(&reg, 0, sizeof(reg));
+  reg.ring_addr = reinterpret_cast<uint64_t>(ring);
+  reg.ring_entries = buf_count_;
+  reg.bgid = BUFFER_GROUP_ID;
+  if (sys_io_uring_register(ring_fd_, IORING_REGISTER_PBUF_RING, &reg, 1) <
+      0) {
+    std::cerr << "注册buffer ring失败: " << strerror(errno) << std::endl;
+    munmap(ring, buf_ring_size_);
+    return false;
+  }
+  buf_ring_ = ring;
+
+  // 初始时把全部缓冲区交给内核
+  auto *br = static_cast<struct io_uring_buf_ring *>(buf_ring_);
+  for (unsigned i = 0; i < buf_count_; ++i) {
+    struct io_uring_buf &buf = br->bufs[i];
+    buf.addr = reinterpret_cast<uint64_t>(buffer_data(static_cast<uint16_t>(i)));
+    buf.len = buf_size_;
+    buf.bid = static_cast<uint16_t>(i);
+  }
+  __atomic_store_n(&br->tail, static_cast<uint16_t>(buf_count_),
+                   __ATOMIC_RELEASE);
+  return true;
+}
+
+bool IoUring::probe_buffer_select() {
+  // 用socketpair收一个字节，确认内核确实能从缓冲区组中选取缓冲区
+  int sv[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) {
+    return false;
+  }
+  bool ok = false;
+  {
+    std::lock_guard<std::mutex> lock(sq_mutex_);
+    auto *sqe = static_cast<struct io_uring_sqe *>(get_sqe_locked());
+    if (sqe) {
+      sqe->opcode = IORING_OP_RECV;
+      sqe->fd = sv[0];
+      sqe->flags = IOSQE_BUFFER_SELECT;
+      sqe->buf_group = BUFFER_GROUP_ID;
+      sqe->user_data = INTERNAL_USER_DATA;
+      ok = true;
+    }
+  }
+  char byte = 0;
+  if (ok && write(sv[1], &byte, 1) == 1) {
+    ok = false;
+    // 探测阶段没有其他请求，只会收到内部完成事件
+    Completion completions[4];
+    for (int round = 0; round < 4 && !ok; ++round) {
+      int count = wait_completions(completions, 4, 250);
+      if (count < 0) {
+        break;
+      }
+      for (int i = 0; i < count; ++i) {
+        if (completions[i].has_buffer()) {
+          recycle_buffer(completions[i].buffer_id());
+        }
+        ok = ok || completions[i].res == 1;
+      }
+    }
+  }
+  close(sv[0]);
+  close(sv[1]);
+  return ok;
+}
+
+const char *IoUring::buffer_data(uint16_t buffer_id) const {
+  return buf_storage_.data() + static_cast<size_t>(buffer_id) * buf_size_;
+}
+
+void IoUring::recycle_buffer(uint16_t buffer_id) {
+  if (buffers_provided_) {
+    // PROVIDE_BUFFERS模式：随下一次提交归还
+    std::lock_guard<std::mutex> lock(sq_mutex_);
+    auto *sqe = static_cast<struct io_uring_sqe *>(get_sqe_locked());
+    if (!sqe) {
+      return;
+    }
+    sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+    sqe->fd = 1;
+    sqe->addr = reinterpret_cast<uint64_t>(buffer_data(buffer_id));
+    sqe->len = buf_size_;
+    sqe->buf_group = BUFFER_GROUP_ID;
+    sqe->off = buffer_id;
+    sqe->user_data = INTERNAL_USER_DATA;
+    return;
+  }
+
+  auto *br = static_cast<struct io_uring_buf_ring *>(buf_ring_);
+  uint16_t tail = br->tail;
+  struct io_uring_buf &buf = br->bufs[tail & (buf_count_ - 1)];
+  buf.addr = reinterpret_cast<uint64_t>(buffer_data(buffer_id));
+  buf.len = buf_size_;
+  buf.bid = buffer_id;
+  __atomic_store_n(&br->tail, static_cast<uint16_t>(tail + 1),
+                   __ATOMIC_RELEASE);
+}
+
+void *IoUring::get_sqe_locked() {
+  if (ring_fd_ < 0) {
+    return nullptr;
+  }
+  for (int attempt = 0; attempt < 2; ++attempt) {
+    unsigned head = load_acquire(sq_head_);
+    if (sqe_tail_ - head < sq_entries_) {
+      auto *sqe = static_cast<struct io_uring_sqe *>(sqes_) +
+                  (sqe_tail_ & sq_mask_);
+      memset(sqe, 0, sizeof(*sqe));
+      sq_array_[sqe_tail_ & sq_mask_] = sqe_tail_ & sq_mask_;
+      ++sqe_tail_;
+      return sqe;
+    }
+    // 提交队列已满，先交给内核
+    if (publish_locked() < 0) {
+      break;
+    }
+  }
+  std::cerr << "io_uring提交队列已满" << std::endl;
+  return nullptr;
+}
+
+int IoUring::publish_locked() {
+  unsigned to_submit = sqe_tail_ - *sq_tail_;
+  if (to_submit == 0) {
+    return 0;
+  }
+  store_release(sq_tail_, sqe_tail_);
+  return enter(to_submit, 0, 0, nullptr, 0);
+}
+
+int IoUring::enter(unsigned to_submit, unsigned min_complete, unsigned flags,
+                   const void *arg, size_t arg_size) {
+  while (true) {
+    int ret = sys_io_uring_enter(ring_fd_, to_submit, min_complete, flags, arg,
+                                 arg_size);
+    if (ret < 0 && errno == EINTR) {
+      continue;
+    }
+    return ret;
+  }
+}
+
+bool IoUring::submit_multishot_accept(int listen_fd, uint64_t user_data) {
+  std::lock_guard<std::mutex> lock(sq_mutex_);
+  auto *sqe = static_cast<struct io_uring_sqe *>(get_sqe_locked());
+  if (!sqe) {
+    return false;
+  }
+  sqe->opcode = IORING_OP_ACCEPT;
+  sqe->fd = listen_fd;
+  sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+  sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+  sqe->user_data = user_data;
+  return true;
+}
+
+bool IoUring::submit_multishot_recv(int fd, uint64_t user_data) {
+  if (!buf_ring_ && !buffers_provided_) {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(sq_mutex_);
+  auto *sqe = static_cast<struct io_uring_sqe *>(get_sqe_locked());
+  if (!sqe) {
+    return false;
+  }
+  sqe->opcode = IORING_OP_RECV;
+  sqe->fd = fd;
+  sqe->ioprio = IORING_RECV_MULTISHOT;
+  sqe->flags = IOSQE_BUFFER_SELECT;
+  sqe->buf_group = BUFFER_GROUP_ID;
+  sqe->user_data = user_data;
+  return true;
+}
+
+bool IoUring::submit_send(int fd, const void *data, size_t len,
+                          uint64_t user_data) {
+  std::lock_guard<std::mutex> lock(sq_mutex_);
+  auto *sqe = static_cast<struct io_uring_sqe *>(get_sqe_locked());
+  if (!sqe) {
+    return false;
+  }
+  sqe->opcode = IORING_OP_SEND;
+  sqe->fd = fd;
+  sqe->addr = reinterpret_cast<uint64_t>(data);
+  sqe->len = static_cast<uint32_t>(len);
+  sqe->msg_flags = MSG_NOSIGNAL;
+  sqe->user_data = user_data;
+  return true;
+}
+
+bool IoUring::submit_poll(int fd, uint32_t poll_mask, uint64_t user_data) {
+  std::lock_guard<std::mutex> lock(sq_mutex_);
+  auto *sqe = static_cast<struct io_uring_sqe *>(get_sqe_locked());
+  if (!sqe) {
+    return false;
+  }
+  sqe->opcode = IORING_OP_POLL_ADD;
+  sqe->fd = fd;
+  sqe->poll32_events = poll_mask;
+  sqe->user_data = user_data;
+  return true;
+}
+
+bool IoUring::submit_cancel_fd(int fd, uint64_t user_data) {
+  std::lock_guard<std::mutex> lock(sq_mutex_);
+  auto *sqe = static_cast<struct io_uring_sqe *>(get_sqe_locked());
+  if (!sqe) {
+    return false;
+  }
+  sqe->opcode = IORING_OP_ASYNC_CANCEL;
+  sqe->fd = fd;
+  sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+  sqe->user_data = user_data;
+  return true;
+}
+
+bool IoUring::flush_submissions() {
+  std::lock_guard<std::mutex> lock(sq_mutex_);
+  return publish_locked() >= 0;
+}
+
+int IoUring::reap(Completion *out, int max) {
+  unsigned head = *cq_head_;
+  unsigned tail = load_acquire(cq_tail_);
+  int count = 0;
+  auto *cqes = static_cast<struct io_uring_cqe *>(cqes_);
+  while (head != tail && count < max) {
+    const struct io_uring_cqe &cqe = cqes[head & cq_mask_];
+    ++head;
+    // 归还缓冲区等内部请求的完成事件不交给调用方（出错时除外）
+    if (cqe.user_data == INTERNAL_USER_DATA && cqe.res >= 0 &&
+        !(cqe.flags & IORING_CQE_F_BUFFER)) {
+      continue;
+    }
+    out[count].user_data = cqe.user_data;
+    out[count].res = cqe.res;
+    out[count].flags = cqe.flags;
+    ++count;
+  }
+  store_release(cq_head_, head);
+  return count;
+}
+
+int IoUring::wait_completions(Completion *out, int max, int timeout_ms) {
+  if (ring_fd_ < 0) {
+    return -1;
+  }
+
+  unsigned to_submit = 0;
+  {
+    std::lock_guard<std::mutex> lock(sq_mutex_);
+    to_submit = sqe_tail_ - *sq_tail_;
+    store_release(sq_tail_, sqe_tail_);
+  }
+
+  // 已有完成事件时只提交不等待
+  int count = reap(out, max);
+  if (count > 0) {
+    if (to_submit > 0 && enter(to_submit, 0, 0, nullptr, 0) < 0) {
+      return -1;
+    }
+    return count;
+  }
+
+  struct __kernel_timespec ts;
+  ts.tv_sec = timeout_ms / 1000;
+  ts.tv_nsec = static_cast<long long>(timeout_ms % 1000) * 1000000;
+  struct io_uring_getevents_arg arg;
+  memset(&arg, 0, sizeof(arg));
+  arg.ts = reinterpret_cast<uint64_t>(&ts);
+
+  int ret = enter(to_submit, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG,
+                  &arg, sizeof(arg));
+  if (ret < 0 && errno != ETIME) {
+    return -1;
+  }
+  return reap(out, max);
+}
+
+#else // !EMS_HAVE_IO_URING
+
+// 未启用io_uring时的空实现，initialize始终失败，调用方回退到Epoll
+bool IoUring::Completion::has_more() const { return false; }
+bool IoUring::Completion::has_buffer() const { return false; }
+uint16_t IoUring::Completion::buffer_id() const { return 0; }
+IoUring::~IoUring() = default;
+bool IoUring::is_supported() { return false; }
+bool IoUring::initialize(unsigned) {
+  std::cerr << "当前构建未启用io_uring" << std::endl;
+  return false;
+}
+bool IoUring::setup_buffer_ring(unsigned, unsigned) { return false; }
+bool IoUring::register_buffer_ring() { return false; }
+bool IoUring::probe_buffer_select() { return false; }
+const char *IoUring::buffer_data(uint16_t) const { return nullptr; }
+void IoUring::recycle_buffer(uint16_t) {}
+bool IoUring::submit_multishot_accept(int, uint64_t) { return false; }
+bool IoUring::submit_multishot_recv(int, uint64_t) { return false; }
+bool IoUring::submit_send(int, const void *, size_t, uint64_t) {
+  return false;
+}
+bool IoUring::submit_poll(int, uint32_t, uint64_t) { return false; }
+bool IoUring::submit_cancel_fd(int, uint64_t) { return false; }
+bool IoUring::flush_submissions() { return false; }
+int IoUring::wait_completions(Completion *, int, int) { return -1; }
+void *IoUring::get_sqe_locked() { return nullptr; }
+int IoUring::enter(unsigned, unsigned, unsigned, const void *, size_t) {
+  return -1;
+}
+int IoUring::publish_locked() { return -1; }
+int IoUring::reap(Completion *, int) { return 0; }
+
+#endif
@@ -1,67 +1,145 @@
 #include "message_buffer.h"
+#include <algorithm>
 #include <arpa/inet.h>
+#include <cerrno>
 #include <cstring>
+#include <sys/uio.h>
 
-MessageBuffer::MessageBuffer() { buffer_.reserve(INITIAL_BUFFER_SIZE); }
+MessageBuffer::MessageBuffer() { buffer_.resize(INITIAL_BUFFER_SIZE); }
 
 void MessageBuffer::append_data(const char *data, size_t len) {
-  if (buffer_.size() + len > MAX_BUFFER_SIZE) {
-    // 防止缓冲区过大，可以在这里处理或抛出异常
+  if (data_size() + len > MAX_BUFFER_SIZE + HEADER_SIZE) {
+    // 丢弃会破坏帧边界，标记溢出由调用方关闭连接
+    overflowed_ = true;
     return;
   }
 
-  size_t old_size = buffer_.size();
-  buffer_.resize(old_size + len);
-  memcpy(buffer_.data() + old_size, data, len);
+  memcpy(prepare_write(len), data, len);
+  commit_write(len);
 }
 
-size_t MessageBuffer::extract_messages(std::vector<std::string> &messages) {
-  size_t extracted_count = 0;
+ssize_t MessageBuffer::read_from_fd(int fd) {
+  return read_with([fd](const struct iovec *iov, int iov_count) {
+    return readv(fd, iov, iov_count);
+  });
+}
 
-  while (true) {
-    // 检查是否有足够数据读取消息头
-    if (buffer_.size() < 4) {
-      break; // 连消息头都不完整，等待更多数据
-    }
-
-    // 解析消息长度
-    uint32_t msg_len;
-    if (!parse_message_length(msg_len)) {
-      // 消息头解析失败，清空缓冲区（协议错误）
-      clear();
-      break;
-    }
-
-    // 检查是否有完整的消息体
-    if (buffer_.size() < 4 + msg_len) {
-      break; // 消息体不完整，等待更多数据
-    }
-
-    // 提取完整消息
-    std::string message(buffer_.data() + 4, msg_len);
-    messages.push_back(message);
-    extracted_count++;
+ssize_t MessageBuffer::read_with(const Reader &reader) {
+  // 单次读取不超过剩余额度，避免缓冲区扩容后一次读入过多数据
+  const size_t max_pending = MAX_BUFFER_SIZE + HEADER_SIZE;
+  size_t limit = max_pending - std::min(data_size(), max_pending);
+  if (limit == 0) {
+    overflowed_ = true;
+    errno = ENOBUFS;
+    return -1;
+  }
+
+  char overflow[OVERFLOW_READ_SIZE];
+  char *dest = prepare_write(std::min(MIN_READ_SPACE, limit));
+  size_t free_space = std::min(writable_size(), limit);
+
+  struct iovec iov[2];
+  iov[0].iov_base = dest;
+  iov[0].iov_len = free_space;
+  iov[1].iov_base = overflow;
+  iov[1].iov_len = std::min(sizeof(overflow), limit - free_space);
+
+  ssize_t n = reader(iov, iov[1].iov_len > 0 ? 2 : 1);
+  if (n <= 0) {
+    return n;
+  }
+  if (static_cast<size_t>(n) <= free_space) {
+    commit_write(static_cast<size_t>(n));
+  } else {
+    commit_write(free_space);
+    append_data(overflow, static_cast<size_t>(n) - free_space);
+  }
+  return n;
+}
+
+char *MessageBuffer::prepare_write(size_t min_space) {
+  ensure_writable(min_space);
+  return buffer_.data() + write_pos_;
+}
+
+void MessageBuffer::commit_write(size_t len) {
+  write_pos_ = std::min(write_pos_ + len, buffer_.size());
+}
+
+void MessageBuffer::ensure_writable(size_t min_space) {
+  if (read_pos_ == write_pos_) {
+    // 已全部消费，从头开始写，不需要搬移
+    read_pos_ = 0;
+    write_pos_ = 0;
+  }
+  if (writable_size() >= min_space) {
+    return;
+  }
+
+  // 把未消费的尾部（通常是半帧）移到开头
+  size_t pending = data_size();
+  if (read_pos_ > 0) {
+    memmove(buffer_.data(), buffer_.data() + read_pos_, pending);
+    read_pos_ = 0;
+    write_pos_ = pending;
+  }
+  if (writable_size() < min_space) {
+    buffer_.resize(std::max(buffer_.size() * 2, pending + min_space));
+  }
+}
 
-    // 从缓冲区移除已处理的消息
-    size_t remaining = buffer_.size() - (4 + msg_len);
-    if (remaining > 0) {
-      // 移动剩余数据到缓冲区开头
-      memmove(buffer_.data(), buffer_.data() + 4 + msg_len, remaining);
-    }
-    buffer_.resize(remaining);
+bool MessageBuffer::next_frame(std::string_view &frame) {
+  // 检查是否有足够数据读取消息头
+  if (data_size() < HEADER_SIZE) {
+    return false; // 连消息头都不完整，等待更多数据
   }
 
+  // 解析消息长度
+  uint32_t msg_len;
+  if (!parse_message_length(msg_len)) {
+    // 消息头解析失败，清空缓冲区（协议错误）
+    clear();
+    return false;
+  }
+
+  // 检查是否有完整的消息体
+  if (data_size() < HEADER_SIZE + msg_len) {
+    return false; // 消息体不完整，等待更多数据
+  }
+
+  frame = std::string_view(buffer_.data() + read_pos_ + HEADER_SIZE, msg_len);
+  read_pos_ += HEADER_SIZE + msg_len;
+  return true;
+}
+
+size_t MessageBuffer::extract_frames(std::vector<std::string_view> &frames) {
+  size_t extracted_count = 0;
+  std::string_view frame;
+  while (next_frame(frame)) {
+    frames.push_back(frame);
+    extracted_count++;
+  }
+  return extracted_count;
+}
+
+size_t MessageBuffer::extract_messages(std::vector<std::string> &messages) {
+  size_t extracted_count = 0;
+  std::string_view frame;
+  while (next_frame(frame)) {
+    messages.emplace_back(frame);
+    extracted_count++;
+  }
   return extracted_count;
 }
 
 bool MessageBuffer::parse_message_length(uint32_t &msg_len) const {
-  if (buffer_.size() < 4) {
+  if (data_size() < HEADER_SIZE) {
     return false;
   }
 
   // 从网络字节序转换为主机字节序
   uint32_t net_len;
-  memcpy(&net_len, buffer_.data(), 4);
+  memcpy(&net_len, buffer_.data() + read_pos_, HEADER_SIZE);
   msg_len = ntohl(net_len);
 
   // 简单的长度校验（防止恶意数据）
@@ -72,10 +150,23 @@ bool MessageBuffer::parse_message_length(uint32_t &msg_len) const {
   return true;
 }
 
-size_t MessageBuffer::data_size() const { return buffer_.size(); }
+size_t MessageBuffer::data_size() const { return write_pos_ - read_pos_; }
 
-void MessageBuffer::clear() { buffer_.clear(); }
+void MessageBuffer::clear() {
+  read_pos_ = 0;
+  write_pos_ = 0;
+  overflowed_ = false;
+}
+
+void MessageBuffer::release_if_empty() {
+  if (data_size() > 0 || overflowed_ || buffer_.empty()) {
+    return;
+  }
+  std::vector<char>().swap(buffer_);
+  read_pos_ = 0;
+  write_pos_ = 0;
+}
 
 bool MessageBuffer::is_too_large() const {
-  return buffer_.size() > MAX_BUFFER_SIZE;
-}
\ No newline at end of file
+  return overflowed_ || data_size() > MAX_BUFFER_SIZE + HEADER_SIZE;
+}
@@ -0,0 +1,244 @@
+#include "output_queue.h"
+
+#include <cerrno>
+#include <cstring>
+#include <linux/errqueue.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+void OutputQueue::push(std::vector<char> message) {
+  if (message.empty()) {
+    return;
+  }
+  pending_bytes_ += message.size();
+  compact();
+  messages_.push_back(Entry{std::move(message), nullptr});
+}
+
+void OutputQueue::push(SharedBuffer message) {
+  if (!message || message->empty()) {
+    return;
+  }
+  pending_bytes_ += message->size();
+  compact();
+  messages_.push_back(Entry{{}, std::move(message)});
+}
+
+OutputQueue::FlushResult OutputQueue::flush(int fd, FlushStats *stats) {
+  return flush_impl(
+      [fd](const struct iovec *iov, int iov_count) {
+        struct msghdr msg {};
+        msg.msg_iov = const_cast<struct iovec *>(iov);
+        msg.msg_iovlen = iov_count;
+        return sendmsg(fd, &msg, MSG_NOSIGNAL);
+      },
+      zerocopy_enabled() ? fd : -1, stats);
+}
+
+OutputQueue::FlushResult OutputQueue::flush(const Writer &writer,
+                                            FlushStats *stats) {
+  return flush_impl(writer, -1, stats);
+}
+
+OutputQueue::FlushResult OutputQueue::flush_impl(const Writer &writer,
+                                                 int zerocopy_fd,
+                                                 FlushStats *stats) {
+  if (zerocopy_fd >= 0 && !zerocopy_inflight_.empty()) {
+    reap_zerocopy(zerocopy_fd, stats);
+  }
+  struct iovec iov[MAX_IOVECS];
+  while (!empty()) {
+    ssize_t n;
+    if (zerocopy_fd >= 0 && is_large(messages_[head_])) {
+      n = send_zerocopy(zerocopy_fd, stats);
+    } else {
+      // 收集队列中的消息，队首消息从未发送的位置开始；
+      // 遇到大消息时停下，留给下一次单独零拷贝发送
+      int iov_count = 0;
+      for (auto it = messages_.begin() + head_;
+           it != messages_.end() && iov_count < MAX_IOVECS; ++it) {
+        if (zerocopy_fd >= 0 && iov_count > 0 && is_large(*it)) {
+          break;
+        }
+        size_t offset = (iov_count == 0) ? head_offset_ : 0;
+        iov[iov_count].iov_base = const_cast<char *>(it->data()) + offset;
+        iov[iov_count].iov_len = it->size() - offset;
+        ++iov_count;
+      }
+      n = writer(iov, iov_count);
+    }
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        return FLUSH_PENDING;
+      }
+      return FLUSH_ERROR;
+    }
+    if (stats) {
+      stats->syscalls++;
+    }
+
+    // 按写出的字节数弹出已完成的消息
+    size_t written = static_cast<size_t>(n);
+    pending_bytes_ -= written;
+    while (written > 0) {
+      size_t head_left = messages_[head_].size() - head_offset_;
+      if (written < head_left) {
+        head_offset_ += written;
+        break;
+      }
+      written -= head_left;
+      pop_front();
+      if (stats) {
+        stats->messages++;
+      }
+    }
+
+    if (head_offset_ > 0) {
+      // 部分写：内核缓冲区已满
+      return FLUSH_PENDING;
+    }
+  }
+  return FLUSH_DRAINED;
+}
+
+ssize_t OutputQueue::send_zerocopy(int fd, FlushStats *stats) {
+  Entry &entry = messages_[head_];
+  struct iovec iov {};
+  iov.iov_base = const_cast<char *>(entry.data()) + head_offset_;
+  iov.iov_len = entry.size() - head_offset_;
+  struct msghdr msg {};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  ssize_t n = sendmsg(fd, &msg, MSG_NOSIGNAL | MSG_ZEROCOPY);
+  if (n >= 0) {
+    // 每次成功的零拷贝sendmsg占用一个完成通知序号，失败的不占用
+    entry.zerocopy = true;
+    entry.zerocopy_seq = zerocopy_next_++;
+    if (stats) {
+      stats->zerocopy_sends++;
+    }
+    return n;
+  }
+  if (errno == ENOBUFS) {
+    // 锁定的页面超过optmem限制：这一次退回普通发送
+    n = sendmsg(fd, &msg, MSG_NOSIGNAL);
+  }
+  return n;
+}
+
+size_t OutputQueue::reap_zerocopy(int fd, FlushStats *stats) {
+  size_t notifications = 0;
+  while (true) {
+    alignas(struct cmsghdr) char control[128];
+    struct msghdr msg {};
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    if (recvmsg(fd, &msg, MSG_ERRQUEUE) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      break; // EAGAIN：错误队列已读空
+    }
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg;
+         cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+      bool recverr =
+          (cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR) ||
+          (cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR);
+      if (!recverr) {
+        continue;
+      }
+      struct sock_extended_err err {};
+      memcpy(&err, CMSG_DATA(cmsg), sizeof(err));
+      if (err.ee_errno != 0 || err.ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+        continue;
+      }
+      // 一条通知覆盖序号区间[ee_info, ee_data]
+      notifications++;
+      if (stats && (err.ee_code & SO_EE_CODE_ZEROCOPY_COPIED)) {
+        stats->zerocopy_copied += err.ee_data - err.ee_info + 1;
+      }
+      complete_zerocopy(err.ee_info, err.ee_data);
+    }
+  }
+
+  size_t released = 0;
+  while (released < zerocopy_inflight_.size() &&
+         zerocopy_completed(zerocopy_inflight_[released].zerocopy_seq)) {
+    released++;
+  }
+  zerocopy_inflight_.erase(zerocopy_inflight_.begin(),
+                           zerocopy_inflight_.begin() + released);
+  if (zerocopy_inflight_.empty() &&
+      zerocopy_inflight_.capacity() > RETAINED_CAPACITY) {
+    std::vector<Entry>().swap(zerocopy_inflight_);
+  }
+  return notifications;
+}
+
+void OutputQueue::complete_zerocopy(uint32_t lo, uint32_t hi) {
+  if (static_cast<int32_t>(lo - zerocopy_done_) > 0) {
+    // 前面还有未完成的发送，先暂存
+    zerocopy_ranges_.emplace_back(lo, hi);
+    return;
+  }
+  if (static_cast<int32_t>(hi + 1 - zerocopy_done_) > 0) {
+    zerocopy_done_ = hi + 1;
+  }
+  // 合并暂存区间中已经连上的部分
+  for (size_t i = 0; i < zerocopy_ranges_.size();) {
+    auto range = zerocopy_ranges_[i];
+    if (static_cast<int32_t>(range.first - zerocopy_done_) > 0) {
+      ++i;
+      continue;
+    }
+    if (static_cast<int32_t>(range.second + 1 - zerocopy_done_) > 0) {
+      zerocopy_done_ = range.second + 1;
+    }
+    zerocopy_ranges_.erase(zerocopy_ranges_.begin() + i);
+    i = 0;
+  }
+}
+
+void OutputQueue::pop_front() {
+  Entry &entry = messages_[head_];
+  if (entry.zerocopy && !zerocopy_completed(entry.zerocopy_seq)) {
+    // 内核可能仍在读这段内存，等完成通知后再释放
+    zerocopy_inflight_.push_back(std::move(entry));
+  }
+  entry = Entry{}; // 立即释放消息内存
+  head_++;
+  head_offset_ = 0;
+  if (head_ == messages_.size()) {
+    reset_pending();
+  }
+}
+
+void OutputQueue::compact() {
+  // 追加会触发扩容且前面已发送的部分过半时，先把已发送的部分移走
+  if (head_ > 0 && messages_.size() == messages_.capacity() &&
+      head_ * 2 >= messages_.size()) {
+    messages_.erase(messages_.begin(), messages_.begin() + head_);
+    head_ = 0;
+  }
+}
+
+void OutputQueue::clear() {
+  reset_pending();
+  std::vector<Entry>().swap(zerocopy_inflight_);
+  zerocopy_ranges_.clear();
+}
+
+void OutputQueue::reset_pending() {
+  if (messages_.capacity() > RETAINED_CAPACITY) {
+    std::vector<Entry>().swap(messages_);
+  } else {
+    messages_.clear();
+  }
+  head_ = 0;
+  head_offset_ = 0;
+  pending_bytes_ = 0;
+}
@@ -1,8 +1,9 @@
 #include "protocol_parser.h"
+#include "message_schema.h"
 #include <arpa/inet.h>
+#include <charconv>
 #include <cstring>
 #include <iostream>
-#include <sstream>
 // 简单协议格式：类型|设备ID|数据
 // 示例：
 // 设备注册: "1|projector_101|classroom_101"
@@ -26,57 +27,302 @@ std::vector<char> ProtocolParser::pack_message(const std::string &body) {
   return packed_message;
 }
 
-ProtocolParser::ParseResult
-ProtocolParser::parse_message(const std::string &data) {
-  ParseResult result;
-  result.success = false;
+namespace {
 
-  // 按|分割消息
-  auto parts = split_string(data, '|');
-  if (parts.size() < 3) {
-    return result;
+// ============ v2编解码工具 ============
+void put_varint(std::vector<char> &out, uint64_t value) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+    value >>= 7;
   }
-  //解析客户端类型
-  int client_type_num = std::stoi(parts[0]);
-  result.client_type = static_cast<ClientType>(client_type_num);
+  out.push_back(static_cast<char>(value));
+}
 
-  // 解析消息类型
-  int type_num = std::stoi(parts[1]);
-  if (type_num < 1 || type_num > 200) {
-    return result;
+bool get_varint(std::string_view data, size_t &pos, uint64_t &value) {
+  value = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    if (pos >= data.size()) {
+      return false;
+    }
+    uint8_t byte = static_cast<uint8_t>(data[pos++]);
+    value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+uint64_t zigzag_encode(int64_t value) {
+  return (static_cast<uint64_t>(value) << 1) ^
+         static_cast<uint64_t>(value >> 63);
+}
+
+int64_t zigzag_decode(uint64_t value) {
+  return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+// 规范形式的十进制整数：格式化回文本后与原字段完全相同
+bool canonical_int(std::string_view field, int64_t &value) {
+  if (field.empty() || field.size() > 19) {
+    return false;
+  }
+  size_t digits = field[0] == '-' ? 1 : 0;
+  if (digits == field.size() || (field[digits] == '0' && field.size() > 1)) {
+    return false; // "-"、"007"、"-0"
   }
-  result.type = static_cast<MessageType>(type_num);
+  const char *end = field.data() + field.size();
+  auto [ptr, ec] = std::from_chars(field.data(), end, value);
+  // 标记里要腾出一位放字段类型
+  constexpr int64_t limit = int64_t{1} << 62;
+  return ec == std::errc() && ptr == end && value < limit && value >= -limit;
+}
+
+uint32_t get_be32(const char *p) {
+  uint32_t value;
+  memcpy(&value, p, sizeof(value));
+  return ntohl(value);
+}
+
+// 固定头：版本、客户端类型、消息类型、请求ID
+constexpr size_t V2_HEADER_SIZE = 1 + 1 + 1 + 4;
 
-  // 设备ID
-  result.equipment_id = parts[2];
+} // namespace
 
-  //  payload
-  if (parts.size() > 3) {
-    for (size_t i = 3; i < parts.size(); ++i) {
-      if (i > 3)
-        result.payload += "|";
-      result.payload += parts[i];
+std::string ProtocolParser::MessageView::payload_text() const {
+  if (version != PROTOCOL_V2) {
+    return std::string(payload);
+  }
+  std::string text;
+  for (size_t i = 3; i < field_count; ++i) {
+    if (i > 3) {
+      text += '|';
     }
+    text += fields[i];
+  }
+  return text;
+}
+
+ProtocolParser::ParseStatus
+ProtocolParser::parse_message(std::string_view data, MessageView &view) {
+  view.int_fields = 0;
+  view.request_id = 0;
+  if (!data.empty() && static_cast<uint8_t>(data[0]) == PROTOCOL_V2) {
+    return parse_message_v2(data, view);
   }
+  view.version = PROTOCOL_V1;
 
+  // 按|切分：客户端类型|消息类型|设备ID|payload...
+  view.field_count = split_fields(data, '|', view.fields);
+  if (view.field_count < 3) {
+    return PARSE_TOO_FEW_FIELDS;
+  }
+  int client_type_num = 0;
+  if (!parse_int(view.fields[0], client_type_num)) {
+    return PARSE_BAD_CLIENT_TYPE;
+  }
+  view.client_type = static_cast<ClientType>(client_type_num);
+
+  int type_num = 0;
+  if (!parse_int(view.fields[1], type_num) || type_num < 1 || type_num > 200) {
+    return PARSE_BAD_MESSAGE_TYPE;
+  }
+  view.type = static_cast<MessageType>(type_num);
+  view.equipment_id = view.fields[2];
+
+  // BATCH的payload是二进制的消息拼接，取设备ID之后的全部原文作为一个字段
+  if (view.type == BATCH) {
+    size_t begin = static_cast<size_t>(view.equipment_id.data() - data.data()) +
+                   view.equipment_id.size() + 1;
+    view.payload = begin < data.size() ? data.substr(begin) : std::string_view{};
+    view.fields[3] = view.payload;
+    view.field_count = view.payload.empty() ? 3 : 4;
+    return PARSE_OK;
+  }
+
+  // payload取原文，不需要把字段重新拼回去
+  if (view.field_count > 3) {
+    const char *begin = view.fields[3].data();
+    const std::string_view &last = view.fields[view.field_count - 1];
+    view.payload = std::string_view(
+        begin, static_cast<size_t>(last.data() + last.size() - begin));
+  } else {
+    view.payload = {};
+  }
+  return PARSE_OK;
+}
+
+ProtocolParser::ParseStatus
+ProtocolParser::parse_message_v2(std::string_view data, MessageView &view) {
+  view.version = PROTOCOL_V2;
+  if (data.size() < V2_HEADER_SIZE) {
+    return PARSE_TRUNCATED;
+  }
+  view.client_type = static_cast<ClientType>(static_cast<uint8_t>(data[1]));
+  int type_num = static_cast<uint8_t>(data[2]);
+  if (type_num < 1 || type_num > 200) {
+    return PARSE_BAD_MESSAGE_TYPE;
+  }
+  view.type = static_cast<MessageType>(type_num);
+  view.request_id = get_be32(data.data() + 3);
+
+  size_t pos = V2_HEADER_SIZE;
+  uint64_t len = 0;
+  if (!get_varint(data, pos, len) || len > data.size() - pos ||
+      pos >= data.size() - len) {
+    return PARSE_TRUNCATED; // 设备ID之后至少还有字段数
+  }
+  view.fields[0] = {};
+  view.fields[1] = {};
+  view.fields[2] = data.substr(pos, len);
+  view.equipment_id = view.fields[2];
+  pos += len;
+
+  size_t count = static_cast<uint8_t>(data[pos++]);
+  if (count > MAX_FIELDS - 3) {
+    return PARSE_BAD_FIELD;
+  }
+  view.field_count = 3 + count;
+  for (size_t i = 3; i < view.field_count; ++i) {
+    uint64_t tag = 0;
+    if (!get_varint(data, pos, tag)) {
+      return PARSE_TRUNCATED;
+    }
+    uint64_t value = tag >> 1;
+    if ((tag & 1) == FIELD_STRING) {
+      if (value > data.size() - pos) {
+        return PARSE_TRUNCATED;
+      }
+      view.fields[i] = data.substr(pos, value);
+      pos += value;
+    } else {
+      // 格式化到视图自带的缓冲区，处理器仍按文本读取
+      char *text = view.int_text[i];
+      auto result = std::to_chars(text, text + sizeof(view.int_text[i]),
+                                  zigzag_decode(value));
+      view.fields[i] = std::string_view(text, result.ptr - text);
+      view.int_fields |= 1u << i;
+    }
+  }
+  if (pos != data.size()) {
+    return PARSE_BAD_FIELD; // 字段之后不应再有数据
+  }
+  view.payload = {};
+  return PARSE_OK;
+}
+
+ProtocolParser::ParseResult
+ProtocolParser::parse_message(std::string_view data) {
+  ParseResult result;
+  MessageView view;
+  if (parse_message(data, view) != PARSE_OK) {
+    return result;
+  }
+  result.client_type = view.client_type;
+  result.type = view.type;
+  result.equipment_id = view.equipment_id;
+  result.payload = view.payload_text();
   result.success = true;
+  result.version = view.version;
+  result.request_id = view.request_id;
   return result;
 }
 
+std::vector<char> ProtocolParser::pack_message_v2(
+    ClientType client_type, MessageType type, uint32_t request_id,
+    std::string_view equipment_id, const std::string_view *fields,
+    size_t field_count) {
+  if (field_count > MAX_FIELDS - 3) {
+    return {};
+  }
+  std::vector<char> packed(4); // 长度头最后填
+  packed.reserve(4 + V2_HEADER_SIZE + equipment_id.size() + 16 * field_count);
+  packed.push_back(static_cast<char>(PROTOCOL_V2));
+  packed.push_back(static_cast<char>(client_type));
+  packed.push_back(static_cast<char>(type));
+  uint32_t net_request_id = htonl(request_id);
+  const char *id_bytes = reinterpret_cast<const char *>(&net_request_id);
+  packed.insert(packed.end(), id_bytes, id_bytes + sizeof(net_request_id));
+  put_varint(packed, equipment_id.size());
+  packed.insert(packed.end(), equipment_id.begin(), equipment_id.end());
+  packed.push_back(static_cast<char>(field_count));
+  for (size_t i = 0; i < field_count; ++i) {
+    int64_t value = 0;
+    if (canonical_int(fields[i], value)) {
+      put_varint(packed, (zigzag_encode(value) << 1) | FIELD_INT);
+    } else {
+      put_varint(packed, uint64_t{fields[i].size()} << 1 | FIELD_STRING);
+      packed.insert(packed.end(), fields[i].begin(), fields[i].end());
+    }
+  }
+  uint32_t net_len = htonl(static_cast<uint32_t>(packed.size() - 4));
+  memcpy(packed.data(), &net_len, 4);
+  return packed;
+}
+
+std::vector<char> ProtocolParser::convert_to_v2(const std::vector<char> &packed,
+                                                uint32_t request_id) {
+  // 只转换恰好一条完整消息的数据，拼接在一起的多条消息原样不认
+  if (packed.size() < 4 || get_be32(packed.data()) != packed.size() - 4) {
+    return {};
+  }
+  MessageView view;
+  if (parse_message(std::string_view(packed.data() + 4, packed.size() - 4),
+                    view) != PARSE_OK) {
+    return {};
+  }
+  if (view.version == PROTOCOL_V2) {
+    return packed;
+  }
+  return pack_message_v2(view.client_type, view.type, request_id,
+                         view.equipment_id, view.fields.data() + 3,
+                         view.field_count - 3);
+}
+
 std::vector<std::string> ProtocolParser::split_string(const std::string &str,
                                                       char delimiter) {
   std::vector<std::string> tokens;
-  if (str.empty()) {
-    return tokens;
+  size_t start = 0;
+  // 与std::getline逐段读取的结果一致：末尾的分隔符不产生空字段
+  while (start < str.size()) {
+    size_t end = str.find(delimiter, start);
+    if (end == std::string::npos) {
+      end = str.size();
+    }
+    tokens.emplace_back(str, start, end - start);
+    start = end + 1;
   }
+  return tokens;
+}
 
-  std::string token;
-  std::istringstream token_stream(str);
-  while (std::getline(token_stream, token, delimiter)) {
-    tokens.push_back(token);
+size_t ProtocolParser::split_fields(std::string_view str, char delimiter,
+                                    Fields &fields) {
+  size_t count = 0;
+  size_t start = 0;
+  while (start < str.size()) {
+    if (count == MAX_FIELDS - 1) {
+      // 最后一个字段放剩余内容（同样去掉末尾的分隔符）
+      size_t end = str.size();
+      if (str.back() == delimiter) {
+        end--;
+      }
+      fields[count++] = str.substr(start, end - start);
+      break;
+    }
+    size_t end = str.find(delimiter, start);
+    if (end == std::string_view::npos) {
+      end = str.size();
+    }
+    fields[count++] = str.substr(start, end - start);
+    start = end + 1;
   }
+  return count;
+}
 
-  return tokens;
+bool ProtocolParser::parse_int(std::string_view field, int &value) {
+  const char *end = field.data() + field.size();
+  auto [ptr, ec] = std::from_chars(field.data(), end, value);
+  return ec == std::errc() && ptr == end;
 }
 
 // ============ qt客户端登录相关 ========
@@ -85,82 +331,65 @@ std::vector<char>
 ProtocolParser::build_qt_login_message(ProtocolParser::ClientType client_type,
                                        const std::string &username,
                                        const std::string &password) {
-  std::string body = std::to_string(client_type) + "|" +
-                     std::to_string(static_cast<int>(QT_CLIENT_LOGIN)) + "|" +
-                     "qt_client" + "|" + // 固定设备ID，标识为Qt客户端
-                     username + "|" + password;
-  return pack_message(body);
+  // 固定设备ID，标识为Qt客户端
+  return message_schema::build<message_schema::QtClientLogin>(
+      client_type, "qt_client", username, password);
 }
 
 // Qt客户端登录响应
 std::vector<char> ProtocolParser::build_qt_login_response_message(
     ProtocolParser::ClientType client_type, bool success,
     const std::string &message) {
-  std::vector<std::string> fields;
-  fields.push_back(success ? "success" : "fail");
-  if (!message.empty()) {
-    fields.push_back(message);
-  }
-  std::string body =
-      build_message_body(client_type, QT_LOGIN_RESPONSE, "", fields);
-  return pack_message(body);
+  return message_schema::build<message_schema::QtLoginResponse>(
+      client_type, "", success ? "success" : "fail", message);
 }
 
 std::vector<char> ProtocolParser::build_qt_equipment_list_query(
     ProtocolParser::ClientType client_type) {
-  std::string body = std::to_string(client_type) + "|" +
-                     std::to_string(static_cast<int>(QT_EQUIPMENT_LIST_QUERY)) +
-                     "||";
-  return pack_message(body);
+  return message_schema::build<message_schema::QtEquipmentListQuery>(
+      client_type, "");
 }
 
 // ============ Qt客户端心跳消息实现 ============
 
 std::vector<char> ProtocolParser::build_qt_heartbeat_message(
     ClientType client_type, const std::string &client_identifier) {
-  // payload为空
-  return pack_message(
-      build_message_body(client_type, QT_HEARTBEAT, client_identifier, {}));
+  return message_schema::build<message_schema::QtHeartbeat>(
+      client_type, client_identifier);
 }
 
 std::vector<char> ProtocolParser::build_qt_heartbeat_response(
     ClientType client_type, const std::string &client_identifier,
     const std::string &timestamp) {
-  return pack_message(build_message_body(client_type, QT_HEARTBEAT_RESPONSE,
-                                         client_identifier, {timestamp}));
+  return message_schema::build<message_schema::QtHeartbeatResponse>(
+      client_type, client_identifier, timestamp);
 }
 
 std::vector<char>
 ProtocolParser::build_set_threshold_message(ClientType client_type,
                                             const std::string &equipment_id,
                                             float threshold_value) {
-  // payload: "equipment_id|threshold_value"
-  std::string payload = equipment_id + "|" + std::to_string(threshold_value);
-  return pack_message(build_message_body(client_type, QT_SET_THRESHOLD,
-                                         equipment_id, {payload}));
+  return message_schema::build<message_schema::QtSetThreshold>(
+      client_type, equipment_id, equipment_id,
+      std::to_string(threshold_value));
 }
 
 std::vector<char> ProtocolParser::build_set_threshold_response(
     ClientType client_type, bool success, const std::string &message) {
-  return pack_message(
-      build_message_body(client_type, QT_SET_THRESHOLD_RESPONSE, "response",
-                         {success ? "success" : "fail", message}));
+  return message_schema::build<message_schema::QtSetThresholdResponse>(
+      client_type, "response", success ? "success" : "fail", message);
 }
 
 std::vector<char>
 ProtocolParser::build_get_all_thresholds_message(ClientType client_type) {
-  return pack_message(
-      build_message_body(client_type, QT_GET_ALL_THRESHOLDS, "", {}));
+  return message_schema::build<message_schema::QtGetAllThresholds>(client_type,
+                                                                  "");
 }
 
 std::vector<char> ProtocolParser::build_get_all_thresholds_response(
     ClientType client_type, bool success, const std::string &data) {
-  std::vector<std::string> fields;
-  fields.push_back(success ? "success" : "fail");
-  if (!data.empty())
-    fields.push_back(data);
-  return pack_message(build_message_body(
-      client_type, QT_GET_ALL_THRESHOLDS_RESPONSE, "response", fields));
+  return message_schema::build<message_schema::QtGetAllThresholdsResponse>(
+      client_type, "response", success ? "success" : "fail", data);
 }
 
 // ============ 私有工具函数 ============
@@ -189,32 +418,27 @@ ProtocolParser::build_message_body(ClientType client_type, MessageType type,
 std::vector<char> ProtocolParser::build_online_message(
     ClientType client_type, const std::string &equipment_id,
     const std::string &location, const std::string &equipment_type) {
-  std::string body = build_message_body(
-      client_type, EQUIPMENT_ONLINE, equipment_id, {location, equipment_type});
-  return pack_message(body);
+  return message_schema::build<message_schema::EquipmentOnline>(
+      client_type, equipment_id, location, equipment_type);
 }
 
-std::vector<char> ProtocolParser::build_online_response(ClientType client_type,
-                                                        bool success) {
-  std::string body =
-      build_message_body(client_type, MessageType::ONLINE_RESPONSE, "response",
-                         {success ? "success" : "fail"});
-  return pack_message(body);
+std::vector<char>
+ProtocolParser::build_online_response(ClientType client_type,
+                                      const std::string &equipment_id,
+                                      bool success,
+                                      const std::string &udp_token) {
+  return message_schema::build<message_schema::OnlineResponse>(
+      client_type, equipment_id, success ? "success" : "fail",
+      success ? udp_token : std::string());
 }
 
 // ============ 登录消息实现 ============
 
 std::vector<char> ProtocolParser::buildQtLoginResponseMessage(
     ClientType client_type, bool success, const std::string &message) {
-  std::vector<std::string> fields;
-  fields.push_back(success ? "success" : "fail");
-  if (!message.empty()) {
-    fields.push_back(message);
-  }
-  // 注意：这里设备ID为空字符串，使用专门的消息构建函数
-  std::string body = build_message_body(
-      client_type, MessageType::QT_LOGIN_RESPONSE, "", fields);
-  return pack_message(body);
+  // 注意：这里设备ID为空字符串
+  return message_schema::build<message_schema::QtLoginResponse>(
+      client_type, "", success ? "success" : "fail", message);
 }
 
 // ============ 状态相关消息实现 ============
@@ -223,31 +447,22 @@ std::vector<char> ProtocolParser::build_status_update_message(
     ClientType client_type, const std::string &equipment_id,
     const std::string &status, const std::string &power_state,
     const std::string &more_data) {
-  std::vector<std::string> fields = {status, power_state};
-  if (!more_data.empty()) {
-    fields.push_back(more_data);
-  }
-
-  std::string body = build_message_body(client_type, MessageType::STATUS_UPDATE,
-                                        equipment_id, fields);
-  return pack_message(body);
+  return message_schema::build<message_schema::StatusUpdate>(
+      client_type, equipment_id, status, power_state, more_data);
 }
 
 std::vector<char>
 ProtocolParser::build_status_query(ClientType client_type,
                                    const std::string &equipment_id) {
-  std::string body =
-      build_message_body(client_type, MessageType::STATUS_QUERY, equipment_id);
-  return pack_message(body);
+  return message_schema::build<message_schema::StatusQuery>(client_type,
+                                                           equipment_id);
 }
 
 std::vector<char> ProtocolParser::build_status_response(
     ClientType client_type, const std::string &equipment_id,
     const std::string &status, const std::string &power_state) {
-  std::string body =
-      build_message_body(client_type, MessageType::STATUS_RESPONSE,
-                         equipment_id, {status, power_state});
-  return pack_message(body);
+  return message_schema::build<message_schema::StatusResponse>(
+      client_type, equipment_id, status, power_state);
 }
 
 // ============ 控制相关消息实现 ============
@@ -255,29 +470,15 @@ std::vector<char> ProtocolParser::build_status_response(
 std::vector<char> ProtocolParser::build_control_command(
     ClientType client_type, const std::string &equipment_id,
     ControlCommandType command_type, const std::string &parameters) {
-  std::vector<std::string> fields = {
-      std::to_string(static_cast<int>(command_type))};
-  if (!parameters.empty()) {
-    fields.push_back(parameters);
-  }
-
-  std::string body = build_message_body(
-      client_type, MessageType::CONTROL_COMMAND, equipment_id, fields);
-  return pack_message(body);
+  return message_schema::build<message_schema::ControlCommand>(
+      client_type, equipment_id, command_type, parameters);
 }
 
 std::vector<char> ProtocolParser::build_control_command_to_server(
     ClientType client_type, const std::string &equipment_id,
     ControlCommandType command_type, const std::string &parameters) {
-  std::vector<std::string> fields = {
-      std::to_string(static_cast<int>(command_type))};
-  if (!parameters.empty()) {
-    fields.push_back(parameters);
-  }
-
-  std::string body = build_message_body(
-      client_type, MessageType::QT_CONTROL_REQUEST, equipment_id, fields);
-  return pack_message(body);
+  return message_schema::build<message_schema::QtControlRequest>(
+      client_type, equipment_id, command_type, parameters);
 }
 
 std::vector<char> ProtocolParser::build_control_response(
@@ -291,23 +492,17 @@ std::vector<char> ProtocolParser::build_control_response(
 std::vector<char>
 ProtocolParser::build_my_control_query(ClientType client_type,
                                        const std::string &reservation_id) {
-  // 消息体：类型 + 设备ID（留空）+ payload（预约ID）
-  std::string body = build_message_body(client_type, QT_MY_CONTROL_QUERY, "",
-                                        {reservation_id});
-  return pack_message(body);
+  // 设备ID留空
+  return message_schema::build<message_schema::QtMyControlQuery>(
+      client_type, "", reservation_id);
 }
 
 std::vector<char> ProtocolParser::build_my_control_request(
     ClientType client_type, const std::string &equipment_id,
     const std::string &command, const std::string &parameters) {
-  // payload 格式：设备ID|命令|参数
-  std::string payload = equipment_id + "|" + command;
-  if (!parameters.empty()) {
-    payload += "|" + parameters;
-  }
-  std::string body =
-      build_message_body(client_type, QT_MY_CONTROL_REQUEST, "", {payload});
-  return pack_message(body);
+  // 设备ID在payload中，消息头的设备ID留空
+  return message_schema::build<message_schema::QtMyControlRequest>(
+      client_type, "", equipment_id, command, parameters);
 }
 
 std::vector<char>
@@ -323,16 +518,14 @@ ProtocolParser::build_my_control_response(ClientType client_type,
 std::vector<char>
 ProtocolParser::build_heartbeat_message(ClientType client_type,
                                         const std::string &equipment_id) {
-  std::string body =
-      build_message_body(client_type, MessageType::HEARTBEAT, equipment_id);
-  return pack_message(body);
+  return message_schema::build<message_schema::Heartbeat>(client_type,
+                                                         equipment_id);
 }
 
 std::vector<char>
 ProtocolParser::build_heartbeat_response(ClientType client_type) {
-  std::string body =
-      build_message_body(client_type, MessageType::HEARTBEAT_RESPONSE, "pong");
-  return pack_message(body);
+  return message_schema::build<message_schema::HeartbeatResponse>(client_type,
+                                                                 "pong");
 }
 
 // ============ 预约系统消息实现 ============
@@ -340,37 +533,27 @@ ProtocolParser::build_heartbeat_response(ClientType client_type) {
 std::vector<char>
 ProtocolParser::build_reservation_response(ClientType client_type, bool success,
                                            const std::string &message) {
-  std::string body =
-      build_message_body(client_type, MessageType::RESERVATION_APPLY,
-                         "response", {success ? "success" : "fail", message});
-  return pack_message(body);
+  return message_schema::build<message_schema::ReservationApplyResponse>(
+      client_type, "response", success ? "success" : "fail", message);
 }
 
 std::vector<char> ProtocolParser::build_reservation_query_response(
     ClientType client_type, bool success, const std::string &data) {
-  std::string body =
-      build_message_body(client_type, MessageType::RESERVATION_QUERY,
-                         "response", {success ? "success" : "fail", data});
-  return pack_message(body);
+  return message_schema::build<message_schema::ReservationQueryResponse>(
+      client_type, "response", success ? "success" : "fail", data);
 }
 
 std::vector<char> ProtocolParser::build_reservation_approve_response(
     ClientType client_type, bool success, const std::string &message) {
-  std::string body =
-      build_message_body(client_type, MessageType::RESERVATION_APPROVE,
-                         "response", {success ? "success" : "fail", message});
-  return pack_message(body);
+  return message_schema::build<message_schema::ReservationApproveResponse>(
+      client_type, "response", success ? "success" : "fail", message);
 }
 
 std::vector<char>
 ProtocolParser::build_my_reservation_response(bool success,
                                               const std::string &data) {
-  std::vector<std::string> fields = {success ? "success" : "fail"};
-  if (!data.empty())
-    fields.push_back(data);
-  std::string body = build_message_body(
-      CLIENT_QT_CLIENT, MY_RESERVATION_RESPONSE, "response", fields);
-  return pack_message(body);
+  return message_schema::build<message_schema::MyReservationResponse>(
+      CLIENT_QT_CLIENT, "response", success ? "success" : "fail", data);
 }
 
 // ============ Qt端预约请求消息实现 ============
@@ -387,9 +570,8 @@ ProtocolParser::build_reservation_message(ClientType client_type,
 std::vector<char>
 ProtocolParser::build_reservation_query(ClientType client_type,
                                         const std::string &equipment_id) {
-  std::string body = build_message_body(
-      client_type, MessageType::RESERVATION_QUERY, equipment_id, {});
-  return pack_message(body);
+  return message_schema::build<message_schema::ReservationQuery>(client_type,
+                                                                equipment_id);
 }
 
 std::vector<char>
@@ -403,20 +585,86 @@ ProtocolParser::build_reservation_approve(ClientType client_type,
 
 std::vector<char>
 ProtocolParser::build_my_reservation_query(ClientType client_type) {
-  std::string body =
-      build_message_body(client_type, MY_RESERVATION_QUERY, "", {});
-  return pack_message(body);
+  return message_schema::build<message_schema::MyReservationQuery>(client_type,
+                                                                  "");
 }
 
 std::vector<char> ProtocolParser::build_power_report_message(
     ClientType client_type, const std::string &equipment_id,
     const std::string &power_state, int power_value,
     const std::string &timestamp) {
-  std::string payload =
-      power_state + "|" + std::to_string(power_value) + "|" + timestamp;
-  std::string body =
-      build_message_body(client_type, POWER_REPORT, equipment_id, {payload});
-  return pack_message(body);
+  return message_schema::build<message_schema::PowerReport>(
+      client_type, equipment_id, power_state, power_value, timestamp);
+}
+
+std::string ProtocolParser::build_udp_power_report(
+    const std::string &equipment_id, const std::string &power_state,
+    int power_value, const std::string &timestamp,
+    const std::string &udp_token) {
+  std::vector<char> packed = message_schema::build<message_schema::PowerReport>(
+      CLIENT_EQUIPMENT, equipment_id, power_state, power_value, timestamp);
+  // 数据报不需要长度头
+  std::string datagram(packed.begin() + 4, packed.end());
+  datagram += '|';
+  datagram += udp_token;
+  return datagram;
+}
+
+bool ProtocolParser::split_udp_token(std::string_view datagram,
+                                     std::string_view &body,
+                                     std::string_view &token) {
+  size_t pos = datagram.rfind('|');
+  if (pos == std::string_view::npos || pos == 0 ||
+      pos + 1 == datagram.size()) {
+    return false;
+  }
+  body = datagram.substr(0, pos);
+  token = datagram.substr(pos + 1);
+  return true;
+}
+
+// ============ 批量消息实现 ============
+
+std::vector<char> ProtocolParser::build_batch_message(
+    ClientType client_type, const std::vector<std::vector<char>> &messages) {
+  if (messages.size() > MAX_BATCH_MESSAGES) {
+    return {};
+  }
+  std::string header = std::to_string(static_cast<int>(client_type)) + "|" +
+                       std::to_string(static_cast<int>(BATCH)) + "||";
+  size_t total = 4 + header.size();
+  for (const auto &message : messages) {
+    total += message.size();
+  }
+  std::vector<char> packed;
+  packed.reserve(total);
+  packed.resize(4); // 长度头最后填
+  packed.insert(packed.end(), header.begin(), header.end());
+  for (const auto &message : messages) {
+    packed.insert(packed.end(), message.begin(), message.end());
+  }
+  uint32_t net_len = htonl(static_cast<uint32_t>(packed.size() - 4));
+  memcpy(packed.data(), &net_len, 4);
+  return packed;
+}
+
+bool ProtocolParser::split_batch(std::string_view payload,
+                                 std::vector<std::string_view> &bodies) {
+  bodies.clear();
+  size_t pos = 0;
+  while (pos < payload.size()) {
+    if (payload.size() - pos < 4 || bodies.size() == MAX_BATCH_MESSAGES) {
+      return false;
+    }
+    uint32_t len = get_be32(payload.data() + pos);
+    pos += 4;
+    if (len == 0 || len > payload.size() - pos) {
+      return false;
+    }
+    bodies.push_back(payload.substr(pos, len));
+    pos += len;
+  }
+  return true;
 }
 
 // ============ 告警系统消息实现 ============
@@ -425,31 +673,25 @@ std::vector<char> ProtocolParser::build_alert_message(
     ClientType client_type, const std::string &equipment_id, int alarm_id,
     const std::string &alarm_type, const std::string &severity,
     const std::string &message) {
-  // payload格式: "alarm_id|alarm_type|severity|message"
-  std::string payload = std::to_string(alarm_id) + "|" + alarm_type + "|" +
-                        severity + "|" + message;
-  return pack_message(build_message_body(client_type, QT_ALERT_MESSAGE,
-                                         equipment_id, {payload}));
+  return message_schema::build<message_schema::QtAlertMessage>(
+      client_type, equipment_id, alarm_id, alarm_type, severity, message);
 }
 
 std::vector<char>
 ProtocolParser::build_alert_ack(ClientType client_type,
                                 const std::string &equipment_id, int alarm_id) {
-  return pack_message(build_message_body(
-      client_type, QT_ALERT_ACK, equipment_id, {std::to_string(alarm_id)}));
+  return message_schema::build<message_schema::QtAlertAck>(
+      client_type, equipment_id, alarm_id);
 }
 
 std::vector<char>
 ProtocolParser::build_alarm_query_message(ClientType client_type) {
-  return pack_message(build_message_body(client_type, QT_ALARM_QUERY, "", {}));
+  return message_schema::build<message_schema::QtAlarmQuery>(client_type, "");
 }
 
 std::vector<char>
 ProtocolParser::build_alarm_query_response(ClientType client_type, bool success,
                                            const std::string &data) {
-  std::vector<std::string> fields = {success ? "success" : "fail"};
-  if (!data.empty())
-    fields.push_back(data);
-  return pack_message(build_message_body(client_type, QT_ALARM_QUERY_RESPONSE,
-                                         "response", fields));
+  return message_schema::build<message_schema::QtAlarmQueryResponse>(
+      client_type, "response", success ? "success" : "fail", data);
 }
@@ -0,0 +1,280 @@
+#include "shm_channel.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <system_error>
+#include <unistd.h>
+
+namespace {
+
+constexpr size_t MIN_RING_BYTES = 4096;
+constexpr int HANDSHAKE_FDS = 3; // memfd、客户端→服务端eventfd、服务端→客户端eventfd
+
+size_t round_up_pow2(size_t value) {
+  size_t result = MIN_RING_BYTES;
+  while (result < value) {
+    result <<= 1;
+  }
+  return result;
+}
+
+void print_error(const char *what) {
+  std::error_code ec(errno, std::system_category());
+  std::cerr << what << "..." << ec.message() << std::endl;
+}
+
+} // namespace
+
+void ShmRing::attach(void *region, size_t capacity) {
+  header_ = static_cast<Header *>(region);
+  data_ = static_cast<char *>(region) + sizeof(Header);
+  capacity_ = capacity;
+}
+
+size_t ShmRing::write(const struct iovec *iov, int iov_count) {
+  uint64_t head = header_->head.load(std::memory_order_relaxed);
+  uint64_t tail = header_->tail.load(std::memory_order_seq_cst);
+  size_t space = capacity_ - static_cast<size_t>(head - tail);
+  size_t written = 0;
+  for (int i = 0; i < iov_count && written < space; ++i) {
+    const char *src = static_cast<const char *>(iov[i].iov_base);
+    size_t len = std::min(iov[i].iov_len, space - written);
+    size_t offset = (head + written) & (capacity_ - 1);
+    size_t first = std::min(len, capacity_ - offset);
+    memcpy(data_ + offset, src, first);
+    memcpy(data_, src + first, len - first);
+    written += len;
+  }
+  if (written > 0) {
+    header_->head.store(head + written, std::memory_order_seq_cst);
+  }
+  return written;
+}
+
+size_t ShmRing::read(const struct iovec *iov, int iov_count) {
+  uint64_t tail = header_->tail.load(std::memory_order_relaxed);
+  uint64_t head = header_->head.load(std::memory_order_seq_cst);
+  size_t available = static_cast<size_t>(head - tail);
+  size_t consumed = 0;
+  for (int i = 0; i < iov_count && consumed < available; ++i) {
+    char *dest = static_cast<char *>(iov[i].iov_base);
+    size_t len = std::min(iov[i].iov_len, available - consumed);
+    size_t offset = (tail + consumed) & (capacity_ - 1);
+    size_t first = std::min(len, capacity_ - offset);
+    memcpy(dest, data_ + offset, first);
+    memcpy(dest + first, data_, len - first);
+    consumed += len;
+  }
+  if (consumed > 0) {
+    header_->tail.store(tail + consumed, std::memory_order_seq_cst);
+  }
+  return consumed;
+}
+
+ShmChannel::~ShmChannel() {
+  if (region_) {
+    // 对端读完剩余数据后看到关闭
+    outgoing_.header()->closed.store(1, std::memory_order_release);
+    notify_peer();
+    munmap(region_, region_size_);
+  }
+  if (memfd_ >= 0) {
+    close(memfd_);
+  }
+  if (peer_fd_ >= 0) {
+    close(peer_fd_);
+  }
+}
+
+std::unique_ptr<ShmChannel> ShmChannel::create(size_t ring_bytes) {
+  ring_bytes = round_up_pow2(ring_bytes);
+  std::unique_ptr<ShmChannel> channel(new ShmChannel());
+  channel->memfd_ = memfd_create("ems_shm_channel", MFD_CLOEXEC);
+  if (channel->memfd_ < 0) {
+    print_error("memfd_create failed");
+    return nullptr;
+  }
+  if (ftruncate(channel->memfd_, 2 * ShmRing::region_size(ring_bytes)) < 0) {
+    print_error("ftruncate failed");
+    return nullptr;
+  }
+  channel->notify_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  channel->peer_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (channel->notify_fd_ < 0 || channel->peer_fd_ < 0) {
+    print_error("eventfd failed");
+    if (channel->notify_fd_ >= 0) {
+      close(channel->notify_fd_);
+    }
+    return nullptr;
+  }
+  if (!channel->map(ring_bytes, true)) {
+    close(channel->notify_fd_);
+    return nullptr;
+  }
+  new (channel->incoming_.header()) ShmRing::Header();
+  new (channel->outgoing_.header()) ShmRing::Header();
+  // 两端注册到事件循环之前可能已有数据写入：初始视为读端在等待，
+  // 第一次写入就会写eventfd，注册时eventfd已可读
+  channel->incoming_.header()->reader_waiting.store(1);
+  channel->outgoing_.header()->reader_waiting.store(1);
+  return channel;
+}
+
+bool ShmChannel::map(size_t ring_bytes, bool server_side) {
+  size_t ring_region = ShmRing::region_size(ring_bytes);
+  region_size_ = 2 * ring_region;
+  void *region = mmap(nullptr, region_size_, PROT_READ | PROT_WRITE,
+                      MAP_SHARED, memfd_, 0);
+  if (region == MAP_FAILED) {
+    print_error("mmap failed");
+    return false;
+  }
+  region_ = region;
+  // 前一半是客户端→服务端，后一半是服务端→客户端
+  char *client_to_server = static_cast<char *>(region);
+  char *server_to_client = client_to_server + ring_region;
+  incoming_.attach(server_side ? client_to_server : server_to_client,
+                   ring_bytes);
+  outgoing_.attach(server_side ? server_to_client : client_to_server,
+                   ring_bytes);
+  return true;
+}
+
+bool ShmChannel::send_handshake(int socket_fd) {
+  uint64_t ring_bytes =
+      region_size_ / 2 - sizeof(ShmRing::Header); // 单个环的容量
+  struct iovec iov {};
+  iov.iov_base = &ring_bytes;
+  iov.iov_len = sizeof(ring_bytes);
+
+  alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(int) * HANDSHAKE_FDS)];
+  struct msghdr msg {};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+  struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(int) * HANDSHAKE_FDS);
+  // 客户端→服务端方向由服务端等待（notify_fd_），另一方向由客户端等待
+  int fds[HANDSHAKE_FDS] = {memfd_, notify_fd_, peer_fd_};
+  memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+  if (sendmsg(socket_fd, &msg, MSG_NOSIGNAL) !=
+      static_cast<ssize_t>(sizeof(ring_bytes))) {
+    print_error("shm handshake send failed");
+    return false;
+  }
+  // 映射已建立，memfd只用于传给客户端
+  close(memfd_);
+  memfd_ = -1;
+  return true;
+}
+
+std::unique_ptr<ShmChannel> ShmChannel::receive_handshake(int socket_fd) {
+  uint64_t ring_bytes = 0;
+  struct iovec iov {};
+  iov.iov_base = &ring_bytes;
+  iov.iov_len = sizeof(ring_bytes);
+
+  alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(int) * HANDSHAKE_FDS)];
+  struct msghdr msg {};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+  ssize_t n = recvmsg(socket_fd, &msg, MSG_WAITALL | MSG_CMSG_CLOEXEC);
+  struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+  if (n != static_cast<ssize_t>(sizeof(ring_bytes)) || !cmsg ||
+      cmsg->cmsg_type != SCM_RIGHTS ||
+      cmsg->cmsg_len != CMSG_LEN(sizeof(int) * HANDSHAKE_FDS)) {
+    std::cerr << "shm handshake receive failed" << std::endl;
+    return nullptr;
+  }
+  int fds[HANDSHAKE_FDS];
+  memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+
+  std::unique_ptr<ShmChannel> channel(new ShmChannel());
+  channel->memfd_ = fds[0];
+  channel->peer_fd_ = fds[1];
+  channel->notify_fd_ = fds[2];
+  struct stat st {};
+  bool valid = ring_bytes >= MIN_RING_BYTES &&
+               (ring_bytes & (ring_bytes - 1)) == 0 &&
+               fstat(channel->memfd_, &st) == 0 &&
+               static_cast<uint64_t>(st.st_size) ==
+                   2 * ShmRing::region_size(ring_bytes);
+  if (!valid || !channel->map(ring_bytes, false)) {
+    std::cerr << "shm handshake invalid ring size: " << ring_bytes
+              << std::endl;
+    close(channel->notify_fd_);
+    return nullptr;
+  }
+  close(channel->memfd_);
+  channel->memfd_ = -1;
+  return channel;
+}
+
+ssize_t ShmChannel::readv(const struct iovec *iov, int iov_count) {
+  ShmRing::Header *header = incoming_.header();
+  size_t n = incoming_.read(iov, iov_count);
+  if (n == 0) {
+    if (header->closed.load(std::memory_order_acquire)) {
+      // 关闭标记之前写入的数据此时一定可见
+      n = incoming_.read(iov, iov_count);
+      return static_cast<ssize_t>(n);
+    }
+    // 读空：清掉eventfd计数并登记等待，再检查一次，避免与写端错过
+    uint64_t value;
+    while (::read(notify_fd_, &value, sizeof(value)) < 0 && errno == EINTR) {
+    }
+    header->reader_waiting.store(1, std::memory_order_seq_cst);
+    n = incoming_.read(iov, iov_count);
+    if (n == 0) {
+      errno = EAGAIN;
+      return -1;
+    }
+  }
+  // 腾出了空间，写端因环满在等待时唤醒它
+  if (header->writer_waiting.exchange(0, std::memory_order_seq_cst) != 0) {
+    notify_peer();
+  }
+  return static_cast<ssize_t>(n);
+}
+
+ssize_t ShmChannel::writev(const struct iovec *iov, int iov_count) {
+  if (incoming_.header()->closed.load(std::memory_order_acquire)) {
+    errno = EPIPE; // 对端已关闭通道
+    return -1;
+  }
+  ShmRing::Header *header = outgoing_.header();
+  size_t n = outgoing_.write(iov, iov_count);
+  if (n == 0) {
+    // 环满：登记等待，对端读出数据后会写eventfd
+    header->writer_waiting.store(1, std::memory_order_seq_cst);
+    n = outgoing_.write(iov, iov_count);
+    if (n == 0) {
+      errno = EAGAIN;
+      return -1;
+    }
+  }
+  if (header->reader_waiting.exchange(0, std::memory_order_seq_cst) != 0) {
+    notify_peer();
+  }
+  return static_cast<ssize_t>(n);
+}
+
+void ShmChannel::notify_peer() {
+  uint64_t one = 1;
+  while (::write(peer_fd_, &one, sizeof(one)) < 0 && errno == EINTR) {
+  }
+  notifications_.fetch_add(1, std::memory_order_relaxed);
+}
@@ -6,7 +6,9 @@
 #include <iostream>
 #include <netinet/in.h>
 #include <sys/socket.h>
+#include <sys/un.h>
 #include <system_error>
+#include <unistd.h>
 
 int Socket::create_socket() {
   // create server_fd
@@ -123,7 +125,7 @@ bool Socket::bind_server_socket(int fd, int port) {
   }
   return true;
 }
-int Socket::accept_socket(int server_fd) {
+int Socket::accept_socket(int server_fd, struct sockaddr_in *peer) {
   struct sockaddr_in client_addr {};
   socklen_t client_len = sizeof(client_addr);
 
@@ -142,10 +144,13 @@ int Socket::accept_socket(int server_fd) {
     return -1;
   }
 
+  if (peer) {
+    *peer = client_addr;
+  }
   return client_fd;
 }
-bool Socket::listen_socket(int fd) {
-  if (listen(fd, max_clients_) < 0) {
+bool Socket::listen_socket(int fd, int backlog) {
+  if (listen(fd, backlog) < 0) {
     std::error_code ec(errno, std::system_category());
     std::cerr << "listen failed..." << ec.message() << std::endl;
     return false;
@@ -163,6 +168,17 @@ bool Socket::set_socket_option(int fd) {
   return true;
 }
 
+bool Socket::set_reuse_port(int fd) {
+  int opt = 1;
+  if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0) {
+    std::error_code ec(errno, std::system_category());
+    std::cerr << "setsockopt SO_REUSEPORT failed..." << ec.message()
+              << std::endl;
+    return false;
+  }
+  return true;
+}
+
 bool Socket::set_nonblock(int fd) {
   int flags = fcntl(fd, F_GETFL, 0);
   if (flags < 0) {
@@ -176,4 +192,62 @@ bool Socket::set_nonblock(int fd) {
     return false;
   }
   return true;
-}
\ No newline at end of file
+}
+namespace {
+bool make_unix_address(const std::string &path, struct sockaddr_un &addr) {
+  addr = {};
+  addr.sun_family = AF_UNIX;
+  if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+    std::cerr << "Unix socket路径无效或过长: " << path << std::endl;
+    return false;
+  }
+  memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+  return true;
+}
+} // namespace
+
+int Socket::create_unix_socket() {
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) {
+    std::error_code ec(errno, std::system_category());
+    std::cerr << "unix socket failed..." << ec.message() << std::endl;
+    return -1;
+  }
+  return fd;
+}
+
+bool Socket::bind_unix_socket(int fd, const std::string &path) {
+  struct sockaddr_un addr {};
+  if (!make_unix_address(path, addr)) {
+    return false;
+  }
+  // 进程异常退出时socket文件不会被删除，不清理的话bind会失败
+  if (unlink(path.c_str()) < 0 && errno != ENOENT) {
+    std::error_code ec(errno, std::system_category());
+    std::cerr << "unlink " << path << " failed..." << ec.message()
+              << std::endl;
+    return false;
+  }
+  if (bind(fd, (sockaddr *)&addr, sizeof(addr)) < 0) {
+    std::error_code ec(errno, std::system_category());
+    std::cerr << "bind " << path << " failed..." << ec.message() << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool Socket::connect_to_unix_socket(int fd, const std::string &path) {
+  struct sockaddr_un addr {};
+  if (!make_unix_address(path, addr)) {
+    return false;
+  }
+  // Unix域socket的connect不会返回EINPROGRESS：要么立即成功，
+  // 要么监听队列已满（EAGAIN）或服务端未启动（ENOENT/ECONNREFUSED）
+  if (connect(fd, (sockaddr *)&addr, sizeof(addr)) < 0) {
+    std::cerr << "Connect " << path << " failed: " << strerror(errno)
+              << std::endl;
+    return false;
+  }
+  std::cout << "Connect success to unix:" << path << std::endl;
+  return true;
+}
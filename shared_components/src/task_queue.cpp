@@ -0,0 +1,89 @@
+#include "task_queue.h"
+#include <cstdint>
+#include <iostream>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <utility>
+
+TaskQueue::TaskQueue() {
+  Node *stub = new Node();
+  head_.store(stub, std::memory_order_relaxed);
+  tail_ = stub;
+}
+
+TaskQueue::~TaskQueue() {
+  Task task;
+  while (pop(task)) {
+  }
+  delete tail_;
+  if (event_fd_ >= 0) {
+    close(event_fd_);
+  }
+}
+
+bool TaskQueue::initialize() {
+  if (event_fd_ >= 0) {
+    return true;
+  }
+  event_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (event_fd_ < 0) {
+    std::cerr << "eventfd创建失败" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool TaskQueue::post(Task task) {
+  if (event_fd_ < 0) {
+    return false;
+  }
+  Node *node = new Node();
+  node->task = std::move(task);
+  // 先交换head_再链接前驱，两步之间消费者看到的是断开的链表，
+  // 会在链接完成后由下面的通知再次唤醒
+  Node *prev = head_.exchange(node, std::memory_order_acq_rel);
+  prev->next.store(node, std::memory_order_release);
+  notify();
+  return true;
+}
+
+void TaskQueue::notify() {
+  if (notified_.exchange(true)) {
+    return; // 消费者尚未处理上一次通知
+  }
+  uint64_t one = 1;
+  ssize_t n = write(event_fd_, &one, sizeof(one));
+  (void)n;
+}
+
+bool TaskQueue::pop(Task &task) {
+  Node *next = tail_->next.load(std::memory_order_acquire);
+  if (!next) {
+    return false;
+  }
+  // 取出的节点成为新的哨兵
+  task = std::move(next->task);
+  delete tail_;
+  tail_ = next;
+  return true;
+}
+
+size_t TaskQueue::run_pending(size_t max_tasks) {
+  // 先清除通知标记再取任务：之后投递的任务一定会重新写eventfd
+  notified_.store(false);
+  uint64_t value;
+  ssize_t n = read(event_fd_, &value, sizeof(value));
+  (void)n;
+
+  size_t count = 0;
+  Task task;
+  while (count < max_tasks && pop(task)) {
+    task();
+    task = nullptr;
+    count++;
+  }
+  if (count == max_tasks && tail_->next.load(std::memory_order_acquire)) {
+    notify();
+  }
+  return count;
+}
@@ -0,0 +1,237 @@
+#include "timer_wheel.h"
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
+TimerWheel::TimerWheel(uint32_t tick_ms)
+    : tick_ms_(tick_ms > 0 ? tick_ms : 1), start_ms_(now_ms()),
+      slot_heads_(ROOT_SLOTS + (LEVELS - 1) * LEVEL_SLOTS, NIL) {}
+
+uint64_t TimerWheel::now_ms() {
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+          std::chrono::steady_clock::now().time_since_epoch())
+          .count());
+}
+
+TimerWheel::TimerId TimerWheel::schedule(uint64_t delay_ms,
+                                         Callback callback) {
+  return add(delay_ms, 0, std::move(callback));
+}
+
+TimerWheel::TimerId TimerWheel::schedule_every(uint64_t interval_ms,
+                                               Callback callback) {
+  return add(interval_ms, interval_ms, std::move(callback));
+}
+
+TimerWheel::TimerId TimerWheel::add(uint64_t delay_ms, uint64_t interval_ms,
+                                    Callback callback) {
+  int32_t index;
+  if (!free_nodes_.empty()) {
+    index = free_nodes_.back();
+    free_nodes_.pop_back();
+  } else {
+    index = static_cast<int32_t>(nodes_.size());
+    nodes_.emplace_back();
+  }
+
+  Node &node = nodes_[index];
+  node.expire_tick = current_tick_ + to_ticks(delay_ms);
+  node.interval_ticks = interval_ms > 0 ? to_ticks(interval_ms) : 0;
+  node.callback = std::move(callback);
+  link(index);
+  active_count_++;
+  return (static_cast<uint64_t>(node.generation) << 32) |
+         static_cast<uint32_t>(index);
+}
+
+bool TimerWheel::reschedule(TimerId id, uint64_t delay_ms) {
+  Node *node = lookup(id);
+  if (!node) {
+    return false;
+  }
+  int32_t index = static_cast<int32_t>(id & 0xffffffffULL);
+  unlink(index);
+  node->expire_tick = current_tick_ + to_ticks(delay_ms);
+  link(index);
+  return true;
+}
+
+bool TimerWheel::cancel(TimerId id) {
+  if (!lookup(id)) {
+    return false;
+  }
+  int32_t index = static_cast<int32_t>(id & 0xffffffffULL);
+  unlink(index);
+  release(index);
+  return true;
+}
+
+TimerWheel::Node *TimerWheel::lookup(TimerId id) {
+  uint32_t index = static_cast<uint32_t>(id & 0xffffffffULL);
+  uint32_t generation = static_cast<uint32_t>(id >> 32);
+  if (index >= nodes_.size()) {
+    return nullptr;
+  }
+  Node &node = nodes_[index];
+  if (node.generation != generation || node.slot == NIL) {
+    return nullptr;
+  }
+  return &node;
+}
+
+uint64_t TimerWheel::to_ticks(uint64_t ms) const {
+  // 向上取整，至少一个tick，保证不会早于请求的时间触发
+  uint64_t ticks = (ms + tick_ms_ - 1) / tick_ms_;
+  return ticks > 0 ? ticks : 1;
+}
+
+void TimerWheel::link(int32_t index) {
+  Node &node = nodes_[index];
+  if (node.expire_tick < current_tick_) {
+    node.expire_tick = current_tick_;
+  }
+  uint64_t delta = node.expire_tick - current_tick_;
+
+  int32_t slot;
+  if (delta < ROOT_SLOTS) {
+    slot = static_cast<int32_t>(node.expire_tick & (ROOT_SLOTS - 1));
+  } else {
+    int level = 1;
+    while (level < LEVELS - 1 &&
+           delta >= (1ULL << (ROOT_BITS + level * LEVEL_BITS))) {
+      level++;
+    }
+    // 超出最高层范围的按最大值处理，到期前会随下放重新计算
+    uint64_t max_delta = (1ULL << (ROOT_BITS + LEVEL_BITS * (LEVELS - 1))) - 1;
+    if (delta > max_delta) {
+      node.expire_tick = current_tick_ + max_delta;
+    }
+    int shift = ROOT_BITS + (level - 1) * LEVEL_BITS;
+    slot = static_cast<int32_t>(
+        ROOT_SLOTS + (level - 1) * LEVEL_SLOTS +
+        ((node.expire_tick >> shift) & (LEVEL_SLOTS - 1)));
+  }
+
+  node.slot = slot;
+  node.prev = NIL;
+  node.next = slot_heads_[slot];
+  if (node.next != NIL) {
+    nodes_[node.next].prev = index;
+  }
+  slot_heads_[slot] = index;
+}
+
+void TimerWheel::unlink(int32_t index) {
+  Node &node = nodes_[index];
+  if (node.prev != NIL) {
+    nodes_[node.prev].next = node.next;
+  } else {
+    slot_heads_[node.slot] = node.next;
+  }
+  if (node.next != NIL) {
+    nodes_[node.next].prev = node.prev;
+  }
+  node.prev = NIL;
+  node.next = NIL;
+  node.slot = NIL;
+}
+
+void TimerWheel::release(int32_t index) {
+  Node &node = nodes_[index];
+  node.callback = nullptr;
+  node.generation++; // 使旧的TimerId失效
+  free_nodes_.push_back(index);
+  active_count_--;
+}
+
+void TimerWheel::cascade(int level) {
+  int shift = ROOT_BITS + (level - 1) * LEVEL_BITS;
+  int32_t slot = static_cast<int32_t>(
+      ROOT_SLOTS + (level - 1) * LEVEL_SLOTS +
+      ((current_tick_ >> shift) & (LEVEL_SLOTS - 1)));
+  int32_t index = slot_heads_[slot];
+  slot_heads_[slot] = NIL;
+  while (index != NIL) {
+    int32_t next = nodes_[index].next;
+    link(index);
+    index = next;
+  }
+}
+
+size_t TimerWheel::step() {
+  current_tick_++;
+
+  // 低层转完一圈时，把上一层对应槽中的定时器下放
+  for (int level = 1; level < LEVELS; ++level) {
+    int shift = ROOT_BITS + (level - 1) * LEVEL_BITS;
+    if ((current_tick_ & ((1ULL << shift) - 1)) != 0) {
+      break;
+    }
+    cascade(level);
+  }
+
+  size_t fired = 0;
+  int32_t slot = static_cast<int32_t>(current_tick_ & (ROOT_SLOTS - 1));
+  // 每次取槽头：回调可能取消同槽的其他定时器
+  while (slot_heads_[slot] != NIL) {
+    int32_t index = slot_heads_[slot];
+    unlink(index);
+    Node &node = nodes_[index];
+
+    Callback callback;
+    if (node.interval_ticks > 0) {
+      // 周期定时器先重新挂上，回调中可以取消
+      callback = node.callback;
+      node.expire_tick = current_tick_ + node.interval_ticks;
+      link(index);
+    } else {
+      callback = std::move(node.callback);
+      release(index);
+    }
+    // 回调可能添加定时器导致nodes_扩容，之后不能再使用node引用
+    callback();
+    fired++;
+  }
+  return fired;
+}
+
+size_t TimerWheel::advance(uint64_t now_ms) {
+  uint64_t target_tick =
+      now_ms > start_ms_ ? (now_ms - start_ms_) / tick_ms_ : 0;
+  if (active_count_ == 0) {
+    current_tick_ = std::max(current_tick_, target_tick);
+    return 0;
+  }
+
+  size_t fired = 0;
+  while (current_tick_ < target_tick) {
+    fired += step();
+  }
+  return fired;
+}
+
+int TimerWheel::next_timeout_ms(uint64_t now_ms) const {
+  if (active_count_ == 0) {
+    return -1;
+  }
+
+  // 第0层中下一个非空槽；到下一次下放之前都没有的话，以下放时刻为准
+  uint64_t next_cascade = (current_tick_ | (ROOT_SLOTS - 1)) + 1;
+  uint64_t expire_tick = next_cascade;
+  for (uint64_t tick = current_tick_ + 1; tick < next_cascade; ++tick) {
+    if (slot_heads_[tick & (ROOT_SLOTS - 1)] != NIL) {
+      expire_tick = tick;
+      break;
+    }
+  }
+
+  uint64_t expire_ms = start_ms_ + expire_tick * tick_ms_;
+  if (expire_ms <= now_ms) {
+    return 0;
+  }
+  uint64_t timeout = expire_ms - now_ms;
+  return timeout > static_cast<uint64_t>(INT32_MAX)
+             ? INT32_MAX
+             : static_cast<int>(timeout);
+}
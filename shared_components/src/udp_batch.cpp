@@ -0,0 +1,137 @@
+#include "udp_batch.h"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <system_error>
+#include <unistd.h>
+
+UdpBatchSocket::UdpBatchSocket()
+    : buffers_(BATCH_SIZE * MAX_DATAGRAM_SIZE) {}
+
+UdpBatchSocket::~UdpBatchSocket() {
+  if (fd_ >= 0) {
+    close(fd_);
+  }
+}
+
+bool UdpBatchSocket::open_socket() {
+  if (fd_ >= 0) {
+    return true;
+  }
+  fd_ = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd_ < 0) {
+    std::error_code ec(errno, std::system_category());
+    std::cerr << "udp socket failed..." << ec.message() << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool UdpBatchSocket::bind(int port, int recv_buffer_bytes) {
+  if (!open_socket()) {
+    return false;
+  }
+  // 设置失败只影响突发时的丢包率，不影响功能
+  setsockopt(fd_, SOL_SOCKET, SO_RCVBUF, &recv_buffer_bytes,
+             sizeof(recv_buffer_bytes));
+  struct sockaddr_in addr {};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = INADDR_ANY;
+  addr.sin_port = htons(static_cast<uint16_t>(port));
+  if (::bind(fd_, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+    std::error_code ec(errno, std::system_category());
+    std::cerr << "udp bind failed..." << ec.message() << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool UdpBatchSocket::connect(const std::string &address, uint16_t port) {
+  if (!open_socket()) {
+    return false;
+  }
+  struct sockaddr_in addr {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  if (inet_pton(AF_INET, address.c_str(), &addr.sin_addr) <= 0) {
+    std::cerr << "Invalid IPv4 address: " << address << std::endl;
+    return false;
+  }
+  if (::connect(fd_, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+    std::error_code ec(errno, std::system_category());
+    std::cerr << "udp connect failed..." << ec.message() << std::endl;
+    return false;
+  }
+  return true;
+}
+
+int UdpBatchSocket::receive(const Handler &handler, int max_batches) {
+  int total = 0;
+  for (int batch = 0; batch < max_batches; ++batch) {
+    for (size_t i = 0; i < BATCH_SIZE; ++i) {
+      iovecs_[i].iov_base = buffers_.data() + i * MAX_DATAGRAM_SIZE;
+      iovecs_[i].iov_len = MAX_DATAGRAM_SIZE;
+      messages_[i].msg_hdr = {};
+      messages_[i].msg_hdr.msg_iov = &iovecs_[i];
+      messages_[i].msg_hdr.msg_iovlen = 1;
+      messages_[i].msg_hdr.msg_name = &sources_[i];
+      messages_[i].msg_hdr.msg_namelen = sizeof(sources_[i]);
+    }
+    int count = recvmmsg(fd_, messages_.data(), BATCH_SIZE, MSG_DONTWAIT,
+                         nullptr);
+    if (count < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+        break;
+      }
+      std::error_code ec(errno, std::system_category());
+      std::cerr << "recvmmsg failed..." << ec.message() << std::endl;
+      return total > 0 ? total : -1;
+    }
+    receive_calls_++;
+    for (int i = 0; i < count; ++i) {
+      // 超过MAX_DATAGRAM_SIZE的数据报被截断，内容不完整，丢弃
+      if (messages_[i].msg_hdr.msg_flags & MSG_TRUNC) {
+        continue;
+      }
+      handler(std::string_view(static_cast<char *>(iovecs_[i].iov_base),
+                               messages_[i].msg_len),
+              sources_[i]);
+      total++;
+    }
+    received_datagrams_ += static_cast<uint64_t>(count);
+    if (static_cast<size_t>(count) < BATCH_SIZE) {
+      break; // 已经读空
+    }
+  }
+  return total;
+}
+
+size_t UdpBatchSocket::send_batch(const std::vector<std::string> &datagrams) {
+  size_t sent = 0;
+  while (sent < datagrams.size()) {
+    size_t count = std::min(BATCH_SIZE, datagrams.size() - sent);
+    std::array<struct mmsghdr, BATCH_SIZE> messages{};
+    std::array<struct iovec, BATCH_SIZE> iovecs{};
+    for (size_t i = 0; i < count; ++i) {
+      const std::string &datagram = datagrams[sent + i];
+      iovecs[i].iov_base = const_cast<char *>(datagram.data());
+      iovecs[i].iov_len = datagram.size();
+      messages[i].msg_hdr.msg_iov = &iovecs[i];
+      messages[i].msg_hdr.msg_iovlen = 1;
+    }
+    int n = sendmmsg(fd_, messages.data(), static_cast<unsigned>(count),
+                     MSG_DONTWAIT);
+    if (n <= 0) {
+      if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+        std::error_code ec(errno, std::system_category());
+        std::cerr << "sendmmsg failed..." << ec.message() << std::endl;
+      }
+      break;
+    }
+    sent += static_cast<size_t>(n);
+  }
+  return sent;
+}
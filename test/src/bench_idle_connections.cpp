@@ -0,0 +1,252 @@
+// 空闲连接容量测试：向运行中的EMS_server建立N条长连接并保持空闲，
+// 统计服务端每连接占用的内存（RSS增量），然后逐轮让所有连接各发一次心跳，
+// 统计服务端处理心跳消耗的CPU时间。
+//
+// 用法: bench_idle_connections <服务端pid> [连接数=100000] [端口=9000] [心跳轮数=3]
+//
+// 测试10万连接的准备：
+//   1. 服务端关闭单IP限速并放开文件数限制：
+//        ulimit -Hn 200000
+//        EMS_ACCEPT_RATE_PER_IP=0 EMS_MAX_OPEN_FILES=200000 ./EMS_server
+//      （服务端启动时自动把软限制提升到EMS_MAX_OPEN_FILES或硬限制，
+//       连接数上限默认按该值自动计算）
+//   2. 本程序同样需要足够的文件数，启动时自动提升到硬限制。
+//   3. 单个源地址只有约2.8万个临时端口，本程序轮流绑定127.0.0.1~127.0.0.N
+//      作为源地址，每个地址最多CONNECTIONS_PER_SOURCE条连接。
+//
+// 连接默认按Qt客户端处理，心跳使用QT_HEARTBEAT（服务端回复QT_HEARTBEAT_RESPONSE）。
+// CPU时间取自/proc/<pid>/stat的utime+stime，包含服务端在此期间的所有工作，
+// 测试时不要有其他客户端。
+#include "epoll.h"
+#include "protocol_parser.h"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <netinet/in.h>
+#include <sstream>
+#include <string>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+constexpr int CONNECTIONS_PER_SOURCE = 25000;
+
+struct BenchConfig {
+  int server_pid = 0;
+  int connections = 100000;
+  int port = 9000;
+  int rounds = 3;
+};
+
+// 服务端常驻内存（KB），读取失败返回-1
+long read_rss_kb(int pid) {
+  std::ifstream status("/proc/" + std::to_string(pid) + "/status");
+  std::string line;
+  while (std::getline(status, line)) {
+    if (line.rfind("VmRSS:", 0) == 0) {
+      return std::atol(line.c_str() + 6);
+    }
+  }
+  return -1;
+}
+
+// 服务端累计CPU时间（秒）：utime + stime
+double read_cpu_seconds(int pid) {
+  std::ifstream stat("/proc/" + std::to_string(pid) + "/stat");
+  std::string content((std::istreambuf_iterator<char>(stat)),
+                      std::istreambuf_iterator<char>());
+  // 进程名可能包含空格，从最后一个')'之后开始解析
+  size_t pos = content.rfind(')');
+  if (pos == std::string::npos) {
+    return -1;
+  }
+  std::istringstream fields(content.substr(pos + 2));
+  std::string field;
+  unsigned long utime = 0;
+  unsigned long stime = 0;
+  // ')'之后第1个字段是state（第3列），utime/stime是第14、15列
+  for (int i = 3; i <= 15 && fields >> field; ++i) {
+    if (i == 14) {
+      utime = std::stoul(field);
+    } else if (i == 15) {
+      stime = std::stoul(field);
+    }
+  }
+  return static_cast<double>(utime + stime) / sysconf(_SC_CLK_TCK);
+}
+
+void raise_fd_limit() {
+  struct rlimit limit {};
+  if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+  }
+}
+
+int connect_one(const BenchConfig &config, int index) {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0) {
+    return -1;
+  }
+  // 源地址轮换，避免单个源地址的临时端口耗尽
+  struct sockaddr_in local {};
+  local.sin_family = AF_INET;
+  local.sin_addr.s_addr =
+      htonl(INADDR_LOOPBACK + index / CONNECTIONS_PER_SOURCE);
+  int one = 1;
+  setsockopt(fd, IPPROTO_IP, IP_BIND_ADDRESS_NO_PORT, &one, sizeof(one));
+  struct sockaddr_in server {};
+  server.sin_family = AF_INET;
+  server.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  server.sin_port = htons(static_cast<uint16_t>(config.port));
+  if (bind(fd, (struct sockaddr *)&local, sizeof(local)) < 0 ||
+      connect(fd, (struct sockaddr *)&server, sizeof(server)) < 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+// 每条连接读完一个完整帧（长度头+消息体）
+bool wait_responses(Epoll &epoll, std::vector<int> &remaining_bytes,
+                    int expected) {
+  std::vector<epoll_event> events(epoll.get_epoll_max_events());
+  std::vector<char> buffer(4096);
+  int done = 0;
+  while (done < expected) {
+    int nfds = epoll.wait_events(events.data(), 5000);
+    if (nfds <= 0) {
+      std::cerr << "等待响应超时，已完成 " << done << "/" << expected
+                << std::endl;
+      return false;
+    }
+    for (int i = 0; i < nfds; ++i) {
+      int fd = events[i].data.fd;
+      ssize_t n = recv(fd, buffer.data(), buffer.size(), MSG_DONTWAIT);
+      if (n <= 0) {
+        continue;
+      }
+      // 只处理每轮一个响应的简单情况：先读长度头，再读到消息体结束
+      int &left = remaining_bytes[fd];
+      if (left < 0) {
+        uint32_t net_len;
+        memcpy(&net_len, buffer.data(), sizeof(net_len));
+        left = static_cast<int>(ntohl(net_len) + sizeof(net_len));
+      }
+      left -= static_cast<int>(n);
+      if (left <= 0) {
+        left = -1;
+        done++;
+      }
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    std::cerr << "用法: " << argv[0]
+              << " <服务端pid> [连接数=100000] [端口=9000] [心跳轮数=3]"
+              << std::endl;
+    return 1;
+  }
+  BenchConfig config;
+  config.server_pid = std::atoi(argv[1]);
+  if (argc > 2) {
+    config.connections = std::atoi(argv[2]);
+  }
+  if (argc > 3) {
+    config.port = std::atoi(argv[3]);
+  }
+  if (argc > 4) {
+    config.rounds = std::atoi(argv[4]);
+  }
+  raise_fd_limit();
+
+  std::cout << "=== 空闲连接容量测试 ===" << std::endl;
+  long rss_before = read_rss_kb(config.server_pid);
+  if (rss_before < 0) {
+    std::cerr << "无法读取服务端进程信息: pid=" << config.server_pid
+              << std::endl;
+    return 1;
+  }
+
+  // 建立连接
+  auto start = std::chrono::steady_clock::now();
+  std::vector<int> fds;
+  fds.reserve(config.connections);
+  for (int i = 0; i < config.connections; ++i) {
+    int fd = connect_one(config, i);
+    if (fd < 0) {
+      std::cerr << "第 " << i << " 条连接失败: " << strerror(errno)
+                << std::endl;
+      break;
+    }
+    fds.push_back(fd);
+  }
+  std::chrono::duration<double> connect_time =
+      std::chrono::steady_clock::now() - start;
+  int count = static_cast<int>(fds.size());
+  std::cout << "已建立连接: " << count << ", 耗时=" << connect_time.count()
+            << "s" << std::endl;
+  if (count == 0) {
+    return 1;
+  }
+
+  Epoll epoll(1024);
+  epoll.initialize();
+  int max_fd = 0;
+  for (int fd : fds) {
+    epoll.add_epoll(fd, EPOLLIN);
+    max_fd = std::max(max_fd, fd);
+  }
+  std::vector<int> remaining_bytes(max_fd + 1, -1);
+
+  std::string body = std::to_string(ProtocolParser::CLIENT_QT_CLIENT) + "|" +
+                     std::to_string(ProtocolParser::QT_HEARTBEAT) +
+                     "|bench|";
+  std::vector<char> heartbeat = ProtocolParser::pack_message(body);
+
+  // 心跳轮次：第一轮之后连接的接收缓冲区等都已分配，再统计内存
+  for (int round = 0; round < config.rounds; ++round) {
+    double cpu_before = read_cpu_seconds(config.server_pid);
+    auto round_start = std::chrono::steady_clock::now();
+    for (int fd : fds) {
+      send(fd, heartbeat.data(), heartbeat.size(), MSG_NOSIGNAL);
+    }
+    if (!wait_responses(epoll, remaining_bytes, count)) {
+      break;
+    }
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - round_start;
+    double cpu = read_cpu_seconds(config.server_pid) - cpu_before;
+    std::cout << "心跳轮 " << round + 1 << ": 耗时=" << elapsed.count()
+              << "s, 服务端CPU=" << cpu << "s, 每次心跳="
+              << cpu * 1e6 / count << "us" << std::endl;
+  }
+
+  // 等服务端日志等异步工作平稳后再读内存
+  std::this_thread::sleep_for(std::chrono::seconds(1));
+  long rss_after = read_rss_kb(config.server_pid);
+  std::cout << "服务端RSS: 连接前=" << rss_before << "KB, 连接后=" << rss_after
+            << "KB, 每连接=" << (rss_after - rss_before) * 1024.0 / count
+            << " 字节" << std::endl;
+
+  for (int fd : fds) {
+    close(fd);
+  }
+  return 0;
+}
@@ -0,0 +1,239 @@
+// epoll与io_uring事件后端对比：N条回环TCP连接，客户端每轮向所有连接各发一条
+// 固定长度消息，服务端回显，统计总耗时和每秒消息数。
+//
+// 用法: bench_io_backend [连接数=1000] [轮数=200] [消息长度=64]
+#include "epoll.h"
+#include "io_uring.h"
+#include "socket.h"
+
+#include <arpa/inet.h>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+struct BenchConfig {
+  int connections = 1000;
+  int rounds = 200;
+  size_t message_size = 64;
+};
+
+// 建立N对回环连接，返回(客户端fd, 服务端fd)
+bool create_connection_pairs(int count, std::vector<int> &client_fds,
+                             std::vector<int> &server_fds) {
+  int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (listen_fd < 0) {
+    return false;
+  }
+  struct sockaddr_in addr {};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = 0;
+  socklen_t len = sizeof(addr);
+  if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+      listen(listen_fd, 4096) < 0 ||
+      getsockname(listen_fd, (struct sockaddr *)&addr, &len) < 0) {
+    close(listen_fd);
+    return false;
+  }
+
+  for (int i = 0; i < count; ++i) {
+    int client_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (client_fd < 0 ||
+        connect(client_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+      std::cerr << "连接失败: " << strerror(errno) << std::endl;
+      close(listen_fd);
+      return false;
+    }
+    int one = 1;
+    setsockopt(client_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    int server_fd = accept(listen_fd, nullptr, nullptr);
+    if (server_fd < 0) {
+      close(listen_fd);
+      return false;
+    }
+    setsockopt(server_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    Socket::set_nonblock(server_fd);
+    client_fds.push_back(client_fd);
+    server_fds.push_back(server_fd);
+  }
+  close(listen_fd);
+  return true;
+}
+
+// 客户端：逐轮发送并等待全部回显
+void run_client(const BenchConfig &config, const std::vector<int> &client_fds) {
+  std::vector<char> message(config.message_size, 'x');
+  std::vector<char> reply(config.message_size);
+  for (int round = 0; round < config.rounds; ++round) {
+    for (int fd : client_fds) {
+      send(fd, message.data(), message.size(), MSG_NOSIGNAL);
+    }
+    for (int fd : client_fds) {
+      size_t received = 0;
+      while (received < reply.size()) {
+        ssize_t n = recv(fd, reply.data() + received, reply.size() - received,
+                         0);
+        if (n <= 0) {
+          return;
+        }
+        received += static_cast<size_t>(n);
+      }
+    }
+  }
+}
+
+// epoll后端：ET模式读到EAGAIN，读到多少回显多少
+void run_epoll_server(const std::vector<int> &server_fds, size_t total_bytes) {
+  Epoll epoll;
+  epoll.initialize();
+  for (int fd : server_fds) {
+    epoll.add_epoll(fd, EPOLLIN | EPOLLET);
+  }
+  std::vector<epoll_event> events(epoll.get_epoll_max_events());
+  char buffer[2048];
+  size_t echoed = 0;
+  while (echoed < total_bytes) {
+    int nfds = epoll.wait_events(events.data(), 1000);
+    for (int i = 0; i < nfds; ++i) {
+      int fd = events[i].data.fd;
+      while (true) {
+        ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+        if (n <= 0) {
+          break;
+        }
+        send(fd, buffer, static_cast<size_t>(n), MSG_NOSIGNAL);
+        echoed += static_cast<size_t>(n);
+      }
+    }
+  }
+}
+
+// io_uring后端：multishot recv到provided buffer，直接从该缓冲区提交send，
+// send完成后归还缓冲区
+void run_uring_server(IoUring &uring, const std::vector<int> &server_fds,
+                      size_t total_bytes) {
+  constexpr uint64_t SEND_FLAG = 1ULL << 63;
+  for (int fd : server_fds) {
+    uring.submit_multishot_recv(fd, static_cast<uint64_t>(fd));
+  }
+  std::vector<IoUring::Completion> completions(1024);
+  size_t echoed = 0;
+  while (echoed < total_bytes) {
+    int count = uring.wait_completions(
+        completions.data(), static_cast<int>(completions.size()), 1000);
+    if (count < 0) {
+      std::cerr << "io_uring等待失败: " << strerror(errno) << std::endl;
+      return;
+    }
+    for (int i = 0; i < count; ++i) {
+      const IoUring::Completion &c = completions[i];
+      if (c.user_data & SEND_FLAG) {
+        // send完成，归还缓冲区（buffer id保存在user_data中）
+        uring.recycle_buffer(static_cast<uint16_t>(c.user_data >> 32));
+        continue;
+      }
+      int fd = static_cast<int>(c.user_data);
+      if (c.res > 0 && c.has_buffer()) {
+        uint64_t send_data = SEND_FLAG |
+                             (static_cast<uint64_t>(c.buffer_id()) << 32) |
+                             static_cast<uint32_t>(fd);
+        uring.submit_send(fd, uring.buffer_data(c.buffer_id()),
+                          static_cast<size_t>(c.res), send_data);
+        echoed += static_cast<size_t>(c.res);
+      } else if (c.has_buffer()) {
+        uring.recycle_buffer(c.buffer_id());
+      }
+      if (!c.has_more() && (c.res > 0 || c.res == -ENOBUFS)) {
+        uring.submit_multishot_recv(fd, static_cast<uint64_t>(fd));
+      }
+    }
+  }
+  // 最后一批send还在提交队列中
+  uring.flush_submissions();
+}
+
+void report(const char *backend, const BenchConfig &config, double seconds) {
+  double messages = static_cast<double>(config.connections) * config.rounds;
+  std::cout << backend << ": 连接数=" << config.connections
+            << ", 轮数=" << config.rounds << ", 消息数=" << messages
+            << ", 耗时=" << seconds << "s, 吞吐=" << messages / seconds
+            << " msg/s" << std::endl;
+}
+
+bool run_bench(const char *backend, const BenchConfig &config) {
+  std::vector<int> client_fds;
+  std::vector<int> server_fds;
+  if (!create_connection_pairs(config.connections, client_fds, server_fds)) {
+    std::cerr << "建立连接失败，检查 ulimit -n" << std::endl;
+    return false;
+  }
+
+  size_t total_bytes = static_cast<size_t>(config.connections) *
+                       config.rounds * config.message_size;
+  bool use_uring = strcmp(backend, "io_uring") == 0;
+  IoUring uring;
+  if (use_uring && !(uring.initialize(4096) &&
+                     uring.setup_buffer_ring(4096, 2048))) {
+    std::cerr << "io_uring不可用，跳过" << std::endl;
+    for (int fd : client_fds) {
+      close(fd);
+    }
+    for (int fd : server_fds) {
+      close(fd);
+    }
+    return false;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  std::thread server([&]() {
+    if (use_uring) {
+      run_uring_server(uring, server_fds, total_bytes);
+    } else {
+      run_epoll_server(server_fds, total_bytes);
+    }
+  });
+  run_client(config, client_fds);
+  server.join();
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  report(backend, config, elapsed.count());
+
+  for (int fd : client_fds) {
+    close(fd);
+  }
+  for (int fd : server_fds) {
+    close(fd);
+  }
+  return true;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  BenchConfig config;
+  if (argc > 1) {
+    config.connections = std::atoi(argv[1]);
+  }
+  if (argc > 2) {
+    config.rounds = std::atoi(argv[2]);
+  }
+  if (argc > 3) {
+    config.message_size = static_cast<size_t>(std::atoi(argv[3]));
+  }
+
+  std::cout << "=== 事件后端性能对比 ===" << std::endl;
+  run_bench("epoll", config);
+  run_bench("io_uring", config);
+  return 0;
+}
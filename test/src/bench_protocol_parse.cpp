@@ -0,0 +1,113 @@
+// 协议解析的分配次数和耗时：对设备HEARTBEAT和POWER_REPORT帧重复解析，
+//   1. 拷贝解析：parse_message得到ParseResult，再用split_string切分payload
+//      （改动前服务端处理器的做法）
+//   2. 视图解析：parse_message到MessageView，payload字段直接取视图
+// 通过替换全局operator new统计每条消息的堆分配次数，视图解析应为0。
+//
+// 用法: bench_protocol_parse [每种消息的解析次数=1000000]
+#include "protocol_parser.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+#include <string_view>
+
+namespace {
+std::atomic<uint64_t> allocations{0};
+} // namespace
+
+void *operator new(size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void *p = std::malloc(size ? size : 1)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, size_t) noexcept { std::free(p); }
+
+namespace {
+
+// 防止编译器把解析结果当作无用计算优化掉
+volatile size_t sink = 0;
+
+struct CaseResult {
+  double ns_per_message;
+  double allocations_per_message;
+};
+
+template <typename Parse>
+CaseResult run(std::string_view frame, long iterations, Parse parse) {
+  uint64_t before = allocations.load(std::memory_order_relaxed);
+  auto start = std::chrono::steady_clock::now();
+  for (long i = 0; i < iterations; ++i) {
+    sink = sink + parse(frame);
+  }
+  std::chrono::duration<double, std::nano> elapsed =
+      std::chrono::steady_clock::now() - start;
+  uint64_t count = allocations.load(std::memory_order_relaxed) - before;
+  return {elapsed.count() / iterations,
+          static_cast<double>(count) / iterations};
+}
+
+size_t parse_copying(std::string_view frame) {
+  ProtocolParser::ParseResult result = ProtocolParser::parse_message(frame);
+  if (!result.success) {
+    return 0;
+  }
+  auto parts = ProtocolParser::split_string(result.payload, '|');
+  return result.equipment_id.size() + parts.size();
+}
+
+size_t parse_view(std::string_view frame) {
+  ProtocolParser::MessageView view;
+  if (ProtocolParser::parse_message(frame, view) != ProtocolParser::PARSE_OK) {
+    return 0;
+  }
+  return view.equipment_id.size() + view.payload_field_count();
+}
+
+void print_result(const char *name, const CaseResult &result) {
+  std::cout << "  " << name << ": " << result.ns_per_message
+            << "ns/条, 分配=" << result.allocations_per_message << "次/条"
+            << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  long iterations = 1000000;
+  if (argc > 1) {
+    iterations = std::max(1L, std::atol(argv[1]));
+  }
+
+  const std::string device = std::to_string(ProtocolParser::CLIENT_EQUIPMENT);
+  const std::string heartbeat =
+      device + "|" + std::to_string(ProtocolParser::HEARTBEAT) +
+      "|projector_101|";
+  const std::string power_report =
+      device + "|" + std::to_string(ProtocolParser::POWER_REPORT) +
+      "|projector_101|on|245|2024-01-01 00:00:00";
+
+  std::cout << "=== 协议解析: 拷贝 vs 视图 (" << iterations << "次) ==="
+            << std::endl;
+  bool ok = true;
+  for (const auto &[name, frame] :
+       {std::pair<const char *, std::string_view>{"HEARTBEAT", heartbeat},
+        {"POWER_REPORT", power_report}}) {
+    std::cout << name << " \"" << frame << "\"" << std::endl;
+    print_result("拷贝解析", run(frame, iterations, parse_copying));
+    CaseResult view = run(frame, iterations, parse_view);
+    print_result("视图解析", view);
+    ok = ok && view.allocations_per_message == 0;
+  }
+  if (!ok) {
+    std::cerr << "视图解析出现了堆分配" << std::endl;
+  }
+  return ok ? 0 : 1;
+}
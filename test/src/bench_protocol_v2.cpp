@@ -0,0 +1,109 @@
+// 文本协议v1与二进制协议v2对比：对常见消息分别统计
+//   1. 线上字节数（含4字节长度头）
+//   2. 视图解析耗时：parse_message到MessageView
+// 并检查往返一致性：v1经convert_to_v2转换后再解析，client_type、类型、设备ID
+// 和拼接回的payload都应与v1解析结果相同。
+//
+// 用法: bench_protocol_v2 [每种消息的解析次数=1000000]
+#include "protocol_parser.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+// 防止编译器把解析结果当作无用计算优化掉
+volatile size_t sink = 0;
+
+struct Sample {
+  const char *name;
+  std::vector<char> v1;
+};
+
+double parse_ns(std::string_view body, long iterations) {
+  auto start = std::chrono::steady_clock::now();
+  for (long i = 0; i < iterations; ++i) {
+    ProtocolParser::MessageView view;
+    if (ProtocolParser::parse_message(body, view) == ProtocolParser::PARSE_OK) {
+      sink = sink + view.equipment_id.size() + view.payload_field_count();
+    }
+  }
+  std::chrono::duration<double, std::nano> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count() / iterations;
+}
+
+std::string_view body_of(const std::vector<char> &packed) {
+  return std::string_view(packed.data() + 4, packed.size() - 4);
+}
+
+bool round_trip(const Sample &sample, const std::vector<char> &v2) {
+  ProtocolParser::ParseResult a =
+      ProtocolParser::parse_message(body_of(sample.v1));
+  ProtocolParser::ParseResult b = ProtocolParser::parse_message(body_of(v2));
+  bool ok = a.success && b.success && b.version == ProtocolParser::PROTOCOL_V2 &&
+            a.client_type == b.client_type && a.type == b.type &&
+            a.equipment_id == b.equipment_id && a.payload == b.payload;
+  if (!ok) {
+    std::cerr << sample.name << " 往返不一致: v1 payload=\"" << a.payload
+              << "\" v2 payload=\"" << b.payload << "\"" << std::endl;
+  }
+  return ok;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  long iterations = 1000000;
+  if (argc > 1) {
+    iterations = std::max(1L, std::atol(argv[1]));
+  }
+
+  using P = ProtocolParser;
+  const std::vector<Sample> samples = {
+      {"HEARTBEAT", P::build_heartbeat_message(P::CLIENT_EQUIPMENT,
+                                               "projector_101")},
+      {"POWER_REPORT",
+       P::build_power_report_message(P::CLIENT_EQUIPMENT, "projector_101",
+                                     "on", 245, "2024-01-01 00:00:00")},
+      {"STATUS_UPDATE",
+       P::build_status_update_message(P::CLIENT_EQUIPMENT, "projector_101",
+                                      "online", "on", "-12|0|007")},
+      {"ALERT", P::build_alert_message(P::CLIENT_EQUIPMENT, "projector_101",
+                                       10086, "power_overload", "high",
+                                       "功率超过阈值 245W > 200W")},
+      {"RESERVATION",
+       P::build_reservation_message(P::CLIENT_QT_CLIENT, "place_3",
+                                    "1001|2024-01-01 09:00:00|"
+                                    "2024-01-01 10:00:00|周例会")},
+  };
+
+  std::cout << "=== 协议v1(文本) vs v2(二进制) (" << iterations << "次) ==="
+            << std::endl;
+  bool ok = true;
+  size_t total_v1 = 0;
+  size_t total_v2 = 0;
+  for (const Sample &sample : samples) {
+    std::vector<char> v2 = P::convert_to_v2(sample.v1, 42);
+    if (v2.empty()) {
+      std::cerr << sample.name << " 转换失败" << std::endl;
+      ok = false;
+      continue;
+    }
+    ok = round_trip(sample, v2) && ok;
+    total_v1 += sample.v1.size();
+    total_v2 += v2.size();
+    std::cout << sample.name << ": 字节 v1=" << sample.v1.size()
+              << " v2=" << v2.size()
+              << ", 解析 v1=" << parse_ns(body_of(sample.v1), iterations)
+              << "ns v2=" << parse_ns(body_of(v2), iterations) << "ns"
+              << std::endl;
+  }
+  std::cout << "合计字节 v1=" << total_v1 << " v2=" << total_v2 << std::endl;
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,176 @@
+// 共享内存通道吞吐测试：向运行中的EMS_server申请N条共享内存通道，
+// 每条通道流水线发送设备心跳（在途不超过窗口），统计每秒处理的心跳数。
+// 没有内核网络栈参与，服务端CPU基本都花在分帧、解析、分发和状态更新上，
+// 适合配合perf观察这些路径。
+//
+// 用法: bench_shm_transport <握手socket路径> [通道数=8] [每通道心跳数=100000] [窗口=256]
+//
+// 服务端需要开启共享内存通道，并关闭设备消息限速：
+//   EMS_SHM_SOCKET=/tmp/ems_shm.sock EMS_MSG_RATE_EQUIPMENT=0 ./EMS_server
+// 心跳使用设备HEARTBEAT（服务端回复HEARTBEAT_RESPONSE），设备无需注册。
+// 服务端每条消息都会打印日志，建议把输出重定向到文件。
+#include "epoll.h"
+#include "message_buffer.h"
+#include "protocol_parser.h"
+#include "shm_channel.h"
+#include "socket.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+struct BenchConfig {
+  std::string shm_path;
+  int channels = 8;
+  long messages = 100000; // 每条通道
+  long window = 256;
+};
+
+struct Channel {
+  std::unique_ptr<ShmChannel> shm;
+  MessageBuffer buffer;
+  long sent = 0;
+  long received = 0;
+  size_t partial = 0; // 上一条心跳未写完的字节偏移
+};
+
+std::unique_ptr<ShmChannel> open_channel(const std::string &path) {
+  int fd = Socket::create_unix_socket();
+  if (fd < 0) {
+    return nullptr;
+  }
+  std::unique_ptr<ShmChannel> channel;
+  if (Socket::connect_to_unix_socket(fd, path)) {
+    channel = ShmChannel::receive_handshake(fd);
+  }
+  close(fd);
+  return channel;
+}
+
+// 在窗口允许的范围内尽量多写，环满时等服务端读出后的通知
+void fill_window(Channel &channel, const std::vector<char> &heartbeat,
+                 const BenchConfig &config) {
+  while (channel.sent < config.messages &&
+         channel.sent - channel.received < config.window) {
+    struct iovec iov {};
+    iov.iov_base = const_cast<char *>(heartbeat.data()) + channel.partial;
+    iov.iov_len = heartbeat.size() - channel.partial;
+    ssize_t n = channel.shm->writev(&iov, 1);
+    if (n <= 0) {
+      return;
+    }
+    channel.partial += static_cast<size_t>(n);
+    if (channel.partial == heartbeat.size()) {
+      channel.partial = 0;
+      channel.sent++;
+    }
+  }
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    std::cerr << "用法: " << argv[0]
+              << " <握手socket路径> [通道数=8] [每通道心跳数=100000] [窗口=256]"
+              << std::endl;
+    return 1;
+  }
+  BenchConfig config;
+  config.shm_path = argv[1];
+  if (argc > 2) {
+    config.channels = std::max(1, std::atoi(argv[2]));
+  }
+  if (argc > 3) {
+    config.messages = std::max(1L, std::atol(argv[3]));
+  }
+  if (argc > 4) {
+    config.window = std::max(1L, std::atol(argv[4]));
+  }
+
+  std::string body = std::to_string(ProtocolParser::CLIENT_EQUIPMENT) + "|" +
+                     std::to_string(ProtocolParser::HEARTBEAT) + "|bench|";
+  std::vector<char> heartbeat = ProtocolParser::pack_message(body);
+
+  Epoll epoll(1024);
+  if (!epoll.initialize()) {
+    return 1;
+  }
+  std::vector<std::unique_ptr<Channel>> channels;
+  for (int i = 0; i < config.channels; ++i) {
+    auto channel = std::make_unique<Channel>();
+    channel->shm = open_channel(config.shm_path);
+    if (!channel->shm) {
+      std::cerr << "第 " << i << " 条通道申请失败: " << config.shm_path
+                << std::endl;
+      return 1;
+    }
+    epoll.add_epoll(channel->shm->notify_fd(), EPOLLIN | EPOLLET,
+                    channel.get());
+    channels.push_back(std::move(channel));
+  }
+
+  std::cout << "=== 共享内存通道: " << config.channels << "通道×"
+            << config.messages << "心跳, 窗口=" << config.window
+            << " ===" << std::endl;
+  auto start = std::chrono::steady_clock::now();
+  for (auto &channel : channels) {
+    fill_window(*channel, heartbeat, config);
+  }
+  long total = static_cast<long>(config.channels) * config.messages;
+  long done = 0;
+  std::string_view frame;
+  while (done < total) {
+    int nfds = epoll.wait(5000);
+    if (nfds <= 0) {
+      std::cerr << "等待响应超时，已完成 " << done << "/" << total
+                << std::endl;
+      return 1;
+    }
+    for (int i = 0; i < nfds; ++i) {
+      auto *channel = static_cast<Channel *>(epoll.events()[i].data.ptr);
+      // eventfd也表示服务端腾出了空间：读到EAGAIN后再补满窗口
+      while (true) {
+        ssize_t n = channel->buffer.read_with(
+            [channel](const struct iovec *iov, int iov_count) {
+              return channel->shm->readv(iov, iov_count);
+            });
+        if (n == 0) {
+          std::cerr << "服务端关闭了通道" << std::endl;
+          return 1;
+        }
+        if (n < 0) {
+          break;
+        }
+        while (channel->buffer.next_frame(frame)) {
+          channel->received++;
+          done++;
+        }
+      }
+      fill_window(*channel, heartbeat, config);
+    }
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  uint64_t notifications = 0;
+  for (auto &channel : channels) {
+    notifications += channel->shm->notifications();
+  }
+  std::cout << "耗时=" << elapsed.count() << "s, 心跳/秒="
+            << static_cast<long>(total / elapsed.count())
+            << ", 本端eventfd唤醒=" << notifications << std::endl;
+  for (auto &channel : channels) {
+    close(channel->shm->notify_fd());
+  }
+  return 0;
+}
@@ -0,0 +1,215 @@
+// 功耗上报接收路径对比：同一进程内发送N条功耗报告，统计服务端接收路径每秒处理的条数
+//   1. TCP回环：长度头分帧，MessageBuffer::read_from_fd + next_frame + parse_message
+//   2. UDP：sendmmsg/recvmmsg批量收发（UdpBatchSocket），拆出令牌后parse_message
+//
+// 用法: bench_udp_ingest [条数=1000000] [UDP在途窗口=4096]
+//
+// 不需要运行中的EMS_server：UDP上报要先经TCP上线拿到令牌，
+// 测试环境通常没有注册设备，这里只比较两条接收路径本身的开销（系统调用+分帧+解析）。
+// UDP允许丢包，发送端按窗口控制在途数量，避免接收缓冲区溢出使结果失真；
+// 仍有丢失时在结果中给出实际收到的条数。
+#include "message_buffer.h"
+#include "protocol_parser.h"
+#include "udp_batch.h"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <netinet/in.h>
+#include <poll.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+constexpr int SEND_CHUNK = 64; // 每次发送的报告数，与UdpBatchSocket::BATCH_SIZE一致
+
+struct BenchConfig {
+  long samples = 1000000;
+  long udp_window = 4096;
+};
+
+std::string make_body(long index) {
+  return std::to_string(ProtocolParser::CLIENT_EQUIPMENT) + "|" +
+         std::to_string(ProtocolParser::POWER_REPORT) + "|dev" +
+         std::to_string(index % 1000) + "|on|" + std::to_string(index % 2000) +
+         "|2024-01-01 00:00:00";
+}
+
+void print_result(const char *name, long sent, long received,
+                  std::chrono::duration<double> elapsed) {
+  std::cout << name << ": 发送=" << sent << ", 收到=" << received
+            << ", 耗时=" << elapsed.count() << "s, 条/秒="
+            << static_cast<long>(received / elapsed.count()) << std::endl;
+}
+
+// 本地回环上的一对TCP连接，失败返回false
+bool tcp_pair(int &client, int &server) {
+  int listener = socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in addr {};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t len = sizeof(addr);
+  if (listener < 0 || bind(listener, (struct sockaddr *)&addr, len) < 0 ||
+      listen(listener, 1) < 0 ||
+      getsockname(listener, (struct sockaddr *)&addr, &len) < 0) {
+    return false;
+  }
+  client = socket(AF_INET, SOCK_STREAM, 0);
+  bool ok = client >= 0 &&
+            connect(client, (struct sockaddr *)&addr, sizeof(addr)) == 0 &&
+            (server = accept(listener, nullptr, nullptr)) >= 0;
+  close(listener);
+  return ok;
+}
+
+bool run_tcp(const BenchConfig &config) {
+  int client = -1;
+  int server = -1;
+  if (!tcp_pair(client, server)) {
+    std::cerr << "TCP连接失败: " << strerror(errno) << std::endl;
+    return false;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  std::thread sender([&config, client]() {
+    std::vector<char> chunk;
+    for (long i = 0; i < config.samples;) {
+      chunk.clear();
+      for (int n = 0; n < SEND_CHUNK && i < config.samples; ++n, ++i) {
+        std::vector<char> frame = ProtocolParser::pack_message(make_body(i));
+        chunk.insert(chunk.end(), frame.begin(), frame.end());
+      }
+      size_t offset = 0;
+      while (offset < chunk.size()) {
+        ssize_t n = send(client, chunk.data() + offset, chunk.size() - offset,
+                         MSG_NOSIGNAL);
+        if (n <= 0) {
+          return;
+        }
+        offset += static_cast<size_t>(n);
+      }
+    }
+  });
+
+  MessageBuffer buffer;
+  std::string_view frame;
+  long received = 0;
+  while (received < config.samples) {
+    if (buffer.read_from_fd(server) <= 0) {
+      break;
+    }
+    while (buffer.next_frame(frame)) {
+      if (ProtocolParser::parse_message(frame).success) {
+        received++;
+      }
+    }
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  sender.join();
+  close(client);
+  close(server);
+  print_result("TCP", config.samples, received, elapsed);
+  return received == config.samples;
+}
+
+bool run_udp(const BenchConfig &config) {
+  UdpBatchSocket receiver;
+  if (!receiver.bind(0)) {
+    return false;
+  }
+  struct sockaddr_in addr {};
+  socklen_t len = sizeof(addr);
+  getsockname(receiver.fd(), (struct sockaddr *)&addr, &len);
+
+  UdpBatchSocket client;
+  if (!client.connect("127.0.0.1", ntohs(addr.sin_port))) {
+    return false;
+  }
+
+  std::atomic<long> received{0};
+  std::atomic<bool> sender_done{false};
+  long sent = 0;
+  auto start = std::chrono::steady_clock::now();
+  std::thread sender([&]() {
+    const std::string token = "0123456789abcdef";
+    std::vector<std::string> datagrams;
+    while (sent < config.samples) {
+      // 在途数量超过窗口时等待接收端追上
+      if (sent - received.load(std::memory_order_relaxed) >=
+          config.udp_window) {
+        std::this_thread::yield();
+        continue;
+      }
+      datagrams.clear();
+      for (int n = 0; n < SEND_CHUNK && sent + n < config.samples; ++n) {
+        datagrams.push_back(make_body(sent + n) + "|" + token);
+      }
+      size_t count = client.send_batch(datagrams);
+      if (count == 0) {
+        std::this_thread::yield();
+      }
+      sent += static_cast<long>(count);
+    }
+    sender_done.store(true, std::memory_order_release);
+  });
+
+  auto handler = [&received](std::string_view datagram, const sockaddr_in &) {
+    std::string_view body;
+    std::string_view token;
+    if (ProtocolParser::split_udp_token(datagram, body, token) &&
+        ProtocolParser::parse_message(body).success) {
+      received.fetch_add(1, std::memory_order_relaxed);
+    }
+  };
+  struct pollfd pfd {};
+  pfd.fd = receiver.fd();
+  pfd.events = POLLIN;
+  // 发送结束后100ms内没有新数据报即认为剩余的已丢失
+  while (received.load(std::memory_order_relaxed) < config.samples) {
+    int timeout = sender_done.load(std::memory_order_acquire) ? 100 : 1000;
+    if (poll(&pfd, 1, timeout) <= 0) {
+      if (sender_done.load(std::memory_order_acquire)) {
+        break;
+      }
+      continue;
+    }
+    receiver.receive(handler, 16);
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  sender.join();
+  print_result("UDP", sent, received.load(), elapsed);
+  std::cout << "UDP recvmmsg调用=" << receiver.receive_calls()
+            << ", 平均每次数据报="
+            << static_cast<double>(receiver.received_datagrams()) /
+                   std::max<uint64_t>(1, receiver.receive_calls())
+            << std::endl;
+  return received.load() > 0;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  BenchConfig config;
+  if (argc > 1) {
+    config.samples = std::max(1L, std::atol(argv[1]));
+  }
+  if (argc > 2) {
+    config.udp_window = std::max(1L, std::atol(argv[2]));
+  }
+
+  std::cout << "=== 功耗上报接收路径: TCP分帧 vs UDP批量 ===" << std::endl;
+  bool ok = run_tcp(config);
+  ok = run_udp(config) && ok;
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,216 @@
+// TCP回环与Unix域socket的心跳路径对比：分别通过两种方式连接运行中的EMS_server，
+//   1. 单连接一问一答：统计心跳往返时延（p50/p99）
+//   2. N条连接每轮各发一次心跳并等齐响应：统计每秒处理的心跳数
+//
+// 用法: bench_uds_heartbeat <TCP端口> <Unix域socket路径> [连接数=100] [轮数=1000]
+//
+// 服务端需要同时监听两者，并关闭设备消息限速：
+//   EMS_UNIX_SOCKET=/tmp/ems.sock EMS_MSG_RATE_EQUIPMENT=0 ./EMS_server
+// 心跳使用设备HEARTBEAT（服务端回复HEARTBEAT_RESPONSE），设备无需注册。
+// 服务端每条消息都会打印日志，建议把输出重定向到文件。
+#include "epoll.h"
+#include "protocol_parser.h"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+struct BenchConfig {
+  int port = 9000;
+  std::string unix_path;
+  int connections = 100;
+  int rounds = 1000;
+};
+
+// 阻塞连接，失败返回-1
+int connect_tcp(int port) {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0) {
+    return -1;
+  }
+  struct sockaddr_in addr {};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons(static_cast<uint16_t>(port));
+  if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+    close(fd);
+    return -1;
+  }
+  int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  return fd;
+}
+
+int connect_unix(const std::string &path) {
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) {
+    return -1;
+  }
+  struct sockaddr_un addr {};
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+  if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+// 阻塞读满一个响应帧
+bool read_frame(int fd, std::vector<char> &buffer) {
+  uint32_t net_len;
+  if (recv(fd, &net_len, sizeof(net_len), MSG_WAITALL) !=
+      static_cast<ssize_t>(sizeof(net_len))) {
+    return false;
+  }
+  size_t len = ntohl(net_len);
+  buffer.resize(len);
+  return len == 0 ||
+         recv(fd, buffer.data(), len, MSG_WAITALL) == static_cast<ssize_t>(len);
+}
+
+double percentile(std::vector<double> &samples, double p) {
+  if (samples.empty()) {
+    return 0;
+  }
+  size_t index = static_cast<size_t>(p * (samples.size() - 1));
+  std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+  return samples[index];
+}
+
+// 单连接一问一答的往返时延
+bool run_ping_pong(const char *name, int fd, const std::vector<char> &heartbeat,
+                   int rounds) {
+  std::vector<char> response;
+  std::vector<double> samples;
+  samples.reserve(rounds);
+  for (int i = 0; i < rounds; ++i) {
+    auto start = std::chrono::steady_clock::now();
+    if (send(fd, heartbeat.data(), heartbeat.size(), MSG_NOSIGNAL) < 0 ||
+        !read_frame(fd, response)) {
+      std::cerr << name << " 一问一答失败: " << strerror(errno) << std::endl;
+      return false;
+    }
+    std::chrono::duration<double, std::micro> rtt =
+        std::chrono::steady_clock::now() - start;
+    samples.push_back(rtt.count());
+  }
+  std::cout << name << " 往返时延: p50=" << percentile(samples, 0.5)
+            << "us, p99=" << percentile(samples, 0.99) << "us" << std::endl;
+  return true;
+}
+
+// N条连接每轮各发一次心跳，等所有连接都收到响应后进入下一轮
+bool run_fan_out(const char *name, const std::vector<int> &fds,
+                 const std::vector<char> &heartbeat, int rounds) {
+  Epoll epoll(1024);
+  if (!epoll.initialize()) {
+    return false;
+  }
+  for (int fd : fds) {
+    epoll.add_epoll(fd, EPOLLIN);
+  }
+  std::vector<epoll_event> events(epoll.get_epoll_max_events());
+  // 响应长度固定，按字节数计数即可
+  std::vector<char> response;
+  if (send(fds[0], heartbeat.data(), heartbeat.size(), MSG_NOSIGNAL) < 0 ||
+      !read_frame(fds[0], response)) {
+    return false;
+  }
+  const size_t frame_size = response.size() + sizeof(uint32_t);
+  std::vector<char> buffer(64 * 1024);
+
+  auto start = std::chrono::steady_clock::now();
+  for (int round = 0; round < rounds; ++round) {
+    for (int fd : fds) {
+      send(fd, heartbeat.data(), heartbeat.size(), MSG_NOSIGNAL);
+    }
+    size_t expected = frame_size * fds.size();
+    size_t received = 0;
+    while (received < expected) {
+      int nfds = epoll.wait_events(events.data(), 5000);
+      if (nfds <= 0) {
+        std::cerr << name << " 等待响应超时" << std::endl;
+        return false;
+      }
+      for (int i = 0; i < nfds; ++i) {
+        ssize_t n = recv(events[i].data.fd, buffer.data(), buffer.size(),
+                         MSG_DONTWAIT);
+        if (n > 0) {
+          received += static_cast<size_t>(n);
+        }
+      }
+    }
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  double total = static_cast<double>(fds.size()) * rounds;
+  std::cout << name << " " << fds.size() << "连接×" << rounds
+            << "轮: 耗时=" << elapsed.count()
+            << "s, 心跳/秒=" << static_cast<long>(total / elapsed.count())
+            << std::endl;
+  return true;
+}
+
+bool run_transport(const char *name, const BenchConfig &config, bool use_unix,
+                   const std::vector<char> &heartbeat) {
+  std::vector<int> fds;
+  for (int i = 0; i < config.connections; ++i) {
+    int fd = use_unix ? connect_unix(config.unix_path) : connect_tcp(config.port);
+    if (fd < 0) {
+      std::cerr << name << " 第 " << i << " 条连接失败: " << strerror(errno)
+                << std::endl;
+      break;
+    }
+    fds.push_back(fd);
+  }
+  bool ok = !fds.empty() && run_ping_pong(name, fds[0], heartbeat,
+                                          config.rounds) &&
+            run_fan_out(name, fds, heartbeat, config.rounds);
+  for (int fd : fds) {
+    close(fd);
+  }
+  return ok;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  if (argc < 3) {
+    std::cerr << "用法: " << argv[0]
+              << " <TCP端口> <Unix域socket路径> [连接数=100] [轮数=1000]"
+              << std::endl;
+    return 1;
+  }
+  BenchConfig config;
+  config.port = std::atoi(argv[1]);
+  config.unix_path = argv[2];
+  if (argc > 3) {
+    config.connections = std::max(1, std::atoi(argv[3]));
+  }
+  if (argc > 4) {
+    config.rounds = std::max(1, std::atoi(argv[4]));
+  }
+
+  std::string body = std::to_string(ProtocolParser::CLIENT_EQUIPMENT) + "|" +
+                     std::to_string(ProtocolParser::HEARTBEAT) + "|bench|";
+  std::vector<char> heartbeat = ProtocolParser::pack_message(body);
+
+  std::cout << "=== 心跳路径: TCP回环 vs Unix域socket ===" << std::endl;
+  bool ok = run_transport("TCP", config, false, heartbeat);
+  ok = run_transport("UDS", config, true, heartbeat) && ok;
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,180 @@
+// 大响应的发送开销：同一进程内通过TCP回环发送多MB消息，接收线程只管读空，
+// 比较OutputQueue普通发送（sendmsg拷贝到内核）与零拷贝发送（MSG_ZEROCOPY）
+// 时发送线程消耗的CPU时间（用户态+内核态，按线程统计）。
+//
+// 用法: bench_zerocopy_send [每种大小的消息数=64] [消息大小MB...=1 4 16]
+//
+// 注意：回环上的接收方在本机，内核投递时仍要拷贝一次，完成通知会带
+// SO_EE_CODE_ZEROCOPY_COPIED（结果中的“退回拷贝”）。这时发送线程的CPU
+// 即使下降，也只是把拷贝挪到了投递路径上，还多了锁页和完成通知的开销；
+// 实际收益要在真实网卡上跨机测试。
+#include "output_queue.h"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <memory>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+struct BenchConfig {
+  long messages = 64;
+  std::vector<size_t> sizes_mb{1, 4, 16};
+};
+
+// 本地回环上的一对TCP连接，失败返回false
+bool tcp_pair(int &client, int &server) {
+  int listener = socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in addr {};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t len = sizeof(addr);
+  if (listener < 0 || bind(listener, (struct sockaddr *)&addr, len) < 0 ||
+      listen(listener, 1) < 0 ||
+      getsockname(listener, (struct sockaddr *)&addr, &len) < 0) {
+    return false;
+  }
+  client = socket(AF_INET, SOCK_STREAM, 0);
+  bool ok = client >= 0 &&
+            connect(client, (struct sockaddr *)&addr, sizeof(addr)) == 0 &&
+            (server = accept(listener, nullptr, nullptr)) >= 0;
+  close(listener);
+  return ok;
+}
+
+double thread_cpu_seconds() {
+  struct rusage usage {};
+  getrusage(RUSAGE_THREAD, &usage);
+  return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+         (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+bool run_case(const char *name, size_t message_bytes, long messages,
+              bool zerocopy) {
+  int sender = -1;
+  int receiver = -1;
+  if (!tcp_pair(sender, receiver)) {
+    std::cerr << "TCP连接失败: " << strerror(errno) << std::endl;
+    return false;
+  }
+  int one = 1;
+  if (zerocopy &&
+      setsockopt(sender, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) < 0) {
+    std::cerr << "SO_ZEROCOPY不可用: " << strerror(errno) << std::endl;
+    close(sender);
+    close(receiver);
+    return false;
+  }
+  int flags = fcntl(sender, F_GETFL, 0);
+  fcntl(sender, F_SETFL, flags | O_NONBLOCK);
+
+  const size_t total = message_bytes * static_cast<size_t>(messages);
+  std::thread drain([receiver, total]() {
+    std::vector<char> buffer(1 << 20);
+    size_t received = 0;
+    while (received < total) {
+      ssize_t n = recv(receiver, buffer.data(), buffer.size(), 0);
+      if (n <= 0) {
+        return;
+      }
+      received += static_cast<size_t>(n);
+    }
+  });
+
+  // 与服务端的广播一样用共享缓冲区入队，不把构造消息的开销算进发送
+  auto message = std::make_shared<const std::vector<char>>(message_bytes, 'x');
+  OutputQueue queue;
+  if (zerocopy) {
+    queue.set_zerocopy_threshold(message_bytes);
+  }
+  OutputQueue::FlushStats stats;
+  struct pollfd pfd {};
+  pfd.fd = sender;
+  pfd.events = POLLOUT;
+
+  bool ok = true;
+  auto start = std::chrono::steady_clock::now();
+  double cpu_start = thread_cpu_seconds();
+  for (long i = 0; i < messages && ok; ++i) {
+    queue.push(message);
+    // 每条消息写完再入队下一条，避免队列无限增长
+    while (ok && !queue.empty()) {
+      OutputQueue::FlushResult result = queue.flush(sender, &stats);
+      if (result == OutputQueue::FLUSH_ERROR) {
+        std::cerr << name << " 发送失败: " << strerror(errno) << std::endl;
+        ok = false;
+      } else if (result == OutputQueue::FLUSH_PENDING) {
+        poll(&pfd, 1, 1000);
+      }
+    }
+  }
+  // 等所有零拷贝发送的完成通知（EPOLLERR/POLLERR）
+  while (ok && queue.zerocopy_inflight() > 0) {
+    pfd.events = 0;
+    if (poll(&pfd, 1, 1000) <= 0) {
+      std::cerr << name << " 等待完成通知超时，在途="
+                << queue.zerocopy_inflight() << std::endl;
+      ok = false;
+      break;
+    }
+    queue.reap_zerocopy(sender, &stats);
+  }
+  double cpu = thread_cpu_seconds() - cpu_start;
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  drain.join();
+  close(sender);
+  close(receiver);
+
+  double mb = static_cast<double>(total) / (1024 * 1024);
+  std::cout << name << " " << message_bytes / (1024 * 1024) << "MB×"
+            << messages << ": 耗时=" << elapsed.count()
+            << "s, MB/秒=" << static_cast<long>(mb / elapsed.count())
+            << ", 发送线程CPU=" << cpu * 1000 << "ms (每MB "
+            << cpu * 1e6 / mb << "us), sendmsg=" << stats.syscalls;
+  if (zerocopy) {
+    std::cout << ", 零拷贝=" << stats.zerocopy_sends
+              << ", 退回拷贝=" << stats.zerocopy_copied;
+  }
+  std::cout << std::endl;
+  return ok;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  BenchConfig config;
+  if (argc > 1) {
+    config.messages = std::max(1L, std::atol(argv[1]));
+  }
+  if (argc > 2) {
+    config.sizes_mb.clear();
+    for (int i = 2; i < argc; ++i) {
+      config.sizes_mb.push_back(
+          static_cast<size_t>(std::max(1L, std::atol(argv[i]))));
+    }
+  }
+
+  std::cout << "=== 大消息发送: 普通sendmsg vs MSG_ZEROCOPY（TCP回环）==="
+            << std::endl;
+  bool ok = true;
+  for (size_t mb : config.sizes_mb) {
+    size_t bytes = mb * 1024 * 1024;
+    ok = run_case("拷贝", bytes, config.messages, false) && ok;
+    ok = run_case("零拷贝", bytes, config.messages, true) && ok;
+  }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,159 @@
+// 控制命令往返检查（协议v1）：本程序同时扮演设备和Qt客户端，
+//   1. 设备连接上线
+//   2. Qt连接发送带参数的QT_CONTROL_REQUEST
+//   3. 设备收到的CONTROL_COMMAND中parameters应为"请求ID|原参数"
+//   4. 设备按该请求ID回复CONTROL_RESPONSE，Qt连接应收到成功的控制响应
+//
+// 用法: test_control_round_trip <端口> [设备ID=projector_101] [参数=brightness=80]
+//
+// 设备ID必须已在数据库中注册。
+#include "message_schema.h"
+#include "protocol_parser.h"
+
+#include <arpa/inet.h>
+#include <cstdlib>
+#include <iostream>
+#include <netinet/in.h>
+#include <string>
+#include <string_view>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+// 阻塞连接并设置接收超时，失败返回-1
+int connect_tcp(int port) {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0) {
+    return -1;
+  }
+  struct sockaddr_in addr {};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons(static_cast<uint16_t>(port));
+  if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+    close(fd);
+    return -1;
+  }
+  struct timeval timeout {};
+  timeout.tv_sec = 5;
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  return fd;
+}
+
+// 阻塞读满一个响应帧
+bool read_frame(int fd, std::vector<char> &buffer) {
+  uint32_t net_len;
+  if (recv(fd, &net_len, sizeof(net_len), MSG_WAITALL) !=
+      static_cast<ssize_t>(sizeof(net_len))) {
+    return false;
+  }
+  size_t len = ntohl(net_len);
+  buffer.resize(len);
+  return len == 0 ||
+         recv(fd, buffer.data(), len, MSG_WAITALL) == static_cast<ssize_t>(len);
+}
+
+// 读到指定类型的消息为止，其间的其他消息（状态查询等）跳过
+bool wait_for(int fd, ProtocolParser::MessageType type,
+              ProtocolParser::ParseResult &result) {
+  std::vector<char> frame;
+  while (read_frame(fd, frame)) {
+    result = ProtocolParser::parse_message(
+        std::string_view(frame.data(), frame.size()));
+    if (result.success && result.type == type) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool send_all(int fd, const std::vector<char> &message) {
+  return send(fd, message.data(), message.size(), MSG_NOSIGNAL) ==
+         static_cast<ssize_t>(message.size());
+}
+
+bool check(const char *name, bool ok) {
+  std::cout << (ok ? "[通过] " : "[失败] ") << name << std::endl;
+  return ok;
+}
+
+// 设备上线后等待一条控制命令，按命令中的请求ID回复成功，返回收到的parameters
+bool run(int equipment_fd, int qt_fd, const std::string &equipment_id,
+         const std::string &parameters) {
+  using P = ProtocolParser;
+  P::ParseResult result;
+  if (!check("设备上线",
+             send_all(equipment_fd,
+                      P::build_online_message(P::CLIENT_EQUIPMENT, equipment_id,
+                                              "test", "projector")) &&
+                 wait_for(equipment_fd, P::ONLINE_RESPONSE, result) &&
+                 result.payload.rfind("success", 0) == 0)) {
+    return false;
+  }
+
+  if (!check("Qt发送控制请求",
+             send_all(qt_fd, P::build_control_command_to_server(
+                                 P::CLIENT_QT_CLIENT, equipment_id,
+                                 P::ADJUST_SETTINGS, parameters)))) {
+    return false;
+  }
+
+  using Command = message_schema::ControlCommand;
+  message_schema::Decoded<Command> command;
+  if (!check("设备收到控制命令",
+             wait_for(equipment_fd, P::CONTROL_COMMAND, result) &&
+                 command.decode(result.payload) == message_schema::DECODE_OK)) {
+    return false;
+  }
+  // parameters第一段是请求ID，之后是原参数
+  std::string_view received = command.text<Command::PARAMETERS>();
+  size_t id_end = received.find('|');
+  std::string_view request_id = received.substr(0, id_end);
+  bool separated = id_end != std::string_view::npos &&
+                   received.substr(id_end + 1) == parameters;
+  std::cout << "  parameters=\"" << received << "\"" << std::endl;
+  bool ok = check("请求ID与参数分隔", separated);
+
+  send_all(equipment_fd,
+           message_schema::build<message_schema::ControlResponse>(
+               P::CLIENT_EQUIPMENT, equipment_id, request_id, "success",
+               "adjust_settings", "设置已调整"));
+
+  using Response = message_schema::ControlResponse;
+  message_schema::Decoded<Response> response;
+  bool replied = wait_for(qt_fd, P::CONTROL_RESPONSE, result) &&
+                 response.decode(result.payload) == message_schema::DECODE_OK &&
+                 response.text<Response::RESULT>() == "success";
+  if (replied) {
+    std::cout << "  响应: " << result.payload << std::endl;
+  }
+  return check("Qt收到成功响应", replied) && ok;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    std::cerr << "用法: " << argv[0]
+              << " <端口> [设备ID=projector_101] [参数=brightness=80]"
+              << std::endl;
+    return 1;
+  }
+  int port = std::atoi(argv[1]);
+  std::string equipment_id = argc > 2 ? argv[2] : "projector_101";
+  std::string parameters = argc > 3 ? argv[3] : "brightness=80";
+
+  int equipment_fd = connect_tcp(port);
+  int qt_fd = connect_tcp(port);
+  if (equipment_fd < 0 || qt_fd < 0) {
+    std::cerr << "连接失败: " << port << std::endl;
+    return 1;
+  }
+  bool ok = run(equipment_fd, qt_fd, equipment_id, parameters);
+  close(equipment_fd);
+  close(qt_fd);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,131 @@
+// 设备端口与Qt端口分离（EMS_QT_PORT）时的连接检查：
+//   1. 设备端口上的连接发送EQUIPMENT_ONLINE，应收到上线成功响应
+//   2. 上线后的设备心跳应收到HEARTBEAT_RESPONSE
+//   3. Qt端口上的连接发送QT_HEARTBEAT，应收到QT_HEARTBEAT_RESPONSE
+//
+// 用法: test_split_ports <设备端口> <Qt端口> [设备ID=projector_101]
+//
+// 服务端需要开启端口分离，设备ID必须已在数据库中注册：
+//   EMS_PORT=9000 EMS_QT_PORT=9001 ./EMS_server
+#include "protocol_parser.h"
+
+#include <arpa/inet.h>
+#include <cstdlib>
+#include <iostream>
+#include <netinet/in.h>
+#include <string>
+#include <string_view>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+// 阻塞连接并设置接收超时，失败返回-1
+int connect_tcp(int port) {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0) {
+    return -1;
+  }
+  struct sockaddr_in addr {};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons(static_cast<uint16_t>(port));
+  if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+    close(fd);
+    return -1;
+  }
+  struct timeval timeout {};
+  timeout.tv_sec = 5;
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  return fd;
+}
+
+// 阻塞读满一个响应帧
+bool read_frame(int fd, std::vector<char> &buffer) {
+  uint32_t net_len;
+  if (recv(fd, &net_len, sizeof(net_len), MSG_WAITALL) !=
+      static_cast<ssize_t>(sizeof(net_len))) {
+    return false;
+  }
+  size_t len = ntohl(net_len);
+  buffer.resize(len);
+  return len == 0 ||
+         recv(fd, buffer.data(), len, MSG_WAITALL) == static_cast<ssize_t>(len);
+}
+
+// 发送请求并等待指定类型的响应，返回响应的payload
+bool request(int fd, const std::vector<char> &message,
+             ProtocolParser::MessageType expected, std::string &payload) {
+  if (send(fd, message.data(), message.size(), MSG_NOSIGNAL) < 0) {
+    return false;
+  }
+  std::vector<char> frame;
+  if (!read_frame(fd, frame)) {
+    return false;
+  }
+  ProtocolParser::ParseResult result = ProtocolParser::parse_message(
+      std::string_view(frame.data(), frame.size()));
+  if (!result.success || result.type != expected) {
+    return false;
+  }
+  payload = result.payload;
+  return true;
+}
+
+bool check(const char *name, bool ok) {
+  std::cout << (ok ? "[通过] " : "[失败] ") << name << std::endl;
+  return ok;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  if (argc < 3) {
+    std::cerr << "用法: " << argv[0]
+              << " <设备端口> <Qt端口> [设备ID=projector_101]" << std::endl;
+    return 1;
+  }
+  int equipment_port = std::atoi(argv[1]);
+  int qt_port = std::atoi(argv[2]);
+  std::string equipment_id = argc > 3 ? argv[3] : "projector_101";
+
+  using P = ProtocolParser;
+  bool ok = true;
+  std::string payload;
+
+  int equipment_fd = connect_tcp(equipment_port);
+  if (equipment_fd < 0) {
+    std::cerr << "连接设备端口失败: " << equipment_port << std::endl;
+    return 1;
+  }
+  bool online =
+      request(equipment_fd,
+              P::build_online_message(P::CLIENT_EQUIPMENT, equipment_id,
+                                      "test", "projector"),
+              P::ONLINE_RESPONSE, payload) &&
+      payload.rfind("success", 0) == 0;
+  ok = check("设备端口上线", online) && ok;
+  ok = check("设备心跳",
+             online && request(equipment_fd,
+                               P::build_heartbeat_message(P::CLIENT_EQUIPMENT,
+                                                          equipment_id),
+                               P::HEARTBEAT_RESPONSE, payload)) &&
+       ok;
+  close(equipment_fd);
+
+  int qt_fd = connect_tcp(qt_port);
+  if (qt_fd < 0) {
+    std::cerr << "连接Qt端口失败: " << qt_port << std::endl;
+    return 1;
+  }
+  ok = check("Qt端口心跳",
+             request(qt_fd,
+                     P::build_qt_heartbeat_message(P::CLIENT_QT_CLIENT,
+                                                   "qt_client"),
+                     P::QT_HEARTBEAT_RESPONSE, payload)) &&
+       ok;
+  close(qt_fd);
+  return ok ? 0 : 1;
+}